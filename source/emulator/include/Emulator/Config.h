@@ -53,6 +53,9 @@ bool                   ShaderValidationEnabled();
 ShaderOptimizationType GetShaderOptimizationType();
 ShaderLogDirection     GetShaderLogDirection();
 String                 GetShaderLogFolder();
+bool                   ShaderCacheEnabled();
+String                 GetShaderCacheFolder();
+bool                   PipelineCacheEnabled();
 
 bool   CommandBufferDumpEnabled();
 String GetCommandBufferDumpFolder();
@@ -60,6 +63,7 @@ String GetCommandBufferDumpFolder();
 Log::Direction GetPrintfDirection();
 String         GetPrintfOutputFile();
 String         GetPrintfOutputFolder();
+bool           PrintfAsyncEnabled();
 
 ProfilerDirection GetProfilerDirection();
 String            GetProfilerOutputFile();
@@ -69,6 +73,11 @@ bool SpirvDebugPrintfEnabled();
 bool   PipelineDumpEnabled();
 String GetPipelineDumpFolder();
 
+bool GpuMemoryWatcherEnabled();
+bool GpuMemoryLazyWriteBack();
+
+bool LibcHostFunctionsEnabled();
+
 } // namespace Kyty::Config
 
 #endif
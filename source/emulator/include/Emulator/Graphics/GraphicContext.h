@@ -29,7 +29,7 @@ struct VulkanSwapchain
 
 struct VulkanCommandPool
 {
-	Core::Mutex      mutex;
+	Core::Mutex      mutex {Core::Mutex::Type::Recursive};
 	VkCommandPool    pool          = nullptr;
 	VkCommandBuffer* buffers       = nullptr;
 	VkFence*         fences        = nullptr;
@@ -65,16 +65,23 @@ struct GraphicContext
 	VkPhysicalDevice         physical_device = nullptr;
 	VkDevice                 device          = nullptr;
 	VulkanQueueInfo          queues[QUEUES_NUM];
+
+	// VK_EXT_external_memory_host: guest memory can be imported as a buffer
+	// Every imported range is a separate VkDeviceMemory, so only a part of maxMemoryAllocationCount is spent on them.
+	bool         external_memory_host   = false;
+	VkDeviceSize host_pointer_alignment = 0;
+	uint32_t     imported_ranges_max    = 0;
 };
 
 struct VulkanMemory
 {
-	VkMemoryRequirements  requirements = {};
-	VkMemoryPropertyFlags property     = 0;
-	VkDeviceMemory        memory       = nullptr;
-	VkDeviceSize          offset       = 0;
-	uint32_t              type         = 0;
-	uint64_t              unique_id    = 0;
+	VkMemoryRequirements  requirements  = {};
+	VkMemoryPropertyFlags property      = 0;
+	VkDeviceMemory        memory        = nullptr;
+	VkDeviceSize          offset        = 0;
+	uint32_t              type          = 0;
+	uint64_t              unique_id     = 0;
+	void*                 suballocation = nullptr;
 };
 
 enum class VulkanImageType
@@ -143,6 +150,16 @@ struct StorageVulkanBuffer: public VulkanBuffer
 	CommandProcessor* cp = nullptr;
 };
 
+struct VulkanImportedRange;
+
+// Vertex or index data. An imported buffer aliases the guest memory, the data starts at the offset.
+struct GuestVulkanBuffer: public VulkanBuffer
+{
+	VkDeviceSize         offset   = 0;
+	bool                 imported = false;
+	VulkanImportedRange* range    = nullptr;
+};
+
 } // namespace Kyty::Libs::Graphics
 
 #endif // KYTY_EMU_ENABLED
@@ -104,6 +104,7 @@ void  GpuMemoryFlushAll(GraphicContext* ctx);
 void  GpuMemoryFrameDone();
 void  GpuMemoryWriteBack(GraphicContext* ctx, CommandProcessor* cp);
 bool  GpuMemoryCheckAccessViolation(uint64_t vaddr, uint64_t size);
+bool  GpuMemoryCheckReadAccess(uint64_t vaddr, uint64_t size);
 bool  GpuMemoryWatcherEnabled();
 
 Vector<GpuMemoryObject> GpuMemoryFindObjects(uint64_t vaddr, uint64_t size, GpuMemoryObjectType type, bool exact, bool only_first);
@@ -6,6 +6,8 @@
 #include "Emulator/Common.h"
 #include "Emulator/Graphics/Objects/GpuMemory.h"
 
+#include <vulkan/vulkan_core.h>
+
 #ifdef KYTY_EMU_ENABLED
 
 namespace Kyty::Libs::Graphics {
@@ -65,6 +67,10 @@ Label* LabelCreate32(GraphicContext* ctx, uint32_t* dst_gpu_addr, uint32_t value
 void   LabelDelete(Label* label);
 void   LabelSet(CommandBuffer* buffer, Label* label);
 
+// Called with the queue locked, before the buffer is submitted. Returns true if the submit must signal the timeline semaphore with the
+// value to retire the labels set in the buffer
+bool LabelSubmit(CommandBuffer* buffer, int queue, VkSemaphore* semaphore, uint64_t* value);
+
 } // namespace Kyty::Libs::Graphics
 
 #endif // KYTY_EMU_ENABLED
@@ -1026,6 +1026,7 @@ bool             ShaderIsDisabled(uint64_t addr);
 bool             ShaderIsDisabled2(uint64_t addr, uint64_t chksum);
 void             ShaderDisable(uint64_t id);
 void             ShaderInjectDebugPrintf(uint64_t id, const ShaderDebugPrintf& cmd);
+bool             ShaderIsDebugPrintfInjected(const ShaderId& id);
 
 } // namespace Kyty::Libs::Graphics
 
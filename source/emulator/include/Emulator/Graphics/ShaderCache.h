@@ -0,0 +1,24 @@
+#ifndef EMULATOR_INCLUDE_EMULATOR_GRAPHICS_SHADERCACHE_H_
+#define EMULATOR_INCLUDE_EMULATOR_GRAPHICS_SHADERCACHE_H_
+
+#include "Kyty/Core/Common.h"
+#include "Kyty/Core/Vector.h"
+
+#include "Emulator/Common.h"
+#include "Emulator/Graphics/Shader.h"
+
+#ifdef KYTY_EMU_ENABLED
+
+namespace Kyty::Libs::Graphics {
+
+// Persistent cache of recompiled SPIR-V binaries. Entries are keyed by ShaderId plus the shader
+// compiler config, loaded once at startup and appended to the cache file by a background thread.
+void ShaderCacheInit();
+bool ShaderCacheFind(ShaderType type, const ShaderId& id, Vector<uint32_t>* spirv);
+void ShaderCacheAdd(ShaderType type, const ShaderId& id, const Vector<uint32_t>& spirv);
+
+} // namespace Kyty::Libs::Graphics
+
+#endif // KYTY_EMU_ENABLED
+
+#endif /* EMULATOR_INCLUDE_EMULATOR_GRAPHICS_SHADERCACHE_H_ */
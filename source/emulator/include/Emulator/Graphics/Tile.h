@@ -41,6 +41,9 @@ void TileInit();
 void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_t width, uint32_t height, bool neo);
 void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height,
                               uint32_t pitch, uint32_t levels, bool neo);
+void TileConvertLinearToTiled(void* dst, const void* src, TileMode mode, uint32_t width, uint32_t height, bool neo);
+void TileConvertLinearToTiled(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height,
+                              uint32_t pitch, uint32_t levels, bool neo);
 
 bool TileGetDepthSize(uint32_t width, uint32_t height, uint32_t pitch, uint32_t z_format, uint32_t stencil_format, bool htile, bool neo,
                       bool next_gen, TileSizeAlign* stencil_size, TileSizeAlign* htile_size, TileSizeAlign* depth_size);
@@ -50,6 +53,14 @@ void TileGetTextureSize(uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t h
 void TileGetTextureSize2(uint32_t format, uint32_t width, uint32_t height, uint32_t pitch, uint32_t levels, uint32_t tile,
                          TileSizeAlign* total_size, TileSizeOffset* level_sizes, TilePaddedSize* padded_size);
 
+#ifdef KYTY_EMU_TESTS
+// Level 0 of a VideoOut surface or of a texture with 8x8 element tiles, for TileBenchmark(). The reference converts element by element.
+void TileGetSurfaceSize(TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height, bool neo, uint64_t* linear_size,
+                        uint64_t* tiled_size);
+void TileConvertSurface(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height, bool neo,
+                        bool to_tiled, bool reference);
+#endif
+
 } // namespace Kyty::Libs::Graphics
 
 #endif
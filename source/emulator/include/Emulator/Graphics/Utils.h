@@ -19,6 +19,7 @@ namespace Kyty::Libs::Graphics {
 class CommandBuffer;
 struct GraphicContext;
 struct VulkanBuffer;
+struct GuestVulkanBuffer;
 struct VulkanImage;
 struct DepthStencilVulkanImage;
 struct VulkanSwapchain;
@@ -47,9 +48,11 @@ struct ImageImageCopy
 	int          dst_y;
 };
 
-void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, uint32_t src_pitch, VulkanImage* dst_image, uint64_t dst_layout);
+void UtilInit();
+void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, uint32_t src_pitch, VulkanImage* dst_image, uint64_t dst_layout,
+                       uint64_t src_offset = 0);
 void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, VulkanImage* dst_image, const Vector<BufferImageCopy>& regions,
-                       uint64_t dst_layout);
+                       uint64_t dst_layout, uint64_t src_offset = 0);
 void UtilImageToBuffer(CommandBuffer* buffer, VulkanImage* src_image, VulkanBuffer* dst_buffer, uint32_t dst_pitch, uint64_t src_layout);
 void UtilImageToImage(CommandBuffer* buffer, const Vector<ImageImageCopy>& regions, VulkanImage* dst_image, uint64_t dst_layout);
 void UtilBlitImage(CommandBuffer* buffer, VulkanImage* src_image, VulkanSwapchain* dst_swapchain);
@@ -59,12 +62,19 @@ void UtilFillImage(GraphicContext* ctx, VulkanImage* dst_image, const void* src_
                    uint64_t dst_layout);
 void UtilFillImage(GraphicContext* ctx, const Vector<ImageImageCopy>& regions, VulkanImage* dst_image, uint64_t dst_layout);
 void UtilFillBuffer(GraphicContext* ctx, void* dst_data, uint64_t size, uint32_t dst_pitch, VulkanImage* src_image, uint64_t src_layout);
+void UtilFillBuffer(GraphicContext* ctx, VulkanBuffer* dst_buffer, const void* src_data, uint64_t size);
+void UtilFlushUploads(GraphicContext* ctx);
 void UtilCopyBuffer(VulkanBuffer* src_buffer, VulkanBuffer* dst_buffer, uint64_t size);
 void UtilSetDepthLayoutOptimal(DepthStencilVulkanImage* image);
 void UtilSetImageLayoutOptimal(VulkanImage* image);
 
 void VulkanCreateBuffer(GraphicContext* gctx, uint64_t size, VulkanBuffer* buffer);
 void VulkanDeleteBuffer(GraphicContext* gctx, VulkanBuffer* buffer);
+void VulkanAddImportRange(uint64_t vaddr, uint64_t size);
+void VulkanRemoveImportRange(GraphicContext* gctx, uint64_t vaddr, uint64_t size);
+bool VulkanImportBuffer(GraphicContext* gctx, uint64_t vaddr, uint64_t size, GuestVulkanBuffer* buffer);
+void VulkanDeleteImportedBuffer(GraphicContext* gctx, GuestVulkanBuffer* buffer);
+void VulkanDeleteRetiredImportedBuffers(GraphicContext* gctx);
 
 inline std::pair<int, int> UtilCalcMipmapOffset(uint32_t lod, uint32_t width, uint32_t height)
 {
@@ -18,9 +18,10 @@
 #define LIB_DEFINE(name) void name(Loader::SymbolDatabase* s)
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define LIB_NAME(l, m)                                                                                                                     \
-	[[maybe_unused]] static thread_local bool PRINT_NAME_ENABLED = true;                                                                   \
-	static constexpr char                     g_library[]        = l;                                                                      \
-	static constexpr char                     g_module[]         = m;
+	[[maybe_unused]] static thread_local bool      PRINT_NAME_ENABLED = true;                                                              \
+	[[maybe_unused]] static Kyty::Log::TraceSwitch g_trace(l);                                                                             \
+	static constexpr char                          g_library[]        = l;                                                                 \
+	static constexpr char                          g_module[]         = m;
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define LIB_VERSION(l, lv, m, mv1, mv2)                                                                                                    \
 	LIB_NAME(l, m);                                                                                                                        \
@@ -63,15 +64,15 @@
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define LIB_FUNC(n, f) LIB_ADD(n, f, Loader::SymbolType::Func)
 
+// True if calls of this library are traced, guards extra output of a traced call
+// NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
+#define PRINT_NAME_TRACED() (g_trace.IsEnabled() && PRINT_NAME_ENABLED)
+
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define PRINT_NAME()                                                                                                                       \
-	if (PRINT_NAME_ENABLED)                                                                                                                \
+	if (PRINT_NAME_TRACED())                                                                                                               \
 	{                                                                                                                                      \
-		if (Kyty::Log::GetDirection() != Kyty::Log::Direction::Silent)                                                                     \
-		{                                                                                                                                  \
-			Kyty::printf(FG_CYAN "[%d][%s] %s::%s::%s()" DEFAULT "\n", Core::Thread::GetThreadIdUnique(),                                  \
-			             Loader::Timer::GetTime().ToString("HH24:MI:SS.FFF").C_Str(), g_library, g_module, __func__);                      \
-		}                                                                                                                                  \
+		Kyty::Log::Trace(g_library, g_module, __func__);                                                                                   \
 	}
 
 namespace Kyty {
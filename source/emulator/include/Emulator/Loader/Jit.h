@@ -141,6 +141,40 @@ struct SafeCall
 	};
 };
 
+// Linux keeps the host thread pointer in fs, Windows keeps TEB in gs
+#if KYTY_PLATFORM == KYTY_PLATFORM_WINDOWS
+constexpr uint8_t TLS_SEGMENT_PREFIX = 0x65;
+#else
+constexpr uint8_t TLS_SEGMENT_PREFIX = 0x64;
+#endif
+
+// Reads the cached TLS base of the current thread from a host TLS slot.
+// If the slot is not set yet (first access from the thread), falls back to SafeCall.
+// Preserves all registers (except rax) and flags.
+struct TlsCall
+{
+	void SetSlotOffset(int32_t offset) { *reinterpret_cast<int32_t*>(&code[0x05]) = offset; }
+
+	SafeCall* GetSlowCall() { return &slow_call; }
+
+	static uint64_t GetSize() { return 0x1000; }
+
+	uint8_t code[0x40] = {
+	    /*00*/ TLS_SEGMENT_PREFIX, 0x48, 0x8b, 0x04, 0x25, 0x00, 0x00, 0x00, 0x00, // mov    rax,QWORD PTR fs:<offset>
+	    /*09*/ 0x48, 0x91,                                                       // xchg   rcx,rax
+	    /*0b*/ 0xe3, 0x03,                                                       // jrcxz  10 <SLOW>
+	    /*0d*/ 0x48, 0x91,                                                       // xchg   rcx,rax
+	    /*0f*/ 0xc3,                                                             // ret
+	    /*10*/ 0x48, 0x91,                                                       // xchg   rcx,rax  /* SLOW */
+	    /*12*/ 0x9c,                                                             // pushf
+	    /*13*/ 0xe8, 0x28, 0x00, 0x00, 0x00,                                     // call   40 <slow_call>
+	    /*18*/ 0x9d,                                                             // popf
+	    /*19*/ 0xc3,                                                             // ret
+	};
+
+	SafeCall slow_call;
+};
+
 #pragma pack()
 
 } // namespace Kyty::Loader::Jit
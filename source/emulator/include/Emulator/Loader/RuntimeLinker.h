@@ -32,19 +32,21 @@ struct ModuleId
 		return version_major == other.version_major && version_minor == other.version_minor && name == other.name;
 	}
 
-	String id;
-	int    version_major;
-	int    version_minor;
-	String name;
+	String   id;
+	int      version_major;
+	int      version_minor;
+	String   name;
+	uint64_t key;
 };
 
 struct LibraryId
 {
 	bool operator==(const LibraryId& other) const { return version == other.version && name == other.name; }
 
-	String id;
-	int    version;
-	String name;
+	String   id;
+	int      version;
+	String   name;
+	uint64_t key;
 };
 
 struct ThreadLocalStorage
@@ -152,6 +154,9 @@ public:
 
 	void Resolve(const String& name, SymbolType type, Program* program, SymbolRecord* out_info, bool* bind_self);
 
+	// Same as Resolve, but doesn't lock. Used by relocation workers while RelocateAll holds the lock on their behalf.
+	void ResolveNoLock(const String& name, SymbolType type, Program* program, SymbolRecord* out_info, bool* bind_self);
+
 	SymbolDatabase* Symbols() { return m_symbols; }
 
 	static uint64_t ReadFromElf(Program* program, uint64_t vaddr);
@@ -171,6 +176,7 @@ private:
 	static void DeleteProgram(Program* program);
 	static void SetupTlsHandler(Program* program);
 
+	// Doesn't lock, see ResolveNoLock
 	Program* FindProgram(const ModuleId& m, const LibraryId& l);
 
 	static const ModuleId*  FindModule(const Program& program, const String& id);
@@ -179,7 +185,7 @@ private:
 	Vector<Program*> m_programs;
 	SymbolDatabase*  m_symbols   = nullptr;
 	bool             m_relocated = false;
-	Core::Mutex      m_mutex;
+	Core::Mutex      m_mutex {Core::Mutex::Type::Recursive};
 };
 
 } // namespace Kyty::Loader
@@ -49,6 +49,7 @@ public:
 	void Add(const SymbolResolve& s, uint64_t vaddr, const String& dbg_name);
 
 	[[nodiscard]] const SymbolRecord* Find(const SymbolResolve& s) const;
+	[[nodiscard]] const SymbolRecord* Find(uint64_t key) const;
 
 	void DbgDump(const String& folder, const String& file_name);
 
@@ -56,9 +57,18 @@ public:
 
 	static String GenerateName(const SymbolResolve& s);
 
+	// Symbols are looked up by a 64-bit hash of (library, module, versions, nid, type). Library and module parts
+	// can be computed once per LibraryId/ModuleId and combined with the nid for every relocation.
+	static uint64_t GenerateKey(const SymbolResolve& s);
+	static uint64_t GenerateKey(uint64_t library_key, uint64_t module_key, const String& name, SymbolType type);
+	static uint64_t GenerateLibraryKey(const String& library, int library_version);
+	static uint64_t GenerateModuleKey(const String& module, int module_version_major, int module_version_minor);
+
 private:
-	Vector<SymbolRecord>            m_symbols;
-	Core::Hashmap<String, uint32_t> m_map;
+	void Add(const SymbolResolve& s, SymbolRecord* r);
+
+	Vector<SymbolRecord>              m_symbols;
+	Core::Hashmap<uint64_t, uint32_t> m_map;
 };
 
 } // namespace Kyty::Loader
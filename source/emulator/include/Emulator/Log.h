@@ -6,6 +6,8 @@
 #include "Kyty/Core/String.h"
 #include "Kyty/Core/Subsystems.h"
 
+#include <atomic>
+
 //#include "Emulator/Config.h"
 
 //#define KYTY_LOG_ENABLED
@@ -76,6 +78,35 @@ void      SetOutputFile(const String& file_name, Core::File::Encoding enc = Core
 bool   IsColoredPrintf();
 String RemoveColors(const String& str);
 
+// Runtime switch for HLE call tracing (see PRINT_NAME). Every LIB_NAME defines one,
+// switches with the same library name are toggled together.
+class TraceSwitch
+{
+public:
+	explicit TraceSwitch(const char* library);
+	~TraceSwitch() = default;
+
+	[[nodiscard]] bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+	void               SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+
+	[[nodiscard]] const char*  GetLibrary() const { return m_library; }
+	[[nodiscard]] TraceSwitch* GetNext() const { return m_next; }
+
+	KYTY_CLASS_NO_COPY(TraceSwitch);
+
+private:
+	const char*      m_library;
+	std::atomic_bool m_enabled {true};
+	TraceSwitch*     m_next;
+};
+
+// Returns false if there is no such library
+bool TraceEnable(const String& library, bool enabled);
+void TraceEnableAll(bool enabled);
+
+// Called by PRINT_NAME, the strings must be static
+void Trace(const char* library, const char* module, const char* func);
+
 } // namespace Log
 
 void printf(const char* format, ...) KYTY_FORMAT_PRINTF(1, 2);
@@ -11,7 +11,8 @@
 #define BUILD_WITH_EASY_PROFILER
 #define EASY_PROFILER_STATIC
 
-#include <easy/profiler.h> // IWYU pragma: export
+#include <easy/arbitrary_value.h> // IWYU pragma: export
+#include <easy/profiler.h>        // IWYU pragma: export
 
 //
 #include "easy/details/profiler_aux.h"    // IWYU pragma: export
@@ -37,6 +38,8 @@
 
 #define KYTY_PROFILER_THREAD(f) EASY_THREAD(f)
 
+#define KYTY_PROFILER_VALUE(f, v) EASY_VALUE(f, v, EASY_GLOBAL_VIN);
+
 namespace Kyty::Profiler {
 
 KYTY_SUBSYSTEM_DEFINE(Profiler);
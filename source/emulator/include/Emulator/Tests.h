@@ -0,0 +1,34 @@
+#ifndef EMULATOR_INCLUDE_EMULATOR_TESTS_H_
+#define EMULATOR_INCLUDE_EMULATOR_TESTS_H_
+
+#include "Kyty/Core/Common.h"
+
+#include "Emulator/Common.h"
+
+// Stress tests and benchmarks, run by the script functions. They are built with KYTY_EMU_TESTS only.
+#if defined(KYTY_EMU_ENABLED) && defined(KYTY_EMU_TESTS)
+
+namespace Kyty::Libs {
+
+namespace LibKernel {
+
+// Creates, deletes and reuses keys from several guest threads
+void PthreadKeysTest();
+
+} // namespace LibKernel
+
+namespace Graphics {
+
+// Creates, updates and deletes GPU objects from several threads
+void GpuMemoryStressTest();
+
+// Detile/retile throughput for common surfaces, checked against the per-element reference and by round trip
+void TileBenchmark();
+
+} // namespace Graphics
+
+} // namespace Kyty::Libs
+
+#endif
+
+#endif /* EMULATOR_INCLUDE_EMULATOR_TESTS_H_ */
@@ -12,6 +12,7 @@ local cfg = {
 	CommandBufferDumpFolder = '_Buffers';
 	PrintfDirection = 'Console'; -- Silent, Console, File
 	PrintfOutputFile = '_kyty.txt';
+	PrintfAsync = true; -- format and write the log in a background thread
 	ProfilerDirection = 'None'; -- None, File, Network,	FileAndNetwork
 	ProfilerOutputFile = '_profile.prof';
 }
@@ -39,6 +40,8 @@ kyty_load_symbols('libSystemService_1');
 kyty_load_symbols('libUserService_1');
 kyty_load_symbols('libVideoOut_1');
 
+-- kyty_trace('libkernel', false); -- HLE call tracing, per library ('*' for all)
+
 kyty_execute();
 
 
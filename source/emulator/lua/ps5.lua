@@ -12,6 +12,7 @@ local cfg = {
 	CommandBufferDumpFolder = '_Buffers';
 	PrintfDirection = 'Console'; -- Silent, Console, File
 	PrintfOutputFile = '_kyty.txt';
+	PrintfAsync = true; -- format and write the log in a background thread
 	ProfilerDirection = 'None'; -- None, File, Network,	FileAndNetwork
 	ProfilerOutputFile = '_profile.prof';
 }
@@ -31,6 +32,8 @@ kyty_load_symbols('libDiscMap_1');
 
 --kyty_dbg_dump('_elf/');
 
+-- kyty_trace('libkernel', false); -- HLE call tracing, per library ('*' for all)
+
 kyty_execute();
 
 
@@ -104,7 +104,7 @@ private:
 		uint64_t last_input_time = 0;
 	};
 
-	Core::Mutex m_mutex;
+	Core::Mutex m_mutex {Core::Mutex::Type::Recursive};
 	PortOut     m_out_ports[OUT_PORTS_MAX];
 	PortIn      m_in_ports[IN_PORTS_MAX];
 };
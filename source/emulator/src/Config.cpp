@@ -19,16 +19,23 @@ struct Config
 	ShaderOptimizationType shader_optimization_type    = ShaderOptimizationType::None;
 	ShaderLogDirection     shader_log_direction        = ShaderLogDirection::Silent;
 	String                 shader_log_folder           = U"_Shaders";
+	bool                   shader_cache_enabled        = true;
+	String                 shader_cache_folder         = U"_ShaderCache";
+	bool                   pipeline_cache_enabled      = true;
 	bool                   command_buffer_dump_enabled = false;
 	String                 command_buffer_dump_folder  = U"_Buffers";
 	Log::Direction         printf_direction            = Log::Direction::Console;
 	String                 printf_output_file          = U"_kyty.txt";
 	String                 printf_output_folder        = U"_Logs";
+	bool                   printf_async                = true;
 	ProfilerDirection      profiler_direction          = ProfilerDirection::None;
 	String                 profiler_output_file        = U"_profile.prof";
 	bool                   spirv_debug_printf_enabled  = false;
 	bool                   pipeline_dump_enabled       = false;
 	String                 pipeline_dump_folder        = U"_Pipelines";
+	bool                   gpu_memory_watcher_enabled  = false;
+	bool                   gpu_memory_lazy_write_back  = false;
+	bool                   libc_host_functions         = false;
 };
 
 static Config* g_config = nullptr;
@@ -92,16 +99,23 @@ void Load(const Scripts::ScriptVar& cfg)
 	LoadEnum(g_config->shader_optimization_type, cfg, U"ShaderOptimizationType");
 	LoadEnum(g_config->shader_log_direction, cfg, U"ShaderLogDirection");
 	LoadStr(g_config->shader_log_folder, cfg, U"ShaderLogFolder");
+	LoadBool(g_config->shader_cache_enabled, cfg, U"ShaderCacheEnabled");
+	LoadStr(g_config->shader_cache_folder, cfg, U"ShaderCacheFolder");
+	LoadBool(g_config->pipeline_cache_enabled, cfg, U"PipelineCacheEnabled");
 	LoadBool(g_config->command_buffer_dump_enabled, cfg, U"CommandBufferDumpEnabled");
 	LoadStr(g_config->command_buffer_dump_folder, cfg, U"CommandBufferDumpFolder");
 	LoadEnum(g_config->printf_direction, cfg, U"PrintfDirection");
 	LoadStr(g_config->printf_output_file, cfg, U"PrintfOutputFile");
 	LoadStr(g_config->printf_output_folder, cfg, U"PrintfOutputFolder");
+	LoadBool(g_config->printf_async, cfg, U"PrintfAsync");
 	LoadEnum(g_config->profiler_direction, cfg, U"ProfilerDirection");
 	LoadStr(g_config->profiler_output_file, cfg, U"ProfilerOutputFile");
 	LoadBool(g_config->spirv_debug_printf_enabled, cfg, U"SpirvDebugPrintfEnabled");
 	LoadBool(g_config->pipeline_dump_enabled, cfg, U"PipelineDumpEnabled");
 	LoadStr(g_config->pipeline_dump_folder, cfg, U"PipelineDumpFolder");
+	LoadBool(g_config->gpu_memory_watcher_enabled, cfg, U"GpuMemoryWatcherEnabled");
+	LoadBool(g_config->gpu_memory_lazy_write_back, cfg, U"GpuMemoryLazyWriteBack");
+	LoadBool(g_config->libc_host_functions, cfg, U"LibcHostFunctions");
 }
 
 uint32_t GetScreenWidth()
@@ -144,6 +158,21 @@ String GetShaderLogFolder()
 	return g_config->shader_log_folder;
 }
 
+bool ShaderCacheEnabled()
+{
+	return g_config->shader_cache_enabled;
+}
+
+String GetShaderCacheFolder()
+{
+	return g_config->shader_cache_folder;
+}
+
+bool PipelineCacheEnabled()
+{
+	return g_config->pipeline_cache_enabled;
+}
+
 bool CommandBufferDumpEnabled()
 {
 	return g_config->command_buffer_dump_enabled;
@@ -169,6 +198,11 @@ String GetPrintfOutputFolder()
 	return g_config->printf_output_folder;
 }
 
+bool PrintfAsyncEnabled()
+{
+	return g_config->printf_async;
+}
+
 ProfilerDirection GetProfilerDirection()
 {
 	return g_config->profiler_direction;
@@ -194,6 +228,21 @@ String GetPipelineDumpFolder()
 	return g_config->pipeline_dump_folder;
 }
 
+bool GpuMemoryWatcherEnabled()
+{
+	return g_config->gpu_memory_watcher_enabled;
+}
+
+bool GpuMemoryLazyWriteBack()
+{
+	return g_config->gpu_memory_lazy_write_back;
+}
+
+bool LibcHostFunctionsEnabled()
+{
+	return g_config->libc_host_functions;
+}
+
 void SetNextGen(bool mode)
 {
 	g_config->next_gen = mode;
@@ -14,7 +14,9 @@
 #include "Emulator/Graphics/Objects/Label.h"
 #include "Emulator/Graphics/Pm4.h"
 #include "Emulator/Graphics/Shader.h"
+#include "Emulator/Graphics/ShaderCache.h"
 #include "Emulator/Graphics/Tile.h"
+#include "Emulator/Graphics/Utils.h"
 #include "Emulator/Graphics/VideoOut.h"
 #include "Emulator/Graphics/Window.h"
 #include "Emulator/Kernel/Pthread.h"
@@ -38,10 +40,12 @@ KYTY_SUBSYSTEM_INIT(Graphics)
 	GraphicsRenderInit();
 	GraphicsRunInit();
 	GpuMemoryInit();
+	UtilInit();
 	LabelInit();
 	TileInit();
 	IndexBufferInit();
 	ShaderInit();
+	ShaderCacheInit();
 }
 
 KYTY_SUBSYSTEM_UNEXPECTED_SHUTDOWN(Graphics) {}
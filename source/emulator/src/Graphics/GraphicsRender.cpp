@@ -1,5 +1,6 @@
 #include "Emulator/Graphics/GraphicsRender.h"
 
+#include "Kyty/Core/ByteBuffer.h"
 #include "Kyty/Core/Common.h"
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/File.h"
@@ -23,6 +24,7 @@
 #include "Emulator/Graphics/Objects/Texture.h"
 #include "Emulator/Graphics/Objects/VertexBuffer.h"
 #include "Emulator/Graphics/Shader.h"
+#include "Emulator/Graphics/ShaderCache.h"
 #include "Emulator/Graphics/Tile.h"
 #include "Emulator/Graphics/Utils.h"
 #include "Emulator/Graphics/VideoOut.h"
@@ -33,6 +35,7 @@
 #include "Emulator/Profiler.h"
 
 #include <atomic>
+#include <xxhash/xxhash.h>
 
 // IWYU pragma: no_forward_declare VkImageView_T
 
@@ -147,7 +150,11 @@ public:
 	void            DeleteAllPipelines();
 
 private:
-	static constexpr uint32_t MAX_PIPELINES = 128;
+	// Soft limit: the least recently used pipelines are destroyed above it, but only if they were not used for
+	// PIPELINE_EVICT_FRAMES frames, otherwise the cache keeps growing.
+	static constexpr uint32_t PIPELINES_SOFT_LIMIT     = 1024;
+	static constexpr int      PIPELINE_EVICT_FRAMES    = 16;
+	static constexpr int      VULKAN_CACHE_SAVE_FRAMES = 60;
 
 	struct Pipeline
 	{
@@ -158,17 +165,41 @@ private:
 		VulkanPipeline*            pipeline       = nullptr;
 		PipelineStaticParameters*  static_params  = nullptr;
 		PipelineDynamicParameters* dynamic_params = nullptr;
+		uint64_t                   hash           = 0;
+		int                        last_frame     = 0;
+		int                        lru_prev       = -1;
+		int                        lru_next       = -1;
 	};
 
-	[[nodiscard]] VulkanPipeline* Find(const Pipeline& p) const;
+	static uint64_t CalcHash(const Pipeline& p);
+
+	[[nodiscard]] int Find(const Pipeline& p) const;
+
+	uint32_t Insert(const Pipeline& p);
+	void     Touch(uint32_t id);
+	void     LruUnlink(uint32_t id);
+	void     LruPushFront(uint32_t id);
+	void     Evict();
+
+	VkPipelineCache GetVulkanCache();
+	void            SaveVulkanCache();
 
 	void DeletePipelineInternal(uint32_t id);
 
 	void DumpToFile(Core::File* f, const Pipeline& p);
 	void DumpPipeline(const char* action, uint32_t id);
 
-	Vector<Pipeline> m_pipelines;
-	Core::Mutex      m_mutex;
+	Vector<Pipeline>                          m_pipelines;
+	Vector<uint32_t>                          m_free;
+	Core::Hashmap<uint64_t, Vector<uint32_t>> m_index;
+	int                                       m_lru_head            = -1;
+	int                                       m_lru_tail            = -1;
+	uint32_t                                  m_live_num            = 0;
+	VkPipelineCache                           m_vk_cache            = nullptr;
+	bool                                      m_vk_cache_init       = false;
+	bool                                      m_vk_cache_dirty      = false;
+	int                                       m_vk_cache_save_frame = 0;
+	Core::Mutex                               m_mutex;
 };
 
 struct VulkanDescriptorSet
@@ -245,7 +276,7 @@ private:
 
 	VulkanDescriptorSet* FindSet(const Set& s);
 
-	Core::Mutex  m_mutex;
+	Core::Mutex  m_mutex {Core::Mutex::Type::Recursive};
 	Vector<Pool> m_pools;
 	Vector<Set>  m_sets;
 	int          m_first_free_set  = -1;
@@ -1974,10 +2005,10 @@ static void CreateLayout(VkDescriptorSetLayout* set_layouts, uint32_t* set_layou
 }
 
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
-static VulkanPipeline* CreatePipelineInternal(VkRenderPass render_pass, const ShaderVertexInputInfo* vs_input_info,
-                                              const Vector<uint32_t>& vs_shader, const ShaderPixelInputInfo* ps_input_info,
-                                              const Vector<uint32_t>& ps_shader, const PipelineStaticParameters* static_params,
-                                              PipelineDynamicParameters* dynamic_params)
+static VulkanPipeline* CreatePipelineInternal(VkPipelineCache vk_cache, VkRenderPass render_pass,
+                                              const ShaderVertexInputInfo* vs_input_info, const Vector<uint32_t>& vs_shader,
+                                              const ShaderPixelInputInfo* ps_input_info, const Vector<uint32_t>& ps_shader,
+                                              const PipelineStaticParameters* static_params, PipelineDynamicParameters* dynamic_params)
 {
 	EXIT_IF(g_render_ctx == nullptr);
 	EXIT_IF(render_pass == nullptr);
@@ -2330,7 +2361,7 @@ static VulkanPipeline* CreatePipelineInternal(VkRenderPass render_pass, const Sh
 
 	EXIT_IF(pipeline->pipeline != nullptr);
 
-	vkCreateGraphicsPipelines(gctx->device, nullptr, 1, &pipeline_info, nullptr, &pipeline->pipeline);
+	vkCreateGraphicsPipelines(gctx->device, vk_cache, 1, &pipeline_info, nullptr, &pipeline->pipeline);
 
 	EXIT_NOT_IMPLEMENTED(pipeline->pipeline == nullptr);
 
@@ -2341,8 +2372,9 @@ static VulkanPipeline* CreatePipelineInternal(VkRenderPass render_pass, const Sh
 }
 
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
-static VulkanPipeline* CreatePipelineInternal(const ShaderComputeInputInfo* input_info, const Vector<uint32_t>& cs_shader,
-                                              const PipelineStaticParameters* static_params, PipelineDynamicParameters* dynamic_params)
+static VulkanPipeline* CreatePipelineInternal(VkPipelineCache vk_cache, const ShaderComputeInputInfo* input_info,
+                                              const Vector<uint32_t>& cs_shader, const PipelineStaticParameters* static_params,
+                                              PipelineDynamicParameters* dynamic_params)
 {
 	EXIT_IF(g_render_ctx == nullptr);
 	EXIT_IF(static_params == nullptr);
@@ -2414,7 +2446,7 @@ static VulkanPipeline* CreatePipelineInternal(const ShaderComputeInputInfo* inpu
 
 	EXIT_IF(pipeline->pipeline != nullptr);
 
-	vkCreateComputePipelines(gctx->device, nullptr, 1, &info, nullptr, &pipeline->pipeline);
+	vkCreateComputePipelines(gctx->device, vk_cache, 1, &info, nullptr, &pipeline->pipeline);
 
 	EXIT_NOT_IMPLEMENTED(pipeline->pipeline == nullptr);
 
@@ -2493,6 +2525,17 @@ void PipelineCache::DeletePipelineInternal(uint32_t id)
 
 	DumpPipeline("delete", id);
 
+	auto& bucket = m_index[p.hash];
+	bucket.Remove(id);
+	if (bucket.IsEmpty())
+	{
+		m_index.Remove(p.hash);
+	}
+
+	LruUnlink(id);
+	m_free.Add(id);
+	m_live_num--;
+
 	delete p.static_params;
 	delete p.dynamic_params;
 
@@ -2511,18 +2554,290 @@ void PipelineCache::DeletePipelineInternal(uint32_t id)
 	p.pipeline = nullptr;
 }
 
-VulkanPipeline* PipelineCache::Find(const Pipeline& p) const
+static uint64_t CalcShaderIdHash(const ShaderId& id, uint64_t seed)
+{
+	uint64_t h = XXH64(&id.hash0, sizeof(id.hash0), seed);
+	h          = XXH64(&id.crc32, sizeof(id.crc32), h);
+	return (id.ids.IsEmpty() ? h : XXH64(id.ids.GetDataConst(), id.ids.Size() * sizeof(uint32_t), h));
+}
+
+uint64_t PipelineCache::CalcHash(const Pipeline& p)
 {
-	for (const auto& pn: m_pipelines)
+	EXIT_IF(p.static_params == nullptr);
+	EXIT_IF(p.dynamic_params == nullptr);
+
+	const auto& d = *p.dynamic_params;
+
+	// Only the parameters compared by PipelineDynamicParameters::operator== are hashed
+	uint32_t dynamic_values[14] = {};
+	dynamic_values[0]           = static_cast<uint32_t>(d.vk_dynamic_state_line_width);
+	dynamic_values[1]           = static_cast<uint32_t>(d.vk_dynamic_state_stencil_compare_mask);
+	dynamic_values[2]           = static_cast<uint32_t>(d.vk_dynamic_state_stencil_write_mask);
+	dynamic_values[3]           = static_cast<uint32_t>(d.vk_dynamic_state_stencil_reference);
+	dynamic_values[4]           = static_cast<uint32_t>(d.vk_dynamic_state_color_write_enable_ext);
+	if (!d.vk_dynamic_state_line_width)
+	{
+		memcpy(&dynamic_values[5], &d.line_width, sizeof(float));
+	}
+	if (!d.vk_dynamic_state_stencil_compare_mask)
+	{
+		dynamic_values[6] = d.stencil_front.compareMask;
+		dynamic_values[7] = d.stencil_back.compareMask;
+	}
+	if (!d.vk_dynamic_state_stencil_write_mask)
+	{
+		dynamic_values[8] = d.stencil_front.writeMask;
+		dynamic_values[9] = d.stencil_back.writeMask;
+	}
+	if (!d.vk_dynamic_state_stencil_reference)
 	{
-		if (pn.pipeline != nullptr && p.render_pass_id == pn.render_pass_id && p.vs_shader_id == pn.vs_shader_id &&
-		    p.ps_shader_id == pn.ps_shader_id && p.cs_shader_id == pn.cs_shader_id && *p.static_params == *pn.static_params &&
-		    *p.dynamic_params == *pn.dynamic_params)
+		dynamic_values[10] = d.stencil_front.reference;
+		dynamic_values[11] = d.stencil_back.reference;
+	}
+	if (!d.vk_dynamic_state_color_write_enable_ext)
+	{
+		dynamic_values[12] = static_cast<uint32_t>(d.color_write_enable);
+	}
+
+	uint64_t h = XXH64(p.static_params, sizeof(PipelineStaticParameters), p.render_pass_id);
+	h          = XXH64(dynamic_values, sizeof(dynamic_values), h);
+	h          = CalcShaderIdHash(p.vs_shader_id, h);
+	h          = CalcShaderIdHash(p.ps_shader_id, h);
+	h          = CalcShaderIdHash(p.cs_shader_id, h);
+
+	return h;
+}
+
+int PipelineCache::Find(const Pipeline& p) const
+{
+	const auto* bucket = m_index.Find(p.hash);
+
+	if (bucket != nullptr)
+	{
+		for (auto id: *bucket)
 		{
-			return pn.pipeline;
+			const auto& pn = m_pipelines.At(id);
+
+			EXIT_IF(pn.pipeline == nullptr);
+
+			if (p.render_pass_id == pn.render_pass_id && p.vs_shader_id == pn.vs_shader_id && p.ps_shader_id == pn.ps_shader_id &&
+			    p.cs_shader_id == pn.cs_shader_id && *p.static_params == *pn.static_params && *p.dynamic_params == *pn.dynamic_params)
+			{
+				return static_cast<int>(id);
+			}
 		}
 	}
-	return nullptr;
+
+	return -1;
+}
+
+void PipelineCache::LruUnlink(uint32_t id)
+{
+	auto& p = m_pipelines[id];
+
+	if (p.lru_prev >= 0)
+	{
+		m_pipelines[p.lru_prev].lru_next = p.lru_next;
+	} else
+	{
+		m_lru_head = p.lru_next;
+	}
+
+	if (p.lru_next >= 0)
+	{
+		m_pipelines[p.lru_next].lru_prev = p.lru_prev;
+	} else
+	{
+		m_lru_tail = p.lru_prev;
+	}
+
+	p.lru_prev = -1;
+	p.lru_next = -1;
+}
+
+void PipelineCache::LruPushFront(uint32_t id)
+{
+	auto& p = m_pipelines[id];
+
+	p.lru_prev = -1;
+	p.lru_next = m_lru_head;
+
+	if (m_lru_head >= 0)
+	{
+		m_pipelines[m_lru_head].lru_prev = static_cast<int>(id);
+	} else
+	{
+		m_lru_tail = static_cast<int>(id);
+	}
+
+	m_lru_head = static_cast<int>(id);
+}
+
+void PipelineCache::Touch(uint32_t id)
+{
+	m_pipelines[id].last_frame = GraphicsRunGetFrameNum();
+
+	if (m_lru_head != static_cast<int>(id))
+	{
+		LruUnlink(id);
+		LruPushFront(id);
+	}
+}
+
+void PipelineCache::Evict()
+{
+	int frame = GraphicsRunGetFrameNum();
+
+	// The pipeline can still be referenced by a command buffer, so only old enough pipelines are destroyed
+	while (m_live_num > PIPELINES_SOFT_LIMIT && m_lru_tail >= 0 && frame - m_pipelines[m_lru_tail].last_frame >= PIPELINE_EVICT_FRAMES)
+	{
+		DeletePipelineInternal(m_lru_tail);
+	}
+}
+
+uint32_t PipelineCache::Insert(const Pipeline& p)
+{
+	EXIT_IF(p.pipeline == nullptr);
+
+	uint32_t id = 0;
+
+	if (!m_free.IsEmpty())
+	{
+		id = m_free.At(m_free.Size() - 1);
+		m_free.RemoveAt(m_free.Size() - 1);
+
+		EXIT_IF(m_pipelines[id].pipeline != nullptr);
+
+		m_pipelines[id] = p;
+	} else
+	{
+		id = m_pipelines.Size();
+		m_pipelines.Add(p);
+	}
+
+	m_index[p.hash].Add(id);
+	m_live_num++;
+
+	m_pipelines[id].last_frame = GraphicsRunGetFrameNum();
+	LruPushFront(id);
+
+	DumpPipeline("create", id);
+
+	m_vk_cache_dirty = true;
+
+	Evict();
+
+	return id;
+}
+
+VkPipelineCache PipelineCache::GetVulkanCache()
+{
+	if (m_vk_cache_init)
+	{
+		return m_vk_cache;
+	}
+
+	m_vk_cache_init = true;
+
+	if (!Config::PipelineCacheEnabled())
+	{
+		return nullptr;
+	}
+
+	EXIT_IF(g_render_ctx == nullptr);
+
+	auto* gctx = g_render_ctx->GetGraphicCtx();
+
+	EXIT_IF(gctx == nullptr);
+
+	// The driver validates the header (vendor, device, cache UUID) and ignores incompatible data
+	String           file_name = Config::GetShaderCacheFolder().FixDirectorySlash() + U"pipelines.bin";
+	Core::ByteBuffer data;
+
+	if (Core::File::IsFileExisting(file_name))
+	{
+		Core::File f;
+		if (f.Open(file_name, Core::File::Mode::Read))
+		{
+			data = f.ReadWholeBuffer();
+		}
+	}
+
+	VkPipelineCacheCreateInfo info {};
+	info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	info.pNext           = nullptr;
+	info.flags           = 0;
+	info.initialDataSize = data.Size();
+	info.pInitialData    = (data.IsEmpty() ? nullptr : data.GetDataConst());
+
+	if (vkCreatePipelineCache(gctx->device, &info, nullptr, &m_vk_cache) != VK_SUCCESS)
+	{
+		info.initialDataSize = 0;
+		info.pInitialData    = nullptr;
+
+		if (vkCreatePipelineCache(gctx->device, &info, nullptr, &m_vk_cache) != VK_SUCCESS)
+		{
+			printf(FG_BRIGHT_RED "Can't create pipeline cache\n" FG_DEFAULT);
+			m_vk_cache = nullptr;
+		}
+	}
+
+	m_vk_cache_save_frame = GraphicsRunGetFrameNum();
+
+	return m_vk_cache;
+}
+
+void PipelineCache::SaveVulkanCache()
+{
+	if (m_vk_cache == nullptr || !m_vk_cache_dirty)
+	{
+		return;
+	}
+
+	int frame = GraphicsRunGetFrameNum();
+
+	if (frame - m_vk_cache_save_frame < VULKAN_CACHE_SAVE_FRAMES)
+	{
+		return;
+	}
+
+	KYTY_PROFILER_FUNCTION();
+
+	m_vk_cache_dirty      = false;
+	m_vk_cache_save_frame = frame;
+
+	auto* gctx = g_render_ctx->GetGraphicCtx();
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(gctx->device, m_vk_cache, &size, nullptr) != VK_SUCCESS || size == 0)
+	{
+		return;
+	}
+
+	Core::ByteBuffer data(static_cast<uint32_t>(size), false);
+	if (vkGetPipelineCacheData(gctx->device, m_vk_cache, &size, data.GetData()) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	// Write a temporary file first, so a crash never leaves a truncated cache behind
+	String folder    = Config::GetShaderCacheFolder().FixDirectorySlash();
+	String file_name = folder + U"pipelines.bin";
+	String tmp_name  = file_name + U".tmp";
+
+	Core::File::CreateDirectories(folder);
+
+	Core::File f;
+	if (!f.Create(tmp_name))
+	{
+		printf(FG_BRIGHT_RED "Can't create file: %s\n" FG_DEFAULT, tmp_name.C_Str());
+		return;
+	}
+	f.Write(data.GetDataConst(), size);
+	f.Close();
+
+	Core::File::DeleteFile(file_name);
+	Core::File::MoveFile(tmp_name, file_name);
 }
 
 VulkanPipeline* PipelineCache::CreatePipeline(VulkanFramebuffer* framebuffer, RenderColorInfo* color, RenderDepthInfo* depth,
@@ -2623,64 +2938,46 @@ VulkanPipeline* PipelineCache::CreatePipeline(VulkanFramebuffer* framebuffer, Re
 	p.dynamic_params->stencil_back       = depth->stencil_dynamic_back;
 	p.dynamic_params->color_write_enable = (cc.mode == 1);
 
-	auto* found = Find(p);
+	p.hash = CalcHash(p);
 
-	if (found != nullptr)
+	SaveVulkanCache();
+
+	if (auto index = Find(p); index >= 0)
 	{
+		auto* found = m_pipelines[index].pipeline;
+		Touch(index);
 		*found->dynamic_params = *p.dynamic_params;
 		delete p.static_params;
 		delete p.dynamic_params;
 		return found;
 	}
 
-	auto vs_code = ShaderParseVS(&vs_regs, &sh_regs);
-	auto ps_code = ShaderParsePS(&ps_regs, &sh_regs);
+	Vector<uint32_t> vs_shader;
+	Vector<uint32_t> ps_shader;
 
-	auto vs_shader = ShaderRecompileVS(vs_code, vs_input_info);
-	auto ps_shader = ShaderRecompilePS(ps_code, ps_input_info);
+	if (!ShaderCacheFind(ShaderType::Vertex, vs_id, &vs_shader))
+	{
+		auto vs_code = ShaderParseVS(&vs_regs, &sh_regs);
+		vs_shader    = ShaderRecompileVS(vs_code, vs_input_info);
+		ShaderCacheAdd(ShaderType::Vertex, vs_id, vs_shader);
+	}
+
+	if (!ShaderCacheFind(ShaderType::Pixel, ps_id, &ps_shader))
+	{
+		auto ps_code = ShaderParsePS(&ps_regs, &sh_regs);
+		ps_shader    = ShaderRecompilePS(ps_code, ps_input_info);
+		ShaderCacheAdd(ShaderType::Pixel, ps_id, ps_shader);
+	}
 
 	EXIT_IF(vs_shader.IsEmpty());
 	EXIT_IF(ps_shader.IsEmpty());
 
-	p.pipeline = CreatePipelineInternal(framebuffer->render_pass, vs_input_info, vs_shader, ps_input_info, ps_shader, p.static_params,
-	                                    p.dynamic_params);
+	p.pipeline = CreatePipelineInternal(GetVulkanCache(), framebuffer->render_pass, vs_input_info, vs_shader, ps_input_info, ps_shader,
+	                                    p.static_params, p.dynamic_params);
 
 	EXIT_NOT_IMPLEMENTED(p.pipeline == nullptr);
 
-	bool updated = false;
-	int  index   = 0;
-	for (auto& pn: m_pipelines)
-	{
-		if (pn.pipeline == nullptr)
-		{
-			pn      = p;
-			updated = true;
-
-			DumpPipeline("create", index);
-
-			break;
-		}
-		index++;
-	}
-
-	if (!updated)
-	{
-		if (m_pipelines.Size() >= PipelineCache::MAX_PIPELINES)
-		{
-			EXIT_NOT_IMPLEMENTED(m_pipelines.Size() >= PipelineCache::MAX_PIPELINES);
-			//			auto  index = Math::Rand::UintInclusiveRange(0, m_pipelines.Size() - 1);
-			//			auto& pn    = m_pipelines[index];
-			//			DeletePipelineInternal(index);
-			//			pn = p;
-		} else
-		{
-			EXIT_IF(m_pipelines.Size() != index);
-
-			m_pipelines.Add(p);
-
-			DumpPipeline("create", index);
-		}
-	}
+	Insert(p);
 
 	return p.pipeline;
 }
@@ -2710,50 +3007,36 @@ VulkanPipeline* PipelineCache::CreatePipeline(const ShaderComputeInputInfo* inpu
 	p.dynamic_params->vk_dynamic_state_stencil_write_mask   = true;
 	p.dynamic_params->color_write_enable                    = true;
 
-	auto* found = Find(p);
+	p.hash = CalcHash(p);
+
+	SaveVulkanCache();
 
-	if (found != nullptr)
+	if (auto index = Find(p); index >= 0)
 	{
+		auto* found = m_pipelines[index].pipeline;
+		Touch(index);
 		*found->dynamic_params = *p.dynamic_params;
 		delete p.static_params;
 		delete p.dynamic_params;
 		return found;
 	}
 
-	auto cs_code = ShaderParseCS(cs_regs, sh_regs);
+	Vector<uint32_t> cs_shader;
+
+	if (!ShaderCacheFind(ShaderType::Compute, cs_id, &cs_shader))
+	{
+		auto cs_code = ShaderParseCS(cs_regs, sh_regs);
+		cs_shader    = ShaderRecompileCS(cs_code, input_info);
+		ShaderCacheAdd(ShaderType::Compute, cs_id, cs_shader);
+	}
 
-	auto cs_shader = ShaderRecompileCS(cs_code, input_info);
 	EXIT_IF(cs_shader.IsEmpty());
 
-	p.pipeline = CreatePipelineInternal(input_info, cs_shader, p.static_params, p.dynamic_params /*, params2*/);
+	p.pipeline = CreatePipelineInternal(GetVulkanCache(), input_info, cs_shader, p.static_params, p.dynamic_params /*, params2*/);
 
 	EXIT_NOT_IMPLEMENTED(p.pipeline == nullptr);
 
-	bool updated = false;
-	for (auto& pn: m_pipelines)
-	{
-		if (pn.pipeline == nullptr)
-		{
-			pn      = p;
-			updated = true;
-			break;
-		}
-	}
-
-	if (!updated)
-	{
-		if (m_pipelines.Size() >= PipelineCache::MAX_PIPELINES)
-		{
-			EXIT_NOT_IMPLEMENTED(m_pipelines.Size() >= PipelineCache::MAX_PIPELINES);
-			//			auto  index = Math::Rand::UintInclusiveRange(0, m_pipelines.Size() - 1);
-			//			auto& pn    = m_pipelines[index];
-			//			DeletePipelineInternal(index);
-			//			pn = p;
-		} else
-		{
-			m_pipelines.Add(p);
-		}
-	}
+	Insert(p);
 
 	return p.pipeline;
 }
@@ -2795,7 +3078,10 @@ void PipelineCache::DeleteAllPipelines()
 
 	for (uint32_t index = 0; index < m_pipelines.Size(); index++)
 	{
-		DeletePipelineInternal(index);
+		if (m_pipelines[index].pipeline != nullptr)
+		{
+			DeletePipelineInternal(index);
+		}
 	}
 }
 
@@ -4771,10 +5057,10 @@ void GraphicsRenderDrawIndex(uint64_t submit_id, CommandBuffer* buffer, HW::Cont
 		uint64_t    addr = b.addr;
 		uint64_t    size = static_cast<uint64_t>(b.stride) * b.num_records;
 
-		auto* vertices = static_cast<VulkanBuffer*>(
+		auto* vertices = static_cast<GuestVulkanBuffer*>(
 		    GpuMemoryCreateObject(submit_id, g_render_ctx->GetGraphicCtx(), nullptr, addr, size, VertexBufferGpuObject()));
 
-		VkDeviceSize offset = 0;
+		VkDeviceSize offset = vertices->offset;
 
 		vkCmdBindVertexBuffers(vk_buffer, i, 1, &vertices->buffer, &offset);
 	}
@@ -4785,12 +5071,12 @@ void GraphicsRenderDrawIndex(uint64_t submit_id, CommandBuffer* buffer, HW::Cont
 	BindDescriptors(submit_id, buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline_layout, ps_input_info.bind,
 	                VK_SHADER_STAGE_FRAGMENT_BIT, DescriptorCache::Stage::Pixel);
 
-	VulkanBuffer* indices = static_cast<VulkanBuffer*>(GpuMemoryCreateObject(
+	auto* indices = static_cast<GuestVulkanBuffer*>(GpuMemoryCreateObject(
 	    submit_id, g_render_ctx->GetGraphicCtx(), nullptr, reinterpret_cast<uint64_t>(index_addr), index_size, IndexBufferGpuObject()));
 
 	EXIT_NOT_IMPLEMENTED(indices == nullptr);
 
-	vkCmdBindIndexBuffer(vk_buffer, indices->buffer, 0, index_type);
+	vkCmdBindIndexBuffer(vk_buffer, indices->buffer, indices->offset, index_type);
 
 	buffer->BeginRenderPass(framebuffer, &color_info, &depth_info);
 
@@ -4896,10 +5182,10 @@ void GraphicsRenderDrawIndexAuto(uint64_t submit_id, CommandBuffer* buffer, HW::
 		uint64_t    addr = b.addr;
 		uint64_t    size = static_cast<uint64_t>(b.stride) * b.num_records;
 
-		auto* vertices = static_cast<VulkanBuffer*>(
+		auto* vertices = static_cast<GuestVulkanBuffer*>(
 		    GpuMemoryCreateObject(submit_id, g_render_ctx->GetGraphicCtx(), nullptr, addr, size, VertexBufferGpuObject()));
 
-		VkDeviceSize offset = 0;
+		VkDeviceSize offset = vertices->offset;
 
 		vkCmdBindVertexBuffers(vk_buffer, i, 1, &vertices->buffer, &offset);
 	}
@@ -5385,6 +5671,7 @@ void GraphicsRenderMemoryFree(uint64_t vaddr, uint64_t size)
 void GraphicsRenderDeleteIndexBuffers()
 {
 	IndexBufferDeleteAll(g_render_ctx->GetGraphicCtx());
+	VulkanDeleteRetiredImportedBuffers(g_render_ctx->GetGraphicCtx());
 }
 
 void GraphicsRenderMemoryFlush(uint64_t vaddr, uint64_t size)
@@ -5475,6 +5762,9 @@ void CommandBuffer::Execute()
 {
 	EXIT_IF(IsInvalid());
 
+	// Uploads recorded so far must be visible to this buffer
+	UtilFlushUploads(g_render_ctx->GetGraphicCtx());
+
 	auto* buffer = m_pool->buffers[m_index];
 	auto* fence  = m_pool->fences[m_index];
 
@@ -5498,6 +5788,24 @@ void CommandBuffer::Execute()
 		queue.mutex->Lock();
 	}
 
+	VkSemaphore                   label_semaphore = nullptr;
+	uint64_t                      label_value     = 0;
+	VkTimelineSemaphoreSubmitInfo timeline_info {};
+
+	if (LabelSubmit(this, m_queue, &label_semaphore, &label_value))
+	{
+		timeline_info.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.pNext                     = nullptr;
+		timeline_info.waitSemaphoreValueCount   = 0;
+		timeline_info.pWaitSemaphoreValues      = nullptr;
+		timeline_info.signalSemaphoreValueCount = 1;
+		timeline_info.pSignalSemaphoreValues    = &label_value;
+
+		submit_info.pNext                = &timeline_info;
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores    = &label_semaphore;
+	}
+
 	auto result = vkQueueSubmit(queue.vk_queue, 1, &submit_info, fence);
 
 	if (queue.mutex != nullptr)
@@ -5514,9 +5822,15 @@ void CommandBuffer::ExecuteWithSemaphore()
 {
 	EXIT_IF(IsInvalid());
 
+	// Uploads recorded so far must be visible to this buffer
+	UtilFlushUploads(g_render_ctx->GetGraphicCtx());
+
 	auto* buffer = m_pool->buffers[m_index];
 	auto* fence  = m_pool->fences[m_index];
 
+	VkSemaphore signal_semaphores[2] = {m_pool->semaphores[m_index], nullptr};
+	uint64_t    signal_values[2]     = {0, 0};
+
 	VkSubmitInfo submit_info {};
 	submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.pNext                = nullptr;
@@ -5526,7 +5840,7 @@ void CommandBuffer::ExecuteWithSemaphore()
 	submit_info.commandBufferCount   = 1;
 	submit_info.pCommandBuffers      = &buffer;
 	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores    = &m_pool->semaphores[m_index];
+	submit_info.pSignalSemaphores    = signal_semaphores;
 
 	EXIT_IF(m_queue < 0 || m_queue >= GraphicContext::QUEUES_NUM);
 
@@ -5537,11 +5851,27 @@ void CommandBuffer::ExecuteWithSemaphore()
 		queue.mutex->Lock();
 	}
 
+	VkTimelineSemaphoreSubmitInfo timeline_info {};
+
+	if (LabelSubmit(this, m_queue, &signal_semaphores[1], &signal_values[1]))
+	{
+		// The value for the binary semaphore is ignored
+		timeline_info.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.pNext                     = nullptr;
+		timeline_info.waitSemaphoreValueCount   = 0;
+		timeline_info.pWaitSemaphoreValues      = nullptr;
+		timeline_info.signalSemaphoreValueCount = 2;
+		timeline_info.pSignalSemaphoreValues    = signal_values;
+
+		submit_info.pNext                = &timeline_info;
+		submit_info.signalSemaphoreCount = 2;
+	}
+
 	auto result = vkQueueSubmit(queue.vk_queue, 1, &submit_info, fence);
 
 	if (queue.mutex != nullptr)
 	{
-		queue.mutex->Lock();
+		queue.mutex->Unlock();
 	}
 
 	m_execute = true;
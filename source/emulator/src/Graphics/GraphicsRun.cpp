@@ -147,7 +147,7 @@ private:
 	uint32_t         m_index_type_and_size = 0;
 	uint32_t         m_num_instances       = 1;
 
-	Core::Mutex m_mutex;
+	Core::Mutex m_mutex {Core::Mutex::Type::Recursive};
 	Core::Mutex m_run_mutex;
 
 	CommandBuffer* m_buffer[VK_BUFFERS_NUM] = {};
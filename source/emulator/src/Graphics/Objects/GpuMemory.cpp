@@ -3,14 +3,17 @@
 #include "Kyty/Core/Database.h"
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/Hashmap.h"
+#include "Kyty/Core/IntervalTree.h"
 #include "Kyty/Core/MagicEnum.h"
 #include "Kyty/Core/String.h"
 #include "Kyty/Core/Threads.h"
 #include "Kyty/Core/Vector.h"
+#include "Kyty/Core/VirtualMemory.h"
 
 #include "Emulator/Config.h"
 #include "Emulator/Graphics/GraphicContext.h"
 #include "Emulator/Graphics/GraphicsRun.h"
+#include "Emulator/Graphics/Utils.h"
 #include "Emulator/Profiler.h"
 
 #include <algorithm>
@@ -82,160 +85,184 @@ static OverlapType GetOverlapType(uint64_t vaddr_a, uint64_t size_a, uint64_t va
 	return OverlapType::None;
 }
 
-class GpuMap1
+// Write-protects guest pages which back GPU objects. The first CPU write to a protected page raises an access violation, the page is
+// unprotected and all objects on it are marked as dirty. Only dirty objects need to be rehashed and re-uploaded.
+// Pages of objects with a pending write-back are hidden: any CPU access faults until the data is copied from the GPU.
+//
+// The fault is handled in the signal handler (exception filter on Windows) of the faulting thread, which takes the watcher, heap list and
+// heap mutexes and may allocate. This can't deadlock: the fault is synchronous and only raised by an access to a protected guest page.
+// Host heap memory is never protected, so the fault can't interrupt the host allocator. The watcher never touches guest memory while its
+// mutex is held. GpuMemory code which writes guest memory under a heap mutex shows and unwatches the pages first, and both the heap and the
+// heap list mutexes are recursive anyway. On Linux guest threads run the handler on an alternate signal stack.
+class GpuPageWatcher
 {
 public:
-	GpuMap1()  = default;
-	~GpuMap1() = default;
+	GpuPageWatcher()  = default;
+	~GpuPageWatcher() = default;
 
-	KYTY_CLASS_NO_COPY(GpuMap1);
+	KYTY_CLASS_NO_COPY(GpuPageWatcher);
 
-	void Insert(uint64_t vaddr, int id)
-	{
-		auto& ids = m_map[vaddr];
-		if (!ids.Contains(id))
-		{
-			ids.Add(id);
-		}
-	}
+	static constexpr uint32_t PAGE_BITS = 12u;
+	static constexpr uint64_t PAGE_SIZE = static_cast<uint64_t>(1) << PAGE_BITS;
 
-	void Erase(uint64_t vaddr, int id)
+	static uint64_t AlignDown(uint64_t vaddr) { return vaddr & ~(PAGE_SIZE - 1); }
+	static uint64_t AlignUp(uint64_t vaddr) { return (vaddr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); }
+
+	void Watch(uint64_t vaddr, uint64_t size)
 	{
-		auto& ids = m_map[vaddr];
-		ids.Remove(id);
-		if (ids.IsEmpty())
+		EXIT_IF(size == 0);
+		Core::LockGuard lock(m_mutex);
+
+		auto first_page = vaddr >> PAGE_BITS;
+		auto last_page  = (vaddr + size - 1) >> PAGE_BITS;
+		for (auto page = first_page; page <= last_page;)
 		{
-			m_map.Remove(vaddr);
+			if (m_pages.Contains(page))
+			{
+				page++;
+				continue;
+			}
+			auto run_start = page;
+			while (page <= last_page && !m_pages.Contains(page))
+			{
+				page++;
+			}
+			Protect(run_start, page - run_start, Core::VirtualMemory::Mode::Read, PageState::Watched);
 		}
 	}
 
-	[[nodiscard]] Vector<int> FindAll(uint64_t vaddr) const { return m_map.Get(vaddr); }
+	// Hidden pages stay protected
+	bool Unwatch(uint64_t vaddr, uint64_t size) { return Unprotect(vaddr, size, PageState::Watched); }
 
-	[[nodiscard]] bool IsEmpty() const
+	// Returns false if some pages can't be protected, the data must be written back right away then
+	bool Hide(uint64_t vaddr, uint64_t size)
 	{
-		int num = 0;
-		m_map.ForEach(
-		    [](auto /*key*/, auto value, void* arg)
-		    {
-			    (*static_cast<int*>(arg)) += value->Size();
-			    return true;
-		    },
-		    &num);
-		return num == 0;
-	}
-
-private:
-	Core::Hashmap<uint64_t, Vector<int>> m_map;
-};
+		EXIT_IF(size == 0);
+		Core::LockGuard lock(m_mutex);
 
-class GpuMap2
-{
-public:
-	GpuMap2()  = default;
-	~GpuMap2() = default;
+		bool ret        = true;
+		auto first_page = vaddr >> PAGE_BITS;
+		auto last_page  = (vaddr + size - 1) >> PAGE_BITS;
+		for (auto page = first_page; page <= last_page;)
+		{
+			const auto* state = m_pages.Find(page);
+			if (state != nullptr && *state == PageState::Hidden)
+			{
+				page++;
+				continue;
+			}
+			auto run_start = page;
+			if (state != nullptr)
+			{
+				// Protected by the watcher, so the pages are writable for the guest
+				for (; page <= last_page && m_pages.Get(page, PageState::Hidden) == PageState::Watched; page++)
+				{
+					m_pages.Put(page, PageState::Hidden);
+				}
+				Core::VirtualMemory::Protect(run_start << PAGE_BITS, (page - run_start) << PAGE_BITS, Core::VirtualMemory::Mode::NoAccess);
+			} else
+			{
+				while (page <= last_page && !m_pages.Contains(page))
+				{
+					page++;
+				}
+				ret = Protect(run_start, page - run_start, Core::VirtualMemory::Mode::NoAccess, PageState::Hidden) && ret;
+			}
+		}
+		return ret;
+	}
 
-	KYTY_CLASS_NO_COPY(GpuMap2);
+	// Returns true if some pages were hidden
+	bool Show(uint64_t vaddr, uint64_t size) { return Unprotect(vaddr, size, PageState::Hidden); }
 
-	void Insert(uint64_t vaddr, uint64_t size, int id)
+	[[nodiscard]] bool IsHidden(uint64_t vaddr, uint64_t size)
 	{
 		EXIT_IF(size == 0);
-		auto first_page = CalcPageId(vaddr);
-		auto last_page  = CalcPageId(vaddr + size - 1);
-		EXIT_IF(last_page < first_page);
+		Core::LockGuard lock(m_mutex);
+
+		auto first_page = vaddr >> PAGE_BITS;
+		auto last_page  = (vaddr + size - 1) >> PAGE_BITS;
 		for (auto page = first_page; page <= last_page; page++)
 		{
-			auto& ids = m_map[page];
-			if (!ids.Contains(id))
+			const auto* state = m_pages.Find(page);
+			if (state != nullptr && *state == PageState::Hidden)
 			{
-				ids.Add(id);
+				return true;
 			}
 		}
+		return false;
 	}
 
-	void Erase(uint64_t vaddr, uint64_t size, int id)
+	// Memory is already unmapped, just drop the pages
+	void Forget(uint64_t vaddr, uint64_t size)
 	{
 		EXIT_IF(size == 0);
-		auto first_page = CalcPageId(vaddr);
-		auto last_page  = CalcPageId(vaddr + size - 1);
-		EXIT_IF(last_page < first_page);
+		Core::LockGuard lock(m_mutex);
+
+		auto first_page = vaddr >> PAGE_BITS;
+		auto last_page  = (vaddr + size - 1) >> PAGE_BITS;
 		for (auto page = first_page; page <= last_page; page++)
 		{
-			auto& ids = m_map[page];
-			ids.Remove(id);
-			if (ids.IsEmpty())
-			{
-				m_map.Remove(page);
-			}
+			m_pages.Remove(page);
 		}
 	}
 
-	[[nodiscard]] Vector<int> FindAll(uint64_t vaddr, uint64_t size) const
+private:
+	enum class PageState
 	{
-		Vector<int> ret;
-		EXIT_IF(size == 0);
-		auto first_page = CalcPageId(vaddr);
-		auto last_page  = CalcPageId(vaddr + size - 1);
-		EXIT_IF(last_page < first_page);
-		for (auto page = first_page; page <= last_page; page++)
+		Watched,
+		Hidden
+	};
+
+	bool Protect(uint64_t first_page, uint64_t pages_num, Core::VirtualMemory::Mode mode, PageState state)
+	{
+		Core::VirtualMemory::Mode old_mode {};
+		if (!Core::VirtualMemory::Protect(first_page << PAGE_BITS, pages_num << PAGE_BITS, mode, &old_mode))
 		{
-			for (int id: m_map.Get(page))
-			{
-				if (!ret.Contains(id))
-				{
-					ret.Add(id);
-				}
-			}
+			return false;
 		}
-		return ret;
+		if (old_mode != Core::VirtualMemory::Mode::ReadWrite)
+		{
+			// CPU can't write here anyway, leave the pages as they were
+			Core::VirtualMemory::Protect(first_page << PAGE_BITS, pages_num << PAGE_BITS, old_mode);
+			return false;
+		}
+		for (uint64_t i = 0; i < pages_num; i++)
+		{
+			m_pages.Put(first_page + i, state);
+		}
+		return true;
 	}
 
-	[[nodiscard]] Vector<int> FindAll(const uint64_t* vaddr, const uint64_t* size, int vaddr_num) const
+	bool Unprotect(uint64_t vaddr, uint64_t size, PageState state)
 	{
-		EXIT_IF(vaddr == nullptr);
-		EXIT_IF(size == nullptr);
-		Vector<int> ret;
-		for (int i = 0; i < vaddr_num; i++)
+		EXIT_IF(size == 0);
+		Core::LockGuard lock(m_mutex);
+
+		bool ret        = false;
+		auto first_page = vaddr >> PAGE_BITS;
+		auto last_page  = (vaddr + size - 1) >> PAGE_BITS;
+		for (auto page = first_page; page <= last_page;)
 		{
-			EXIT_IF(size[i] == 0);
-			auto first_page = CalcPageId(vaddr[i]);
-			auto last_page  = CalcPageId(vaddr[i] + size[i] - 1);
-			EXIT_IF(last_page < first_page);
-			for (auto page = first_page; page <= last_page; page++)
+			const auto* s = m_pages.Find(page);
+			if (s == nullptr || *s != state)
 			{
-				for (int id: m_map.Get(page))
-				{
-					if (!ret.Contains(id))
-					{
-						ret.Add(id);
-					}
-				}
+				page++;
+				continue;
+			}
+			auto run_start = page;
+			for (; page <= last_page && (s = m_pages.Find(page)) != nullptr && *s == state; page++)
+			{
+				m_pages.Remove(page);
 			}
+			Core::VirtualMemory::Protect(run_start << PAGE_BITS, (page - run_start) << PAGE_BITS, Core::VirtualMemory::Mode::ReadWrite);
+			ret = true;
 		}
 		return ret;
 	}
 
-	[[nodiscard]] bool IsEmpty() const
-	{
-		int num = 0;
-		m_map.ForEach(
-		    [](auto /*key*/, auto value, void* arg)
-		    {
-			    (*static_cast<int*>(arg)) += value->Size();
-			    return true;
-		    },
-		    &num);
-		return num == 0;
-	}
-
-private:
-	static constexpr uint32_t PAGE_BITS = 14u;
-
-	static uint32_t CalcPageId(uint64_t vaddr)
-	{
-		EXIT_IF((vaddr >> (PAGE_BITS + 32u)) != 0);
-		return static_cast<uint32_t>(vaddr >> PAGE_BITS);
-	}
-	Core::Hashmap<uint32_t, Vector<int>> m_map;
+	Core::Mutex                        m_mutex;
+	Core::Hashmap<uint64_t, PageState> m_pages;
 };
 
 class GpuMemory
@@ -245,6 +272,11 @@ public:
 	{
 		EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread());
 		DbgInit();
+		if (Config::GpuMemoryWatcherEnabled())
+		{
+			m_watcher         = new GpuPageWatcher;
+			m_lazy_write_back = Config::GpuMemoryLazyWriteBack();
+		}
 	}
 	virtual ~GpuMemory() { KYTY_NOT_IMPLEMENTED; }
 	KYTY_CLASS_NO_COPY(GpuMemory);
@@ -261,13 +293,19 @@ public:
 	Vector<GpuMemoryObject> FindObjects(const uint64_t* vaddr, const uint64_t* size, int vaddr_num, GpuMemoryObjectType type, bool exact,
 	                                    bool only_first);
 
-	// Sync: GPU -> CPU
+	// Sync: GPU -> CPU. In the lazy mode the data is copied on the first CPU access.
 	void WriteBack(GraphicContext* ctx, CommandProcessor* cp);
 
 	// Sync: CPU -> GPU
 	void Flush(GraphicContext* ctx, uint64_t vaddr, uint64_t size);
 	void FlushAll(GraphicContext* ctx);
 
+	// CPU is going to access [vaddr, vaddr + size)
+	bool CheckAccessViolation(uint64_t vaddr, uint64_t size);
+	// CPU is going to read [vaddr, vaddr + size), watched pages stay protected
+	bool CheckReadAccess(uint64_t vaddr, uint64_t size);
+	[[nodiscard]] bool IsWatcherEnabled() const { return m_watcher != nullptr; }
+
 	void DbgInit();
 	void DbgDbDump();
 	void DbgDbSave(const String& file_name);
@@ -297,6 +335,8 @@ private:
 		bool                         in_use                        = false;
 		bool                         read_only                     = false;
 		bool                         check_hash                    = false;
+		bool                         watched                       = false;
+		bool                         write_back_pending            = false;
 		VulkanMemory                 mem;
 	};
 
@@ -323,14 +363,57 @@ private:
 		int                     next_free_id = -1;
 	};
 
+	// Objects of a heap are guarded by the heap mutex, the heap list by m_mutex. Lock order: heap -> m_mutex -> watcher, a thread never
+	// holds two heaps at once. An unmapped heap is removed from the list, but another thread can still wait for its mutex. So heaps are
+	// reference counted: the list holds one reference, every HeapRef and HeapList one more, the last one deletes the heap.
 	struct Heap
 	{
-		AllocatedRange range;
-		Vector<Object> objects;
-		uint64_t       objects_size  = 0;
-		int            first_free_id = -1;
-		GpuMap1*       objects_map1  = nullptr;
-		GpuMap2*       objects_map2  = nullptr;
+		Core::Mutex         mutex {Core::Mutex::Type::Recursive};
+		AllocatedRange      range;
+		Vector<Object>      objects;
+		uint64_t            objects_size  = 0;
+		int                 first_free_id = -1;
+		Core::IntervalTree* objects_tree  = nullptr;
+		int                 pending_num   = 0; // Objects with a pending write-back
+		bool                mapped        = true;
+		int                 refs          = 1; // Guarded by m_mutex
+	};
+
+	class HeapRef
+	{
+	public:
+		HeapRef(GpuMemory* memory, Heap* heap): m_memory(memory), m_heap(heap) {}
+		~HeapRef() { m_memory->ReleaseHeap(m_heap); }
+
+		KYTY_CLASS_NO_COPY(HeapRef);
+
+		Heap& operator*() const { return *m_heap; }
+
+	private:
+		GpuMemory* m_memory;
+		Heap*      m_heap;
+	};
+
+	class HeapList
+	{
+	public:
+		HeapList(GpuMemory* memory, Vector<Heap*> heaps): m_memory(memory), m_heaps(std::move(heaps)) {}
+		~HeapList()
+		{
+			for (auto* heap: m_heaps)
+			{
+				m_memory->ReleaseHeap(heap);
+			}
+		}
+
+		KYTY_CLASS_NO_COPY(HeapList);
+
+		[[nodiscard]] auto begin() const { return m_heaps.begin(); }
+		[[nodiscard]] auto end() const { return m_heaps.end(); }
+
+	private:
+		GpuMemory*    m_memory;
+		Vector<Heap*> m_heaps;
 	};
 
 	struct Destructor
@@ -340,35 +423,58 @@ private:
 		VulkanMemory             mem;
 	};
 
-	[[nodiscard]] Destructor Free(int heap_id, int object_id);
+	[[nodiscard]] Destructor Free(Heap& heap, int object_id);
 
-	Vector<OverlappedBlock> FindBlocks_slow(int heap_id, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
-	                                        bool only_first = false);
-	Vector<OverlappedBlock> FindBlocks(int heap_id, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, bool only_first = false);
-	bool  FindFast(int heap_id, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, GpuMemoryObjectType type, bool only_first,
+	Vector<OverlappedBlock> FindBlocks(Heap& heap, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, bool only_first = false);
+	bool  FindFast(Heap& heap, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, GpuMemoryObjectType type, bool only_first,
 	               int* id);
-	Block CreateBlock(const uint64_t* vaddr, const uint64_t* size, int vaddr_num, int heap_id, int obj_id);
-	void  DeleteBlock(Block* b, int heap_id, int obj_id);
-	void  Link(int heap_id, int id1, int id2, OverlapType rel, GpuMemoryScenario scenario);
-	int   GetHeapId(uint64_t vaddr, uint64_t size);
+	Block CreateBlock(const uint64_t* vaddr, const uint64_t* size, int vaddr_num, Heap& heap, int obj_id);
+	void  DeleteBlock(Block* b, Heap& heap, int obj_id);
+	void  Link(Heap& heap, int id1, int id2, OverlapType rel, GpuMemoryScenario scenario);
+	void  Watch(Heap& heap, int obj_id);
+	bool  Unwatch(uint64_t vaddr, uint64_t size);
+	void  MarkDirty(uint64_t vaddr, uint64_t size);
+	void  MarkDirty(Heap& heap, uint64_t vaddr, uint64_t size);
+
+	// Copies the object from GPU to the guest memory
+	void WriteBackObject(GraphicContext* ctx, Heap& heap, int obj_id);
+
+	// Completes pending write-backs of all objects on the pages of the blocks. The object drop_id is going to be overwritten by GPU, its
+	// write-back is cancelled.
+	void ResolveWriteBack(Heap& heap, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, int drop_id = -1);
+
+	// m_mutex must be locked
+	Heap* FindHeap(uint64_t vaddr, uint64_t size);
+
+	// The heap mutex is not locked, the caller locks it and checks that the heap is still mapped
+	HeapRef GetHeap(uint64_t vaddr, uint64_t size);
+
+	HeapList GetHeaps();
+	void     ReleaseHeap(Heap* heap);
 
 	// Update (CPU -> GPU)
-	void Update(uint64_t submit_id, GraphicContext* ctx, int heap_id, int obj_id);
+	void Update(uint64_t submit_id, GraphicContext* ctx, Heap& heap, int obj_id);
 
-	bool create_existing(const Vector<OverlappedBlock>& others, const GpuObject& info, int heap_id, int* id);
-	bool create_generate_mips(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, int heap_id);
-	bool create_texture_triplet(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, int heap_id);
-	bool create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, int heap_id);
-	bool create_all_the_same(const Vector<OverlappedBlock>& others, int heap_id);
+	bool create_existing(const Vector<OverlappedBlock>& others, const GpuObject& info, Heap& heap, int* id);
+	bool create_generate_mips(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, Heap& heap);
+	bool create_texture_triplet(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, Heap& heap);
+	bool create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, Heap& heap);
+	bool create_all_the_same(const Vector<OverlappedBlock>& others, Heap& heap);
 
 	[[nodiscard]] String create_dbg_exit(const String& msg, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
 	                                     const Vector<OverlappedBlock>& others, GpuMemoryObjectType type);
 
-	Core::Mutex m_mutex;
+	Core::Mutex m_mutex {Core::Mutex::Type::Recursive};
+	Core::Mutex m_db_mutex;
 
-	Vector<Heap> m_heaps;
+	Vector<Heap*> m_heaps;
 
-	uint64_t m_current_frame = 0;
+	GpuPageWatcher* m_watcher         = nullptr;
+	bool            m_lazy_write_back = false;
+
+	std::atomic<GraphicContext*> m_write_back_ctx = nullptr;
+
+	std::atomic_uint64_t m_current_frame = 0;
 
 	Core::Database::Connection m_db;
 	Core::Database::Statement* m_db_add_range  = nullptr;
@@ -542,15 +648,14 @@ void GpuMemory::SetAllocatedRange(uint64_t vaddr, uint64_t size)
 {
 	EXIT_IF(size == 0);
 
-	EXIT_NOT_IMPLEMENTED(IsAllocated(vaddr, size));
-
 	Core::LockGuard lock(m_mutex);
 
-	Heap h;
-	h.range.vaddr  = vaddr;
-	h.range.size   = size;
-	h.objects_map1 = new GpuMap1;
-	h.objects_map2 = new GpuMap2;
+	EXIT_NOT_IMPLEMENTED(FindHeap(vaddr, size) != nullptr);
+
+	auto* h         = new Heap;
+	h->range.vaddr  = vaddr;
+	h->range.size   = size;
+	h->objects_tree = new Core::IntervalTree;
 
 	m_heaps.Add(h);
 }
@@ -561,22 +666,58 @@ bool GpuMemory::IsAllocated(uint64_t vaddr, uint64_t size)
 
 	Core::LockGuard lock(m_mutex);
 
-	return (GetHeapId(vaddr, size) >= 0);
+	return (FindHeap(vaddr, size) != nullptr);
 }
 
-int GpuMemory::GetHeapId(uint64_t vaddr, uint64_t size)
+GpuMemory::Heap* GpuMemory::FindHeap(uint64_t vaddr, uint64_t size)
 {
-	int index = 0;
-	for (const auto& heap: m_heaps)
+	for (auto* heap: m_heaps)
 	{
-		const auto& r = heap.range;
+		const auto& r = heap->range;
 		if ((vaddr >= r.vaddr && vaddr < r.vaddr + r.size) || ((vaddr + size - 1) >= r.vaddr && (vaddr + size - 1) < r.vaddr + r.size))
 		{
-			return index;
+			return heap;
 		}
-		index++;
 	}
-	return -1;
+	return nullptr;
+}
+
+GpuMemory::HeapRef GpuMemory::GetHeap(uint64_t vaddr, uint64_t size)
+{
+	Core::LockGuard lock(m_mutex);
+
+	auto* heap = FindHeap(vaddr, size);
+
+	EXIT_NOT_IMPLEMENTED(heap == nullptr);
+
+	heap->refs++;
+
+	return HeapRef(this, heap);
+}
+
+GpuMemory::HeapList GpuMemory::GetHeaps()
+{
+	Core::LockGuard lock(m_mutex);
+
+	for (auto* heap: m_heaps)
+	{
+		heap->refs++;
+	}
+
+	return HeapList(this, m_heaps);
+}
+
+void GpuMemory::ReleaseHeap(Heap* heap)
+{
+	Core::LockGuard lock(m_mutex);
+
+	EXIT_IF(heap->refs <= 0);
+
+	if (--heap->refs == 0)
+	{
+		EXIT_IF(heap->mapped);
+		delete heap;
+	}
 }
 
 static uint64_t calc_hash(const uint8_t* buf, uint64_t size)
@@ -592,7 +733,7 @@ static uint64_t get_current_time()
 	return ++t;
 }
 
-void GpuMemory::Link(int heap_id, int id1, int id2, OverlapType rel, GpuMemoryScenario scenario)
+void GpuMemory::Link(Heap& heap, int id1, int id2, OverlapType rel, GpuMemoryScenario scenario)
 {
 	OverlapType other_rel = OverlapType::None;
 	switch (rel)
@@ -603,8 +744,6 @@ void GpuMemory::Link(int heap_id, int id1, int id2, OverlapType rel, GpuMemorySc
 		default: EXIT("invalid rel: %s\n", Core::EnumName(rel).C_Str());
 	}
 
-	auto& heap = m_heaps[heap_id];
-
 	auto& h1 = heap.objects[id1];
 	EXIT_IF(h1.free);
 
@@ -618,20 +757,33 @@ void GpuMemory::Link(int heap_id, int id1, int id2, OverlapType rel, GpuMemorySc
 	h2.scenario = scenario;
 }
 
-void GpuMemory::Update(uint64_t submit_id, GraphicContext* ctx, int heap_id, int obj_id)
+void GpuMemory::Update(uint64_t submit_id, GraphicContext* ctx, Heap& heap, int obj_id)
 {
 	KYTY_PROFILER_BLOCK("GpuMemory::Update");
 
-	auto& heap = m_heaps[heap_id];
-
 	auto& h           = heap.objects[obj_id];
 	auto& o           = h.info;
 	bool  need_update = false;
 
-	bool mem_watch = false;
+	if (o.write_back_pending)
+	{
+		// The pages are hidden, CPU couldn't change the memory
+		return;
+	}
+
+	// Hashing reads the guest memory
+	ResolveWriteBack(heap, h.block.vaddr, h.block.size, h.block.vaddr_num);
 
-	if ((mem_watch && o.cpu_update_time > o.gpu_update_time) || (!mem_watch && submit_id > o.submit_id))
+	bool mem_watch = (m_watcher != nullptr && o.check_hash);
+
+	if ((mem_watch && !o.watched) || (!mem_watch && submit_id > o.submit_id))
 	{
+		if (mem_watch)
+		{
+			// Protect before hashing, so CPU writes made during the update mark the object dirty again
+			Watch(heap, obj_id);
+		}
+
 		uint64_t hash[VADDR_BLOCKS_MAX] = {};
 
 		for (int vi = 0; vi < h.block.vaddr_num; vi++)
@@ -672,11 +824,177 @@ void GpuMemory::Update(uint64_t submit_id, GraphicContext* ctx, int heap_id, int
 	}
 }
 
-bool GpuMemory::create_existing(const Vector<OverlappedBlock>& others, const GpuObject& info, int heap_id, int* id)
+void GpuMemory::Watch(Heap& heap, int obj_id)
 {
-	EXIT_IF(id == nullptr);
+	EXIT_IF(m_watcher == nullptr);
+
+	auto& h = heap.objects[obj_id];
+
+	for (int vi = 0; vi < h.block.vaddr_num; vi++)
+	{
+		m_watcher->Watch(h.block.vaddr[vi], h.block.size[vi]);
+	}
+
+	h.info.watched = true;
+}
+
+// No heap must be locked by the caller
+bool GpuMemory::Unwatch(uint64_t vaddr, uint64_t size)
+{
+	EXIT_IF(m_watcher == nullptr);
+
+	if (!m_watcher->Unwatch(vaddr, size))
+	{
+		return false;
+	}
+
+	MarkDirty(vaddr, size);
+
+	return true;
+}
+
+void GpuMemory::MarkDirty(uint64_t vaddr, uint64_t size)
+{
+	uint64_t page_vaddr = GpuPageWatcher::AlignDown(vaddr);
+	uint64_t page_size  = GpuPageWatcher::AlignUp(vaddr + size) - page_vaddr;
+
+	for (auto* heap: GetHeaps())
+	{
+		const auto& r = heap->range;
+		if (page_vaddr < r.vaddr + r.size && r.vaddr < page_vaddr + page_size)
+		{
+			Core::LockGuard heap_lock(heap->mutex);
+
+			if (heap->mapped)
+			{
+				MarkDirty(*heap, vaddr, size);
+			}
+		}
+	}
+}
+
+void GpuMemory::MarkDirty(Heap& heap, uint64_t vaddr, uint64_t size)
+{
+	// The whole pages are writable now, so every object on them becomes dirty
+	uint64_t page_vaddr = GpuPageWatcher::AlignDown(vaddr);
+	uint64_t page_size  = GpuPageWatcher::AlignUp(vaddr + size) - page_vaddr;
+
+	for (const auto& obj: FindBlocks(heap, &page_vaddr, &page_size, 1))
+	{
+		auto& o = heap.objects[obj.object_id].info;
+		if (o.watched)
+		{
+			o.watched         = false;
+			o.cpu_update_time = get_current_time();
+		}
+	}
+}
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+void GpuMemory::ResolveWriteBack(Heap& heap, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, int drop_id)
+{
+	if (heap.pending_num == 0)
+	{
+		return;
+	}
+
+	KYTY_PROFILER_BLOCK("GpuMemory::ResolveWriteBack");
+
+	// Objects share pages, showing the pages of one object exposes the pages of its neighbours
+	Vector<AllocatedRange> ranges;
+	for (int vi = 0; vi < vaddr_num; vi++)
+	{
+		ranges.Add(AllocatedRange({vaddr[vi], size[vi]}));
+	}
+
+	for (uint32_t i = 0; i < ranges.Size() && heap.pending_num > 0; i++)
+	{
+		uint64_t page_vaddr = GpuPageWatcher::AlignDown(ranges[i].vaddr);
+		uint64_t page_size  = GpuPageWatcher::AlignUp(ranges[i].vaddr + ranges[i].size) - page_vaddr;
+
+		for (const auto& obj: FindBlocks(heap, &page_vaddr, &page_size, 1))
+		{
+			auto& h = heap.objects[obj.object_id];
+			if (!h.info.write_back_pending)
+			{
+				continue;
+			}
+
+			h.info.write_back_pending = false;
+			heap.pending_num--;
+
+			for (int vi = 0; vi < h.block.vaddr_num; vi++)
+			{
+				ranges.Add(AllocatedRange({h.block.vaddr[vi], h.block.size[vi]}));
+			}
+
+			if (obj.object_id == drop_id)
+			{
+				for (int vi = 0; vi < h.block.vaddr_num; vi++)
+				{
+					if (m_watcher->Show(h.block.vaddr[vi], h.block.size[vi]))
+					{
+						MarkDirty(heap, h.block.vaddr[vi], h.block.size[vi]);
+					}
+				}
+			} else
+			{
+				auto* ctx = m_write_back_ctx.load();
+				EXIT_IF(ctx == nullptr);
+				WriteBackObject(ctx, heap, obj.object_id);
+			}
+		}
+	}
+}
+
+bool GpuMemory::CheckAccessViolation(uint64_t vaddr, uint64_t size)
+{
+	if (m_watcher == nullptr)
+	{
+		return false;
+	}
+
+	bool resolved = CheckReadAccess(vaddr, size);
+
+	return Unwatch(vaddr, size) || resolved;
+}
+
+bool GpuMemory::CheckReadAccess(uint64_t vaddr, uint64_t size)
+{
+	if (m_watcher == nullptr || !m_lazy_write_back || !m_watcher->IsHidden(vaddr, size))
+	{
+		return false;
+	}
+
+	uint64_t page_vaddr = GpuPageWatcher::AlignDown(vaddr);
+	uint64_t page_size  = GpuPageWatcher::AlignUp(vaddr + size) - page_vaddr;
+
+	for (auto* heap: GetHeaps())
+	{
+		const auto& r = heap->range;
+		if (page_vaddr < r.vaddr + r.size && r.vaddr < page_vaddr + page_size)
+		{
+			Core::LockGuard heap_lock(heap->mutex);
+
+			if (heap->mapped)
+			{
+				ResolveWriteBack(*heap, &page_vaddr, &page_size, 1);
+			}
+		}
+	}
+
+	// Pages could be left hidden by a partially failed write-back
+	if (m_watcher->Show(vaddr, size))
+	{
+		MarkDirty(vaddr, size);
+	}
+
+	return true;
+}
 
-	auto& heap = m_heaps[heap_id];
+bool GpuMemory::create_existing(const Vector<OverlappedBlock>& others, const GpuObject& info, Heap& heap, int* id)
+{
+	EXIT_IF(id == nullptr);
 
 	uint64_t               max_gpu_update_time = 0;
 	const OverlappedBlock* latest_block        = nullptr;
@@ -724,10 +1042,8 @@ bool GpuMemory::create_existing(const Vector<OverlappedBlock>& others, const Gpu
 	return false;
 }
 
-bool GpuMemory::create_generate_mips(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, int heap_id)
+bool GpuMemory::create_generate_mips(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, Heap& heap)
 {
-	auto& heap = m_heaps[heap_id];
-
 	if (others.Size() == 3 && type == GpuMemoryObjectType::RenderTexture)
 	{
 		const auto&         b0    = others.At(0);
@@ -782,10 +1098,8 @@ bool GpuMemory::create_generate_mips(const Vector<OverlappedBlock>& others, GpuM
 	return false;
 }
 
-bool GpuMemory::create_texture_triplet(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, int heap_id)
+bool GpuMemory::create_texture_triplet(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, Heap& heap)
 {
-	auto& heap = m_heaps[heap_id];
-
 	if (others.Size() == 2 && type == GpuMemoryObjectType::StorageTexture)
 	{
 		const auto&         b0    = others.At(0);
@@ -808,14 +1122,12 @@ bool GpuMemory::create_texture_triplet(const Vector<OverlappedBlock>& others, Gp
 	return false;
 }
 
-bool GpuMemory::create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, int heap_id)
+bool GpuMemory::create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuMemoryObjectType type, Heap& heap)
 {
-	auto& heap = m_heaps[heap_id];
-
 	if (type == GpuMemoryObjectType::VertexBuffer || type == GpuMemoryObjectType::IndexBuffer)
 	{
 		return std::all_of(others.begin(), others.end(),
-		                   [heap](auto& r)
+		                   [&heap](auto& r)
 		                   {
 			                   OverlapType         rel    = r.relation;
 			                   const auto&         o      = heap.objects[r.object_id];
@@ -827,7 +1139,7 @@ bool GpuMemory::create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuM
 	if (type == GpuMemoryObjectType::Texture)
 	{
 		return std::all_of(others.begin(), others.end(),
-		                   [heap](auto& r)
+		                   [&heap](auto& r)
 		                   {
 			                   OverlapType         rel    = r.relation;
 			                   const auto&         o      = heap.objects[r.object_id];
@@ -839,7 +1151,7 @@ bool GpuMemory::create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuM
 	if (type == GpuMemoryObjectType::RenderTexture)
 	{
 		return std::all_of(others.begin(), others.end(),
-		                   [heap](auto& r)
+		                   [&heap](auto& r)
 		                   {
 			                   OverlapType         rel    = r.relation;
 			                   const auto&         o      = heap.objects[r.object_id];
@@ -851,14 +1163,13 @@ bool GpuMemory::create_maybe_deleted(const Vector<OverlappedBlock>& others, GpuM
 	return false;
 }
 
-bool GpuMemory::create_all_the_same(const Vector<OverlappedBlock>& others, int heap_id)
+bool GpuMemory::create_all_the_same(const Vector<OverlappedBlock>& others, Heap& heap)
 {
-	auto&               heap = m_heaps[heap_id];
 	OverlapType         rel  = others.At(0).relation;
 	GpuMemoryObjectType type = heap.objects[others.At(0).object_id].info.object.type;
 
 	return std::all_of(others.begin(), others.end(),
-	                   [rel, type, heap](auto& r) { return (rel == r.relation && type == heap.objects[r.object_id].info.object.type); });
+	                   [rel, type, &heap](auto& r) { return (rel == r.relation && type == heap.objects[r.object_id].info.object.type); });
 }
 
 String GpuMemory::create_dbg_exit(const String& msg, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
@@ -893,13 +1204,11 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 	EXIT_IF(info.type == GpuMemoryObjectType::Invalid);
 	EXIT_IF(vaddr == nullptr || size == nullptr || vaddr_num > VADDR_BLOCKS_MAX || vaddr_num <= 0);
 
-	Core::LockGuard lock(m_mutex);
-
-	int heap_id = GetHeapId(vaddr[0], size[0]);
+	auto            heap_ref = GetHeap(vaddr[0], size[0]);
+	auto&           heap     = *heap_ref;
+	Core::LockGuard lock(heap.mutex);
 
-	EXIT_NOT_IMPLEMENTED(heap_id < 0);
-
-	auto& heap = m_heaps[heap_id];
+	EXIT_NOT_IMPLEMENTED(!heap.mapped);
 
 	bool overlap             = false;
 	bool delete_all          = false;
@@ -908,7 +1217,7 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 	GpuMemoryScenario scenario = GpuMemoryScenario::Common;
 
 	int fast_id = -1;
-	if (FindFast(heap_id, vaddr, size, vaddr_num, info.type, false, &fast_id))
+	if (FindFast(heap, vaddr, size, vaddr_num, info.type, false, &fast_id))
 	{
 		auto& h = heap.objects[fast_id];
 		EXIT_IF(h.free);
@@ -916,7 +1225,13 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 
 		if (h.scenario == GpuMemoryScenario::Common && info.Equal(o.params))
 		{
-			Update(submit_id, ctx, heap_id, fast_id);
+			if (o.write_back_pending && !info.read_only)
+			{
+				// GPU is going to overwrite the object, the old data is not needed anymore
+				ResolveWriteBack(heap, h.block.vaddr, h.block.size, h.block.vaddr_num, fast_id);
+			}
+
+			Update(submit_id, ctx, heap, fast_id);
 
 			o.use_num++;
 			o.use_last_frame = m_current_frame;
@@ -928,18 +1243,23 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 		}
 	}
 
-	auto others = FindBlocks(heap_id, vaddr, size, vaddr_num);
+	auto others = FindBlocks(heap, vaddr, size, vaddr_num);
 
 	if (!others.IsEmpty())
 	{
 		int existing_id = -1;
-		if (create_existing(others, info, heap_id, &existing_id))
+		if (create_existing(others, info, heap, &existing_id))
 		{
 			auto& h = heap.objects[existing_id];
 			EXIT_IF(h.free);
 			auto& o = h.info;
 
-			Update(submit_id, ctx, heap_id, existing_id);
+			if (o.write_back_pending && !info.read_only)
+			{
+				ResolveWriteBack(heap, h.block.vaddr, h.block.size, h.block.vaddr_num, existing_id);
+			}
+
+			Update(submit_id, ctx, heap, existing_id);
 
 			o.use_num++;
 			o.use_last_frame = m_current_frame;
@@ -1005,21 +1325,21 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 			}
 		} else
 		{
-			if (create_generate_mips(others, info.type, heap_id))
+			if (create_generate_mips(others, info.type, heap))
 			{
 				overlap             = true;
 				create_from_objects = true;
 				scenario            = GpuMemoryScenario::GenerateMips;
-			} else if (create_texture_triplet(others, info.type, heap_id))
+			} else if (create_texture_triplet(others, info.type, heap))
 			{
 				overlap  = true;
 				scenario = GpuMemoryScenario::TextureTriplet;
-			} else if (create_maybe_deleted(others, info.type, heap_id))
+			} else if (create_maybe_deleted(others, info.type, heap))
 			{
 				delete_all = true;
 			} else
 			{
-				if (!create_all_the_same(others, heap_id))
+				if (!create_all_the_same(others, heap))
 				{
 					EXIT("%s\n", create_dbg_exit(U"!create_all_the_same", vaddr, size, vaddr_num, others, info.type).C_Str());
 				}
@@ -1049,13 +1369,16 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 
 	EXIT_IF(delete_all && overlap);
 
+	// The new object is created from the guest memory, the overlapped objects can be deleted
+	ResolveWriteBack(heap, vaddr, size, vaddr_num);
+
 	Vector<Destructor> destructors;
 
 	if (delete_all)
 	{
 		for (const auto& obj: others)
 		{
-			destructors.Add(Free(heap_id, obj.object_id));
+			destructors.Add(Free(heap, obj.object_id));
 		}
 	}
 
@@ -1071,6 +1394,15 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 		o.params[i] = info.params[i];
 	}
 
+	if (m_watcher != nullptr && info.check_hash)
+	{
+		for (int vi = 0; vi < vaddr_num; vi++)
+		{
+			m_watcher->Watch(vaddr[vi], size[vi]);
+		}
+		o.watched = true;
+	}
+
 	uint64_t hash[VADDR_BLOCKS_MAX] = {};
 
 	for (int vi = 0; vi < vaddr_num; vi++)
@@ -1129,7 +1461,7 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 		auto& u            = heap.objects[heap.first_free_id];
 		heap.first_free_id = u.next_free_id;
 		u.free             = false;
-		u.block            = CreateBlock(vaddr, size, vaddr_num, heap_id, index);
+		u.block            = CreateBlock(vaddr, size, vaddr_num, heap, index);
 		u.info             = o;
 		u.others.Clear();
 		u.scenario = scenario;
@@ -1138,7 +1470,7 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 		index = static_cast<int>(heap.objects.Size());
 
 		Object h {};
-		h.block = CreateBlock(vaddr, size, vaddr_num, heap_id, index);
+		h.block = CreateBlock(vaddr, size, vaddr_num, heap, index);
 		h.info  = o;
 		h.others.Clear();
 		h.scenario = scenario;
@@ -1150,16 +1482,20 @@ void* GpuMemory::CreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBu
 	{
 		for (const auto& obj: others)
 		{
-			Link(heap_id, index, obj.object_id, obj.relation, scenario);
+			Link(heap, index, obj.object_id, obj.relation, scenario);
 		}
 	}
 
-	m_mutex.Unlock();
+	heap.mutex.Unlock();
+	if (!destructors.IsEmpty())
+	{
+		UtilFlushUploads(ctx);
+	}
 	for (auto& d: destructors)
 	{
 		d.delete_func(ctx, d.obj, &d.mem);
 	}
-	m_mutex.Lock();
+	heap.mutex.Lock();
 
 	return o.object.obj;
 }
@@ -1171,20 +1507,18 @@ Vector<GpuMemoryObject> GpuMemory::FindObjects(const uint64_t* vaddr, const uint
 
 	EXIT_IF(vaddr == nullptr || size == nullptr || vaddr_num > VADDR_BLOCKS_MAX || vaddr_num <= 0);
 
-	Core::LockGuard lock(m_mutex);
-
-	Vector<GpuMemoryObject> ret;
-
-	int heap_id = GetHeapId(vaddr[0], size[0]);
+	auto            heap_ref = GetHeap(vaddr[0], size[0]);
+	auto&           heap     = *heap_ref;
+	Core::LockGuard lock(heap.mutex);
 
-	EXIT_NOT_IMPLEMENTED(heap_id < 0);
+	EXIT_NOT_IMPLEMENTED(!heap.mapped);
 
-	auto& heap = m_heaps[heap_id];
+	Vector<GpuMemoryObject> ret;
 
 	if (exact)
 	{
 		int fast_id = -1;
-		if (FindFast(heap_id, vaddr, size, vaddr_num, type, only_first, &fast_id))
+		if (FindFast(heap, vaddr, size, vaddr_num, type, only_first, &fast_id))
 		{
 			const auto& h = heap.objects[fast_id];
 			EXIT_IF(h.free);
@@ -1193,7 +1527,7 @@ Vector<GpuMemoryObject> GpuMemory::FindObjects(const uint64_t* vaddr, const uint
 		return ret;
 	}
 
-	auto objects = FindBlocks(heap_id, vaddr, size, vaddr_num, only_first);
+	auto objects = FindBlocks(heap, vaddr, size, vaddr_num, only_first);
 
 	for (const auto& obj: objects)
 	{
@@ -1214,18 +1548,16 @@ void GpuMemory::ResetHash(const uint64_t* vaddr, const uint64_t* size, int vaddr
 	EXIT_IF(type == GpuMemoryObjectType::Invalid);
 	EXIT_IF(vaddr == nullptr || size == nullptr || vaddr_num > VADDR_BLOCKS_MAX || vaddr_num <= 0);
 
-	Core::LockGuard lock(m_mutex);
-
-	int heap_id = GetHeapId(vaddr[0], size[0]);
+	auto            heap_ref = GetHeap(vaddr[0], size[0]);
+	auto&           heap     = *heap_ref;
+	Core::LockGuard lock(heap.mutex);
 
-	EXIT_NOT_IMPLEMENTED(heap_id < 0);
-
-	auto& heap = m_heaps[heap_id];
+	EXIT_NOT_IMPLEMENTED(!heap.mapped);
 
 	uint64_t new_hash = 0;
 
 	int fast_id = -1;
-	if (FindFast(heap_id, vaddr, size, vaddr_num, type, false, &fast_id))
+	if (FindFast(heap, vaddr, size, vaddr_num, type, false, &fast_id))
 	{
 		auto& h = heap.objects[fast_id];
 		EXIT_IF(h.free);
@@ -1245,7 +1577,7 @@ void GpuMemory::ResetHash(const uint64_t* vaddr, const uint64_t* size, int vaddr
 		}
 	}
 
-	auto object_ids = FindBlocks(heap_id, vaddr, size, vaddr_num);
+	auto object_ids = FindBlocks(heap, vaddr, size, vaddr_num);
 
 	if (!object_ids.IsEmpty())
 	{
@@ -1276,17 +1608,22 @@ void GpuMemory::Free(GraphicContext* ctx, uint64_t vaddr, uint64_t size, bool un
 {
 	KYTY_PROFILER_BLOCK("GpuMemory::Free", profiler::colors::Green300);
 
-	m_mutex.Lock();
+	auto  heap_ref = GetHeap(vaddr, size);
+	auto& heap     = *heap_ref;
+	heap.mutex.Lock();
+
+	EXIT_NOT_IMPLEMENTED(!heap.mapped);
 
 	printf("Release gpu objects:\n");
 	printf("\t gpu_vaddr = 0x%016" PRIx64 "\n", vaddr);
 	printf("\t size   = 0x%016" PRIx64 "\n", size);
 
-	int heap_id = GetHeapId(vaddr, size);
-
-	EXIT_NOT_IMPLEMENTED(heap_id < 0);
+	if (!unmap)
+	{
+		ResolveWriteBack(heap, &vaddr, &size, 1);
+	}
 
-	auto object_ids = FindBlocks(heap_id, &vaddr, &size, 1);
+	auto object_ids = FindBlocks(heap, &vaddr, &size, 1);
 
 	Vector<Destructor> destructors;
 
@@ -1295,40 +1632,44 @@ void GpuMemory::Free(GraphicContext* ctx, uint64_t vaddr, uint64_t size, bool un
 		switch (obj.relation)
 		{
 			case OverlapType::IsContainedWithin:
-			case OverlapType::Crosses: destructors.Add(Free(heap_id, obj.object_id)); break;
+			case OverlapType::Crosses: destructors.Add(Free(heap, obj.object_id)); break;
 			default: GpuMemoryDbgDump(); EXIT("unknown obj.relation: %s\n", Core::EnumName(obj.relation).C_Str());
 		}
 	}
 
 	if (unmap)
 	{
-		EXIT_NOT_IMPLEMENTED(!IsAllocated(vaddr, size));
-
-		int index = 0;
-		for (auto& a: m_heaps)
-		{
-			if (a.range.vaddr == vaddr && a.range.size == size)
-			{
-				EXIT_IF(a.objects_map1 == nullptr);
-				EXIT_IF(a.objects_map2 == nullptr);
-				EXIT_NOT_IMPLEMENTED(heap_id != index);
-				EXIT_NOT_IMPLEMENTED(a.objects_size != 0);
-				EXIT_NOT_IMPLEMENTED(!a.objects_map1->IsEmpty());
-				EXIT_NOT_IMPLEMENTED(!a.objects_map2->IsEmpty());
+		EXIT_NOT_IMPLEMENTED(heap.range.vaddr != vaddr || heap.range.size != size);
+		EXIT_IF(heap.objects_tree == nullptr);
+		EXIT_NOT_IMPLEMENTED(heap.objects_size != 0);
+		EXIT_NOT_IMPLEMENTED(!heap.objects_tree->IsEmpty());
 
-				delete a.objects_map1;
-				delete a.objects_map2;
+		delete heap.objects_tree;
+		heap.objects_tree = nullptr;
+		heap.objects.Clear();
+		heap.first_free_id = -1;
+		heap.mapped        = false;
 
-				m_heaps.RemoveAt(index);
-				break;
-			}
-			index++;
+		if (m_watcher != nullptr)
+		{
+			m_watcher->Forget(vaddr, size);
 		}
 
-		EXIT_NOT_IMPLEMENTED(IsAllocated(vaddr, size));
+		m_mutex.Lock();
+		m_heaps.Remove(&heap);
+		EXIT_NOT_IMPLEMENTED(FindHeap(vaddr, size) != nullptr);
+		// The reference of the list, heap_ref keeps the heap until the mutex is unlocked
+		heap.refs--;
+		m_mutex.Unlock();
 	}
 
-	m_mutex.Unlock();
+	heap.mutex.Unlock();
+
+	// Pending uploads can still reference the objects
+	if (!destructors.IsEmpty())
+	{
+		UtilFlushUploads(ctx);
+	}
 
 	for (auto& d: destructors)
 	{
@@ -1336,12 +1677,10 @@ void GpuMemory::Free(GraphicContext* ctx, uint64_t vaddr, uint64_t size, bool un
 	}
 }
 
-GpuMemory::Destructor GpuMemory::Free(int heap_id, int object_id)
+GpuMemory::Destructor GpuMemory::Free(Heap& heap, int object_id)
 {
 	KYTY_PROFILER_BLOCK("GpuMemory::Free", profiler::colors::Green400);
 
-	auto& heap = m_heaps[heap_id];
-
 	auto& h = heap.objects[object_id];
 	EXIT_IF(h.free);
 	auto&       o     = h.info;
@@ -1367,26 +1706,36 @@ GpuMemory::Destructor GpuMemory::Free(int heap_id, int object_id)
 		ret.mem         = o.mem;
 	}
 
+	if (o.write_back_pending)
+	{
+		// The memory is unmapped
+		o.write_back_pending = false;
+		heap.pending_num--;
+	}
+
 	h.free             = true;
 	h.next_free_id     = heap.first_free_id;
 	heap.first_free_id = object_id;
-	DeleteBlock(&h.block, heap_id, object_id);
+	DeleteBlock(&h.block, heap, object_id);
 
 	return ret;
 }
 
-bool GpuMemory::FindFast(int heap_id, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, GpuMemoryObjectType type, bool only_first,
+bool GpuMemory::FindFast(Heap& heap, const uint64_t* vaddr, const uint64_t* size, int vaddr_num, GpuMemoryObjectType type, bool only_first,
                          int* id)
 {
 	KYTY_PROFILER_BLOCK("GpuMemory::FindFast", profiler::colors::Green200);
 
-	auto& heap = m_heaps[heap_id];
-
 	EXIT_IF(id == nullptr);
 
+	Vector<int> ids;
+
 	for (int vi = 0; vi < vaddr_num; vi++)
 	{
-		for (int obj_id: heap.objects_map1->FindAll(vaddr[vi]))
+		ids.Clear();
+		heap.objects_tree->FindStart(vaddr[vi], &ids);
+
+		for (int obj_id: ids)
 		{
 			auto& b = heap.objects[obj_id];
 			EXIT_IF(b.free);
@@ -1423,133 +1772,34 @@ bool GpuMemory::FindFast(int heap_id, const uint64_t* vaddr, const uint64_t* siz
 }
 
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
-Vector<GpuMemory::OverlappedBlock> GpuMemory::FindBlocks_slow(int heap_id, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
-                                                              bool only_first)
+Vector<GpuMemory::OverlappedBlock> GpuMemory::FindBlocks(Heap& heap, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
+                                                         bool only_first)
 {
 	KYTY_PROFILER_BLOCK("GpuMemory::FindBlocks", profiler::colors::Green100);
 
-	auto& heap = m_heaps[heap_id];
-
 	EXIT_IF(vaddr_num <= 0 || vaddr_num > VADDR_BLOCKS_MAX);
 	EXIT_IF(vaddr == nullptr || size == nullptr);
 	EXIT_IF(only_first && vaddr_num != 1);
 
 	Vector<GpuMemory::OverlappedBlock> ret;
 
-	// TODO(): implement interval-tree
-
-	if (vaddr_num != 1)
+	// Candidates in ascending order, an object is reported once even if several of its ranges overlap
+	Vector<int> ids;
 	{
-		int index = 0;
-		for (const auto& b: heap.objects)
-		{
-			if (!b.free)
-			{
-				bool equal = true;
-				for (int i = 0; i < vaddr_num; i++)
-				{
-					if (GetOverlapType(b.block.vaddr[i], b.block.size[i], vaddr[i], size[i]) != OverlapType::Equals)
-					{
-						equal = false;
-						break;
-					}
-				}
-				if (equal)
-				{
-					ret.Add({OverlapType::Equals, index});
-				} else
-				{
-					bool cross = false;
-					for (int i = 0; i < vaddr_num; i++)
-					{
-						for (int j = 0; j < b.block.vaddr_num; j++)
-						{
-							if (GetOverlapType(b.block.vaddr[j], b.block.size[j], vaddr[i], size[i]) != OverlapType::None)
-							{
-								cross = true;
-								break;
-							}
-						}
-						if (cross)
-						{
-							break;
-						}
-					}
-					if (cross)
-					{
-						ret.Add({OverlapType::Crosses, index});
-					}
-				}
-			}
-			index++;
-		}
-	} else
-	{
-		int index = 0;
-		for (const auto& b: heap.objects)
+		KYTY_PROFILER_BLOCK("find");
+
+		for (int vi = 0; vi < vaddr_num; vi++)
 		{
-			if (!b.free)
-			{
-				if (b.block.vaddr_num == 1 || only_first)
-				{
-					auto type = GetOverlapType(b.block.vaddr[0], b.block.size[0], vaddr[0], size[0]);
-					if (type != OverlapType::None)
-					{
-						ret.Add({type, index});
-					}
-				} else
-				{
-					for (int i = 0; i < b.block.vaddr_num; i++)
-					{
-						if (GetOverlapType(b.block.vaddr[i], b.block.size[i], vaddr[0], size[0]) != OverlapType::None)
-						{
-							ret.Add({OverlapType::Crosses, index});
-							break;
-						}
-					}
-				}
-			}
-			index++;
+			heap.objects_tree->FindOverlaps(vaddr[vi], size[vi], &ids);
 		}
-	}
 
-	//	printf("FindBlocks:\n");
-	//	for (int vi = 0; vi < vaddr_num; vi++)
-	//	{
-	//		printf("\t vaddr = 0x%016" PRIx64 ", size = 0x%016" PRIx64 "\n", vaddr[vi], size[vi]);
-	//	}
-	//	for (const auto& d: ret)
-	//	{
-	//		printf("\t id = %d, rel = %s\n", d.object_id, Core::EnumName(d.relation).C_Str());
-	//		const auto& b = m_objects[d.object_id];
-	//		for (int vi = 0; vi < b.block.vaddr_num; vi++)
-	//		{
-	//			printf("\t\t vaddr = 0x%016" PRIx64 ", size = 0x%016" PRIx64 "\n", b.block.vaddr[vi], b.block.size[vi]);
-	//		}
-	//	}
-
-	return ret;
-}
-
-// NOLINTNEXTLINE(readability-function-cognitive-complexity)
-Vector<GpuMemory::OverlappedBlock> GpuMemory::FindBlocks(int heap_id, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
-                                                         bool only_first)
-{
-	KYTY_PROFILER_BLOCK("GpuMemory::FindBlocks", profiler::colors::Green100);
-
-	auto& heap = m_heaps[heap_id];
-
-	EXIT_IF(vaddr_num <= 0 || vaddr_num > VADDR_BLOCKS_MAX);
-	EXIT_IF(vaddr == nullptr || size == nullptr);
-	EXIT_IF(only_first && vaddr_num != 1);
-
-	Vector<GpuMemory::OverlappedBlock> ret;
-
-	// TODO(): implement interval-tree
+		std::sort(ids.begin(), ids.end());
+		ids.RemoveAt(static_cast<uint32_t>(std::unique(ids.begin(), ids.end()) - ids.begin()), ids.Size());
+	}
 
 	if (vaddr_num != 1)
 	{
-		for (int index: heap.objects_map2->FindAll(vaddr, size, vaddr_num))
+		for (int index: ids)
 		{
 			const auto& b = heap.objects[index];
 			if (!b.free)
@@ -1593,7 +1843,7 @@ Vector<GpuMemory::OverlappedBlock> GpuMemory::FindBlocks(int heap_id, const uint
 		}
 	} else
 	{
-		for (int index: heap.objects_map2->FindAll(vaddr[0], size[0]))
+		for (int index: ids)
 		{
 			const auto& b = heap.objects[index];
 			if (!b.free)
@@ -1620,12 +1870,6 @@ Vector<GpuMemory::OverlappedBlock> GpuMemory::FindBlocks(int heap_id, const uint
 		}
 	}
 
-	{
-		KYTY_PROFILER_BLOCK("sort");
-		ret.Sort([](auto& b1, auto& b2) { return b1.object_id < b2.object_id; });
-	}
-
-	//
 	//	printf("FindBlocks:\n");
 	//	for (int vi = 0; vi < vaddr_num; vi++)
 	//	{
@@ -1644,13 +1888,11 @@ Vector<GpuMemory::OverlappedBlock> GpuMemory::FindBlocks(int heap_id, const uint
 	return ret;
 }
 
-GpuMemory::Block GpuMemory::CreateBlock(const uint64_t* vaddr, const uint64_t* size, int vaddr_num, int heap_id, int obj_id)
+GpuMemory::Block GpuMemory::CreateBlock(const uint64_t* vaddr, const uint64_t* size, int vaddr_num, Heap& heap, int obj_id)
 {
 	EXIT_IF(vaddr_num > VADDR_BLOCKS_MAX);
 	EXIT_IF(vaddr == nullptr || size == nullptr);
 
-	auto& heap = m_heaps[heap_id];
-
 	Block nb {};
 	nb.vaddr_num = vaddr_num;
 	for (int vi = 0; vi < vaddr_num; vi++)
@@ -1658,63 +1900,59 @@ GpuMemory::Block GpuMemory::CreateBlock(const uint64_t* vaddr, const uint64_t* s
 		nb.vaddr[vi] = vaddr[vi];
 		nb.size[vi]  = size[vi];
 		heap.objects_size += size[vi];
-		heap.objects_map1->Insert(vaddr[vi], obj_id);
-		heap.objects_map2->Insert(vaddr[vi], size[vi], obj_id);
+		heap.objects_tree->Insert(vaddr[vi], size[vi], obj_id);
 	}
 	return nb;
 }
 
-void GpuMemory::DeleteBlock(Block* b, int heap_id, int obj_id)
+void GpuMemory::DeleteBlock(Block* b, Heap& heap, int obj_id)
 {
-	auto& heap = m_heaps[heap_id];
-
 	for (int vi = 0; vi < b->vaddr_num; vi++)
 	{
 		heap.objects_size -= b->size[vi];
-		heap.objects_map1->Erase(b->vaddr[vi], obj_id);
-		heap.objects_map2->Erase(b->vaddr[vi], b->size[vi], obj_id);
+		bool erased = heap.objects_tree->Erase(b->vaddr[vi], b->size[vi], obj_id);
+		EXIT_NOT_IMPLEMENTED(!erased);
 	}
 }
 
 void GpuMemory::FrameDone()
 {
-	Core::LockGuard lock(m_mutex);
-
 	m_current_frame++;
 }
 
-// NOLINTNEXTLINE(readability-function-cognitive-complexity)
 void GpuMemory::WriteBack(GraphicContext* ctx, CommandProcessor* cp)
 {
 	GraphicsRunCommandProcessorLock(cp);
 
-	Core::LockGuard lock(m_mutex);
-
-	struct WriteBackObject
+	struct Candidate
 	{
-		int heap_id   = -1;
-		int object_id = -1;
+		Heap* heap      = nullptr;
+		int   object_id = -1;
+		void* obj       = nullptr;
 	};
 
-	Vector<WriteBackObject> objects;
+	Vector<Candidate> objects;
 
-	int heap_id = 0;
-	for (auto& heap: m_heaps)
+	// Keeps the candidate heaps alive while they are unlocked
+	auto heaps = GetHeaps();
+
+	for (auto* heap: heaps)
 	{
+		Core::LockGuard heap_lock(heap->mutex);
+
 		int index = 0;
-		for (auto& h: heap.objects)
+		for (auto& h: heap->objects)
 		{
 			if (!h.free)
 			{
 				auto& o = h.info;
 				if (o.in_use && o.write_back_func != nullptr && !o.read_only)
 				{
-					objects.Add(WriteBackObject({heap_id, index}));
+					objects.Add(Candidate({heap, index, o.object.obj}));
 				}
 			}
 			index++;
 		}
-		heap_id++;
 	}
 
 	if (!objects.IsEmpty())
@@ -1723,103 +1961,165 @@ void GpuMemory::WriteBack(GraphicContext* ctx, CommandProcessor* cp)
 		GraphicsRunCommandProcessorFlush(cp);
 		GraphicsRunCommandProcessorWait(cp);
 
+		m_write_back_ctx = ctx;
+
 		for (const auto& obj: objects)
 		{
-			auto& heap  = m_heaps[obj.heap_id];
+			auto&           heap = *obj.heap;
+			Core::LockGuard heap_lock(heap.mutex);
+
+			// The object could be deleted or reused by another thread while the heap was unlocked
+			if (!heap.mapped || heap.objects[obj.object_id].free || heap.objects[obj.object_id].info.object.obj != obj.obj ||
+			    !heap.objects[obj.object_id].info.in_use)
+			{
+				continue;
+			}
+
 			auto& h     = heap.objects[obj.object_id];
 			auto& o     = h.info;
 			auto& block = h.block;
 
-			o.write_back_func(ctx, o.params, o.object.obj, block.vaddr, block.size, block.vaddr_num);
-			o.cpu_update_time = get_current_time();
+			bool hidden = m_lazy_write_back;
+			for (int vi = 0; vi < block.vaddr_num && hidden; vi++)
+			{
+				hidden = m_watcher->Hide(block.vaddr[vi], block.size[vi]);
+			}
 
-			if (!h.others.IsEmpty())
+			if (hidden)
+			{
+				// The GPU data is ready, it's copied when CPU touches the pages
+				o.write_back_pending = true;
+				heap.pending_num++;
+			} else
 			{
-				EXIT_NOT_IMPLEMENTED(h.others.Size() != 1);
-				EXIT_NOT_IMPLEMENTED(h.others.At(0).relation != OverlapType::Equals);
+				WriteBackObject(ctx, heap, obj.object_id);
+			}
 
-				auto& o2 = heap.objects[h.others.At(0).object_id].info;
+			o.in_use = false;
+		}
+	}
 
-				o2.cpu_update_time = o.cpu_update_time;
-				o2.submit_id       = 0;
-				for (int vi = 0; vi < block.vaddr_num; vi++)
-				{
-					o2.hash[vi] = 0;
-				}
-				Update(o.submit_id, ctx, obj.heap_id, h.others.At(0).object_id);
+	GraphicsRunCommandProcessorUnlock(cp);
+}
 
-				for (int vi = 0; vi < block.vaddr_num; vi++)
-				{
-					printf("WriteBack (GPU -> CPU): type = %s, vaddr = 0x%016" PRIx64 ", size = 0x%016" PRIx64 ", old_hash = 0x%016" PRIx64
-					       ", new_hash = 0x%016" PRIx64 "\n",
-					       Core::EnumName(o.object.type).C_Str(), block.vaddr[vi], block.size[vi], o.hash[vi], o2.hash[vi]);
+void GpuMemory::WriteBackObject(GraphicContext* ctx, Heap& heap, int obj_id)
+{
+	KYTY_PROFILER_BLOCK("GpuMemory::WriteBackObject");
 
-					o.hash[vi] = o2.hash[vi];
-				}
-			} else
+	auto& h     = heap.objects[obj_id];
+	auto& o     = h.info;
+	auto& block = h.block;
+
+	EXIT_IF(h.free);
+	EXIT_IF(o.write_back_pending);
+
+	Vector<AllocatedRange> unprotected;
+
+	if (m_watcher != nullptr)
+	{
+		for (int vi = 0; vi < block.vaddr_num; vi++)
+		{
+			bool shown     = m_watcher->Show(block.vaddr[vi], block.size[vi]);
+			bool unwatched = m_watcher->Unwatch(block.vaddr[vi], block.size[vi]);
+			if (shown || unwatched)
 			{
-				for (int vi = 0; vi < block.vaddr_num; vi++)
-				{
-					uint64_t new_hash = 0;
+				unprotected.Add(AllocatedRange({block.vaddr[vi], block.size[vi]}));
+			}
+		}
+	}
 
-					if (o.check_hash)
-					{
-						new_hash = calc_hash(reinterpret_cast<const uint8_t*>(block.vaddr[vi]), block.size[vi]);
-					}
+	o.write_back_func(ctx, o.params, o.object.obj, block.vaddr, block.size, block.vaddr_num);
+	o.cpu_update_time = get_current_time();
 
-					printf("WriteBack (GPU -> CPU): type = %s, vaddr = 0x%016" PRIx64 ", size = 0x%016" PRIx64 ", old_hash = 0x%016" PRIx64
-					       ", new_hash = 0x%016" PRIx64 "\n",
-					       Core::EnumName(o.object.type).C_Str(), block.vaddr[vi], block.size[vi], o.hash[vi], new_hash);
+	if (!h.others.IsEmpty())
+	{
+		EXIT_NOT_IMPLEMENTED(h.others.Size() != 1);
+		EXIT_NOT_IMPLEMENTED(h.others.At(0).relation != OverlapType::Equals);
 
-					o.hash[vi] = new_hash;
-				}
+		auto& o2 = heap.objects[h.others.At(0).object_id].info;
+
+		if (o2.write_back_pending)
+		{
+			// Gets the data of the first object, as if it was written back right after it
+			o2.write_back_pending = false;
+			heap.pending_num--;
+		}
+
+		o2.cpu_update_time = o.cpu_update_time;
+		o2.submit_id       = 0;
+		for (int vi = 0; vi < block.vaddr_num; vi++)
+		{
+			o2.hash[vi] = 0;
+		}
+		Update(o.submit_id, ctx, heap, h.others.At(0).object_id);
+
+		for (int vi = 0; vi < block.vaddr_num; vi++)
+		{
+			printf("WriteBack (GPU -> CPU): type = %s, vaddr = 0x%016" PRIx64 ", size = 0x%016" PRIx64 ", old_hash = 0x%016" PRIx64
+			       ", new_hash = 0x%016" PRIx64 "\n",
+			       Core::EnumName(o.object.type).C_Str(), block.vaddr[vi], block.size[vi], o.hash[vi], o2.hash[vi]);
+
+			o.hash[vi] = o2.hash[vi];
+		}
+	} else
+	{
+		for (int vi = 0; vi < block.vaddr_num; vi++)
+		{
+			uint64_t new_hash = 0;
+
+			if (o.check_hash)
+			{
+				new_hash = calc_hash(reinterpret_cast<const uint8_t*>(block.vaddr[vi]), block.size[vi]);
 			}
 
-			o.in_use = false;
+			printf("WriteBack (GPU -> CPU): type = %s, vaddr = 0x%016" PRIx64 ", size = 0x%016" PRIx64 ", old_hash = 0x%016" PRIx64
+			       ", new_hash = 0x%016" PRIx64 "\n",
+			       Core::EnumName(o.object.type).C_Str(), block.vaddr[vi], block.size[vi], o.hash[vi], new_hash);
+
+			o.hash[vi] = new_hash;
 		}
 	}
 
-	GraphicsRunCommandProcessorUnlock(cp);
+	for (const auto& r: unprotected)
+	{
+		MarkDirty(heap, r.vaddr, r.size);
+	}
 }
 
 void GpuMemory::Flush(GraphicContext* ctx, uint64_t vaddr, uint64_t size)
 {
-	Core::LockGuard lock(m_mutex);
-
-	int heap_id = GetHeapId(vaddr, size);
+	auto            heap_ref = GetHeap(vaddr, size);
+	auto&           heap     = *heap_ref;
+	Core::LockGuard lock(heap.mutex);
 
-	EXIT_NOT_IMPLEMENTED(heap_id < 0);
+	EXIT_NOT_IMPLEMENTED(!heap.mapped);
 
-	auto& heap = m_heaps[heap_id];
-
-	auto object_ids = FindBlocks(heap_id, &vaddr, &size, 1);
+	auto object_ids = FindBlocks(heap, &vaddr, &size, 1);
 
 	for (const auto& obj: object_ids)
 	{
 		auto& h = heap.objects[obj.object_id];
 		EXIT_IF(h.free);
 
-		Update(UINT64_MAX, ctx, heap_id, obj.object_id);
+		Update(UINT64_MAX, ctx, heap, obj.object_id);
 	}
 }
 
 void GpuMemory::FlushAll(GraphicContext* ctx)
 {
-	Core::LockGuard lock(m_mutex);
-
-	int heap_id = 0;
-	for (auto& heap: m_heaps)
+	for (auto* heap: GetHeaps())
 	{
+		Core::LockGuard heap_lock(heap->mutex);
+
 		int index = 0;
-		for (auto& h: heap.objects)
+		for (auto& h: heap->objects)
 		{
 			if (!h.free)
 			{
-				Update(UINT64_MAX, ctx, heap_id, index);
+				Update(UINT64_MAX, ctx, *heap, index);
 			}
 			index++;
 		}
-		heap_id++;
 	}
 }
 
@@ -1912,7 +2212,7 @@ void GpuMemory::DbgDbDump()
 {
 	KYTY_PROFILER_FUNCTION();
 
-	Core::LockGuard lock(m_mutex);
+	Core::LockGuard lock(m_db_mutex);
 
 	static int dump_id = 0;
 
@@ -1931,16 +2231,18 @@ void GpuMemory::DbgDbDump()
 		m_db.Exec("delete from ranges");
 
 		int heap_id = 0;
-		for (const auto& heap: m_heaps)
+		for (auto* heap: GetHeaps())
 		{
+			Core::LockGuard heap_lock(heap->mutex);
+
 			m_db_add_range->Reset();
 			m_db_add_range->BindInt(":dump_id", dump_id);
-			m_db_add_range->BindString(":vaddr", hex(heap.range.vaddr));
-			m_db_add_range->BindString(":size", hex(heap.range.size));
+			m_db_add_range->BindString(":vaddr", hex(heap->range.vaddr));
+			m_db_add_range->BindString(":size", hex(heap->range.size));
 			m_db_add_range->Step();
 
 			int index = 0;
-			for (const auto& r: heap.objects)
+			for (const auto& r: heap->objects)
 			{
 				if (!r.free)
 				{
@@ -2023,7 +2325,7 @@ void GpuMemory::DbgDbSave(const String& file_name)
 {
 	KYTY_PROFILER_FUNCTION();
 
-	Core::LockGuard lock(m_mutex);
+	Core::LockGuard lock(m_db_mutex);
 
 	if (!m_db.IsInvalid())
 	{
@@ -2042,10 +2344,621 @@ struct VulkanMemoryStat
 {
 	std::atomic_uint64_t allocated[VK_MAX_MEMORY_TYPES];
 	std::atomic_uint64_t count[VK_MAX_MEMORY_TYPES];
+	std::atomic_uint64_t reserved[VK_MAX_MEMORY_TYPES];
+	std::atomic_uint64_t blocks[VK_MAX_MEMORY_TYPES];
+	std::atomic_uint64_t largest_free[VK_MAX_MEMORY_TYPES];
 };
 
 static VulkanMemoryStat* g_mem_stat = nullptr;
 
+static uint32_t IntLog2(uint64_t i)
+{
+#if KYTY_COMPILER == KYTY_COMPILER_CLANG || KYTY_PLATFORM != KYTY_PLATFORM_WINDOWS
+	return 63 - __builtin_clzll(i | 1u);
+#else
+	unsigned long temp;
+	_BitScanReverse64(&temp, i | 1u);
+	return temp;
+#endif
+}
+
+static uint32_t IntLowestBit(uint64_t i)
+{
+	EXIT_IF(i == 0);
+#if KYTY_COMPILER == KYTY_COMPILER_CLANG || KYTY_PLATFORM != KYTY_PLATFORM_WINDOWS
+	return __builtin_ctzll(i);
+#else
+	unsigned long temp;
+	_BitScanForward64(&temp, i);
+	return temp;
+#endif
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+class VulkanMemoryBlock;
+
+struct VulkanMemoryChunk
+{
+	uint64_t           offset    = 0;
+	uint64_t           size      = 0;
+	bool               free      = false;
+	VulkanMemoryChunk* prev_phys = nullptr;
+	VulkanMemoryChunk* next_phys = nullptr;
+	VulkanMemoryChunk* prev_free = nullptr;
+	VulkanMemoryChunk* next_free = nullptr;
+	VulkanMemoryBlock* block     = nullptr;
+};
+
+// Two-level segregated fit placement inside one VkDeviceMemory.
+// All offsets and sizes are multiples of the granularity, so neighbouring resources never share a granularity page.
+class VulkanMemoryBlock
+{
+public:
+	static constexpr uint32_t SL_BITS  = 4;
+	static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+	static constexpr uint32_t FL_COUNT = 64;
+
+	VulkanMemoryBlock(uint64_t size, uint64_t granularity, uint32_t type, bool dedicated)
+	    : m_size(size), m_granularity(granularity), m_type(type), m_dedicated(dedicated)
+	{
+		auto* chunk   = new VulkanMemoryChunk;
+		chunk->offset = 0;
+		chunk->size   = size;
+		chunk->block  = this;
+		m_first       = chunk;
+		InsertFree(chunk);
+	}
+
+	virtual ~VulkanMemoryBlock()
+	{
+		EXIT_IF(m_used != 0);
+		EXIT_IF(m_first == nullptr || m_first->next_phys != nullptr);
+		delete m_first;
+	}
+
+	KYTY_CLASS_NO_COPY(VulkanMemoryBlock);
+
+	VulkanMemoryChunk* Alloc(uint64_t size, uint64_t alignment);
+	void               Free(VulkanMemoryChunk* chunk);
+
+	[[nodiscard]] uint64_t GetLargestFree() const;
+
+	[[nodiscard]] uint64_t GetSize() const { return m_size; }
+	[[nodiscard]] uint64_t GetUsed() const { return m_used; }
+	[[nodiscard]] uint32_t GetType() const { return m_type; }
+	[[nodiscard]] bool     IsEmpty() const { return m_used == 0; }
+	[[nodiscard]] bool     IsDedicated() const { return m_dedicated; }
+
+	VkDeviceMemory memory = nullptr;
+	uint8_t*       mapped = nullptr;
+
+private:
+	static void Mapping(uint64_t size, uint32_t* fl, uint32_t* sl);
+
+	void InsertFree(VulkanMemoryChunk* chunk);
+	void RemoveFree(VulkanMemoryChunk* chunk);
+	void Split(VulkanMemoryChunk* chunk, uint64_t size);
+
+	uint64_t           m_size        = 0;
+	uint64_t           m_granularity = 0;
+	uint64_t           m_used        = 0;
+	uint32_t           m_type        = 0;
+	bool               m_dedicated   = false;
+	VulkanMemoryChunk* m_first       = nullptr;
+	uint64_t           m_fl_bitmap   = 0;
+	uint32_t           m_sl_bitmap[FL_COUNT] {};
+	VulkanMemoryChunk* m_free[FL_COUNT][SL_COUNT] {};
+};
+
+void VulkanMemoryBlock::Mapping(uint64_t size, uint32_t* fl, uint32_t* sl)
+{
+	auto log2 = IntLog2(size);
+	if (log2 < SL_BITS)
+	{
+		*fl = 0;
+		*sl = static_cast<uint32_t>(size);
+	} else
+	{
+		*fl = log2 - SL_BITS + 1;
+		*sl = static_cast<uint32_t>(size >> (log2 - SL_BITS)) - SL_COUNT;
+	}
+}
+
+void VulkanMemoryBlock::InsertFree(VulkanMemoryChunk* chunk)
+{
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	Mapping(chunk->size, &fl, &sl);
+
+	chunk->free      = true;
+	chunk->prev_free = nullptr;
+	chunk->next_free = m_free[fl][sl];
+	if (chunk->next_free != nullptr)
+	{
+		chunk->next_free->prev_free = chunk;
+	}
+	m_free[fl][sl] = chunk;
+
+	m_fl_bitmap |= static_cast<uint64_t>(1) << fl;
+	m_sl_bitmap[fl] |= 1u << sl;
+}
+
+void VulkanMemoryBlock::RemoveFree(VulkanMemoryChunk* chunk)
+{
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	Mapping(chunk->size, &fl, &sl);
+
+	if (chunk->prev_free != nullptr)
+	{
+		chunk->prev_free->next_free = chunk->next_free;
+	} else
+	{
+		m_free[fl][sl] = chunk->next_free;
+	}
+	if (chunk->next_free != nullptr)
+	{
+		chunk->next_free->prev_free = chunk->prev_free;
+	}
+
+	if (m_free[fl][sl] == nullptr)
+	{
+		m_sl_bitmap[fl] &= ~(1u << sl);
+		if (m_sl_bitmap[fl] == 0)
+		{
+			m_fl_bitmap &= ~(static_cast<uint64_t>(1) << fl);
+		}
+	}
+
+	chunk->free      = false;
+	chunk->prev_free = nullptr;
+	chunk->next_free = nullptr;
+}
+
+// Cuts the chunk to 'size' bytes, the rest becomes a new free chunk
+void VulkanMemoryBlock::Split(VulkanMemoryChunk* chunk, uint64_t size)
+{
+	auto* rest      = new VulkanMemoryChunk;
+	rest->offset    = chunk->offset + size;
+	rest->size      = chunk->size - size;
+	rest->block     = this;
+	rest->prev_phys = chunk;
+	rest->next_phys = chunk->next_phys;
+	if (rest->next_phys != nullptr)
+	{
+		rest->next_phys->prev_phys = rest;
+	}
+	chunk->next_phys = rest;
+	chunk->size      = size;
+
+	InsertFree(rest);
+}
+
+VulkanMemoryChunk* VulkanMemoryBlock::Alloc(uint64_t size, uint64_t alignment)
+{
+	size      = AlignUp(size, m_granularity);
+	alignment = std::max(alignment, m_granularity);
+
+	if (m_dedicated)
+	{
+		// The block holds one resource at offset 0, which suits any alignment
+		if (m_used != 0 || size > m_size)
+		{
+			return nullptr;
+		}
+
+		auto* chunk = m_first;
+		EXIT_IF(!chunk->free || chunk->next_phys != nullptr);
+
+		RemoveFree(chunk);
+
+		m_used += chunk->size;
+
+		return chunk;
+	}
+
+	// Chunk offsets are multiples of the granularity, so this is the worst-case padding
+	uint64_t search_size = size + (alignment - m_granularity);
+
+	if (search_size > m_size - m_used)
+	{
+		return nullptr;
+	}
+
+	// Round up to the next list, every chunk there is large enough
+	auto log2 = IntLog2(search_size);
+	if (log2 >= SL_BITS)
+	{
+		search_size += (static_cast<uint64_t>(1) << (log2 - SL_BITS)) - 1;
+	}
+
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	Mapping(search_size, &fl, &sl);
+
+	if (fl >= FL_COUNT)
+	{
+		return nullptr;
+	}
+
+	uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+	if (sl_map == 0)
+	{
+		uint64_t fl_map = (fl + 1 < FL_COUNT ? m_fl_bitmap & (~static_cast<uint64_t>(0) << (fl + 1)) : 0);
+		if (fl_map == 0)
+		{
+			return nullptr;
+		}
+		fl     = IntLowestBit(fl_map);
+		sl_map = m_sl_bitmap[fl];
+	}
+	sl = IntLowestBit(sl_map);
+
+	auto* chunk = m_free[fl][sl];
+	EXIT_IF(chunk == nullptr);
+
+	RemoveFree(chunk);
+
+	uint64_t padding = AlignUp(chunk->offset, alignment) - chunk->offset;
+
+	EXIT_IF(chunk->size < size + padding);
+
+	if (padding != 0)
+	{
+		// Keep the padding as a free chunk in front of the allocation
+		Split(chunk, padding);
+		auto* next = chunk->next_phys;
+		RemoveFree(next);
+		InsertFree(chunk);
+		chunk = next;
+	}
+
+	if (chunk->size > size)
+	{
+		Split(chunk, size);
+	}
+
+	m_used += chunk->size;
+
+	return chunk;
+}
+
+void VulkanMemoryBlock::Free(VulkanMemoryChunk* chunk)
+{
+	EXIT_IF(chunk == nullptr);
+	EXIT_IF(chunk->block != this);
+	EXIT_IF(chunk->free);
+
+	m_used -= chunk->size;
+
+	if (auto* prev = chunk->prev_phys; prev != nullptr && prev->free)
+	{
+		RemoveFree(prev);
+		prev->size += chunk->size;
+		prev->next_phys = chunk->next_phys;
+		if (prev->next_phys != nullptr)
+		{
+			prev->next_phys->prev_phys = prev;
+		}
+		delete chunk;
+		chunk = prev;
+	}
+
+	if (auto* next = chunk->next_phys; next != nullptr && next->free)
+	{
+		RemoveFree(next);
+		chunk->size += next->size;
+		chunk->next_phys = next->next_phys;
+		if (chunk->next_phys != nullptr)
+		{
+			chunk->next_phys->prev_phys = chunk;
+		}
+		delete next;
+	}
+
+	InsertFree(chunk);
+}
+
+uint64_t VulkanMemoryBlock::GetLargestFree() const
+{
+	if (m_fl_bitmap == 0)
+	{
+		return 0;
+	}
+
+	auto fl = IntLog2(m_fl_bitmap);
+	auto sl = IntLog2(m_sl_bitmap[fl]);
+
+	uint64_t largest = 0;
+	for (const auto* chunk = m_free[fl][sl]; chunk != nullptr; chunk = chunk->next_free)
+	{
+		largest = std::max(largest, chunk->size);
+	}
+
+	return largest;
+}
+
+// Sub-allocates VulkanMemory objects from large per-type blocks instead of calling vkAllocateMemory for each resource
+class VulkanMemoryManager
+{
+public:
+	static constexpr uint64_t BLOCK_SIZE_MAX  = static_cast<uint64_t>(256) * 1024 * 1024;
+	static constexpr uint64_t BLOCK_SIZE_MIN  = static_cast<uint64_t>(16) * 1024 * 1024;
+	static constexpr uint64_t GRANULARITY_MIN = 256;
+
+	VulkanMemoryManager() = default;
+	virtual ~VulkanMemoryManager() { KYTY_NOT_IMPLEMENTED; }
+	KYTY_CLASS_NO_COPY(VulkanMemoryManager);
+
+	bool  Alloc(GraphicContext* ctx, VulkanMemory* mem);
+	void  Free(GraphicContext* ctx, VulkanMemory* mem);
+	void* Map(VulkanMemory* mem);
+
+	Core::StringList GetStat();
+
+private:
+	void               Init(GraphicContext* ctx);
+	uint32_t           FindType(uint32_t type_bits, VkMemoryPropertyFlags property);
+	VulkanMemoryBlock* CreateBlock(GraphicContext* ctx, uint32_t type, uint64_t size, bool dedicated);
+	void               DeleteBlock(GraphicContext* ctx, VulkanMemoryBlock* block);
+	void               UpdateStat(uint32_t type);
+
+	Core::Mutex                       m_mutex;
+	bool                              m_initialized = false;
+	VkPhysicalDeviceMemoryProperties  m_properties {};
+	uint64_t                          m_granularity = GRANULARITY_MIN;
+	Core::Hashmap<uint64_t, uint32_t> m_types;
+	Vector<VulkanMemoryBlock*>        m_blocks[VK_MAX_MEMORY_TYPES];
+	uint64_t                          m_block_size[VK_MAX_MEMORY_TYPES] {};
+};
+
+static VulkanMemoryManager* g_mem_manager = nullptr;
+
+void VulkanMemoryManager::Init(GraphicContext* ctx)
+{
+	vkGetPhysicalDeviceMemoryProperties(ctx->physical_device, &m_properties);
+
+	VkPhysicalDeviceProperties device_properties {};
+	vkGetPhysicalDeviceProperties(ctx->physical_device, &device_properties);
+
+	// Linear and optimal resources may share a block, keep them on separate granularity pages
+	m_granularity = std::max(GRANULARITY_MIN, static_cast<uint64_t>(device_properties.limits.bufferImageGranularity));
+
+	for (uint32_t i = 0; i < m_properties.memoryTypeCount; i++)
+	{
+		uint64_t heap_size = m_properties.memoryHeaps[m_properties.memoryTypes[i].heapIndex].size;
+		m_block_size[i]    = AlignUp(std::clamp(heap_size / 8, BLOCK_SIZE_MIN, BLOCK_SIZE_MAX), m_granularity);
+	}
+
+	m_initialized = true;
+}
+
+uint32_t VulkanMemoryManager::FindType(uint32_t type_bits, VkMemoryPropertyFlags property)
+{
+	uint64_t key = (static_cast<uint64_t>(type_bits) << 32u) | property;
+
+	if (const auto* index = m_types.Find(key); index != nullptr)
+	{
+		return *index;
+	}
+
+	uint32_t index = 0;
+	for (; index < m_properties.memoryTypeCount; index++)
+	{
+		if ((type_bits & (static_cast<uint32_t>(1) << index)) != 0 &&
+		    (m_properties.memoryTypes[index].propertyFlags & property) == property)
+		{
+			break;
+		}
+	}
+
+	EXIT_NOT_IMPLEMENTED(index >= m_properties.memoryTypeCount);
+
+	m_types.Put(key, index);
+
+	return index;
+}
+
+VulkanMemoryBlock* VulkanMemoryManager::CreateBlock(GraphicContext* ctx, uint32_t type, uint64_t size, bool dedicated)
+{
+	VkMemoryAllocateInfo alloc_info {};
+	alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.pNext           = nullptr;
+	alloc_info.allocationSize  = size;
+	alloc_info.memoryTypeIndex = type;
+
+	VkDeviceMemory memory = nullptr;
+
+	if (vkAllocateMemory(ctx->device, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+	{
+		return nullptr;
+	}
+
+	auto* block   = new VulkanMemoryBlock(size, m_granularity, type, dedicated);
+	block->memory = memory;
+
+	// Host-visible blocks stay mapped for their whole lifetime, a VkDeviceMemory can't be mapped twice
+	if ((m_properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+	{
+		void* data = nullptr;
+		EXIT_NOT_IMPLEMENTED(vkMapMemory(ctx->device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS);
+		block->mapped = static_cast<uint8_t*>(data);
+	}
+
+	m_blocks[type].Add(block);
+
+	g_mem_stat->reserved[type] += size;
+	g_mem_stat->blocks[type]++;
+
+	return block;
+}
+
+void VulkanMemoryManager::DeleteBlock(GraphicContext* ctx, VulkanMemoryBlock* block)
+{
+	auto type = block->GetType();
+
+	if (block->mapped != nullptr)
+	{
+		vkUnmapMemory(ctx->device, block->memory);
+	}
+	vkFreeMemory(ctx->device, block->memory, nullptr);
+
+	g_mem_stat->reserved[type] -= block->GetSize();
+	g_mem_stat->blocks[type]--;
+
+	m_blocks[type].Remove(block);
+
+	delete block;
+}
+
+void VulkanMemoryManager::UpdateStat(uint32_t type)
+{
+	uint64_t largest = 0;
+	for (const auto* block: m_blocks[type])
+	{
+		largest = std::max(largest, block->GetLargestFree());
+	}
+	g_mem_stat->largest_free[type] = largest;
+}
+
+bool VulkanMemoryManager::Alloc(GraphicContext* ctx, VulkanMemory* mem)
+{
+	Core::LockGuard lock(m_mutex);
+
+	if (!m_initialized)
+	{
+		Init(ctx);
+	}
+
+	auto     type      = FindType(mem->requirements.memoryTypeBits, mem->property);
+	uint64_t size      = mem->requirements.size;
+	uint64_t alignment = std::max(static_cast<uint64_t>(mem->requirements.alignment), static_cast<uint64_t>(1));
+
+	VulkanMemoryChunk* chunk = nullptr;
+
+	if (size <= m_block_size[type] / 2)
+	{
+		for (auto* block: m_blocks[type])
+		{
+			if (!block->IsDedicated() && (chunk = block->Alloc(size, alignment)) != nullptr)
+			{
+				break;
+			}
+		}
+
+		if (chunk == nullptr)
+		{
+			if (auto* block = CreateBlock(ctx, type, m_block_size[type], false); block != nullptr)
+			{
+				if ((chunk = block->Alloc(size, alignment)) == nullptr)
+				{
+					DeleteBlock(ctx, block);
+				}
+			}
+		}
+	}
+
+	if (chunk == nullptr)
+	{
+		// Large resources, or the device is too short of memory for a whole block
+		if (auto* block = CreateBlock(ctx, type, AlignUp(size, m_granularity), true); block != nullptr)
+		{
+			if ((chunk = block->Alloc(size, alignment)) == nullptr)
+			{
+				DeleteBlock(ctx, block);
+			}
+		}
+	}
+
+	mem->type = type;
+
+	if (chunk == nullptr)
+	{
+		return false;
+	}
+
+	mem->memory        = chunk->block->memory;
+	mem->offset        = chunk->offset;
+	mem->suballocation = chunk;
+
+	UpdateStat(type);
+
+	return true;
+}
+
+void VulkanMemoryManager::Free(GraphicContext* ctx, VulkanMemory* mem)
+{
+	Core::LockGuard lock(m_mutex);
+
+	auto* chunk = static_cast<VulkanMemoryChunk*>(mem->suballocation);
+
+	EXIT_IF(chunk == nullptr);
+
+	auto* block = chunk->block;
+	auto  type  = block->GetType();
+
+	block->Free(chunk);
+
+	if (block->IsEmpty())
+	{
+		// Keep one empty block per type, so alloc/free cycles don't hit vkAllocateMemory every time
+		bool keep = !block->IsDedicated() &&
+		            !m_blocks[type].Contains(block, [](const VulkanMemoryBlock* b, const VulkanMemoryBlock* self)
+		                                     { return b != self && !b->IsDedicated() && b->IsEmpty(); });
+
+		if (!keep)
+		{
+			DeleteBlock(ctx, block);
+		}
+	}
+
+	UpdateStat(type);
+
+	mem->suballocation = nullptr;
+}
+
+void* VulkanMemoryManager::Map(VulkanMemory* mem)
+{
+	auto* chunk = static_cast<VulkanMemoryChunk*>(mem->suballocation);
+
+	EXIT_IF(chunk == nullptr);
+	EXIT_NOT_IMPLEMENTED(chunk->block->mapped == nullptr);
+
+	return chunk->block->mapped + chunk->offset;
+}
+
+Core::StringList VulkanMemoryManager::GetStat()
+{
+	Core::LockGuard lock(m_mutex);
+
+	Core::StringList stat;
+	stat.Add(U"type, count, allocated, blocks, reserved, largest_free, fragmentation");
+	for (uint32_t i = 0; i < m_properties.memoryTypeCount; i++)
+	{
+		UpdateStat(i);
+
+		uint64_t allocated    = g_mem_stat->allocated[i];
+		uint64_t count        = g_mem_stat->count[i];
+		uint64_t reserved     = g_mem_stat->reserved[i];
+		uint64_t blocks       = g_mem_stat->blocks[i];
+		uint64_t largest_free = g_mem_stat->largest_free[i];
+		uint64_t free         = 0;
+		for (const auto* block: m_blocks[i])
+		{
+			free += block->GetSize() - block->GetUsed();
+		}
+		// 0% - all free space is one range, 100% - free space is scattered in small pieces
+		double fragmentation = (free == 0 ? 0.0 : 100.0 * (1.0 - static_cast<double>(largest_free) / static_cast<double>(free)));
+		stat.Add(String::FromPrintf("%u, %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ", %.1f%%", i, count, allocated,
+		                            blocks, reserved, largest_free, fragmentation));
+	}
+	return stat;
+}
+
 void GpuMemoryInit()
 {
 	EXIT_IF(g_gpu_memory != nullptr);
@@ -2054,12 +2967,16 @@ void GpuMemoryInit()
 	g_gpu_memory    = new GpuMemory;
 	g_gpu_resources = new GpuResources;
 
-	g_mem_stat = new VulkanMemoryStat;
+	g_mem_stat    = new VulkanMemoryStat;
+	g_mem_manager = new VulkanMemoryManager;
 
 	for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
 	{
-		g_mem_stat->allocated[i] = 0;
-		g_mem_stat->count[i]     = 0;
+		g_mem_stat->allocated[i]    = 0;
+		g_mem_stat->count[i]        = 0;
+		g_mem_stat->reserved[i]     = 0;
+		g_mem_stat->blocks[i]       = 0;
+		g_mem_stat->largest_free[i] = 0;
 	}
 }
 
@@ -2068,6 +2985,8 @@ void GpuMemorySetAllocatedRange(uint64_t vaddr, uint64_t size)
 	EXIT_IF(g_gpu_memory == nullptr);
 
 	g_gpu_memory->SetAllocatedRange(vaddr, size);
+
+	VulkanAddImportRange(vaddr, size);
 }
 
 void GpuMemoryFree(GraphicContext* ctx, uint64_t vaddr, uint64_t size, bool unmap)
@@ -2076,6 +2995,12 @@ void GpuMemoryFree(GraphicContext* ctx, uint64_t vaddr, uint64_t size, bool unma
 	EXIT_IF(ctx == nullptr);
 
 	g_gpu_memory->Free(ctx, vaddr, size, unmap);
+
+	if (unmap)
+	{
+		// The objects are deleted, GPU is idle
+		VulkanRemoveImportRange(ctx, vaddr, size);
+	}
 }
 
 void* GpuMemoryCreateObject(uint64_t submit_id, GraphicContext* ctx, CommandBuffer* buffer, uint64_t vaddr, uint64_t size,
@@ -2163,14 +3088,31 @@ void GpuMemoryWriteBack(GraphicContext* ctx, CommandProcessor* cp)
 	g_gpu_memory->WriteBack(ctx, cp);
 }
 
-bool GpuMemoryCheckAccessViolation(uint64_t /*vaddr*/, uint64_t /*size*/)
+bool GpuMemoryCheckAccessViolation(uint64_t vaddr, uint64_t size)
 {
-	return false;
+	if (g_gpu_memory == nullptr || size == 0)
+	{
+		return false;
+	}
+
+	// CPU writes to memory which backs GPU objects or accesses memory which waits for a write-back
+	return g_gpu_memory->CheckAccessViolation(vaddr, size);
+}
+
+bool GpuMemoryCheckReadAccess(uint64_t vaddr, uint64_t size)
+{
+	if (g_gpu_memory == nullptr || size == 0)
+	{
+		return false;
+	}
+
+	// CPU reads memory which waits for a write-back
+	return g_gpu_memory->CheckReadAccess(vaddr, size);
 }
 
 bool GpuMemoryWatcherEnabled()
 {
-	return false;
+	return (g_gpu_memory != nullptr && g_gpu_memory->IsWatcherEnabled());
 }
 
 bool VulkanAllocate(GraphicContext* ctx, VulkanMemory* mem)
@@ -2183,51 +3125,21 @@ bool VulkanAllocate(GraphicContext* ctx, VulkanMemory* mem)
 	EXIT_IF(mem == nullptr);
 	EXIT_IF(mem->memory != nullptr);
 	EXIT_IF(mem->requirements.size == 0);
-
-	VkPhysicalDeviceMemoryProperties memory_properties {};
-	vkGetPhysicalDeviceMemoryProperties(ctx->physical_device, &memory_properties);
-
-	uint32_t index = 0;
-	for (; index < memory_properties.memoryTypeCount; index++)
-	{
-		if ((mem->requirements.memoryTypeBits & (static_cast<uint32_t>(1) << index)) != 0 &&
-		    (memory_properties.memoryTypes[index].propertyFlags & mem->property) == mem->property)
-		{
-			break;
-		}
-	}
-
-	mem->type   = index;
-	mem->offset = 0;
-
-	VkMemoryAllocateInfo alloc_info {};
-	alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	alloc_info.pNext           = nullptr;
-	alloc_info.allocationSize  = mem->requirements.size;
-	alloc_info.memoryTypeIndex = index;
+	EXIT_IF(g_mem_manager == nullptr);
 
 	mem->unique_id = ++seq;
 
-	auto result = vkAllocateMemory(ctx->device, &alloc_info, nullptr, &mem->memory);
-
-	if (result == VK_SUCCESS)
+	if (g_mem_manager->Alloc(ctx, mem))
 	{
-		g_mem_stat->allocated[index] += mem->requirements.size;
-		g_mem_stat->count[index]++;
+		g_mem_stat->allocated[mem->type] += mem->requirements.size;
+		g_mem_stat->count[mem->type]++;
 		return true;
 	}
 
-	Core::StringList stat;
-	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
-	{
-		uint64_t allocated = g_mem_stat->allocated[i];
-		uint64_t count     = g_mem_stat->count[i];
-		stat.Add(String::FromPrintf("%u, %" PRIu64 ", %" PRIu64 "", i, count, allocated));
-	}
+	auto stat = g_mem_manager->GetStat();
 	g_gpu_memory->DbgDbDump();
 	g_gpu_memory->DbgDbSave(U"_gpu_memory.db");
-	EXIT("size = %" PRIu64 ", index = %u, error: %s:%s\n", mem->requirements.size, index, string_VkResult(result),
-	     stat.Concat(U'\n').C_Str());
+	EXIT("size = %" PRIu64 ", index = %u, error: out of memory:\n%s\n", mem->requirements.size, mem->type, stat.Concat(U'\n').C_Str());
 
 	return false;
 }
@@ -2238,13 +3150,15 @@ void VulkanFree(GraphicContext* ctx, VulkanMemory* mem)
 
 	EXIT_IF(ctx == nullptr);
 	EXIT_IF(mem == nullptr);
+	EXIT_IF(g_mem_manager == nullptr);
 
-	vkFreeMemory(ctx->device, mem->memory, nullptr);
+	g_mem_manager->Free(ctx, mem);
 
 	g_mem_stat->allocated[mem->type] -= mem->requirements.size;
 	g_mem_stat->count[mem->type]--;
 
 	mem->memory = nullptr;
+	mem->offset = 0;
 }
 
 void VulkanMapMemory(GraphicContext* ctx, VulkanMemory* mem, void** data)
@@ -2254,8 +3168,10 @@ void VulkanMapMemory(GraphicContext* ctx, VulkanMemory* mem, void** data)
 	EXIT_IF(ctx == nullptr);
 	EXIT_IF(mem == nullptr);
 	EXIT_IF(data == nullptr);
+	EXIT_IF(g_mem_manager == nullptr);
 
-	vkMapMemory(ctx->device, mem->memory, mem->offset, mem->requirements.size, 0, data);
+	// Host-visible blocks are persistently mapped
+	*data = g_mem_manager->Map(mem);
 }
 
 void VulkanUnmapMemory(GraphicContext* ctx, VulkanMemory* mem)
@@ -2264,8 +3180,7 @@ void VulkanUnmapMemory(GraphicContext* ctx, VulkanMemory* mem)
 
 	EXIT_IF(ctx == nullptr);
 	EXIT_IF(mem == nullptr);
-
-	vkUnmapMemory(ctx->device, mem->memory);
+	EXIT_IF(mem->suballocation == nullptr);
 }
 
 void VulkanBindImageMemory(GraphicContext* ctx, VulkanImage* image, VulkanMemory* mem)
@@ -19,7 +19,7 @@ public:
 	virtual ~IndexBufferManager() { KYTY_NOT_IMPLEMENTED; }
 	KYTY_CLASS_NO_COPY(IndexBufferManager);
 
-	void RegisterForDelete(VulkanBuffer* buf)
+	void RegisterForDelete(GuestVulkanBuffer* buf)
 	{
 		Core::Mutex m_mutex;
 
@@ -49,7 +49,7 @@ public:
 private:
 	Core::Mutex m_mutex;
 
-	Vector<VulkanBuffer*> m_buffers;
+	Vector<GuestVulkanBuffer*> m_buffers;
 };
 
 static IndexBufferManager* g_index_buffer_manager = nullptr;
@@ -78,51 +78,57 @@ static void* create_func(GraphicContext* ctx, const uint64_t* /*params*/, const
 	EXIT_IF(mem == nullptr);
 	EXIT_IF(ctx == nullptr);
 
-	auto* vk_obj = new VulkanBuffer;
+	auto* vk_obj = new GuestVulkanBuffer;
 
-	vk_obj->usage           = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	vk_obj->usage  = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	vk_obj->buffer = nullptr;
+
+	// No allocation and no copy, GPU reads the guest memory
+	if (VulkanImportBuffer(ctx, *vaddr, *size, vk_obj))
+	{
+		return vk_obj;
+	}
+
+	vk_obj->usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	vk_obj->memory.property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	vk_obj->buffer          = nullptr;
 
 	VulkanCreateBuffer(ctx, *size, vk_obj);
 	EXIT_NOT_IMPLEMENTED(vk_obj->buffer == nullptr);
 
-	VulkanBuffer staging_buffer {};
-	staging_buffer.usage           = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	staging_buffer.memory.property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-	VulkanCreateBuffer(ctx, *size, &staging_buffer);
-	EXIT_NOT_IMPLEMENTED(staging_buffer.buffer == nullptr);
-
-	void* data = nullptr;
-	// vkMapMemory(ctx->device, staging_buffer.memory.memory, staging_buffer.memory.offset, *size, 0, &data);
-	VulkanMapMemory(ctx, &staging_buffer.memory, &data);
-	memcpy(data, reinterpret_cast<void*>(*vaddr), *size);
-	// vkUnmapMemory(ctx->device, staging_buffer.memory.memory);
-	VulkanUnmapMemory(ctx, &staging_buffer.memory);
-
-	UtilCopyBuffer(&staging_buffer, vk_obj, *size);
-
-	VulkanDeleteBuffer(ctx, &staging_buffer);
+	UtilFillBuffer(ctx, vk_obj, reinterpret_cast<void*>(*vaddr), *size);
 
 	return vk_obj;
 }
 
-static void update_func(GraphicContext* /*ctx*/, const uint64_t* /*params*/, void* /*obj*/, const uint64_t* /*vaddr*/,
+static void update_func(GraphicContext* /*ctx*/, const uint64_t* /*params*/, void* obj, const uint64_t* /*vaddr*/,
                         const uint64_t* /*size*/, int /*vaddr_num*/)
 {
 	KYTY_PROFILER_BLOCK("IndexBufferGpuObject::update_func");
 
-	KYTY_NOT_IMPLEMENTED;
+	EXIT_IF(obj == nullptr);
+
+	// Imported buffers always see the current guest memory
+	EXIT_NOT_IMPLEMENTED(!static_cast<GuestVulkanBuffer*>(obj)->imported);
 }
 
-static void delete_func(GraphicContext* /*ctx*/, void* obj, VulkanMemory* /*mem*/)
+static void delete_func(GraphicContext* ctx, void* obj, VulkanMemory* /*mem*/)
 {
 	KYTY_PROFILER_BLOCK("IndexBufferGpuObject::delete_func");
 
 	EXIT_IF(g_index_buffer_manager == nullptr);
 
-	auto* vk_obj = reinterpret_cast<VulkanBuffer*>(obj);
+	auto* vk_obj = reinterpret_cast<GuestVulkanBuffer*>(obj);
+
+	EXIT_IF(vk_obj == nullptr);
+	EXIT_IF(vk_obj->buffer == nullptr);
+
+	if (vk_obj->imported)
+	{
+		// Deleted after the submits, or before the guest memory is unmapped
+		EXIT_IF(ctx == nullptr);
+		VulkanDeleteImportedBuffer(ctx, vk_obj);
+		return;
+	}
 
 	g_index_buffer_manager->RegisterForDelete(vk_obj);
 }
@@ -2,19 +2,17 @@
 
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/Threads.h"
+#include "Kyty/Core/Timer.h"
 #include "Kyty/Core/Vector.h"
 
 #include "Emulator/Graphics/GraphicContext.h"
 #include "Emulator/Graphics/GraphicsRender.h"
-#include "Emulator/Graphics/GraphicsRun.h"
 #include "Emulator/Profiler.h"
 
 #ifdef KYTY_EMU_ENABLED
 
 namespace Kyty::Libs::Graphics {
 
-class CommandProcessor;
-
 enum LabelStatus
 {
 	New,
@@ -36,11 +34,32 @@ struct LabelCallbacks
 
 struct Label
 {
-	VkDevice          device = nullptr;
-	VkEvent           event  = nullptr;
-	LabelStatus       status = LabelStatus::New;
-	LabelCallbacks    callbacks;
-	CommandProcessor* cp = nullptr;
+	LabelStatus    status = LabelStatus::New;
+	LabelCallbacks callbacks;
+};
+
+// Labels set in a command buffer which is not submitted yet
+struct LabelPending
+{
+	CommandBuffer* buffer = nullptr;
+	Vector<Label*> labels;
+};
+
+// Labels retired when the queue timeline semaphore reaches the value
+struct LabelBatch
+{
+	uint64_t       value       = 0;
+	uint64_t       seq         = 0;
+	uint64_t       submit_time = 0;
+	Vector<Label*> labels;
+};
+
+struct LabelQueue
+{
+	VkSemaphore        semaphore = nullptr;
+	uint64_t           value     = 0;
+	uint64_t           completed = 0;
+	Vector<LabelBatch> batches;
 };
 
 class LabelManager
@@ -61,191 +80,294 @@ public:
 	                LabelGpuObject::callback_t callback_2, const uint64_t* args);
 	void   Delete(Label* label);
 	void   Set(CommandBuffer* buffer, Label* label);
+	bool   Submit(CommandBuffer* buffer, int queue, VkSemaphore* semaphore, uint64_t* value);
 
 private:
 	static void ThreadRun(void* data);
-
-	bool        Remove(Label* label);
-	static void Destroy(Label* label);
-
-	Core::Mutex    m_mutex;
-	Core::CondVar  m_cond_var;
-	Vector<Label*> m_labels;
+	static void Fire(const LabelCallbacks& label);
+
+	Label* Create(GraphicContext* ctx, const LabelCallbacks& callbacks);
+	void   CreateSemaphores(VkDevice device);
+	void   Wait();
+	void   Retire(Vector<Label*>* deleted_labels, Vector<LabelCallbacks>* fired_labels);
+
+	Core::Mutex          m_mutex;
+	Core::CondVar        m_cond_var;
+	Vector<Label*>       m_labels;
+	Vector<LabelPending> m_pending;
+	VkDevice             m_device      = nullptr;
+	LabelQueue           m_queues[GraphicContext::QUEUES_NUM];
+	VkSemaphore          m_wake        = nullptr;
+	uint64_t             m_wake_value  = 0;
+	uint64_t             m_seq         = 0;
+	uint32_t             m_batches_num = 0;
 };
 
 static LabelManager* g_label_manager = nullptr;
 
-void LabelManager::ThreadRun(void* data)
+void LabelManager::CreateSemaphores(VkDevice device)
 {
-	auto* manager = static_cast<LabelManager*>(data);
+	EXIT_IF(device == nullptr);
 
-	for (;;)
+	VkSemaphoreTypeCreateInfo type_create_info {};
+	type_create_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_create_info.pNext         = nullptr;
+	type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_create_info.initialValue  = 0;
+
+	VkSemaphoreCreateInfo create_info {};
+	create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	create_info.pNext = &type_create_info;
+	create_info.flags = 0;
+
+	// One timeline per queue: values signaled by different queues are not ordered
+	for (auto& q: m_queues)
 	{
-		manager->m_mutex.Lock();
+		vkCreateSemaphore(device, &create_info, nullptr, &q.semaphore);
 
-		int active_count = 0;
+		EXIT_NOT_IMPLEMENTED(q.semaphore == nullptr);
+	}
 
-		Vector<Label*>         deleted_labels;
-		Vector<LabelCallbacks> fired_labels;
+	// Signaled from the host to wake up the thread when a new queue gets work
+	vkCreateSemaphore(device, &create_info, nullptr, &m_wake);
 
-		for (auto& label: manager->m_labels)
-		{
-			if (label->status == LabelStatus::Active || label->status == LabelStatus::ActiveDeleted)
-			{
-				active_count++;
+	EXIT_NOT_IMPLEMENTED(m_wake == nullptr);
 
-				if (vkGetEventStatus(label->device, label->event) == VK_EVENT_SET)
-				{
-					if (label->status == LabelStatus::ActiveDeleted)
-					{
-						deleted_labels.Add(label);
-					}
+	m_device = device;
+}
 
-					label->status = LabelStatus::NotActive;
+void LabelManager::Wait()
+{
+	VkSemaphore semaphores[GraphicContext::QUEUES_NUM + 1];
+	uint64_t    values[GraphicContext::QUEUES_NUM + 1];
+	uint32_t    count = 0;
 
-					fired_labels.Add(label->callbacks);
-				}
-			}
-		}
+	m_mutex.Lock();
 
-		if (active_count == 0)
+	while (m_batches_num == 0)
+	{
+		m_cond_var.Wait(&m_mutex);
+	}
+
+	for (const auto& q: m_queues)
+	{
+		if (!q.batches.IsEmpty())
 		{
-			manager->m_cond_var.Wait(&manager->m_mutex);
+			semaphores[count] = q.semaphore;
+			values[count]     = q.batches.At(0).value;
+			count++;
 		}
+	}
+
+	semaphores[count] = m_wake;
+	values[count]     = m_wake_value + 1;
+	count++;
+
+	m_mutex.Unlock();
+
+	VkSemaphoreWaitInfo wait_info {};
+	wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.pNext          = nullptr;
+	wait_info.flags          = VK_SEMAPHORE_WAIT_ANY_BIT;
+	wait_info.semaphoreCount = count;
+	wait_info.pSemaphores    = semaphores;
+	wait_info.pValues        = values;
+
+	auto result = vkWaitSemaphores(m_device, &wait_info, UINT64_MAX);
+
+	EXIT_NOT_IMPLEMENTED(result != VK_SUCCESS);
+}
+
+void LabelManager::Retire(Vector<Label*>* deleted_labels, Vector<LabelCallbacks>* fired_labels)
+{
+	Core::LockGuard lock(m_mutex);
 
-		for (auto& label: deleted_labels)
+	for (auto& q: m_queues)
+	{
+		if (!q.batches.IsEmpty())
 		{
-			bool removed = manager->Remove(label);
-			EXIT_NOT_IMPLEMENTED(!removed);
+			vkGetSemaphoreCounterValue(m_device, q.semaphore, &q.completed);
 		}
+	}
+
+	uint64_t now       = Core::Timer::QueryPerformanceCounter();
+	uint64_t frequency = Core::Timer::QueryPerformanceFrequency();
 
-		manager->m_mutex.Unlock();
+	// Completed batches from all queues, in submission order
+	for (;;)
+	{
+		LabelQueue* next = nullptr;
 
-		for (auto& label: deleted_labels)
+		for (auto& q: m_queues)
 		{
-			Destroy(label);
+			if (!q.batches.IsEmpty() && q.batches.At(0).value <= q.completed &&
+			    (next == nullptr || q.batches.At(0).seq < next->batches.At(0).seq))
+			{
+				next = &q;
+			}
 		}
 
-		for (auto& label: fired_labels)
+		if (next == nullptr)
 		{
-			bool write = true;
+			break;
+		}
 
-			if (label.callback_1 != nullptr)
-			{
-				write = label.callback_1(label.args);
-			}
+		const auto& batch = next->batches.At(0);
 
-			if (write && label.dst_gpu_addr64 != nullptr)
+		for (auto* label: batch.labels)
+		{
+			if (label->status == LabelStatus::ActiveDeleted)
 			{
-				*label.dst_gpu_addr64 = label.value64;
+				auto index = m_labels.Find(label);
+				EXIT_NOT_IMPLEMENTED(!m_labels.IndexValid(index));
+				m_labels.RemoveAt(index);
 
-				printf(FG_BRIGHT_GREEN "EndOfPipe Signal!!! [0x%016" PRIx64 "] <- 0x%016" PRIx64 "\n" FG_DEFAULT,
-				       reinterpret_cast<uint64_t>(label.dst_gpu_addr64), label.value64);
+				deleted_labels->Add(label);
 			}
 
-			if (write && label.dst_gpu_addr32 != nullptr)
-			{
-				*label.dst_gpu_addr32 = label.value32;
+			label->status = LabelStatus::NotActive;
 
-				printf(FG_BRIGHT_GREEN "EndOfPipe Signal!!! [0x%016" PRIx64 "] <- 0x%08" PRIx32 "\n" FG_DEFAULT,
-				       reinterpret_cast<uint64_t>(label.dst_gpu_addr32), label.value32);
-			}
+			fired_labels->Add(label->callbacks);
+		}
 
-			if (label.callback_2 != nullptr)
-			{
-				label.callback_2(label.args);
-			}
+		[[maybe_unused]] uint64_t latency_us = (now - batch.submit_time) * 1000000 / frequency;
+		KYTY_PROFILER_VALUE("Label latency (us)", latency_us);
+
+		next->batches.RemoveAt(0);
+		m_batches_num--;
+	}
+}
+
+void LabelManager::Fire(const LabelCallbacks& label)
+{
+	bool write = true;
+
+	if (label.callback_1 != nullptr)
+	{
+		write = label.callback_1(label.args);
+	}
+
+	if (write && label.dst_gpu_addr64 != nullptr)
+	{
+		*label.dst_gpu_addr64 = label.value64;
+
+		printf(FG_BRIGHT_GREEN "EndOfPipe Signal!!! [0x%016" PRIx64 "] <- 0x%016" PRIx64 "\n" FG_DEFAULT,
+		       reinterpret_cast<uint64_t>(label.dst_gpu_addr64), label.value64);
+	}
+
+	if (write && label.dst_gpu_addr32 != nullptr)
+	{
+		*label.dst_gpu_addr32 = label.value32;
+
+		printf(FG_BRIGHT_GREEN "EndOfPipe Signal!!! [0x%016" PRIx64 "] <- 0x%08" PRIx32 "\n" FG_DEFAULT,
+		       reinterpret_cast<uint64_t>(label.dst_gpu_addr32), label.value32);
+	}
+
+	if (label.callback_2 != nullptr)
+	{
+		label.callback_2(label.args);
+	}
+}
+
+void LabelManager::ThreadRun(void* data)
+{
+	KYTY_PROFILER_THREAD("Thread_Label");
+
+	auto* manager = static_cast<LabelManager*>(data);
+
+	for (;;)
+	{
+		{
+			KYTY_PROFILER_BLOCK("LabelManager::Wait", profiler::colors::Grey);
+
+			manager->Wait();
 		}
 
-		Core::Thread::SleepMicro(100);
+		KYTY_PROFILER_BLOCK("LabelManager::Retire", profiler::colors::Green300);
+
+		Vector<Label*>         deleted_labels;
+		Vector<LabelCallbacks> fired_labels;
+
+		manager->Retire(&deleted_labels, &fired_labels);
+
+		for (auto* label: deleted_labels)
+		{
+			delete label;
+		}
+
+		for (const auto& label: fired_labels)
+		{
+			Fire(label);
+		}
 	}
 }
 
-Label* LabelManager::Create64(GraphicContext* ctx, uint64_t* dst_gpu_addr, uint64_t value, LabelGpuObject::callback_t callback_1,
-                              LabelGpuObject::callback_t callback_2, const uint64_t* args)
+Label* LabelManager::Create(GraphicContext* ctx, const LabelCallbacks& callbacks)
 {
 	EXIT_IF(ctx == nullptr);
-	EXIT_IF(args == nullptr);
 
 	Core::LockGuard lock(m_mutex);
 
-	auto* label = new Label;
-
-	label->status                   = LabelStatus::New;
-	label->callbacks.dst_gpu_addr64 = dst_gpu_addr;
-	label->callbacks.value64        = value;
-	label->callbacks.dst_gpu_addr32 = nullptr;
-	label->callbacks.value32        = 0;
-	label->event                    = nullptr;
-	label->device                   = ctx->device;
-	label->callbacks.callback_1     = callback_1;
-	label->callbacks.callback_2     = callback_2;
-	label->cp                       = nullptr;
-
-	for (int i = 0; i < LABEL_ARGS_MAX; i++)
+	if (m_device == nullptr)
 	{
-		label->callbacks.args[i] = args[i];
+		CreateSemaphores(ctx->device);
 	}
 
-	VkEventCreateInfo create_info {};
-	create_info.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
-	create_info.pNext = nullptr;
-	create_info.flags = 0;
+	EXIT_NOT_IMPLEMENTED(m_device != ctx->device);
 
-	vkCreateEvent(ctx->device, &create_info, nullptr, &label->event);
+	auto* label = new Label;
 
-	EXIT_NOT_IMPLEMENTED(label->event == nullptr);
+	label->status    = LabelStatus::New;
+	label->callbacks = callbacks;
 
 	m_labels.Add(label);
 
 	return label;
 }
 
-Label* LabelManager::Create32(GraphicContext* ctx, uint32_t* dst_gpu_addr, uint32_t value, LabelGpuObject::callback_t callback_1,
+Label* LabelManager::Create64(GraphicContext* ctx, uint64_t* dst_gpu_addr, uint64_t value, LabelGpuObject::callback_t callback_1,
                               LabelGpuObject::callback_t callback_2, const uint64_t* args)
 {
-	EXIT_IF(ctx == nullptr);
 	EXIT_IF(args == nullptr);
 
-	Core::LockGuard lock(m_mutex);
+	LabelCallbacks callbacks;
 
-	auto* label = new Label;
-
-	label->status                   = LabelStatus::New;
-	label->callbacks.dst_gpu_addr32 = dst_gpu_addr;
-	label->callbacks.value32        = value;
-	label->callbacks.dst_gpu_addr64 = nullptr;
-	label->callbacks.value64        = 0;
-	label->event                    = nullptr;
-	label->device                   = ctx->device;
-	label->callbacks.callback_1     = callback_1;
-	label->callbacks.callback_2     = callback_2;
-	label->cp                       = nullptr;
+	callbacks.dst_gpu_addr64 = dst_gpu_addr;
+	callbacks.value64        = value;
+	callbacks.callback_1     = callback_1;
+	callbacks.callback_2     = callback_2;
 
 	for (int i = 0; i < LABEL_ARGS_MAX; i++)
 	{
-		label->callbacks.args[i] = args[i];
+		callbacks.args[i] = args[i];
 	}
 
-	VkEventCreateInfo create_info {};
-	create_info.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
-	create_info.pNext = nullptr;
-	create_info.flags = 0;
+	return Create(ctx, callbacks);
+}
 
-	vkCreateEvent(ctx->device, &create_info, nullptr, &label->event);
+Label* LabelManager::Create32(GraphicContext* ctx, uint32_t* dst_gpu_addr, uint32_t value, LabelGpuObject::callback_t callback_1,
+                              LabelGpuObject::callback_t callback_2, const uint64_t* args)
+{
+	EXIT_IF(args == nullptr);
 
-	EXIT_NOT_IMPLEMENTED(label->event == nullptr);
+	LabelCallbacks callbacks;
 
-	m_labels.Add(label);
+	callbacks.dst_gpu_addr32 = dst_gpu_addr;
+	callbacks.value32        = value;
+	callbacks.callback_1     = callback_1;
+	callbacks.callback_2     = callback_2;
 
-	return label;
+	for (int i = 0; i < LABEL_ARGS_MAX; i++)
+	{
+		callbacks.args[i] = args[i];
+	}
+
+	return Create(ctx, callbacks);
 }
 
-bool LabelManager::Remove(Label* label)
+void LabelManager::Delete(Label* label)
 {
 	EXIT_IF(label == nullptr);
-	EXIT_IF(label->event == nullptr);
-	EXIT_IF(label->device == nullptr);
 
 	Core::LockGuard lock(m_mutex);
 
@@ -253,73 +375,105 @@ bool LabelManager::Remove(Label* label)
 
 	EXIT_NOT_IMPLEMENTED(!m_labels.IndexValid(index));
 
-	EXIT_NOT_IMPLEMENTED(label->status != LabelStatus::NotActive && label->status != LabelStatus::Active);
+	EXIT_NOT_IMPLEMENTED(label->status != LabelStatus::New && label->status != LabelStatus::NotActive &&
+	                     label->status != LabelStatus::Active);
 
 	if (label->status == LabelStatus::Active)
 	{
+		// Deleted by the thread when the label is retired
 		label->status = LabelStatus::ActiveDeleted;
 
-		return false;
+		return;
 	}
 
 	m_labels.RemoveAt(index);
 
-	return true;
+	delete label;
 }
 
-void LabelManager::Destroy(Label* label)
+void LabelManager::Set(CommandBuffer* buffer, Label* label)
 {
 	EXIT_IF(label == nullptr);
-	EXIT_IF(label->event == nullptr);
-	EXIT_IF(label->device == nullptr);
-	EXIT_IF(label->cp == nullptr);
+	EXIT_IF(buffer == nullptr);
+	EXIT_IF(buffer->IsInvalid());
 
-	// All submitted commands that refer to event must have completed execution
-	GraphicsRunCommandProcessorWait(label->cp);
+	Core::LockGuard lock(m_mutex);
 
-	vkDestroyEvent(label->device, label->event, nullptr);
+	EXIT_NOT_IMPLEMENTED(!m_labels.Contains(label));
 
-	delete label;
-}
+	EXIT_NOT_IMPLEMENTED(label->status != LabelStatus::New && label->status != LabelStatus::NotActive);
 
-void LabelManager::Delete(Label* label)
-{
-	if (Remove(label))
+	label->status = LabelStatus::Active;
+
+	for (auto& p: m_pending)
 	{
-		Destroy(label);
+		if (p.buffer == buffer)
+		{
+			p.labels.Add(label);
+			return;
+		}
 	}
+
+	LabelPending p;
+	p.buffer = buffer;
+	p.labels.Add(label);
+
+	m_pending.Add(p);
 }
 
-void LabelManager::Set(CommandBuffer* buffer, Label* label)
+bool LabelManager::Submit(CommandBuffer* buffer, int queue, VkSemaphore* semaphore, uint64_t* value)
 {
-	EXIT_IF(label == nullptr);
 	EXIT_IF(buffer == nullptr);
-	EXIT_IF(buffer->IsInvalid());
-	EXIT_IF(label->event == nullptr);
-	EXIT_IF(label->device == nullptr);
+	EXIT_IF(semaphore == nullptr);
+	EXIT_IF(value == nullptr);
+	EXIT_IF(queue < 0 || queue >= GraphicContext::QUEUES_NUM);
 
 	Core::LockGuard lock(m_mutex);
 
-	auto index = m_labels.Find(label);
+	uint32_t index = 0;
+	for (; index < m_pending.Size() && m_pending.At(index).buffer != buffer; index++)
+	{
+	}
 
-	EXIT_NOT_IMPLEMENTED(!m_labels.IndexValid(index));
+	if (index == m_pending.Size())
+	{
+		return false;
+	}
 
-	EXIT_NOT_IMPLEMENTED(label->status != LabelStatus::New && label->status != LabelStatus::NotActive);
+	EXIT_IF(m_device == nullptr);
 
-	label->status = LabelStatus::Active;
+	auto& q = m_queues[queue];
 
-	EXIT_IF(label->event == nullptr);
+	LabelBatch batch;
+	batch.value       = ++q.value;
+	batch.seq         = ++m_seq;
+	batch.submit_time = Core::Timer::QueryPerformanceCounter();
+	batch.labels      = m_pending.At(index).labels;
 
-	label->cp = buffer->GetParent();
+	m_pending.RemoveAt(index);
 
-	auto* vk_buffer = buffer->GetPool()->buffers[buffer->GetIndex()];
+	if (m_batches_num == 0)
+	{
+		m_cond_var.Signal();
+	} else if (q.batches.IsEmpty())
+	{
+		// The thread doesn't wait for this queue yet
+		VkSemaphoreSignalInfo signal_info {};
+		signal_info.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+		signal_info.pNext     = nullptr;
+		signal_info.semaphore = m_wake;
+		signal_info.value     = ++m_wake_value;
+
+		vkSignalSemaphore(m_device, &signal_info);
+	}
 
-	EXIT_NOT_IMPLEMENTED(vk_buffer == nullptr);
+	q.batches.Add(batch);
+	m_batches_num++;
 
-	vkResetEvent(label->device, label->event);
-	vkCmdSetEvent(vk_buffer, label->event, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	*semaphore = q.semaphore;
+	*value     = batch.value;
 
-	m_cond_var.Signal();
+	return true;
 }
 
 void LabelInit()
@@ -359,6 +513,13 @@ void LabelSet(CommandBuffer* buffer, Label* label)
 	g_label_manager->Set(buffer, label);
 }
 
+bool LabelSubmit(CommandBuffer* buffer, int queue, VkSemaphore* semaphore, uint64_t* value)
+{
+	EXIT_IF(g_label_manager == nullptr);
+
+	return g_label_manager->Submit(buffer, queue, semaphore, value);
+}
+
 static void* create_func(GraphicContext* ctx, const uint64_t* params, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
                          VulkanMemory* /*mem*/)
 {
@@ -5,6 +5,7 @@
 
 #include "Emulator/Graphics/GraphicContext.h"
 #include "Emulator/Graphics/GraphicsRender.h"
+#include "Emulator/Graphics/Tile.h"
 #include "Emulator/Graphics/Utils.h"
 #include "Emulator/Profiler.h"
 
@@ -43,22 +44,23 @@ static void update_func(GraphicContext* ctx, const uint64_t* params, void* obj,
 
 	auto* vk_obj = static_cast<RenderTextureVulkanImage*>(obj);
 
-	bool tiled = (params[RenderTextureObject::PARAM_TILED] != 0);
-	// bool neo    = (params[RenderTextureObject::PARAM_NEO] != 0);
-	auto pitch = params[RenderTextureObject::PARAM_PITCH];
-	auto width = params[RenderTextureObject::PARAM_WIDTH];
-	// auto height = params[RenderTextureObject::PARAM_HEIGHT];
+	bool tiled  = (params[RenderTextureObject::PARAM_TILED] != 0);
+	bool neo    = (params[RenderTextureObject::PARAM_NEO] != 0);
+	auto pitch  = params[RenderTextureObject::PARAM_PITCH];
+	auto width  = params[RenderTextureObject::PARAM_WIDTH];
+	auto height = params[RenderTextureObject::PARAM_HEIGHT];
+	auto format = static_cast<RenderTextureFormat>(params[RenderTextureObject::PARAM_FORMAT]);
 
 	vk_obj->layout = VK_IMAGE_LAYOUT_UNDEFINED;
 
 	if (tiled && buffer_is_tiled(*vaddr, *size))
 	{
 		EXIT_NOT_IMPLEMENTED(width != pitch);
-		auto* temp_buf = new uint8_t[*size];
-		KYTY_NOT_IMPLEMENTED;
-		// TODO()
-		// TileConvertTiledToLinear(temp_buf, reinterpret_cast<void*>(*vaddr), TileMode::VideoOutTiled, width, height, neo);
-		// UtilFillImage(ctx, vk_obj, temp_buf, *size, pitch);
+		EXIT_NOT_IMPLEMENTED(format == RenderTextureFormat::R8Unorm);
+		uint64_t linear_size = width * height * 4;
+		auto*    temp_buf    = new uint8_t[linear_size];
+		TileConvertTiledToLinear(temp_buf, reinterpret_cast<void*>(*vaddr), TileMode::VideoOutTiled, width, height, neo);
+		UtilFillImage(ctx, vk_obj, temp_buf, linear_size, pitch, static_cast<uint64_t>(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
 		delete[] temp_buf;
 	} else
 	{
@@ -438,19 +440,33 @@ static void write_back(GraphicContext* ctx, const uint64_t* params, void* obj, c
 	EXIT_IF(obj == nullptr);
 	EXIT_IF(vaddr == nullptr || size == nullptr || vaddr_num != 1);
 
-	bool tiled = (params[RenderTextureObject::PARAM_TILED] != 0);
-	auto pitch = params[RenderTextureObject::PARAM_PITCH];
-	auto width = params[RenderTextureObject::PARAM_WIDTH];
+	bool tiled  = (params[RenderTextureObject::PARAM_TILED] != 0);
+	bool neo    = (params[RenderTextureObject::PARAM_NEO] != 0);
+	auto pitch  = params[RenderTextureObject::PARAM_PITCH];
+	auto width  = params[RenderTextureObject::PARAM_WIDTH];
+	auto height = params[RenderTextureObject::PARAM_HEIGHT];
+	auto format = static_cast<RenderTextureFormat>(params[RenderTextureObject::PARAM_FORMAT]);
 
 	EXIT_IF(!(params[RenderTextureObject::PARAM_WRITE_BACK] != 0));
 
-	EXIT_NOT_IMPLEMENTED(tiled);
 	EXIT_NOT_IMPLEMENTED(width != pitch);
 
 	auto* vk_obj = reinterpret_cast<RenderTextureVulkanImage*>(obj);
 
-	UtilFillBuffer(ctx, reinterpret_cast<void*>(*vaddr), *size, pitch, vk_obj,
-	               static_cast<uint64_t>(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+	if (tiled)
+	{
+		// Read back linear, then swizzle into the guest layout
+		EXIT_NOT_IMPLEMENTED(format == RenderTextureFormat::R8Unorm);
+		uint64_t linear_size = width * height * 4;
+		auto*    temp_buf    = new uint8_t[linear_size];
+		UtilFillBuffer(ctx, temp_buf, linear_size, pitch, vk_obj, static_cast<uint64_t>(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+		TileConvertLinearToTiled(reinterpret_cast<void*>(*vaddr), temp_buf, TileMode::VideoOutTiled, width, height, neo);
+		delete[] temp_buf;
+	} else
+	{
+		UtilFillBuffer(ctx, reinterpret_cast<void*>(*vaddr), *size, pitch, vk_obj,
+		               static_cast<uint64_t>(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+	}
 }
 
 bool RenderTextureObject::Equal(const uint64_t* other) const
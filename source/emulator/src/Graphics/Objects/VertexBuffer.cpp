@@ -18,23 +18,15 @@ static void update_func(GraphicContext* ctx, const uint64_t* /*params*/, void* o
 	EXIT_IF(vaddr_num != 1 || size == nullptr || vaddr == nullptr || *vaddr == 0);
 	EXIT_IF(obj == nullptr);
 
-	auto* vk_obj = static_cast<VulkanBuffer*>(obj);
+	auto* vk_obj = static_cast<GuestVulkanBuffer*>(obj);
 
-	VulkanBuffer staging_buffer {};
-	staging_buffer.usage           = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	staging_buffer.memory.property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (vk_obj->imported)
+	{
+		// GPU reads the guest memory directly
+		return;
+	}
 
-	VulkanCreateBuffer(ctx, *size, &staging_buffer);
-	EXIT_NOT_IMPLEMENTED(staging_buffer.buffer == nullptr);
-
-	void* data = nullptr;
-	VulkanMapMemory(ctx, &staging_buffer.memory, &data);
-	memcpy(data, reinterpret_cast<void*>(*vaddr), *size);
-	VulkanUnmapMemory(ctx, &staging_buffer.memory);
-
-	UtilCopyBuffer(&staging_buffer, vk_obj, *size);
-
-	VulkanDeleteBuffer(ctx, &staging_buffer);
+	UtilFillBuffer(ctx, vk_obj, reinterpret_cast<void*>(*vaddr), *size);
 }
 
 static void* create_func(GraphicContext* ctx, const uint64_t* params, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
@@ -46,11 +38,18 @@ static void* create_func(GraphicContext* ctx, const uint64_t* params, const uint
 	EXIT_IF(mem == nullptr);
 	EXIT_IF(ctx == nullptr);
 
-	auto* vk_obj = new VulkanBuffer;
+	auto* vk_obj = new GuestVulkanBuffer;
 
-	vk_obj->usage           = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	vk_obj->usage  = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	vk_obj->buffer = nullptr;
+
+	if (VulkanImportBuffer(ctx, *vaddr, *size, vk_obj))
+	{
+		return vk_obj;
+	}
+
+	vk_obj->usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	vk_obj->memory.property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	vk_obj->buffer          = nullptr;
 
 	VulkanCreateBuffer(ctx, *size, vk_obj);
 	EXIT_NOT_IMPLEMENTED(vk_obj->buffer == nullptr);
@@ -64,12 +63,19 @@ static void delete_func(GraphicContext* ctx, void* obj, VulkanMemory* /*mem*/)
 {
 	KYTY_PROFILER_BLOCK("VertexBufferGpuObject::delete_func");
 
-	auto* vk_obj = reinterpret_cast<VulkanBuffer*>(obj);
+	auto* vk_obj = reinterpret_cast<GuestVulkanBuffer*>(obj);
 
 	EXIT_IF(vk_obj == nullptr);
 	EXIT_IF(vk_obj->buffer == nullptr);
 	EXIT_IF(ctx == nullptr);
 
+	if (vk_obj->imported)
+	{
+		// Deleted after the submits, or before the guest memory is unmapped
+		VulkanDeleteImportedBuffer(ctx, vk_obj);
+		return;
+	}
+
 	VulkanDeleteBuffer(ctx, vk_obj);
 
 	delete vk_obj;
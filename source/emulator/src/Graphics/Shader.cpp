@@ -3026,6 +3026,18 @@ void ShaderInjectDebugPrintf(uint64_t id, const ShaderDebugPrintf& cmd)
 	g_debug_printfs->Add(c);
 }
 
+bool ShaderIsDebugPrintfInjected(const ShaderId& id)
+{
+	if (g_debug_printfs == nullptr)
+	{
+		return false;
+	}
+
+	auto printf_id = (static_cast<uint64_t>(id.hash0) << 32u) | id.crc32;
+
+	return g_debug_printfs->Contains(printf_id, [](auto cmd, auto id) { return cmd.id == id; });
+}
+
 } // namespace Kyty::Libs::Graphics
 
 #endif // KYTY_EMU_ENABLED
@@ -0,0 +1,394 @@
+#include "Emulator/Graphics/ShaderCache.h"
+
+#include "Kyty/Core/ByteBuffer.h"
+#include "Kyty/Core/DbgAssert.h"
+#include "Kyty/Core/File.h"
+#include "Kyty/Core/Hashmap.h"
+#include "Kyty/Core/String.h"
+#include "Kyty/Core/Threads.h"
+
+#include "Emulator/Config.h"
+#include "Emulator/Profiler.h"
+
+#include <cstring>
+#include <xxhash/xxhash.h>
+
+#ifdef KYTY_EMU_ENABLED
+
+namespace Kyty::Libs::Graphics {
+
+// Bump when the recompiler output changes, old cache files are ignored then
+constexpr uint32_t SHADER_CACHE_VERSION = 1;
+constexpr uint32_t SHADER_CACHE_MAGIC   = 0x4348534bu; // KSHC
+constexpr uint32_t SPIRV_MAGIC          = 0x07230203u;
+
+// On-disk layout:
+//     FileHeader
+//     { RecordHeader, uint32_t words[words_num] } * N
+// words = { type, hash0, crc32, ids_num, spirv_num, ids[ids_num], spirv[spirv_num] }
+struct ShaderCacheFileHeader
+{
+	uint32_t magic   = 0;
+	uint32_t version = 0;
+	uint64_t config  = 0;
+};
+
+struct ShaderCacheRecordHeader
+{
+	uint32_t words_num = 0;
+	uint32_t reserved  = 0;
+	uint64_t checksum  = 0;
+};
+
+struct ShaderCacheEntry
+{
+	ShaderType       type = ShaderType::Unknown;
+	ShaderId         id;
+	Vector<uint32_t> spirv;
+};
+
+constexpr uint32_t SHADER_CACHE_RECORD_WORDS = 5;
+
+class ShaderCache
+{
+public:
+	ShaderCache() = default;
+	virtual ~ShaderCache() { KYTY_NOT_IMPLEMENTED; }
+	KYTY_CLASS_NO_COPY(ShaderCache);
+
+	bool Find(ShaderType type, const ShaderId& id, Vector<uint32_t>* spirv);
+	void Add(ShaderType type, const ShaderId& id, const Vector<uint32_t>& spirv);
+
+private:
+	static void ThreadRun(void* data);
+
+	void Open();
+
+	static uint64_t CalcKey(ShaderType type, const ShaderId& id);
+	static bool     Parse(const uint32_t* words, uint32_t words_num, ShaderCacheEntry* entry);
+
+	Core::Mutex                                m_mutex;
+	Core::CondVar                              m_cond_var;
+	Core::File                                 m_file;
+	bool                                       m_opened = false;
+	Core::Hashmap<uint64_t, ShaderCacheEntry*> m_entries;
+	Vector<Vector<uint32_t>>                   m_queue;
+};
+
+static ShaderCache* g_shader_cache = nullptr;
+
+uint64_t ShaderCache::CalcKey(ShaderType type, const ShaderId& id)
+{
+	uint32_t head[3] = {static_cast<uint32_t>(type), id.hash0, id.crc32};
+
+	uint64_t seed = XXH64(head, sizeof(head), 0);
+
+	return (id.ids.IsEmpty() ? seed : XXH64(id.ids.GetDataConst(), id.ids.Size() * sizeof(uint32_t), seed));
+}
+
+bool ShaderCache::Parse(const uint32_t* words, uint32_t words_num, ShaderCacheEntry* entry)
+{
+	if (words_num < SHADER_CACHE_RECORD_WORDS)
+	{
+		return false;
+	}
+
+	uint32_t type      = words[0];
+	uint32_t ids_num   = words[3];
+	uint32_t spirv_num = words[4];
+
+	if (type > static_cast<uint32_t>(ShaderType::Compute) || spirv_num == 0 ||
+	    static_cast<uint64_t>(ids_num) + spirv_num + SHADER_CACHE_RECORD_WORDS != words_num)
+	{
+		return false;
+	}
+
+	const uint32_t* ids   = words + SHADER_CACHE_RECORD_WORDS;
+	const uint32_t* spirv = ids + ids_num;
+
+	if (spirv[0] != SPIRV_MAGIC)
+	{
+		return false;
+	}
+
+	entry->type     = static_cast<ShaderType>(type);
+	entry->id.hash0 = words[1];
+	entry->id.crc32 = words[2];
+	entry->id.ids.Clear();
+	entry->id.ids.Expand(ids_num);
+	for (uint32_t i = 0; i < ids_num; i++)
+	{
+		entry->id.ids.Add(ids[i]);
+	}
+	entry->spirv.Clear();
+	entry->spirv.Expand(spirv_num);
+	for (uint32_t i = 0; i < spirv_num; i++)
+	{
+		entry->spirv.Add(spirv[i]);
+	}
+
+	return true;
+}
+
+void ShaderCache::Open()
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_IF(m_opened);
+
+	m_opened = true;
+
+	// Every option that changes the recompiler output selects its own cache file
+	uint32_t config_values[] = {SHADER_CACHE_VERSION, static_cast<uint32_t>(Config::GetShaderOptimizationType()),
+	                            static_cast<uint32_t>(Config::ShaderValidationEnabled()),
+	                            static_cast<uint32_t>(Config::SpirvDebugPrintfEnabled()), static_cast<uint32_t>(Config::IsNextGen())};
+
+	auto config = XXH64(config_values, sizeof(config_values), 0);
+	auto folder = Config::GetShaderCacheFolder().FixDirectorySlash();
+
+	Core::File::CreateDirectories(folder);
+
+	auto file_name = folder + String::FromPrintf("shaders_%016" PRIx64 ".bin", config);
+
+	ShaderCacheFileHeader header;
+
+	uint64_t good_size = 0;
+
+	if (Core::File::IsFileExisting(file_name) && m_file.Open(file_name, Core::File::Mode::ReadWrite))
+	{
+		auto buf  = m_file.ReadWholeBuffer();
+		auto size = buf.Size();
+
+		if (size >= sizeof(header))
+		{
+			memcpy(&header, buf.GetDataConst(), sizeof(header));
+		}
+
+		if (size >= sizeof(header) && header.magic == SHADER_CACHE_MAGIC && header.version == SHADER_CACHE_VERSION &&
+		    header.config == config)
+		{
+			uint64_t offset = sizeof(header);
+			good_size       = offset;
+
+			Vector<uint32_t> words;
+
+			while (offset + sizeof(ShaderCacheRecordHeader) <= size)
+			{
+				ShaderCacheRecordHeader r;
+				memcpy(&r, buf.GetDataConst() + offset, sizeof(r));
+				offset += sizeof(r);
+
+				uint64_t bytes = static_cast<uint64_t>(r.words_num) * sizeof(uint32_t);
+
+				if (offset + bytes > size)
+				{
+					break;
+				}
+
+				words.Clear();
+				words.Expand(r.words_num);
+				for (uint32_t i = 0; i < r.words_num; i++)
+				{
+					uint32_t w = 0;
+					memcpy(&w, buf.GetDataConst() + offset + i * sizeof(uint32_t), sizeof(w));
+					words.Add(w);
+				}
+				offset += bytes;
+
+				auto* entry = new ShaderCacheEntry;
+
+				if (r.checksum != XXH64(words.GetDataConst(), bytes, 0) || !Parse(words.GetDataConst(), r.words_num, entry))
+				{
+					delete entry;
+					break;
+				}
+
+				auto key = CalcKey(entry->type, entry->id);
+
+				if (auto* const* old = m_entries.Find(key); old != nullptr)
+				{
+					delete *old;
+				}
+
+				m_entries.Put(key, entry);
+
+				good_size = offset;
+			}
+
+			if (good_size != size)
+			{
+				printf("Shader cache: %s is damaged, dropped %" PRIu64 " bytes\n", file_name.C_Str(), size - good_size);
+				m_file.Truncate(good_size);
+			}
+		}
+
+		if (good_size == 0)
+		{
+			m_file.Close();
+		}
+	}
+
+	if (good_size == 0)
+	{
+		if (!m_file.Create(file_name))
+		{
+			printf("Shader cache: can't create %s\n", file_name.C_Str());
+			return;
+		}
+
+		header.magic   = SHADER_CACHE_MAGIC;
+		header.version = SHADER_CACHE_VERSION;
+		header.config  = config;
+
+		m_file.Write(&header, sizeof(header));
+		m_file.Flush();
+
+		good_size = sizeof(header);
+	}
+
+	m_file.Seek(good_size);
+
+	printf("Shader cache: %s, %u shaders\n", file_name.C_Str(), m_entries.Size());
+
+	Core::Thread t(ThreadRun, this);
+	t.Detach();
+}
+
+void ShaderCache::ThreadRun(void* data)
+{
+	auto* cache = static_cast<ShaderCache*>(data);
+
+	for (;;)
+	{
+		cache->m_mutex.Lock();
+
+		while (cache->m_queue.IsEmpty())
+		{
+			cache->m_cond_var.Wait(&cache->m_mutex);
+		}
+
+		auto queue = cache->m_queue;
+		cache->m_queue.Clear();
+
+		cache->m_mutex.Unlock();
+
+		for (const auto& words: queue)
+		{
+			ShaderCacheRecordHeader r;
+			r.words_num = words.Size();
+			r.checksum  = XXH64(words.GetDataConst(), words.Size() * sizeof(uint32_t), 0);
+
+			cache->m_file.Write(&r, sizeof(r));
+			cache->m_file.Write(words.GetDataConst(), words.Size() * sizeof(uint32_t));
+		}
+
+		cache->m_file.Flush();
+	}
+}
+
+bool ShaderCache::Find(ShaderType type, const ShaderId& id, Vector<uint32_t>* spirv)
+{
+	EXIT_IF(spirv == nullptr);
+
+	auto key = CalcKey(type, id);
+
+	Core::LockGuard lock(m_mutex);
+
+	if (!m_opened)
+	{
+		Open();
+	}
+
+	if (auto* const* entry = m_entries.Find(key); entry != nullptr && (*entry)->type == type && (*entry)->id == id)
+	{
+		*spirv = (*entry)->spirv;
+		return true;
+	}
+
+	return false;
+}
+
+void ShaderCache::Add(ShaderType type, const ShaderId& id, const Vector<uint32_t>& spirv)
+{
+	if (spirv.IsEmpty())
+	{
+		return;
+	}
+
+	auto key = CalcKey(type, id);
+
+	auto* entry  = new ShaderCacheEntry;
+	entry->type  = type;
+	entry->id    = id;
+	entry->spirv = spirv;
+
+	Vector<uint32_t> words;
+	words.Expand(SHADER_CACHE_RECORD_WORDS + id.ids.Size() + spirv.Size());
+	words.Add(static_cast<uint32_t>(type));
+	words.Add(id.hash0);
+	words.Add(id.crc32);
+	words.Add(id.ids.Size());
+	words.Add(spirv.Size());
+	words.Add(id.ids);
+	words.Add(spirv);
+
+	Core::LockGuard lock(m_mutex);
+
+	if (!m_opened)
+	{
+		Open();
+	}
+
+	if (auto* const* old = m_entries.Find(key); old != nullptr)
+	{
+		delete *old;
+	}
+
+	m_entries.Put(key, entry);
+
+	if (!m_file.IsInvalid())
+	{
+		m_queue.Add(words);
+		m_cond_var.Signal();
+	}
+}
+
+void ShaderCacheInit()
+{
+	EXIT_IF(g_shader_cache != nullptr);
+
+	// Shader dumps are produced by the recompiler, so don't hide them behind the cache
+	if (!Config::ShaderCacheEnabled() || Config::GetShaderLogDirection() != Config::ShaderLogDirection::Silent)
+	{
+		return;
+	}
+
+	// The cache file is opened on first use, the title type (gen4/gen5) is not known yet
+	g_shader_cache = new ShaderCache;
+}
+
+bool ShaderCacheFind(ShaderType type, const ShaderId& id, Vector<uint32_t>* spirv)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	if (g_shader_cache == nullptr || ShaderIsDebugPrintfInjected(id))
+	{
+		return false;
+	}
+
+	return g_shader_cache->Find(type, id, spirv);
+}
+
+void ShaderCacheAdd(ShaderType type, const ShaderId& id, const Vector<uint32_t>& spirv)
+{
+	if (g_shader_cache == nullptr || ShaderIsDebugPrintfInjected(id))
+	{
+		return;
+	}
+
+	g_shader_cache->Add(type, id, spirv);
+}
+
+} // namespace Kyty::Libs::Graphics
+
+#endif // KYTY_EMU_ENABLED
@@ -3,6 +3,7 @@
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/String.h"
 #include "Kyty/Core/Threads.h"
+#include "Kyty/Core/Vector.h"
 
 #include "Emulator/Graphics/AsyncJob.h"
 #include "Emulator/Profiler.h"
@@ -12,7 +13,10 @@
 #endif
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
 #include <iterator>
+#include <thread>
 
 #ifdef KYTY_EMU_ENABLED
 
@@ -34,33 +38,38 @@ static bool IsPowerOfTwo(uint32_t x)
 	return (x != 0) && ((x & (x - 1)) == 0);
 }
 
-struct Uint128
-{
-	uint64_t n[2];
-};
-
-struct Uint256
-{
-	Uint128 n[2];
-};
-
+// Shared worker pool, the calling thread takes one band too
 class Tiler
 {
 public:
-	Tiler(): m_job1(nullptr), m_job2(nullptr) /*, m_job3(nullptr), m_job4(nullptr)*/
+	static constexpr uint32_t JOBS_MAX = 7;
+
+	Tiler()
 	{
 		EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread());
+
+		m_jobs_num = std::clamp(std::thread::hardware_concurrency(), 2u, JOBS_MAX + 1) - 1;
+
+		for (uint32_t i = 0; i < m_jobs_num; i++)
+		{
+			m_jobs[i] = new AsyncJob("Tiler");
+		}
 	}
 	virtual ~Tiler() { KYTY_NOT_IMPLEMENTED; }
 
 	KYTY_CLASS_NO_COPY(Tiler);
 
+	using band_func_t = std::function<void(uint32_t start_y, uint32_t end_y)>;
+
+	void ParallelFor(uint32_t height, uint32_t rows_align, const band_func_t& func);
+
+private:
+	static constexpr uint32_t ROWS_MIN = 32;
+
 	Core::Mutex m_mutex;
 
-	AsyncJob m_job1;
-	AsyncJob m_job2;
-	// AsyncJob m_job3;
-	// AsyncJob m_job4;
+	uint32_t  m_jobs_num = 0;
+	AsyncJob* m_jobs[JOBS_MAX] {};
 };
 
 class Tiler32
@@ -200,6 +209,14 @@ public:
 
 		return ((byte_offset << 3u) | bit_offset) / 8;
 	}
+
+	// Element, pipe and bank bits are XOR of x and y bits, the bits above them are a sum of x and y terms.
+	// So GetTiledOffset(x, y) == Combine(GetTiledOffset(x, 0), GetTiledOffset(0, y)).
+	[[nodiscard]] uint64_t Combine(uint64_t x_offset, uint64_t y_offset) const
+	{
+		const uint64_t low_mask = (static_cast<uint64_t>(1) << (8u + m_pipe_bits + m_bank_bits)) - 1;
+		return ((x_offset ^ y_offset) & low_mask) + (x_offset & ~low_mask) + (y_offset & ~low_mask);
+	}
 };
 
 class Tiler1d
@@ -269,6 +286,9 @@ public:
 		uint64_t offset            = tile_offset * 8 + element_offset;
 		return offset / 8;
 	}
+
+	// x and y bits of the element index don't overlap, so GetTiledOffset(x, y) == GetTiledOffset(x, 0) + GetTiledOffset(0, y)
+	[[nodiscard]] static uint64_t Combine(uint64_t x_offset, uint64_t y_offset) { return x_offset + y_offset; }
 };
 
 static Tiler* g_tiler = nullptr;
@@ -284,188 +304,133 @@ void TileInit()
 	init_maps();
 }
 
-// NOLINTNEXTLINE(readability-non-const-parameter)
-static void Detile32(const Tiler32* t, uint32_t width, uint32_t height, uint32_t dst_pitch, uint8_t* dst, const uint8_t* src, bool neo)
+void Tiler::ParallelFor(uint32_t height, uint32_t rows_align, const band_func_t& func)
 {
-	EXIT_IF(g_tiler == nullptr);
+	uint32_t bands_num = std::min(m_jobs_num + 1, height / ROWS_MIN);
 
-	Core::LockGuard lock(g_tiler->m_mutex);
+	if (bands_num <= 1)
+	{
+		func(0, height);
+		return;
+	}
 
-	struct DetileParams
+	Core::LockGuard lock(m_mutex);
+
+	struct Band
 	{
-		const Tiler32* t;
-		uint32_t       start_y;
-		uint32_t       width;
-		uint32_t       height;
-		uint32_t       dst_pitch;
-		uint8_t*       dst;
-		const uint8_t* src;
-		bool           neo;
+		const band_func_t* func;
+		uint32_t           start_y;
+		uint32_t           end_y;
 	};
 
-	auto func = [](void* args)
-	{
-		auto* p = static_cast<DetileParams*>(args);
-
-		auto*          dst       = p->dst;
-		const auto*    src       = p->src;
-		const Tiler32* t         = p->t;
-		uint32_t       start_y   = p->start_y;
-		uint32_t       width     = p->width;
-		uint32_t       height    = p->height;
-		uint64_t       dst_pitch = p->dst_pitch;
-		bool           neo       = p->neo;
-
-		for (uint32_t y = start_y; y < height; y++)
-		{
-			uint32_t x             = 0;
-			uint64_t linear_offset = y * dst_pitch * 4;
+	Band bands[JOBS_MAX + 1];
 
-			for (; x + 1 < width; x += 2)
-			{
-				auto tiled_offset = t->GetTiledOffset(x, y, neo);
+	// Bands start at a tile row, so neighbouring threads don't share tiles
+	uint32_t band_height = (height + bands_num - 1) / bands_num;
+	band_height          = (band_height + rows_align - 1) / rows_align * rows_align;
 
-				*reinterpret_cast<uint64_t*>(dst + linear_offset) = *reinterpret_cast<const uint64_t*>(src + tiled_offset);
-				linear_offset += 8;
-			}
-			if (x < width)
-			{
-				auto tiled_offset = t->GetTiledOffset(x, y, neo);
+	uint32_t jobs_num = 0;
+	for (uint32_t start_y = 0; start_y < height; start_y += band_height)
+	{
+		bands[jobs_num++] = {&func, start_y, std::min(start_y + band_height, height)};
+	}
 
-				*reinterpret_cast<uint32_t*>(dst + linear_offset) = *reinterpret_cast<const uint32_t*>(src + tiled_offset);
-			}
-		}
+	auto job_func = [](void* arg)
+	{
+		const auto* band = static_cast<const Band*>(arg);
+		(*band->func)(band->start_y, band->end_y);
 	};
 
-	DetileParams p1 {t, 0, width, height / 4, dst_pitch, dst, src, neo};
-	DetileParams p2 {t, p1.height, width, /*(height * 2) / 4*/ height, dst_pitch, dst, src, neo};
-	// DetileParams p3 {t, p2.height, width, (height * 3) / 4, dst_pitch, dst, src, neo};
-	// DetileParams p4 {t, p3.height, width, height, dst_pitch, dst, src, neo};
-
-	g_tiler->m_job1.Execute(func, &p1);
-	g_tiler->m_job2.Execute(func, &p2);
-	// g_tiler->m_job3.Execute(func, &p3);
-	// g_tiler->m_job4.Execute(func, &p4);
-
-	g_tiler->m_job1.Wait();
-	g_tiler->m_job2.Wait();
-	// g_tiler->m_job3.Wait();
-	// g_tiler->m_job4.Wait();
-
-	//	Core::Thread t1(func, &p1);
-	//	Core::Thread t2(func, &p2);
-	//	Core::Thread t3(func, &p3);
-	//	Core::Thread t4(func, &p4);
-	//
-	//	t1.Join();
-	//	t2.Join();
-	//	t3.Join();
-	//	t4.Join();
-}
-
-static void Detile32(const Tiler1d* t, uint32_t width, uint32_t height, uint32_t dst_pitch, uint8_t* dst, const uint8_t* src, bool neo)
-{
-	for (uint32_t y = 0; y < height; y++)
+	for (uint32_t i = 1; i < jobs_num; i++)
 	{
-		uint32_t x             = 0;
-		uint64_t linear_offset = y * static_cast<uint64_t>(dst_pitch) * 4;
+		m_jobs[i - 1]->Execute(job_func, &bands[i]);
+	}
 
-		for (; x + 1 < width; x += 2)
-		{
-			auto tiled_offset = t->GetTiledOffset(x, y, neo);
+	job_func(&bands[0]);
 
-			*reinterpret_cast<uint64_t*>(dst + linear_offset) = *reinterpret_cast<const uint64_t*>(src + tiled_offset);
-			linear_offset += 8;
-		}
-		if (x < width)
-		{
-			auto tiled_offset = t->GetTiledOffset(x, y, neo);
+	for (uint32_t i = 1; i < jobs_num; i++)
+	{
+		m_jobs[i - 1]->Wait();
+	}
+}
 
-			*reinterpret_cast<uint32_t*>(dst + linear_offset) = *reinterpret_cast<const uint32_t*>(src + tiled_offset);
-		}
+template <bool TO_TILED>
+static void CopyElements(uint8_t* dst, const uint8_t* src, uint64_t linear_offset, uint64_t tiled_offset, uint32_t size)
+{
+	if constexpr (TO_TILED)
+	{
+		memcpy(dst + tiled_offset, src + linear_offset, size);
+	} else
+	{
+		memcpy(dst + linear_offset, src + tiled_offset, size);
 	}
 }
 
-static void Detile64(const Tiler1d* t, uint32_t width, uint32_t height, uint32_t dst_pitch, uint8_t* dst, const uint8_t* src, bool neo)
+// Copies rows [start_y, end_y) in either direction. Elements go in pairs: x and x + 1 are adjacent in both tile modes.
+template <uint32_t ELEMENT_SIZE, bool TO_TILED, class T>
+static void ConvertRows(const T* t, const uint64_t* x_offsets, uint32_t width, uint32_t start_y, uint32_t end_y, uint64_t linear_pitch,
+                        uint8_t* dst, const uint8_t* src, bool neo)
 {
-	for (uint32_t y = 0; y < height; y++)
+	for (uint32_t y = start_y; y < end_y; y++)
 	{
+		uint64_t y_offset      = t->GetTiledOffset(0, y, neo);
+		uint64_t linear_offset = y * linear_pitch * ELEMENT_SIZE;
 		uint32_t x             = 0;
-		uint64_t linear_offset = y * static_cast<uint64_t>(dst_pitch) * 8;
 
 		for (; x + 1 < width; x += 2)
 		{
-			auto tiled_offset = t->GetTiledOffset(x, y, neo);
-
-			*reinterpret_cast<Uint128*>(dst + linear_offset) = *reinterpret_cast<const Uint128*>(src + tiled_offset);
-			linear_offset += 16;
+			CopyElements<TO_TILED>(dst, src, linear_offset, t->Combine(x_offsets[x], y_offset), ELEMENT_SIZE * 2);
+			linear_offset += ELEMENT_SIZE * 2;
 		}
 		if (x < width)
 		{
-			auto tiled_offset = t->GetTiledOffset(x, y, neo);
-
-			*reinterpret_cast<uint64_t*>(dst + linear_offset) = *reinterpret_cast<const uint64_t*>(src + tiled_offset);
+			CopyElements<TO_TILED>(dst, src, linear_offset, t->Combine(x_offsets[x], y_offset), ELEMENT_SIZE);
 		}
 	}
 }
 
-static void Detile128(const Tiler1d* t, uint32_t width, uint32_t height, uint32_t dst_pitch, uint8_t* dst, const uint8_t* src, bool neo)
+template <uint32_t ELEMENT_SIZE, bool TO_TILED, class T>
+static void Convert(const T* t, uint32_t width, uint32_t height, uint32_t linear_pitch, uint32_t rows_align, uint8_t* dst,
+                    const uint8_t* src, bool neo)
 {
-	for (uint32_t y = 0; y < height; y++)
+	EXIT_IF(g_tiler == nullptr);
+
+	// Column part of the swizzle, the row part is computed once per row
+	Vector<uint64_t> x_offsets(width, false);
+	for (uint32_t x = 0; x < width; x++)
 	{
-		uint32_t x             = 0;
-		uint64_t linear_offset = y * static_cast<uint64_t>(dst_pitch) * 16;
+		x_offsets[x] = t->GetTiledOffset(x, 0, neo);
+	}
 
-		for (; x + 1 < width; x += 2)
-		{
-			auto tiled_offset = t->GetTiledOffset(x, y, neo);
+	const uint64_t* lut = x_offsets.GetDataConst();
 
-			*reinterpret_cast<Uint256*>(dst + linear_offset) = *reinterpret_cast<const Uint256*>(src + tiled_offset);
-			linear_offset += 32;
-		}
-		if (x < width)
-		{
-			auto tiled_offset = t->GetTiledOffset(x, y, neo);
-
-			*reinterpret_cast<Uint128*>(dst + linear_offset) = *reinterpret_cast<const Uint128*>(src + tiled_offset);
-		}
-	}
+	g_tiler->ParallelFor(height, rows_align,
+	                     [=](uint32_t start_y, uint32_t end_y)
+	                     { ConvertRows<ELEMENT_SIZE, TO_TILED>(t, lut, width, start_y, end_y, linear_pitch, dst, src, neo); });
 }
 
-static void Detile1d(const Tiler1d* t, uint8_t* dst, const uint8_t* src, bool neo)
+template <bool TO_TILED>
+static void Convert1d(const Tiler1d* t, uint8_t* dst, const uint8_t* src, bool neo)
 {
 	if (t->m_bits_per_element == 32)
 	{
-		Detile32(t, t->m_width, t->m_height, t->m_pitch, dst, src, neo);
+		Convert<4, TO_TILED>(t, t->m_width, t->m_height, t->m_pitch, 8, dst, src, neo);
 	} else if (t->m_bits_per_element == 64)
 	{
-		Detile64(t, t->m_width, t->m_height, t->m_pitch, dst, src, neo);
+		Convert<8, TO_TILED>(t, t->m_width, t->m_height, t->m_pitch, 8, dst, src, neo);
 	} else if (t->m_bits_per_element == 128)
 	{
-		Detile128(t, t->m_width, t->m_height, t->m_pitch, dst, src, neo);
+		Convert<16, TO_TILED>(t, t->m_width, t->m_height, t->m_pitch, 8, dst, src, neo);
 	} else
 	{
 		EXIT("Unknown size");
 	}
 }
 
-void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_t width, uint32_t height, bool neo)
-{
-	KYTY_PROFILER_FUNCTION();
-
-	EXIT_NOT_IMPLEMENTED(mode != TileMode::VideoOutTiled);
-
-	Tiler32 t;
-	t.Init(width, height, neo);
-
-	Detile32(&t, width, height, width, static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), neo);
-}
-
-void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height,
-                              uint32_t pitch, uint32_t levels, bool neo)
+template <bool TO_TILED>
+static void ConvertTexture(uint8_t* dst, const uint8_t* src, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height, uint32_t pitch,
+                           uint32_t levels, bool neo)
 {
-	EXIT_NOT_IMPLEMENTED(mode != TileMode::TextureTiled);
-
 	TilePaddedSize padded_sizes[16];
 	TileSizeOffset level_sizes[16];
 
@@ -475,15 +440,12 @@ void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_
 	uint32_t mip_height = height;
 	uint32_t mip_pitch  = pitch;
 
-	auto*       dstptr = static_cast<uint8_t*>(dst);
-	const auto* srcptr = static_cast<const uint8_t*>(src);
-
 	for (uint32_t l = 0; l < levels; l++)
 	{
 		Tiler1d t;
 		t.Init(dfmt, nfmt, mip_width, mip_height, mip_pitch, padded_sizes[l].width, padded_sizes[l].height, neo);
 
-		Detile1d(&t, dstptr + level_sizes[l].offset, srcptr + level_sizes[l].offset, neo);
+		Convert1d<TO_TILED>(&t, dst + level_sizes[l].offset, src + level_sizes[l].offset, neo);
 
 		if (mip_width > 1)
 		{
@@ -500,6 +462,50 @@ void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_
 	}
 }
 
+void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_t width, uint32_t height, bool neo)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_NOT_IMPLEMENTED(mode != TileMode::VideoOutTiled);
+
+	Tiler32 t;
+	t.Init(width, height, neo);
+
+	Convert<4, false>(&t, width, height, width, t.m_macro_tile_height, static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), neo);
+}
+
+void TileConvertTiledToLinear(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height,
+                              uint32_t pitch, uint32_t levels, bool neo)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_NOT_IMPLEMENTED(mode != TileMode::TextureTiled);
+
+	ConvertTexture<false>(static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), dfmt, nfmt, width, height, pitch, levels, neo);
+}
+
+void TileConvertLinearToTiled(void* dst, const void* src, TileMode mode, uint32_t width, uint32_t height, bool neo)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_NOT_IMPLEMENTED(mode != TileMode::VideoOutTiled);
+
+	Tiler32 t;
+	t.Init(width, height, neo);
+
+	Convert<4, true>(&t, width, height, width, t.m_macro_tile_height, static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), neo);
+}
+
+void TileConvertLinearToTiled(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height,
+                              uint32_t pitch, uint32_t levels, bool neo)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_NOT_IMPLEMENTED(mode != TileMode::TextureTiled);
+
+	ConvertTexture<true>(static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), dfmt, nfmt, width, height, pitch, levels, neo);
+}
+
 bool TileGetDepthSize(uint32_t width, uint32_t height, uint32_t pitch, uint32_t z_format, uint32_t stencil_format, bool htile, bool neo,
                       bool next_gen, TileSizeAlign* stencil_size, TileSizeAlign* htile_size, TileSizeAlign* depth_size)
 {
@@ -1211,6 +1217,102 @@ void TileGetTextureSize2(uint32_t format, uint32_t width, uint32_t height, uint3
 	}
 }
 
+#ifdef KYTY_EMU_TESTS
+
+// Reference implementation, one GetTiledOffset() per element
+template <uint32_t ELEMENT_SIZE, bool TO_TILED, class T>
+static void ConvertReference(const T* t, uint32_t width, uint32_t height, uint8_t* dst, const uint8_t* src, bool neo)
+{
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			CopyElements<TO_TILED>(dst, src, (static_cast<uint64_t>(y) * width + x) * ELEMENT_SIZE, t->GetTiledOffset(x, y, neo),
+			                       ELEMENT_SIZE);
+		}
+	}
+}
+
+template <uint32_t ELEMENT_SIZE, class T>
+static void ConvertSurface(const T* t, uint32_t width, uint32_t height, uint32_t rows_align, uint8_t* dst, const uint8_t* src, bool neo,
+                           bool to_tiled, bool reference)
+{
+	if (reference)
+	{
+		to_tiled ? ConvertReference<ELEMENT_SIZE, true>(t, width, height, dst, src, neo)
+		         : ConvertReference<ELEMENT_SIZE, false>(t, width, height, dst, src, neo);
+	} else
+	{
+		to_tiled ? Convert<ELEMENT_SIZE, true>(t, width, height, width, rows_align, dst, src, neo)
+		         : Convert<ELEMENT_SIZE, false>(t, width, height, width, rows_align, dst, src, neo);
+	}
+}
+
+// Tiles are 8x8 elements, the size doesn't come from the texture tables
+static void InitSurface1d(Tiler1d* t, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height)
+{
+	t->Init(dfmt, nfmt, width, height, width, 0, 0, false);
+	t->m_tiles_per_row = ((t->m_width + 7) & ~7u) / 8;
+}
+
+void TileGetSurfaceSize(TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height, bool neo, uint64_t* linear_size,
+                        uint64_t* tiled_size)
+{
+	EXIT_IF(linear_size == nullptr || tiled_size == nullptr);
+
+	if (mode == TileMode::VideoOutTiled)
+	{
+		Tiler32 t;
+		t.Init(width, height, neo);
+		*linear_size = static_cast<uint64_t>(width) * height * 4;
+		*tiled_size  = static_cast<uint64_t>(t.m_padded_width) * t.m_padded_height * 4;
+		return;
+	}
+
+	EXIT_NOT_IMPLEMENTED(mode != TileMode::TextureTiled || neo);
+
+	Tiler1d t;
+	InitSurface1d(&t, dfmt, nfmt, width, height);
+	*linear_size = static_cast<uint64_t>(t.m_width) * t.m_height * t.m_bits_per_element / 8;
+	*tiled_size  = static_cast<uint64_t>((t.m_width + 7) & ~7u) * ((t.m_height + 7) & ~7u) * t.m_bits_per_element / 8;
+}
+
+void TileConvertSurface(void* dst, const void* src, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height, bool neo,
+                        bool to_tiled, bool reference)
+{
+	// The benchmark can run before TileInit()
+	if (g_tiler == nullptr)
+	{
+		g_tiler = new Tiler;
+	}
+
+	auto*       d = static_cast<uint8_t*>(dst);
+	const auto* s = static_cast<const uint8_t*>(src);
+
+	if (mode == TileMode::VideoOutTiled)
+	{
+		Tiler32 t;
+		t.Init(width, height, neo);
+		ConvertSurface<4>(&t, width, height, t.m_macro_tile_height, d, s, neo, to_tiled, reference);
+		return;
+	}
+
+	EXIT_NOT_IMPLEMENTED(mode != TileMode::TextureTiled || neo);
+
+	Tiler1d t;
+	InitSurface1d(&t, dfmt, nfmt, width, height);
+
+	switch (t.m_bits_per_element)
+	{
+		case 32: ConvertSurface<4>(&t, t.m_width, t.m_height, 8, d, s, false, to_tiled, reference); break;
+		case 64: ConvertSurface<8>(&t, t.m_width, t.m_height, 8, d, s, false, to_tiled, reference); break;
+		case 128: ConvertSurface<16>(&t, t.m_width, t.m_height, 8, d, s, false, to_tiled, reference); break;
+		default: EXIT("unknown size\n");
+	}
+}
+
+#endif // KYTY_EMU_TESTS
+
 } // namespace Kyty::Libs::Graphics
 
 #endif // KYTY_EMU_ENABLED
@@ -1,6 +1,7 @@
 #include "Emulator/Graphics/Utils.h"
 
 #include "Kyty/Core/DbgAssert.h"
+#include "Kyty/Core/Threads.h"
 #include "Kyty/Core/Vector.h"
 
 #include "Emulator/Graphics/GraphicContext.h"
@@ -12,6 +13,217 @@
 
 namespace Kyty::Libs::Graphics {
 
+// Host data is copied into a persistently mapped ring and the copies are recorded into one command buffer on
+// QUEUE_UTIL. The batch is submitted and waited for once, before any other command buffer is submitted, or when
+// the ring is full. Uploads larger than the ring get a temporary staging buffer which lives until the batch is done.
+class StagingRing
+{
+public:
+	static constexpr uint64_t RING_SIZE = static_cast<uint64_t>(64) * 1024 * 1024;
+	static constexpr uint64_t ALIGNMENT = 256;
+
+	StagingRing() { EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread()); }
+	virtual ~StagingRing() { KYTY_NOT_IMPLEMENTED; }
+	KYTY_CLASS_NO_COPY(StagingRing);
+
+	// Must be called with the mutex locked, the copy must be recorded into the returned buffer before unlocking
+	CommandBuffer* Upload(GraphicContext* ctx, const void* src_data, uint64_t size, VulkanBuffer** buffer, uint64_t* offset);
+	void           Flush(GraphicContext* ctx);
+
+	Core::Mutex& GetMutex() { return m_mutex; }
+
+private:
+	void Init(GraphicContext* ctx);
+	void Submit(GraphicContext* ctx);
+
+	Core::Mutex           m_mutex {Core::Mutex::Type::Recursive};
+	VulkanBuffer          m_ring;
+	uint8_t*              m_ring_data = nullptr;
+	uint64_t              m_offset    = 0;
+	CommandBuffer*        m_batch     = nullptr;
+	Vector<VulkanBuffer*> m_oversized;
+};
+
+static StagingRing* g_staging = nullptr;
+
+// Guest memory of a GPU heap (VK_EXT_external_memory_host). It's imported on first use as one VkDeviceMemory, the buffers are bound to
+// it by offset.
+struct VulkanImportedRange
+{
+	uint64_t                   vaddr       = 0;
+	uint64_t                   size        = 0;
+	VkDeviceMemory             memory      = nullptr;
+	uint32_t                   type        = 0;
+	bool                       failed      = false; // The device can't import the range, buffers are copied
+	int                        buffers_num = 0;     // Buffers bound to the memory
+	Vector<GuestVulkanBuffer*> retired;             // Deleted buffers, submitted commands can still use them
+};
+
+class ImportedMemory
+{
+public:
+	ImportedMemory() { EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread()); }
+	virtual ~ImportedMemory() { KYTY_NOT_IMPLEMENTED; }
+	KYTY_CLASS_NO_COPY(ImportedMemory);
+
+	void AddRange(uint64_t vaddr, uint64_t size);
+	void RemoveRange(GraphicContext* gctx, uint64_t vaddr, uint64_t size);
+	bool CreateBuffer(GraphicContext* gctx, uint64_t vaddr, uint64_t size, GuestVulkanBuffer* buffer);
+	void RetireBuffer(GuestVulkanBuffer* buffer);
+	void DeleteRetired(GraphicContext* gctx);
+
+private:
+	VulkanImportedRange* Find(uint64_t vaddr, uint64_t size);
+	static bool          Import(GraphicContext* gctx, VulkanImportedRange* range);
+	static void          DeleteRetired(GraphicContext* gctx, VulkanImportedRange* range);
+
+	Core::Mutex                  m_mutex;
+	Vector<VulkanImportedRange*> m_ranges;
+	uint32_t                     m_imported_num = 0;
+};
+
+static ImportedMemory* g_imported_memory = nullptr;
+
+void StagingRing::Init(GraphicContext* ctx)
+{
+	EXIT_IF(m_ring.buffer != nullptr);
+
+	m_ring.usage           = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	m_ring.memory.property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	VulkanCreateBuffer(ctx, RING_SIZE, &m_ring);
+	EXIT_NOT_IMPLEMENTED(m_ring.buffer == nullptr);
+
+	void* data = nullptr;
+	VulkanMapMemory(ctx, &m_ring.memory, &data);
+	EXIT_NOT_IMPLEMENTED(data == nullptr);
+
+	m_ring_data = static_cast<uint8_t*>(data);
+	m_offset    = 0;
+}
+
+void StagingRing::Submit(GraphicContext* ctx)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	if (m_batch == nullptr)
+	{
+		return;
+	}
+
+	// Execute() flushes the uploads too, so detach the batch first
+	auto* batch = m_batch;
+	m_batch     = nullptr;
+
+	batch->End();
+	batch->Execute();
+	batch->WaitForFence();
+	delete batch;
+
+	for (auto* b: m_oversized)
+	{
+		VulkanDeleteBuffer(ctx, b);
+		delete b;
+	}
+	m_oversized.Clear();
+
+	m_offset = 0;
+}
+
+CommandBuffer* StagingRing::Upload(GraphicContext* ctx, const void* src_data, uint64_t size, VulkanBuffer** buffer, uint64_t* offset)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_IF(ctx == nullptr);
+	EXIT_IF(src_data == nullptr);
+	EXIT_IF(buffer == nullptr);
+	EXIT_IF(offset == nullptr);
+
+	if (m_ring.buffer == nullptr)
+	{
+		Init(ctx);
+	}
+
+	uint64_t aligned_size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	if (aligned_size > RING_SIZE)
+	{
+		auto* staging_buffer            = new VulkanBuffer;
+		staging_buffer->usage           = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		staging_buffer->memory.property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VulkanCreateBuffer(ctx, size, staging_buffer);
+		EXIT_NOT_IMPLEMENTED(staging_buffer->buffer == nullptr);
+
+		void* data = nullptr;
+		VulkanMapMemory(ctx, &staging_buffer->memory, &data);
+		std::memcpy(data, src_data, size);
+		VulkanUnmapMemory(ctx, &staging_buffer->memory);
+
+		m_oversized.Add(staging_buffer);
+
+		*buffer = staging_buffer;
+		*offset = 0;
+	} else
+	{
+		if (m_offset + aligned_size > RING_SIZE)
+		{
+			Submit(ctx);
+		}
+
+		std::memcpy(m_ring_data + m_offset, src_data, size);
+
+		*buffer = &m_ring;
+		*offset = m_offset;
+
+		m_offset += aligned_size;
+	}
+
+	if (m_batch == nullptr)
+	{
+		m_batch = new CommandBuffer(GraphicContext::QUEUE_UTIL);
+		EXIT_NOT_IMPLEMENTED(m_batch->IsInvalid());
+		m_batch->Begin();
+	} else
+	{
+		// The same resource can be uploaded twice in one batch
+		VkMemoryBarrier barrier {};
+		barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.pNext         = nullptr;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(m_batch->GetPool()->buffers[m_batch->GetIndex()], VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	return m_batch;
+}
+
+void StagingRing::Flush(GraphicContext* ctx)
+{
+	Core::LockGuard lock(m_mutex);
+
+	Submit(ctx);
+}
+
+void UtilInit()
+{
+	EXIT_IF(g_staging != nullptr);
+
+	g_staging = new StagingRing;
+
+	EXIT_IF(g_imported_memory != nullptr);
+
+	g_imported_memory = new ImportedMemory;
+}
+
+void UtilFlushUploads(GraphicContext* ctx)
+{
+	if (g_staging != nullptr)
+	{
+		g_staging->Flush(ctx);
+	}
+}
+
 static void set_image_layout(VkCommandBuffer buffer, VulkanImage* dst_image, uint32_t base_level, uint32_t levels,
                              VkImageAspectFlags aspect_mask, VkImageLayout old_image_layout, VkImageLayout new_image_layout)
 {
@@ -84,7 +296,8 @@ static void set_image_layout(VkCommandBuffer buffer, VulkanImage* dst_image, uin
 	dst_image->layout = new_image_layout;
 }
 
-void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, uint32_t src_pitch, VulkanImage* dst_image, uint64_t dst_layout)
+void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, uint32_t src_pitch, VulkanImage* dst_image, uint64_t dst_layout,
+                       uint64_t src_offset)
 {
 	EXIT_IF(src_buffer == nullptr);
 	EXIT_IF(src_buffer->buffer == nullptr);
@@ -97,7 +310,7 @@ void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, uint32_t
 	                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
 	VkBufferImageCopy region {};
-	region.bufferOffset      = 0;
+	region.bufferOffset      = src_offset;
 	region.bufferRowLength   = (src_pitch != dst_image->extent.width ? src_pitch : 0);
 	region.bufferImageHeight = 0;
 
@@ -146,7 +359,7 @@ void UtilImageToBuffer(CommandBuffer* buffer, VulkanImage* src_image, VulkanBuff
 }
 
 void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, VulkanImage* dst_image, const Vector<BufferImageCopy>& regions,
-                       uint64_t dst_layout)
+                       uint64_t dst_layout, uint64_t src_offset)
 {
 	EXIT_IF(src_buffer == nullptr);
 	EXIT_IF(src_buffer->buffer == nullptr);
@@ -162,7 +375,7 @@ void UtilBufferToImage(CommandBuffer* buffer, VulkanBuffer* src_buffer, VulkanIm
 	uint32_t index = 0;
 	for (const auto& r: regions)
 	{
-		region[index].bufferOffset                    = r.offset;
+		region[index].bufferOffset                    = src_offset + r.offset;
 		region[index].bufferRowLength                 = (r.width != r.pitch ? r.pitch : 0);
 		region[index].bufferImageHeight               = 0;
 		region[index].imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -314,6 +527,283 @@ void VulkanDeleteBuffer(GraphicContext* gctx, VulkanBuffer* buffer)
 	buffer->buffer = nullptr;
 }
 
+VulkanImportedRange* ImportedMemory::Find(uint64_t vaddr, uint64_t size)
+{
+	for (auto* range: m_ranges)
+	{
+		if (vaddr >= range->vaddr && vaddr + size <= range->vaddr + range->size)
+		{
+			return range;
+		}
+	}
+	return nullptr;
+}
+
+void ImportedMemory::AddRange(uint64_t vaddr, uint64_t size)
+{
+	Core::LockGuard lock(m_mutex);
+
+	EXIT_NOT_IMPLEMENTED(Find(vaddr, size) != nullptr);
+
+	auto* range  = new VulkanImportedRange;
+	range->vaddr = vaddr;
+	range->size  = size;
+
+	m_ranges.Add(range);
+}
+
+void ImportedMemory::RemoveRange(GraphicContext* gctx, uint64_t vaddr, uint64_t size)
+{
+	Core::LockGuard lock(m_mutex);
+
+	auto* range = Find(vaddr, size);
+
+	EXIT_NOT_IMPLEMENTED(range == nullptr || range->vaddr != vaddr || range->size != size);
+
+	DeleteRetired(gctx, range);
+
+	EXIT_NOT_IMPLEMENTED(range->buffers_num != 0);
+
+	if (range->memory != nullptr)
+	{
+		vkFreeMemory(gctx->device, range->memory, nullptr);
+		m_imported_num--;
+	}
+
+	m_ranges.Remove(range);
+	delete range;
+}
+
+bool ImportedMemory::Import(GraphicContext* gctx, VulkanImportedRange* range)
+{
+	static auto get_host_pointer_properties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(
+	    vkGetDeviceProcAddr(gctx->device, "vkGetMemoryHostPointerPropertiesEXT"));
+
+	EXIT_NOT_IMPLEMENTED(get_host_pointer_properties == nullptr);
+
+	static auto memory_properties = [gctx]()
+	{
+		VkPhysicalDeviceMemoryProperties properties {};
+		vkGetPhysicalDeviceMemoryProperties(gctx->physical_device, &properties);
+		return properties;
+	}();
+
+	// Pages outside the heap can't be imported
+	uint64_t alignment = gctx->host_pointer_alignment;
+	if ((range->vaddr & (alignment - 1)) != 0 || (range->size & (alignment - 1)) != 0)
+	{
+		return false;
+	}
+
+	VkMemoryHostPointerPropertiesEXT host_properties {};
+	host_properties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+
+	if (get_host_pointer_properties(gctx->device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+	                                reinterpret_cast<void*>(range->vaddr), &host_properties) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	VkImportMemoryHostPointerInfoEXT import_info {};
+	import_info.sType        = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+	import_info.handleType   = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+	import_info.pHostPointer = reinterpret_cast<void*>(range->vaddr);
+
+	VkMemoryAllocateInfo alloc_info {};
+	alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.pNext           = &import_info;
+	alloc_info.allocationSize  = range->size;
+	alloc_info.memoryTypeIndex = 0;
+
+	// CPU writes to the guest memory must be visible to the GPU without flushes
+	while (alloc_info.memoryTypeIndex < memory_properties.memoryTypeCount &&
+	       ((host_properties.memoryTypeBits & (1u << alloc_info.memoryTypeIndex)) == 0 ||
+	        (memory_properties.memoryTypes[alloc_info.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0))
+	{
+		alloc_info.memoryTypeIndex++;
+	}
+
+	if (alloc_info.memoryTypeIndex >= memory_properties.memoryTypeCount ||
+	    vkAllocateMemory(gctx->device, &alloc_info, nullptr, &range->memory) != VK_SUCCESS)
+	{
+		range->memory = nullptr;
+		return false;
+	}
+
+	range->type = alloc_info.memoryTypeIndex;
+
+	return true;
+}
+
+bool ImportedMemory::CreateBuffer(GraphicContext* gctx, uint64_t vaddr, uint64_t size, GuestVulkanBuffer* buffer)
+{
+	Core::LockGuard lock(m_mutex);
+
+	auto* range = Find(vaddr, size);
+
+	if (range == nullptr || range->failed)
+	{
+		return false;
+	}
+
+	if (range->memory == nullptr)
+	{
+		if (m_imported_num >= gctx->imported_ranges_max)
+		{
+			return false;
+		}
+
+		if (!Import(gctx, range))
+		{
+			range->failed = true;
+			return false;
+		}
+
+		m_imported_num++;
+	}
+
+	// The buffer starts at an aligned offset of the range, the data at buffer->offset
+	uint64_t alignment   = gctx->host_pointer_alignment;
+	uint64_t bind_offset = (vaddr - range->vaddr) & ~(alignment - 1);
+
+	VkExternalMemoryBufferCreateInfo external_info {};
+	external_info.sType       = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+	external_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+	VkBufferCreateInfo buffer_info {};
+	buffer_info.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.pNext       = &external_info;
+	buffer_info.size        = vaddr + size - (range->vaddr + bind_offset);
+	buffer_info.usage       = buffer->usage;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(gctx->device, &buffer_info, nullptr, &buffer->buffer) != VK_SUCCESS)
+	{
+		buffer->buffer = nullptr;
+		return false;
+	}
+
+	vkGetBufferMemoryRequirements(gctx->device, buffer->buffer, &buffer->memory.requirements);
+
+	const auto& requirements = buffer->memory.requirements;
+
+	if ((requirements.memoryTypeBits & (1u << range->type)) == 0 || (bind_offset % requirements.alignment) != 0 ||
+	    bind_offset + requirements.size > range->size)
+	{
+		vkDestroyBuffer(gctx->device, buffer->buffer, nullptr);
+		buffer->buffer = nullptr;
+		return false;
+	}
+
+	vkBindBufferMemory(gctx->device, buffer->buffer, range->memory, bind_offset);
+
+	// The memory belongs to the range
+	buffer->memory.memory = nullptr;
+	buffer->memory.type   = range->type;
+	buffer->offset        = vaddr - (range->vaddr + bind_offset);
+	buffer->imported      = true;
+	buffer->range         = range;
+
+	range->buffers_num++;
+
+	return true;
+}
+
+void ImportedMemory::RetireBuffer(GuestVulkanBuffer* buffer)
+{
+	Core::LockGuard lock(m_mutex);
+
+	auto* range = buffer->range;
+
+	EXIT_IF(range == nullptr);
+	EXIT_IF(range->buffers_num <= 0);
+
+	range->buffers_num--;
+	range->retired.Add(buffer);
+}
+
+void ImportedMemory::DeleteRetired(GraphicContext* gctx, VulkanImportedRange* range)
+{
+	for (auto* buffer: range->retired)
+	{
+		vkDestroyBuffer(gctx->device, buffer->buffer, nullptr);
+		delete buffer;
+	}
+
+	range->retired.Clear();
+}
+
+void ImportedMemory::DeleteRetired(GraphicContext* gctx)
+{
+	Core::LockGuard lock(m_mutex);
+
+	for (auto* range: m_ranges)
+	{
+		DeleteRetired(gctx, range);
+	}
+}
+
+void VulkanAddImportRange(uint64_t vaddr, uint64_t size)
+{
+	EXIT_IF(g_imported_memory == nullptr);
+
+	g_imported_memory->AddRange(vaddr, size);
+}
+
+void VulkanRemoveImportRange(GraphicContext* gctx, uint64_t vaddr, uint64_t size)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_IF(gctx == nullptr);
+	EXIT_IF(g_imported_memory == nullptr);
+
+	g_imported_memory->RemoveRange(gctx, vaddr, size);
+}
+
+// Creates a buffer over the guest memory (VK_EXT_external_memory_host), GPU reads the data in place.
+// Returns false if the device can't import this memory or too many ranges are imported already.
+bool VulkanImportBuffer(GraphicContext* gctx, uint64_t vaddr, uint64_t size, GuestVulkanBuffer* buffer)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_IF(gctx == nullptr);
+	EXIT_IF(buffer == nullptr);
+	EXIT_IF(buffer->buffer != nullptr);
+	EXIT_IF(size == 0);
+	EXIT_IF(g_imported_memory == nullptr);
+
+	if (!gctx->external_memory_host)
+	{
+		return false;
+	}
+
+	return g_imported_memory->CreateBuffer(gctx, vaddr, size, buffer);
+}
+
+// Takes the ownership of the buffer. It's destroyed by VulkanDeleteRetiredImportedBuffers(), when the submits which could use it are
+// done, or when its range is removed.
+void VulkanDeleteImportedBuffer(GraphicContext* gctx, GuestVulkanBuffer* buffer)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_IF(buffer == nullptr);
+	EXIT_IF(gctx == nullptr);
+	EXIT_IF(!buffer->imported);
+	EXIT_IF(g_imported_memory == nullptr);
+
+	g_imported_memory->RetireBuffer(buffer);
+}
+
+void VulkanDeleteRetiredImportedBuffers(GraphicContext* gctx)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	EXIT_IF(gctx == nullptr);
+	EXIT_IF(g_imported_memory == nullptr);
+
+	g_imported_memory->DeleteRetired(gctx);
+}
+
 void UtilFillImage(GraphicContext* ctx, VulkanImage* dst_image, const void* src_data, uint64_t size, uint32_t src_pitch,
                    uint64_t dst_layout)
 {
@@ -322,29 +812,41 @@ void UtilFillImage(GraphicContext* ctx, VulkanImage* dst_image, const void* src_
 	EXIT_IF(ctx == nullptr);
 	EXIT_IF(dst_image == nullptr);
 	EXIT_IF(src_data == nullptr);
+	EXIT_IF(g_staging == nullptr);
 
-	VulkanBuffer staging_buffer {};
-	staging_buffer.usage           = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	staging_buffer.memory.property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	VulkanCreateBuffer(ctx, size, &staging_buffer);
+	Core::LockGuard lock(g_staging->GetMutex());
 
-	void* data = nullptr;
-	VulkanMapMemory(ctx, &staging_buffer.memory, &data);
-	std::memcpy(data, src_data, size);
-	VulkanUnmapMemory(ctx, &staging_buffer.memory);
+	VulkanBuffer* staging_buffer = nullptr;
+	uint64_t      offset         = 0;
 
-	CommandBuffer buffer(GraphicContext::QUEUE_UTIL);
-	// buffer.SetQueue(GraphicContext::QUEUE_UTIL);
+	auto* buffer = g_staging->Upload(ctx, src_data, size, &staging_buffer, &offset);
 
-	EXIT_NOT_IMPLEMENTED(buffer.IsInvalid());
+	UtilBufferToImage(buffer, staging_buffer, src_pitch, dst_image, dst_layout, offset);
+}
 
-	buffer.Begin();
-	UtilBufferToImage(&buffer, &staging_buffer, src_pitch, dst_image, dst_layout);
-	buffer.End();
-	buffer.Execute();
-	buffer.WaitForFence();
+void UtilFillBuffer(GraphicContext* ctx, VulkanBuffer* dst_buffer, const void* src_data, uint64_t size)
+{
+	KYTY_PROFILER_FUNCTION();
 
-	VulkanDeleteBuffer(ctx, &staging_buffer);
+	EXIT_IF(ctx == nullptr);
+	EXIT_IF(dst_buffer == nullptr);
+	EXIT_IF(dst_buffer->buffer == nullptr);
+	EXIT_IF(src_data == nullptr);
+	EXIT_IF(g_staging == nullptr);
+
+	Core::LockGuard lock(g_staging->GetMutex());
+
+	VulkanBuffer* staging_buffer = nullptr;
+	uint64_t      offset         = 0;
+
+	auto* buffer = g_staging->Upload(ctx, src_data, size, &staging_buffer, &offset);
+
+	VkBufferCopy copy_region {};
+	copy_region.srcOffset = offset;
+	copy_region.dstOffset = 0;
+	copy_region.size      = size;
+
+	vkCmdCopyBuffer(buffer->GetPool()->buffers[buffer->GetIndex()], staging_buffer->buffer, dst_buffer->buffer, 1, &copy_region);
 }
 
 void UtilFillBuffer(GraphicContext* ctx, void* dst_data, uint64_t size, uint32_t dst_pitch, VulkanImage* src_image, uint64_t src_layout)
@@ -429,29 +931,16 @@ void UtilFillImage(GraphicContext* ctx, VulkanImage* image, const void* src_data
 {
 	EXIT_IF(ctx == nullptr);
 	EXIT_IF(image == nullptr);
+	EXIT_IF(g_staging == nullptr);
 
-	VulkanBuffer staging_buffer {};
-	staging_buffer.usage           = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	staging_buffer.memory.property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	VulkanCreateBuffer(ctx, size, &staging_buffer);
-
-	void* data = nullptr;
-	VulkanMapMemory(ctx, &staging_buffer.memory, &data);
-	std::memcpy(data, src_data, size);
-	VulkanUnmapMemory(ctx, &staging_buffer.memory);
+	Core::LockGuard lock(g_staging->GetMutex());
 
-	CommandBuffer buffer(GraphicContext::QUEUE_UTIL);
-	// buffer.SetQueue(GraphicContext::QUEUE_UTIL);
+	VulkanBuffer* staging_buffer = nullptr;
+	uint64_t      offset         = 0;
 
-	EXIT_NOT_IMPLEMENTED(buffer.IsInvalid());
+	auto* buffer = g_staging->Upload(ctx, src_data, size, &staging_buffer, &offset);
 
-	buffer.Begin();
-	UtilBufferToImage(&buffer, &staging_buffer, image, regions, dst_layout);
-	buffer.End();
-	buffer.Execute();
-	buffer.WaitForFence();
-
-	VulkanDeleteBuffer(ctx, &staging_buffer);
+	UtilBufferToImage(buffer, staging_buffer, image, regions, dst_layout, offset);
 }
 
 void UtilFillImage(GraphicContext* ctx, const Vector<ImageImageCopy>& regions, VulkanImage* dst_image, uint64_t dst_layout)
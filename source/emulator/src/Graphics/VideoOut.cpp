@@ -135,7 +135,7 @@ struct VideoOutBufferInfo
 
 struct VideoOutConfig
 {
-	Core::Mutex                      mutex;
+	Core::Mutex                      mutex {Core::Mutex::Type::Recursive};
 	VideoOutResolutionStatus         resolution;
 	bool                             opened    = false;
 	int                              flip_rate = 0;
@@ -213,7 +213,7 @@ public:
 	void VblankEnd();
 
 private:
-	Core::Mutex               m_mutex;
+	Core::Mutex               m_mutex {Core::Mutex::Type::Recursive};
 	VideoOutConfig            m_video_out_ctx[VIDEO_OUT_NUM_MAX];
 	Graphics::GraphicContext* m_graphic_ctx = nullptr;
 	FlipQueue                 m_flip_queue;
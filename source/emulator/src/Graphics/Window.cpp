@@ -239,7 +239,7 @@ struct WindowContext
 	char device_name[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = {0};
 	char processor_name[64]                            = {0};
 
-	Core::Mutex   mutex;
+	Core::Mutex   mutex {Core::Mutex::Type::Recursive};
 	bool          graphic_initialized = false;
 	Core::CondVar graphic_initialized_condvar;
 };
@@ -1468,9 +1468,13 @@ static void VulkanFindPhysicalDevice(VkInstance instance, VkSurfaceKHR surface,
 		VkPhysicalDeviceProperties device_properties {};
 		VkPhysicalDeviceFeatures2  device_features2 {};
 
+		VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore {};
+		timeline_semaphore.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		timeline_semaphore.pNext = nullptr;
+
 		VkPhysicalDeviceColorWriteEnableFeaturesEXT color_write_ext {};
 		color_write_ext.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COLOR_WRITE_ENABLE_FEATURES_EXT;
-		color_write_ext.pNext = nullptr;
+		color_write_ext.pNext = &timeline_semaphore;
 
 		device_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 		device_features2.pNext = &color_write_ext;
@@ -1499,6 +1503,12 @@ static void VulkanFindPhysicalDevice(VkInstance instance, VkSurfaceKHR surface,
 			skip_device = true;
 		}
 
+		if (timeline_semaphore.timelineSemaphore != VK_TRUE)
+		{
+			printf("timelineSemaphore is not supported\n");
+			skip_device = true;
+		}
+
 		if (device_features2.features.fragmentStoresAndAtomics != VK_TRUE)
 		{
 			printf("fragmentStoresAndAtomics is not supported\n");
@@ -1668,6 +1678,17 @@ static void VulkanFindPhysicalDevice(VkInstance instance, VkSurfaceKHR surface,
 	*out_queues = best_queues;
 }
 
+static bool VulkanDeviceExtensionAvailable(VkPhysicalDevice device, const char* name)
+{
+	uint32_t extensions_count = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensions_count, nullptr);
+
+	Vector<VkExtensionProperties> available_extensions(extensions_count);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensions_count, available_extensions.GetData());
+
+	return available_extensions.Contains(name, [](auto p, auto ext) { return strcmp(p.extensionName, ext) == 0; });
+}
+
 static VkDevice VulkanCreateDevice(VkPhysicalDevice physical_device, VkSurfaceKHR surface, const VulkanExtensions* r,
                                    const VulkanQueues& queues, const Vector<const char*>& device_extensions)
 {
@@ -1704,9 +1725,14 @@ static VkDevice VulkanCreateDevice(VkPhysicalDevice physical_device, VkSurfaceKH
 	device_features.samplerAnisotropy        = VK_TRUE;
 	// device_features.shaderImageGatherExtended = VK_TRUE;
 
+	VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore {};
+	timeline_semaphore.sType             = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timeline_semaphore.pNext             = nullptr;
+	timeline_semaphore.timelineSemaphore = VK_TRUE;
+
 	VkPhysicalDeviceColorWriteEnableFeaturesEXT color_write_ext {};
 	color_write_ext.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COLOR_WRITE_ENABLE_FEATURES_EXT;
-	color_write_ext.pNext            = nullptr;
+	color_write_ext.pNext            = &timeline_semaphore;
 	color_write_ext.colorWriteEnable = VK_TRUE;
 
 	VkDeviceCreateInfo create_info {};
@@ -2206,6 +2232,28 @@ static void VulkanCreate(WindowContext* ctx)
 	memcpy(ctx->device_name, device_properties.deviceName, sizeof(ctx->device_name));
 	memcpy(ctx->processor_name, Core::GetSystemInfo().ProcessorName.C_Str(), sizeof(ctx->processor_name));
 
+	// Optional: vertex and index buffers are read from the guest memory without copying
+	if (VulkanDeviceExtensionAvailable(ctx->graphic_ctx.physical_device, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_properties {};
+		host_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 device_properties2 {};
+		device_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		device_properties2.pNext = &host_properties;
+
+		vkGetPhysicalDeviceProperties2(ctx->graphic_ctx.physical_device, &device_properties2);
+
+		device_extensions.Add(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+
+		ctx->graphic_ctx.external_memory_host   = true;
+		ctx->graphic_ctx.host_pointer_alignment = host_properties.minImportedHostPointerAlignment;
+		ctx->graphic_ctx.imported_ranges_max    = device_properties.limits.maxMemoryAllocationCount / 4;
+
+		printf("External host memory: alignment = %" PRIu64 ", imported ranges max = %u\n",
+		       static_cast<uint64_t>(host_properties.minImportedHostPointerAlignment), ctx->graphic_ctx.imported_ranges_max);
+	}
+
 	ctx->graphic_ctx.device = VulkanCreateDevice(ctx->graphic_ctx.physical_device, ctx->surface, &r, queues, device_extensions);
 	if (ctx->graphic_ctx.device == nullptr)
 	{
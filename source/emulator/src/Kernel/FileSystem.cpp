@@ -7,11 +7,11 @@
 #include "Kyty/Core/Threads.h"
 #include "Kyty/Core/Vector.h"
 
+#include "Emulator/Graphics/Objects/GpuMemory.h"
 #include "Emulator/Libs/Errno.h"
 #include "Emulator/Libs/Libs.h"
 
 #include <atomic>
-#include <climits>
 
 #ifdef KYTY_EMU_ENABLED
 
@@ -21,6 +21,14 @@ LIB_NAME("libkernel", "libkernel");
 
 constexpr int DESCRIPTOR_MIN = 3;
 
+// ReadFile/WriteFile with an offset move the file pointer on Windows and Core::File puts it back, so positional I/O takes the file
+// mutex there. Elsewhere it doesn't touch the cursor and runs without the lock.
+#if KYTY_PLATFORM == KYTY_PLATFORM_WINDOWS
+constexpr bool POSITIONAL_IO_LOCKED = true;
+#else
+constexpr bool POSITIONAL_IO_LOCKED = false;
+#endif
+
 class MountPoints
 {
 public:
@@ -43,7 +51,7 @@ public:
 
 private:
 	Vector<MountPair> m_mount_pairs;
-	Core::Mutex       m_mutex;
+	Core::Mutex       m_mutex {Core::Mutex::Type::Recursive};
 };
 
 struct File
@@ -60,107 +68,330 @@ struct File
 
 class FileDescriptors
 {
+	static constexpr uint32_t READERS_SHIFT = 16;
+	static constexpr uint32_t READER        = 1u << READERS_SHIFT;
+
 public:
+	// Holds the descriptor open, Close waits until every FileRef to it is gone
+	class FileRef
+	{
+	public:
+		FileRef() = default;
+		FileRef(File* file, std::atomic_uint32_t* state): m_file(file), m_state(state) {}
+		~FileRef()
+		{
+			if (m_state != nullptr)
+			{
+				m_state->fetch_sub(READER, std::memory_order_release);
+			}
+		}
+
+		KYTY_CLASS_NO_COPY(FileRef);
+
+		File*    operator->() const { return m_file; }
+		explicit operator bool() const { return m_file != nullptr; }
+
+	private:
+		File*                 m_file  = nullptr;
+		std::atomic_uint32_t* m_state = nullptr;
+	};
+
 	FileDescriptors() { EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread()); }
 	virtual ~FileDescriptors() { KYTY_NOT_IMPLEMENTED; }
 
 	KYTY_CLASS_NO_COPY(FileDescriptors);
 
-	int   CreateDescriptor();
-	void  DeleteDescriptor(int d);
-	File* GetFile(int d);
-	File* GetFile(const String& real_name);
-	void  CloseAll();
+	int     CreateDescriptor(File** file);
+	void    DeleteDescriptor(int d);
+	bool    Close(int d, String* real_name);
+	FileRef GetFile(int d);
+	bool    IsOpened(const String& real_name);
+	void    CloseAll();
 
 private:
-	Vector<File*> m_files;
-	Core::Mutex   m_mutex;
+	// Descriptor is (generation << INDEX_BITS) | (index + DESCRIPTOR_MIN). The generation changes every time the slot is freed, so a
+	// stale descriptor doesn't reach a file opened later in the same slot.
+	static constexpr uint32_t INDEX_BITS      = 16;
+	static constexpr uint32_t INDEX_MASK      = (1u << INDEX_BITS) - 1;
+	static constexpr uint32_t GENERATION_MASK = 0x3fffu;
+	static constexpr uint32_t SLOTS_MAX       = INDEX_MASK + 1 - DESCRIPTOR_MIN;
+	static constexpr uint32_t CHUNK_SIZE      = 256;
+	static constexpr uint32_t CHUNKS_MAX      = (SLOTS_MAX + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	static constexpr uint32_t USED            = 1u;
+	static constexpr uint32_t READERS_MASK    = ~((1u << READERS_SHIFT) - 1);
+
+	struct Slot
+	{
+		File                 file;
+		std::atomic_uint32_t state {0}; // (readers << READERS_SHIFT) | (generation << 1) | used
+	};
+
+	struct Chunk
+	{
+		Slot slots[CHUNK_SIZE];
+	};
+
+	// Chunks are never freed, so the lookup doesn't need the mutex
+	Slot* FindSlot(int d);
+
+	// m_mutex must be locked. Stops new lookups and waits for the ones in progress.
+	static void Drain(Slot* slot);
+
+	// m_mutex must be locked, the slot must be drained
+	void FreeSlot(Slot* slot, int d);
+
+	std::atomic<Chunk*> m_chunks[CHUNKS_MAX] {};
+	uint32_t            m_free_index = 0;
+	Core::Mutex         m_mutex;
 };
 
 static MountPoints*     g_mount_points = nullptr;
 static FileDescriptors* g_files        = nullptr;
 
+// Game package, nothing writes there while the game is running
+static bool is_read_only_path(const String& name)
+{
+	return name.StartsWith(U"/app0/");
+}
+
+// The host kernel doesn't raise an access violation when it touches a protected page, read() and write() just fail with EFAULT. Pages
+// of the buffer which are hidden by GpuMemory are written back before the call. Watched pages are readable, they are released only if
+// the kernel writes to the buffer.
+static void prepare_io_buffer(const void* buf, uint64_t nbytes, bool kernel_writes)
+{
+	if (kernel_writes)
+	{
+		Graphics::GpuMemoryCheckAccessViolation(reinterpret_cast<uint64_t>(buf), nbytes);
+	} else
+	{
+		Graphics::GpuMemoryCheckReadAccess(reinterpret_cast<uint64_t>(buf), nbytes);
+	}
+}
+
 static void sec_to_timespec(KernelTimespec* ts, double sec)
 {
 	ts->tv_sec  = static_cast<int64_t>(sec);
 	ts->tv_nsec = static_cast<int64_t>((sec - static_cast<double>(ts->tv_sec)) * 1000000000.0);
 }
 
-int FileDescriptors::CreateDescriptor()
+FileDescriptors::Slot* FileDescriptors::FindSlot(int d)
 {
-	Core::LockGuard lock(m_mutex);
+	auto     fd         = static_cast<uint32_t>(d);
+	auto     index      = (fd & INDEX_MASK) - DESCRIPTOR_MIN;
+	uint32_t generation = fd >> INDEX_BITS;
+
+	if (index >= SLOTS_MAX || generation > GENERATION_MASK)
+	{
+		return nullptr;
+	}
 
-	auto* file      = new File {};
-	file->opened    = false;
-	file->directory = false;
+	auto* chunk = m_chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+
+	if (chunk == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto& slot = chunk->slots[index % CHUNK_SIZE];
+
+	return ((slot.state.load(std::memory_order_acquire) & ~READERS_MASK) == ((generation << 1u) | USED) ? &slot : nullptr);
+}
+
+int FileDescriptors::CreateDescriptor(File** file)
+{
+	EXIT_IF(file == nullptr);
+
+	Core::LockGuard lock(m_mutex);
 
-	int files_num = static_cast<int>(m_files.Size());
-	for (int index = 0; index < files_num; index++)
+	for (uint32_t index = m_free_index; index < SLOTS_MAX; index++)
 	{
-		if (m_files.At(index) == nullptr)
+		auto* chunk = m_chunks[index / CHUNK_SIZE].load(std::memory_order_relaxed);
+
+		if (chunk == nullptr)
 		{
-			m_files[index] = file;
-			return index + DESCRIPTOR_MIN;
+			chunk = new Chunk;
+			m_chunks[index / CHUNK_SIZE].store(chunk, std::memory_order_release);
+		}
+
+		auto&    slot  = chunk->slots[index % CHUNK_SIZE];
+		uint32_t state = slot.state.load(std::memory_order_relaxed);
+
+		if ((state & USED) == 0)
+		{
+			auto* f = &slot.file;
+
+			f->name.Clear();
+			f->real_name.Clear();
+			f->opened    = false;
+			f->directory = false;
+			f->dents.Clear();
+			f->dents_index = 0;
+
+			slot.state.store(state | USED, std::memory_order_release);
+
+			*file = f;
+
+			m_free_index = index + 1;
+
+			return static_cast<int>(((state >> 1u) << INDEX_BITS) | (index + DESCRIPTOR_MIN));
 		}
 	}
 
-	m_files.Add(file);
-	return static_cast<int>(m_files.Size()) + DESCRIPTOR_MIN - 1;
+	EXIT("too many descriptors\n");
+	return -1;
 }
 
 void FileDescriptors::DeleteDescriptor(int d)
 {
 	Core::LockGuard lock(m_mutex);
 
-	auto index = static_cast<uint32_t>(d - DESCRIPTOR_MIN);
+	auto* slot = FindSlot(d);
 
-	EXIT_IF(!m_files.IndexValid(index));
-	EXIT_IF(m_files.At(index) == nullptr);
-	EXIT_IF(m_files.At(index)->opened);
+	EXIT_IF(slot == nullptr);
+	EXIT_IF(slot->file.opened);
 
-	delete m_files.At(index);
-	m_files[index] = nullptr;
+	Drain(slot);
+	FreeSlot(slot, d);
 }
 
-File* FileDescriptors::GetFile(int d)
+// Only one of the threads closing the same descriptor finds the slot, the others get false
+bool FileDescriptors::Close(int d, String* real_name)
 {
+	EXIT_IF(real_name == nullptr);
+
 	Core::LockGuard lock(m_mutex);
 
-	auto index = static_cast<uint32_t>(d - DESCRIPTOR_MIN);
+	auto* slot = FindSlot(d);
+
+	if (slot == nullptr)
+	{
+		return false;
+	}
+
+	auto& file = slot->file;
+
+	if (!file.opened)
+	{
+		// Still being opened
+		return false;
+	}
+
+	Drain(slot);
+
+	if (!file.directory)
+	{
+		file.f.Close();
+	}
+
+	file.opened = false;
+
+	*real_name = file.real_name;
 
-	EXIT_IF(!m_files.IndexValid(index));
+	FreeSlot(slot, d);
 
-	return m_files.At(index);
+	return true;
 }
 
-File* FileDescriptors::GetFile(const String& real_name)
+void FileDescriptors::Drain(Slot* slot)
+{
+	slot->state.fetch_and(~USED, std::memory_order_acq_rel);
+
+	while ((slot->state.load(std::memory_order_acquire) & READERS_MASK) != 0)
+	{
+		Core::Thread::SleepMicro(10);
+	}
+}
+
+void FileDescriptors::FreeSlot(Slot* slot, int d)
+{
+	uint32_t generation = ((slot->state.load(std::memory_order_relaxed) >> 1u) + 1) & GENERATION_MASK;
+
+	slot->state.store(generation << 1u, std::memory_order_release);
+
+	auto index = (static_cast<uint32_t>(d) & INDEX_MASK) - DESCRIPTOR_MIN;
+
+	if (index < m_free_index)
+	{
+		m_free_index = index;
+	}
+}
+
+FileDescriptors::FileRef FileDescriptors::GetFile(int d)
+{
+	auto* slot = FindSlot(d);
+
+	if (slot == nullptr)
+	{
+		return FileRef();
+	}
+
+	uint32_t id    = ((static_cast<uint32_t>(d) >> INDEX_BITS) << 1u) | USED;
+	uint32_t state = slot->state.load(std::memory_order_relaxed);
+
+	// The slot may be closed or reused meanwhile, the reader is counted only if it's still the same descriptor
+	while ((state & ~READERS_MASK) == id)
+	{
+		if (slot->state.compare_exchange_weak(state, state + READER, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			return FileRef(&slot->file, &slot->state);
+		}
+	}
+
+	return FileRef();
+}
+
+bool FileDescriptors::IsOpened(const String& real_name)
 {
 	Core::LockGuard lock(m_mutex);
 
-	for (auto* f: m_files)
+	for (auto& c: m_chunks)
 	{
-		if (f != nullptr && f->real_name == real_name)
+		auto* chunk = c.load(std::memory_order_relaxed);
+
+		if (chunk == nullptr)
 		{
-			return f;
+			break;
+		}
+
+		for (auto& slot: chunk->slots)
+		{
+			if ((slot.state.load(std::memory_order_relaxed) & USED) != 0 && slot.file.real_name == real_name)
+			{
+				return true;
+			}
 		}
 	}
 
-	return nullptr;
+	return false;
 }
 
 void FileDescriptors::CloseAll()
 {
 	Core::LockGuard lock(m_mutex);
 
-	for (auto& f: m_files)
+	for (auto& c: m_chunks)
 	{
-		if (f != nullptr && f->opened)
+		auto* chunk = c.load(std::memory_order_relaxed);
+
+		if (chunk == nullptr)
+		{
+			break;
+		}
+
+		for (auto& slot: chunk->slots)
 		{
-			f->f.Close();
-			delete f;
-			f = nullptr;
+			uint32_t state = slot.state.load(std::memory_order_relaxed);
+
+			if ((state & USED) != 0 && slot.file.opened)
+			{
+				slot.file.f.Close();
+				slot.file.opened = false;
+				slot.state.store((state & READERS_MASK) | ((((state >> 1u) + 1) & GENERATION_MASK) << 1u), std::memory_order_release);
+			}
 		}
 	}
+
+	m_free_index = 0;
 }
 
 void MountPoints::Mount(const String& folder, const String& point)
@@ -317,8 +548,8 @@ int KYTY_SYSV_ABI KernelOpen(const char* path, int flags, uint16_t mode)
 	EXIT_NOT_IMPLEMENTED(directory && rw_mode != Core::File::Mode::Read);
 	EXIT_NOT_IMPLEMENTED(directory && (trunc || creat));
 
-	int   descriptor = g_files->CreateDescriptor();
-	auto* file       = g_files->GetFile(descriptor);
+	File* file       = nullptr;
+	int   descriptor = g_files->CreateDescriptor(&file);
 
 	EXIT_IF(file == nullptr || file->opened || file->directory);
 
@@ -364,6 +595,13 @@ int KYTY_SYSV_ABI KernelOpen(const char* path, int flags, uint16_t mode)
 
 			printf("\tCreate: " FG_WHITE BOLD "%s" DEFAULT ", %s\n", file->real_name.C_Str(),
 			       (result ? FG_GREEN "[ok]" FG_DEFAULT : FG_RED "[fail]" FG_DEFAULT));
+		} else if (rw_mode == Core::File::Mode::Read && is_read_only_path(file->name))
+		{
+			// Reads are served from the page cache, no stdio buffering and no syscall per read
+			result = file->f.OpenMapped(file->real_name);
+
+			printf("\tOpen mapped: " FG_WHITE BOLD "%s" DEFAULT ", %s\n", file->real_name.C_Str(),
+			       (result ? FG_GREEN "[ok]" FG_DEFAULT : FG_RED "[fail]" FG_DEFAULT));
 		} else
 		{
 			result = file->f.Open(file->real_name, rw_mode);
@@ -401,25 +639,14 @@ int KYTY_SYSV_ABI KernelClose(int d)
 		return KERNEL_ERROR_EPERM;
 	}
 
-	auto* file = g_files->GetFile(d);
+	String real_name;
 
-	if (file == nullptr)
+	if (!g_files->Close(d, &real_name))
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
-	EXIT_IF(!file->opened);
-
-	if (!file->directory)
-	{
-		file->f.Close();
-	}
-
-	file->opened = false;
-
-	printf("\tClose: " FG_WHITE BOLD "%s" DEFAULT "\n", file->real_name.C_Str());
-
-	g_files->DeleteDescriptor(d);
+	printf("\tClose: " FG_WHITE BOLD "%s" DEFAULT "\n", real_name.C_Str());
 
 	return OK;
 }
@@ -440,24 +667,27 @@ int64_t KYTY_SYSV_ABI KernelRead(int d, void* buf, size_t nbytes)
 		return KERNEL_ERROR_EFAULT;
 	}
 
-	auto* file = g_files->GetFile(d);
+	auto file = g_files->GetFile(d);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
 	EXIT_NOT_IMPLEMENTED(file->directory);
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
-	EXIT_NOT_IMPLEMENTED(nbytes > UINT_MAX);
+	prepare_io_buffer(buf, nbytes, true);
 
 	file->mutex.Lock();
 
 	bool     is_invalid = file->f.IsInvalid();
-	uint32_t bytes_read = 0;
-	file->f.Read(buf, static_cast<uint32_t>(nbytes), &bytes_read);
+	uint64_t bytes_read = 0;
+	file->f.Read(buf, nbytes, &bytes_read);
 
 	file->mutex.Unlock();
 
@@ -467,9 +697,9 @@ int64_t KYTY_SYSV_ABI KernelRead(int d, void* buf, size_t nbytes)
 		return KERNEL_ERROR_EIO;
 	}
 
-	printf("\tRead %u bytes from: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_read, file->real_name.C_Str());
+	printf("\tRead %" PRIu64 " bytes from: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_read, file->real_name.C_Str());
 
-	return bytes_read;
+	return static_cast<int64_t>(bytes_read);
 }
 
 int64_t KYTY_SYSV_ABI KernelWrite(int d, const void* buf, size_t nbytes)
@@ -488,24 +718,27 @@ int64_t KYTY_SYSV_ABI KernelWrite(int d, const void* buf, size_t nbytes)
 		return KERNEL_ERROR_EFAULT;
 	}
 
-	auto* file = g_files->GetFile(d);
+	auto file = g_files->GetFile(d);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
 	EXIT_NOT_IMPLEMENTED(file->directory);
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
-	EXIT_NOT_IMPLEMENTED(nbytes > UINT_MAX);
+	prepare_io_buffer(buf, nbytes, false);
 
 	file->mutex.Lock();
 
 	bool     is_invalid    = file->f.IsInvalid();
-	uint32_t bytes_written = 0;
-	file->f.Write(buf, static_cast<uint32_t>(nbytes), &bytes_written);
+	uint64_t bytes_written = 0;
+	file->f.Write(buf, nbytes, &bytes_written);
 
 	file->mutex.Unlock();
 
@@ -515,9 +748,9 @@ int64_t KYTY_SYSV_ABI KernelWrite(int d, const void* buf, size_t nbytes)
 		return KERNEL_ERROR_EIO;
 	}
 
-	printf("\tWrite %u bytes to: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_written, file->real_name.C_Str());
+	printf("\tWrite %" PRIu64 " bytes to: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_written, file->real_name.C_Str());
 
-	return bytes_written;
+	return static_cast<int64_t>(bytes_written);
 }
 
 int64_t KYTY_SYSV_ABI KernelPread(int d, void* buf, size_t nbytes, int64_t offset)
@@ -541,39 +774,48 @@ int64_t KYTY_SYSV_ABI KernelPread(int d, void* buf, size_t nbytes, int64_t offse
 		return KERNEL_ERROR_EINVAL;
 	}
 
-	auto* file = g_files->GetFile(d);
+	auto file = g_files->GetFile(d);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
 	EXIT_NOT_IMPLEMENTED(file->directory);
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
-	EXIT_NOT_IMPLEMENTED(nbytes > UINT_MAX);
+	if (file->f.IsInvalid())
+	{
+		printf("\tfile is invalid\n");
+		return KERNEL_ERROR_EIO;
+	}
 
-	file->mutex.Lock();
+	prepare_io_buffer(buf, nbytes, true);
 
-	bool     is_invalid = file->f.IsInvalid();
-	auto     pos        = file->f.Tell();
-	uint32_t bytes_read = 0;
-	file->f.Seek(offset);
-	file->f.Read(buf, static_cast<uint32_t>(nbytes), &bytes_read);
-	file->f.Seek(pos);
+	if (POSITIONAL_IO_LOCKED)
+	{
+		file->mutex.Lock();
+	}
 
-	file->mutex.Unlock();
+	uint64_t bytes_read = 0;
+	file->f.ReadAt(buf, nbytes, offset, &bytes_read);
 
-	if (is_invalid)
+	if (POSITIONAL_IO_LOCKED)
 	{
-		printf("\tfile is invalid\n");
-		return KERNEL_ERROR_EIO;
+		file->mutex.Unlock();
 	}
 
-	printf("\tRead %u bytes (pos = %" PRId64 ") from: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_read, offset, file->real_name.C_Str());
+	if (PRINT_NAME_TRACED())
+	{
+		printf("\tRead %" PRIu64 " bytes (pos = %" PRId64 ") from: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_read, offset,
+		       file->real_name.C_Str());
+	}
 
-	return bytes_read;
+	return static_cast<int64_t>(bytes_read);
 }
 
 int64_t KYTY_SYSV_ABI KernelPwrite(int d, const void* buf, size_t nbytes, int64_t offset)
@@ -597,39 +839,48 @@ int64_t KYTY_SYSV_ABI KernelPwrite(int d, const void* buf, size_t nbytes, int64_
 		return KERNEL_ERROR_EINVAL;
 	}
 
-	auto* file = g_files->GetFile(d);
+	auto file = g_files->GetFile(d);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
 	EXIT_NOT_IMPLEMENTED(file->directory);
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
-	EXIT_NOT_IMPLEMENTED(nbytes > UINT_MAX);
+	if (file->f.IsInvalid())
+	{
+		printf("\tfile is invalid\n");
+		return KERNEL_ERROR_EIO;
+	}
 
-	file->mutex.Lock();
+	prepare_io_buffer(buf, nbytes, false);
 
-	bool     is_invalid    = file->f.IsInvalid();
-	auto     pos           = file->f.Tell();
-	uint32_t bytes_written = 0;
-	file->f.Seek(offset);
-	file->f.Write(buf, static_cast<uint32_t>(nbytes), &bytes_written);
-	file->f.Seek(pos);
+	if (POSITIONAL_IO_LOCKED)
+	{
+		file->mutex.Lock();
+	}
 
-	file->mutex.Unlock();
+	uint64_t bytes_written = 0;
+	file->f.WriteAt(buf, nbytes, offset, &bytes_written);
 
-	if (is_invalid)
+	if (POSITIONAL_IO_LOCKED)
 	{
-		printf("\tfile is invalid\n");
-		return KERNEL_ERROR_EIO;
+		file->mutex.Unlock();
 	}
 
-	printf("\tWrite %u bytes (pos = %" PRId64 ") to: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_written, offset, file->real_name.C_Str());
+	if (PRINT_NAME_TRACED())
+	{
+		printf("\tWrite %" PRIu64 " bytes (pos = %" PRId64 ") to: " FG_WHITE BOLD "%s" DEFAULT "\n", bytes_written, offset,
+		       file->real_name.C_Str());
+	}
 
-	return bytes_written;
+	return static_cast<int64_t>(bytes_written);
 }
 
 int64_t KYTY_SYSV_ABI KernelLseek(int d, int64_t offset, int whence)
@@ -643,16 +894,19 @@ int64_t KYTY_SYSV_ABI KernelLseek(int d, int64_t offset, int whence)
 		return KERNEL_ERROR_EPERM;
 	}
 
-	auto* file = g_files->GetFile(d);
+	auto file = g_files->GetFile(d);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
 	EXIT_NOT_IMPLEMENTED(file->directory);
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
 	file->mutex.Lock();
 
@@ -768,14 +1022,17 @@ int KYTY_SYSV_ABI KernelFstat(int d, FileStat* sb)
 		return KERNEL_ERROR_EFAULT;
 	}
 
-	auto* file = g_files->GetFile(d);
+	auto file = g_files->GetFile(d);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
 	printf("\tKernelFstat: %s\n", file->real_name.C_Str());
 
@@ -836,8 +1093,8 @@ int KYTY_SYSV_ABI KernelUnlink(const char* path)
 	auto real_file_name = g_mount_points->GetRealFilename(path_s);
 	auto real_directory = g_mount_points->GetRealDirectory(path_s);
 
-	EXIT_NOT_IMPLEMENTED(g_files->GetFile(real_file_name) != nullptr);
-	EXIT_NOT_IMPLEMENTED(g_files->GetFile(real_directory) != nullptr);
+	EXIT_NOT_IMPLEMENTED(g_files->IsOpened(real_file_name));
+	EXIT_NOT_IMPLEMENTED(g_files->IsOpened(real_directory));
 
 	bool is_dir  = Core::File::IsDirectoryExisting(real_file_name) || Core::File::IsDirectoryExisting(real_directory);
 	bool is_file = Core::File::IsFileExisting(real_file_name);
@@ -880,9 +1137,9 @@ int KYTY_SYSV_ABI KernelGetdirentries(int fd, char* buf, int nbytes, int64_t* ba
 		return KERNEL_ERROR_EFAULT;
 	}
 
-	auto* file = g_files->GetFile(fd);
+	auto file = g_files->GetFile(fd);
 
-	if (file == nullptr)
+	if (!file)
 	{
 		return KERNEL_ERROR_EBADF;
 	}
@@ -892,7 +1149,10 @@ int KYTY_SYSV_ABI KernelGetdirentries(int fd, char* buf, int nbytes, int64_t* ba
 		return KERNEL_ERROR_EINVAL;
 	}
 
-	EXIT_IF(!file->opened);
+	if (!file->opened)
+	{
+		return KERNEL_ERROR_EBADF;
+	}
 
 	printf("\t dir    = %s\n", file->real_name.C_Str());
 	printf("\t nbytes = %d\n", nbytes);
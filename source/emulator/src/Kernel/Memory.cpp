@@ -2,6 +2,7 @@
 
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/MagicEnum.h"
+#include "Kyty/Core/RangeAllocator.h"
 #include "Kyty/Core/String.h"
 #include "Kyty/Core/Threads.h"
 #include "Kyty/Core/Vector.h"
@@ -14,6 +15,8 @@
 #include "Emulator/Libs/Libs.h"
 
 #include <algorithm>
+#include <iterator>
+#include <map>
 
 #ifdef KYTY_EMU_ENABLED
 
@@ -38,7 +41,9 @@ public:
 		int                     memory_type;
 	};
 
-	PhysicalMemory() { EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread()); }
+	using blocks_t = std::map<uint64_t, AllocatedBlock>;
+
+	PhysicalMemory(): m_free(0, Size()) { EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread()); }
 	virtual ~PhysicalMemory() { KYTY_NOT_IMPLEMENTED; }
 
 	KYTY_CLASS_NO_COPY(PhysicalMemory);
@@ -52,12 +57,16 @@ public:
 	bool Find(uint64_t vaddr, uint64_t* base_addr, size_t* len, int* prot, VirtualMemory::Mode* mode, Graphics::GpuMemoryMode* gpu_mode);
 	bool Find(uint64_t phys_addr, bool next, PhysicalMemory::AllocatedBlock* out);
 
-	[[nodiscard]] Core::Mutex&                  GetMutex() { return m_mutex; }
-	[[nodiscard]] const Vector<AllocatedBlock>& GetBlocks() const { return m_allocated; }
+	[[nodiscard]] Core::Mutex&    GetMutex() { return m_mutex; }
+	[[nodiscard]] const blocks_t& GetBlocks() const { return m_allocated; }
 
 private:
-	Vector<AllocatedBlock> m_allocated;
-	Core::Mutex            m_mutex;
+	blocks_t::iterator FindBlock(uint64_t phys_addr);
+
+	blocks_t                     m_allocated; // start_addr -> block
+	std::map<uint64_t, uint64_t> m_mapped;    // map_vaddr -> start_addr
+	Core::RangeAllocator         m_free;
+	Core::Mutex                  m_mutex;
 };
 
 class FlexibleMemory
@@ -110,11 +119,6 @@ KYTY_SUBSYSTEM_UNEXPECTED_SHUTDOWN(Memory) {}
 
 KYTY_SUBSYSTEM_DESTROY(Memory) {}
 
-static uint64_t get_aligned_pos(uint64_t pos, size_t align)
-{
-	return (align != 0 ? (pos + (align - 1)) & ~(align - 1) : pos);
-}
-
 void RegisterCallbacks(callback_func_t alloc_func, callback_func_t free_func)
 {
 	EXIT_IF(g_alloc_callback != nullptr || g_free_callback != nullptr);
@@ -124,7 +128,7 @@ void RegisterCallbacks(callback_func_t alloc_func, callback_func_t free_func)
 	g_free_callback  = free_func;
 
 	g_physical_memory->GetMutex().Lock();
-	for (const auto& b: g_physical_memory->GetBlocks())
+	for (const auto& [start, b]: g_physical_memory->GetBlocks())
 	{
 		g_alloc_callback(b.map_vaddr, b.map_size);
 	}
@@ -138,6 +142,22 @@ void RegisterCallbacks(callback_func_t alloc_func, callback_func_t free_func)
 	g_flexible_memory->GetMutex().Unlock();
 }
 
+PhysicalMemory::blocks_t::iterator PhysicalMemory::FindBlock(uint64_t phys_addr)
+{
+	auto it = m_allocated.upper_bound(phys_addr);
+
+	if (it != m_allocated.begin())
+	{
+		auto prev = std::prev(it);
+		if (phys_addr < prev->second.start_addr + prev->second.size)
+		{
+			return prev;
+		}
+	}
+
+	return m_allocated.end();
+}
+
 bool PhysicalMemory::Alloc(uint64_t search_start, uint64_t search_end, size_t len, size_t alignment, uint64_t* phys_addr_out,
                            int memory_type)
 {
@@ -150,18 +170,7 @@ bool PhysicalMemory::Alloc(uint64_t search_start, uint64_t search_end, size_t le
 
 	uint64_t free_pos = 0;
 
-	for (const auto& b: m_allocated)
-	{
-		uint64_t n = b.start_addr + b.size;
-		if (n > free_pos)
-		{
-			free_pos = n;
-		}
-	}
-
-	free_pos = get_aligned_pos(free_pos, alignment);
-
-	if (free_pos >= search_start && free_pos + len <= search_end)
+	if (m_free.Alloc(search_start, search_end, len, alignment, &free_pos))
 	{
 		AllocatedBlock b {};
 		b.size        = len;
@@ -173,7 +182,7 @@ bool PhysicalMemory::Alloc(uint64_t search_start, uint64_t search_end, size_t le
 		b.mode        = VirtualMemory::Mode::NoAccess;
 		b.memory_type = memory_type;
 
-		m_allocated.Add(b);
+		m_allocated[free_pos] = b;
 
 		*phys_addr_out = free_pos;
 		return true;
@@ -190,19 +199,25 @@ bool PhysicalMemory::Release(uint64_t start, size_t len, uint64_t* vaddr, uint64
 
 	Core::LockGuard lock(m_mutex);
 
-	uint32_t index = 0;
-	for (auto& b: m_allocated)
+	auto it = m_allocated.find(start);
+
+	if (it != m_allocated.end() && it->second.size == len)
 	{
-		if (start == b.start_addr && len == b.size)
-		{
-			*vaddr    = b.map_vaddr;
-			*size     = b.map_size;
-			*gpu_mode = b.gpu_mode;
+		const auto& b = it->second;
 
-			m_allocated.RemoveAt(index);
-			return true;
+		*vaddr    = b.map_vaddr;
+		*size     = b.map_size;
+		*gpu_mode = b.gpu_mode;
+
+		if (b.map_vaddr != 0 || b.map_size != 0)
+		{
+			m_mapped.erase(b.map_vaddr);
 		}
-		index++;
+
+		EXIT_IF(!m_free.Free(start, len));
+
+		m_allocated.erase(it);
+		return true;
 	}
 
 	return false;
@@ -213,23 +228,26 @@ bool PhysicalMemory::Map(uint64_t vaddr, uint64_t phys_addr, size_t len, int pro
 {
 	Core::LockGuard lock(m_mutex);
 
-	for (auto& b: m_allocated)
+	auto it = FindBlock(phys_addr);
+
+	if (it != m_allocated.end())
 	{
-		if (phys_addr >= b.start_addr && phys_addr < b.start_addr + b.size)
+		auto& b = it->second;
+
+		if (b.map_vaddr != 0 || b.map_size != 0 || m_mapped.find(vaddr) != m_mapped.end())
 		{
-			if (b.map_vaddr != 0 || b.map_size != 0)
-			{
-				return false;
-			}
+			return false;
+		}
 
-			b.map_vaddr = vaddr;
-			b.map_size  = len;
-			b.prot      = prot;
-			b.mode      = mode;
-			b.gpu_mode  = gpu_mode;
+		b.map_vaddr = vaddr;
+		b.map_size  = len;
+		b.prot      = prot;
+		b.mode      = mode;
+		b.gpu_mode  = gpu_mode;
 
-			return true;
-		}
+		m_mapped[vaddr] = b.start_addr;
+
+		return true;
 	}
 
 	return false;
@@ -241,9 +259,13 @@ bool PhysicalMemory::Unmap(uint64_t vaddr, uint64_t size, Graphics::GpuMemoryMod
 
 	Core::LockGuard lock(m_mutex);
 
-	for (auto& b: m_allocated)
+	auto it = m_mapped.find(vaddr);
+
+	if (it != m_mapped.end())
 	{
-		if (b.map_vaddr == vaddr && b.map_size == size)
+		auto& b = m_allocated[it->second];
+
+		if (b.map_size == size)
 		{
 			*gpu_mode = b.gpu_mode;
 
@@ -253,6 +275,8 @@ bool PhysicalMemory::Unmap(uint64_t vaddr, uint64_t size, Graphics::GpuMemoryMod
 			b.prot      = 0;
 			b.mode      = VirtualMemory::Mode::NoAccess;
 
+			m_mapped.erase(it);
+
 			return true;
 		}
 	}
@@ -266,30 +290,17 @@ bool PhysicalMemory::Find(uint64_t phys_addr, bool next, AllocatedBlock* out)
 
 	Core::LockGuard lock(m_mutex);
 
-	for (auto& b: m_allocated)
+	if (auto it = FindBlock(phys_addr); it != m_allocated.end())
 	{
-		if (phys_addr >= b.start_addr && phys_addr < b.start_addr + b.size)
-		{
-			*out = b;
-			return true;
-		}
+		*out = it->second;
+		return true;
 	}
 
 	if (next)
 	{
-		uint64_t        min_start_addr = UINT64_MAX;
-		AllocatedBlock* next           = nullptr;
-		for (auto& b: m_allocated)
-		{
-			if (b.start_addr > phys_addr && b.start_addr < min_start_addr)
-			{
-				min_start_addr = b.start_addr;
-				next           = &b;
-			}
-		}
-		if (next != nullptr)
+		if (auto it = m_allocated.upper_bound(phys_addr); it != m_allocated.end())
 		{
-			*out = *next;
+			*out = it->second;
 			return true;
 		}
 	}
@@ -302,36 +313,42 @@ bool PhysicalMemory::Find(uint64_t vaddr, uint64_t* base_addr, size_t* len, int*
 {
 	Core::LockGuard lock(m_mutex);
 
-	return std::any_of(m_allocated.begin(), m_allocated.end(),
-	                   [vaddr, base_addr, len, prot, mode, gpu_mode](auto& b)
-	                   {
-		                   if (vaddr >= b.map_vaddr && vaddr < b.map_vaddr + b.map_size)
-		                   {
-			                   if (base_addr != nullptr)
-			                   {
-				                   *base_addr = b.map_vaddr;
-			                   }
-			                   if (len != nullptr)
-			                   {
-				                   *len = b.map_size;
-			                   }
-			                   if (prot != nullptr)
-			                   {
-				                   *prot = b.prot;
-			                   }
-			                   if (mode != nullptr)
-			                   {
-				                   *mode = b.mode;
-			                   }
-			                   if (gpu_mode != nullptr)
-			                   {
-				                   *gpu_mode = b.gpu_mode;
-			                   }
+	auto it = m_mapped.upper_bound(vaddr);
 
-			                   return true;
-		                   }
-		                   return false;
-	                   });
+	if (it == m_mapped.begin())
+	{
+		return false;
+	}
+
+	const auto& b = m_allocated[std::prev(it)->second];
+
+	if (vaddr >= b.map_vaddr && vaddr < b.map_vaddr + b.map_size)
+	{
+		if (base_addr != nullptr)
+		{
+			*base_addr = b.map_vaddr;
+		}
+		if (len != nullptr)
+		{
+			*len = b.map_size;
+		}
+		if (prot != nullptr)
+		{
+			*prot = b.prot;
+		}
+		if (mode != nullptr)
+		{
+			*mode = b.mode;
+		}
+		if (gpu_mode != nullptr)
+		{
+			*gpu_mode = b.gpu_mode;
+		}
+
+		return true;
+	}
+
+	return false;
 }
 
 bool FlexibleMemory::Map(uint64_t vaddr, size_t len, int prot, VirtualMemory::Mode mode, Graphics::GpuMemoryMode gpu_mode)
@@ -515,17 +532,18 @@ int KYTY_SYSV_ABI KernelMunmap(uint64_t vaddr, size_t len)
 
 	EXIT_NOT_IMPLEMENTED(!result);
 
-	if (vaddr != 0 || len != 0)
-	{
-		VirtualMemory::Free(vaddr);
-	}
-
+	// GPU objects may alias the pages (imported buffers), they are deleted while the memory is still mapped
 	if (gpu_mode != Graphics::GpuMemoryMode::NoAccess)
 	{
 		Graphics::GraphicsRunWait();
 		Graphics::GpuMemoryFree(Graphics::WindowGetGraphicContext(), vaddr, len, true);
 	}
 
+	if (vaddr != 0 || len != 0)
+	{
+		VirtualMemory::Free(vaddr);
+	}
+
 	if (g_free_callback != nullptr)
 	{
 		g_free_callback(vaddr, len);
@@ -669,17 +687,18 @@ int KYTY_SYSV_ABI KernelReleaseDirectMemory(int64_t start, size_t len)
 
 	EXIT_NOT_IMPLEMENTED(!result);
 
-	if (vaddr != 0 || size != 0)
-	{
-		VirtualMemory::Free(vaddr);
-	}
-
+	// GPU objects may alias the pages (imported buffers), they are deleted while the memory is still mapped
 	if (gpu_mode != Graphics::GpuMemoryMode::NoAccess)
 	{
 		Graphics::GraphicsRunWait();
 		Graphics::GpuMemoryFree(Graphics::WindowGetGraphicContext(), vaddr, size, true);
 	}
 
+	if (vaddr != 0 || size != 0)
+	{
+		VirtualMemory::Free(vaddr);
+	}
+
 	if (g_free_callback != nullptr)
 	{
 		g_free_callback(vaddr, len);
@@ -8,6 +8,7 @@
 #include "Kyty/Core/Threads.h"
 #include "Kyty/Core/Timer.h"
 #include "Kyty/Core/Vector.h"
+#include "Kyty/Core/VirtualMemory.h"
 
 #include "Emulator/Libs/Errno.h"
 #include "Emulator/Libs/Libs.h"
@@ -64,6 +65,12 @@ struct PthreadAttrPrivate
 	pthread_attr_t p;
 };
 
+struct PthreadSpecific
+{
+	uint64_t seq;
+	void*    data;
+};
+
 struct PthreadPrivate
 {
 	uint8_t              reserved[4096];
@@ -77,6 +84,7 @@ struct PthreadPrivate
 	std::atomic_bool     detached;
 	std::atomic_bool     almost_done;
 	std::atomic_bool     free;
+	PthreadSpecific      specific_values[KEYS_MAX];
 };
 
 struct PthreadRwlockPrivate
@@ -132,6 +140,9 @@ public:
 	void  DeleteObjects(Loader::Program* program);
 
 private:
+	// m_mutex must be locked
+	void* Create(void* addr, PthreadStaticObject::Type type);
+
 	Vector<PthreadStaticObject*> m_objects;
 	Core::Mutex                  m_mutex;
 };
@@ -146,26 +157,20 @@ public:
 
 	bool Create(int* key, pthread_key_destructor_func_t destructor);
 	bool Delete(int key);
-	void Destruct(int thread_id);
-	bool Set(int key, int thread_id, void* data);
-	bool Get(int key, int thread_id, void** data);
+	void Destruct(Pthread thread);
+	bool Set(int key, void* data);
+	bool Get(int key, void** data);
 
 private:
-	struct Map
-	{
-		int   thread_id = -1;
-		void* data      = nullptr;
-	};
-
+	// The key is in use while the sequence number is odd. Every thread keeps its own values in PthreadPrivate and stores the
+	// sequence number next to each value, so a value set before the key was deleted never matches the key that reuses the slot.
 	struct Key
 	{
-		bool                          used       = false;
-		pthread_key_destructor_func_t destructor = nullptr;
-		Vector<Map>                   specific_values;
+		std::atomic_uint64_t                       seq {0};
+		std::atomic<pthread_key_destructor_func_t> destructor {nullptr};
 	};
 
-	Core::Mutex m_mutex;
-	Key         m_keys[KEYS_MAX];
+	Key m_keys[KEYS_MAX];
 };
 
 class PthreadPool
@@ -182,7 +187,7 @@ public:
 
 private:
 	Vector<Pthread> m_threads;
-	Core::Mutex     m_mutex;
+	Core::Mutex     m_mutex {Core::Mutex::Type::Recursive};
 };
 
 class PThreadContext
@@ -403,13 +408,19 @@ static void sec_to_timespec(KernelTimespec* ts, double sec)
 
 void* PthreadStaticObjects::CreateObject(void* addr, PthreadStaticObject::Type type)
 {
-	Core::LockGuard lock(m_mutex);
-
-	if (addr == nullptr || *static_cast<void**>(addr) != nullptr)
+	if (addr == nullptr)
 	{
 		return addr;
 	}
 
+	// The lock is taken only on the first use of the object
+	Core::LazyCreate(static_cast<std::atomic<void*>*>(addr), &m_mutex, [this, addr, type]() { return Create(addr, type); });
+
+	return addr;
+}
+
+void* PthreadStaticObjects::Create(void* addr, PthreadStaticObject::Type type)
+{
 	auto* rt      = Core::Singleton<Loader::RuntimeLinker>::Instance();
 	auto  vaddr   = reinterpret_cast<uint64_t>(addr);
 	auto* program = rt->FindProgramByAddr(vaddr);
@@ -423,12 +434,19 @@ void* PthreadStaticObjects::CreateObject(void* addr, PthreadStaticObject::Type t
 
 	String name = String::FromPrintf("Static%016" PRIx64, vaddr);
 
-	int result = OK;
+	void* object = nullptr;
+	int   result = OK;
 	switch (type)
 	{
-		case PthreadStaticObject::Type::Mutex: result = PthreadMutexInit(static_cast<PthreadMutex*>(addr), nullptr, name.C_Str()); break;
-		case PthreadStaticObject::Type::Cond: result = PthreadCondInit(static_cast<PthreadCond*>(addr), nullptr, name.C_Str()); break;
-		case PthreadStaticObject::Type::Rwlock: result = PthreadRwlockInit(static_cast<PthreadRwlock*>(addr), nullptr, name.C_Str()); break;
+		case PthreadStaticObject::Type::Mutex:
+			result = PthreadMutexInit(reinterpret_cast<PthreadMutex*>(&object), nullptr, name.C_Str());
+			break;
+		case PthreadStaticObject::Type::Cond:
+			result = PthreadCondInit(reinterpret_cast<PthreadCond*>(&object), nullptr, name.C_Str());
+			break;
+		case PthreadStaticObject::Type::Rwlock:
+			result = PthreadRwlockInit(reinterpret_cast<PthreadRwlock*>(&object), nullptr, name.C_Str());
+			break;
 		default: EXIT("unknown type: %d\n", static_cast<int>(type));
 	}
 
@@ -444,7 +462,7 @@ void* PthreadStaticObjects::CreateObject(void* addr, PthreadStaticObject::Type t
 		m_objects.Add(obj);
 	}
 
-	return addr;
+	return object;
 }
 
 void PthreadStaticObjects::DeleteObjects(Loader::Program* program)
@@ -514,16 +532,15 @@ bool PthreadKeys::Create(int* key, pthread_key_destructor_func_t destructor)
 {
 	EXIT_IF(key == nullptr);
 
-	Core::LockGuard lock(m_mutex);
-
 	for (int index = 0; index < KEYS_MAX; index++)
 	{
-		if (!m_keys[index].used)
+		auto& k   = m_keys[index];
+		auto  seq = k.seq.load(std::memory_order_relaxed);
+
+		if ((seq & 1u) == 0 && k.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel))
 		{
-			*key                     = index;
-			m_keys[index].used       = true;
-			m_keys[index].destructor = destructor;
-			m_keys[index].specific_values.Clear();
+			k.destructor.store(destructor, std::memory_order_release);
+			*key = index;
 			return true;
 		}
 	}
@@ -533,104 +550,110 @@ bool PthreadKeys::Create(int* key, pthread_key_destructor_func_t destructor)
 
 bool PthreadKeys::Delete(int key)
 {
-	Core::LockGuard lock(m_mutex);
-
-	if (key < 0 || key >= KEYS_MAX || !m_keys[key].used)
+	if (key < 0 || key >= KEYS_MAX)
 	{
 		return false;
 	}
 
-	m_keys[key].used       = false;
-	m_keys[key].destructor = nullptr;
-	m_keys[key].specific_values.Clear();
+	auto& k   = m_keys[key];
+	auto  seq = k.seq.load(std::memory_order_relaxed);
 
-	return true;
+	// Threads' values are not touched, the new sequence number makes them stale
+	return (seq & 1u) != 0 && k.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel);
 }
 
-void PthreadKeys::Destruct(int thread_id)
+void PthreadKeys::Destruct(Pthread thread)
 {
-	Core::LockGuard lock(m_mutex);
+	EXIT_IF(thread == nullptr);
 
-	struct CallInfo
-	{
-		pthread_key_destructor_func_t destructor;
-		void*                         data;
-	};
+	auto* values = thread->specific_values;
 
 	for (int iter = 0; iter < DESTRUCTOR_ITERATIONS; iter++)
 	{
-		Vector<CallInfo> delete_list;
+		bool called = false;
 
-		for (auto& key: m_keys)
+		for (int index = 0; index < KEYS_MAX; index++)
 		{
-			if (key.used && key.destructor != nullptr)
+			auto& v = values[index];
+
+			if (v.data == nullptr)
 			{
-				for (auto& v: key.specific_values)
-				{
-					if (v.thread_id == thread_id && v.data != nullptr)
-					{
-						delete_list.Add(CallInfo({key.destructor, v.data}));
-					}
-				}
+				continue;
 			}
-		}
 
-		if (delete_list.IsEmpty())
-		{
-			return;
+			auto& k          = m_keys[index];
+			auto  seq        = k.seq.load(std::memory_order_acquire);
+			auto  destructor = k.destructor.load(std::memory_order_acquire);
+			void* data       = v.data;
+
+			v.data = nullptr;
+
+			// The key may be deleted and created again between the loads, then the destructor belongs to the new key
+			if (v.seq == seq && (seq & 1u) != 0 && destructor != nullptr && k.seq.load(std::memory_order_acquire) == seq)
+			{
+				destructor(data);
+				called = true;
+			}
 		}
 
-		for (auto& d: delete_list)
+		if (!called)
 		{
-			d.destructor(d.data);
+			break;
 		}
 	}
+
+	// The pool reuses PthreadPrivate, don't leave values for the next thread
+	for (int index = 0; index < KEYS_MAX; index++)
+	{
+		values[index].data = nullptr;
+	}
 }
 
-bool PthreadKeys::Set(int key, int thread_id, void* data)
+bool PthreadKeys::Set(int key, void* data)
 {
-	Core::LockGuard lock(m_mutex);
-
-	if (key < 0 || key >= KEYS_MAX || !m_keys[key].used)
+	if (key < 0 || key >= KEYS_MAX)
 	{
 		return false;
 	}
 
-	for (auto& v: m_keys[key].specific_values)
+	auto seq = m_keys[key].seq.load(std::memory_order_acquire);
+
+	if ((seq & 1u) == 0)
 	{
-		if (v.thread_id == thread_id)
-		{
-			v.data = data;
-			return true;
-		}
+		return false;
 	}
 
-	m_keys[key].specific_values.Add(Map({thread_id, data}));
+	EXIT_NOT_IMPLEMENTED(g_pthread_self == nullptr);
+
+	auto& v = g_pthread_self->specific_values[key];
+
+	v.seq  = seq;
+	v.data = data;
 
 	return true;
 }
 
-bool PthreadKeys::Get(int key, int thread_id, void** data)
+bool PthreadKeys::Get(int key, void** data)
 {
 	EXIT_IF(data == nullptr);
 
-	Core::LockGuard lock(m_mutex);
-
-	if (key < 0 || key >= KEYS_MAX || !m_keys[key].used)
+	if (key < 0 || key >= KEYS_MAX)
 	{
 		return false;
 	}
 
-	for (auto& v: m_keys[key].specific_values)
+	auto seq = m_keys[key].seq.load(std::memory_order_acquire);
+
+	if ((seq & 1u) == 0)
 	{
-		if (v.thread_id == thread_id)
-		{
-			*data = v.data;
-			return true;
-		}
+		return false;
 	}
 
-	*data = nullptr;
+	EXIT_NOT_IMPLEMENTED(g_pthread_self == nullptr);
+
+	const auto& v = g_pthread_self->specific_values[key];
+
+	*data = (v.seq == seq ? v.data : nullptr);
 
 	return true;
 }
@@ -1923,6 +1946,9 @@ static void cleanup_thread(void* arg)
 		thread_dtors();
 	}
 
+	// Key destructors run in the exiting thread, so they see its own values
+	g_pthread_context->GetPthreadKeys()->Destruct(thread);
+
 	thread->almost_done = true;
 }
 
@@ -1935,6 +1961,8 @@ static void* run_thread(void* arg)
 
 	g_pthread_self = thread;
 
+	Core::VirtualMemory::ExceptionHandler::InstallAltStack();
+
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast)
 	pthread_cleanup_push(cleanup_thread, thread);
 
@@ -2061,8 +2089,6 @@ int KYTY_SYSV_ABI PthreadJoin(Pthread thread, void** value)
 	auto* rt = Core::Singleton<Loader::RuntimeLinker>::Instance();
 	rt->DeleteTlss(id);
 
-	g_pthread_context->GetPthreadKeys()->Destruct(id);
-
 	switch (result)
 	{
 		case 0: return OK;
@@ -2526,15 +2552,16 @@ int KYTY_SYSV_ABI PthreadSetspecific(PthreadKey key, void* value)
 {
 	PRINT_NAME();
 
-	int thread_id = Core::Thread::GetThreadIdUnique();
-
-	printf("\t key       = %d\n", key);
-	printf("\t thread_id = %d\n", thread_id);
-	printf("\t value     = %016" PRIx64 "\n", reinterpret_cast<uint64_t>(value));
+	if (PRINT_NAME_TRACED())
+	{
+		printf("\t key       = %d\n", key);
+		printf("\t thread_id = %d\n", Core::Thread::GetThreadIdUnique());
+		printf("\t value     = %016" PRIx64 "\n", reinterpret_cast<uint64_t>(value));
+	}
 
 	EXIT_IF(g_pthread_context == nullptr || g_pthread_context->GetPthreadKeys() == nullptr);
 
-	if (!g_pthread_context->GetPthreadKeys()->Set(key, thread_id, value))
+	if (!g_pthread_context->GetPthreadKeys()->Set(key, value))
 	{
 		return KERNEL_ERROR_EINVAL;
 	}
@@ -2546,21 +2573,25 @@ void* KYTY_SYSV_ABI PthreadGetspecific(PthreadKey key)
 {
 	PRINT_NAME();
 
-	int thread_id = Core::Thread::GetThreadIdUnique();
-
-	printf("\t key       = %d\n", key);
-	printf("\t thread_id = %d\n", thread_id);
+	if (PRINT_NAME_TRACED())
+	{
+		printf("\t key       = %d\n", key);
+		printf("\t thread_id = %d\n", Core::Thread::GetThreadIdUnique());
+	}
 
 	EXIT_IF(g_pthread_context == nullptr || g_pthread_context->GetPthreadKeys() == nullptr);
 
 	void* value = nullptr;
 
-	if (!g_pthread_context->GetPthreadKeys()->Get(key, thread_id, &value))
+	if (!g_pthread_context->GetPthreadKeys()->Get(key, &value))
 	{
 		return nullptr;
 	}
 
-	printf("\t value     = %016" PRIx64 "\n", reinterpret_cast<uint64_t>(value));
+	if (PRINT_NAME_TRACED())
+	{
+		printf("\t value     = %016" PRIx64 "\n", reinterpret_cast<uint64_t>(value));
+	}
 
 	return value;
 }
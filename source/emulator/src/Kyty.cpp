@@ -26,6 +26,7 @@
 #include "Emulator/Loader/Timer.h"
 #include "Emulator/Network.h"
 #include "Emulator/Profiler.h"
+#include "Emulator/Tests.h"
 
 #include <cstdlib>
 
@@ -400,6 +401,27 @@ KYTY_SCRIPT_FUNC(kyty_shader_printf)
 	return 0;
 }
 
+KYTY_SCRIPT_FUNC(kyty_trace)
+{
+	if (Scripts::ArgGetVarCount() != 2)
+	{
+		EXIT("invalid args\n");
+	}
+
+	auto library = Scripts::ArgGetVar(0).ToString();
+	auto enabled = Scripts::ArgGetVar(1).ToBool();
+
+	if (library == U"*")
+	{
+		Log::TraceEnableAll(enabled);
+	} else if (!Log::TraceEnable(library, enabled))
+	{
+		EXIT("unknown library: %s\n", library.C_Str());
+	}
+
+	return 0;
+}
+
 KYTY_SCRIPT_FUNC(kyty_run_tests)
 {
 	if (!UnitTest::unit_test_all())
@@ -410,6 +432,29 @@ KYTY_SCRIPT_FUNC(kyty_run_tests)
 	return 0;
 }
 
+#ifdef KYTY_EMU_TESTS
+KYTY_SCRIPT_FUNC(kyty_tile_benchmark)
+{
+	Libs::Graphics::TileBenchmark();
+
+	return 0;
+}
+
+KYTY_SCRIPT_FUNC(kyty_gpu_memory_stress_test)
+{
+	Libs::Graphics::GpuMemoryStressTest();
+
+	return 0;
+}
+
+KYTY_SCRIPT_FUNC(kyty_pthread_keys_test)
+{
+	Libs::LibKernel::PthreadKeysTest();
+
+	return 0;
+}
+#endif
+
 void kyty_help() {}
 
 } // namespace LuaFunc
@@ -428,7 +473,13 @@ void kyty_reg()
 	Scripts::RegisterFunc("kyty_mount", LuaFunc::kyty_mount_func, LuaFunc::kyty_help);
 	Scripts::RegisterFunc("kyty_shader_disable", LuaFunc::kyty_shader_disable, LuaFunc::kyty_help);
 	Scripts::RegisterFunc("kyty_shader_printf", LuaFunc::kyty_shader_printf, LuaFunc::kyty_help);
+	Scripts::RegisterFunc("kyty_trace", LuaFunc::kyty_trace, LuaFunc::kyty_help);
 	Scripts::RegisterFunc("kyty_run_tests", LuaFunc::kyty_run_tests, LuaFunc::kyty_help);
+#ifdef KYTY_EMU_TESTS
+	Scripts::RegisterFunc("kyty_tile_benchmark", LuaFunc::kyty_tile_benchmark, LuaFunc::kyty_help);
+	Scripts::RegisterFunc("kyty_gpu_memory_stress_test", LuaFunc::kyty_gpu_memory_stress_test, LuaFunc::kyty_help);
+	Scripts::RegisterFunc("kyty_pthread_keys_test", LuaFunc::kyty_pthread_keys_test, LuaFunc::kyty_help);
+#endif
 }
 
 #else
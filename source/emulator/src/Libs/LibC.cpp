@@ -6,17 +6,107 @@
 #include "Kyty/Core/String.h"
 
 #include "Emulator/Common.h"
+#include "Emulator/Config.h"
 #include "Emulator/Libs/Libs.h"
 #include "Emulator/Libs/Printf.h"
 #include "Emulator/Libs/VaContext.h"
 #include "Emulator/Loader/SymbolDatabase.h"
 
 #include <cstdlib>
+#include <cstring>
 
 #ifdef KYTY_EMU_ENABLED
 
 namespace Kyty::Libs {
 
+// Frequently called memory and string routines of the guest libc. Titles bundle versions tuned for the console CPU,
+// the host CRT selects the best variant for the host at runtime (AVX2, ERMS, ...). There is no PRINT_NAME() on purpose.
+namespace LibcHost {
+
+static KYTY_SYSV_ABI void* memcpy(void* dst, const void* src, size_t n)
+{
+	// Overlapping copies happen to work with the console version, some titles depend on it
+	return ::memmove(dst, src, n);
+}
+
+static KYTY_SYSV_ABI void* memmove(void* dst, const void* src, size_t n)
+{
+	return ::memmove(dst, src, n);
+}
+
+static KYTY_SYSV_ABI void* memset(void* s, int c, size_t n)
+{
+	return ::memset(s, c, n);
+}
+
+static KYTY_SYSV_ABI int memcmp(const void* s1, const void* s2, size_t n)
+{
+	return ::memcmp(s1, s2, n);
+}
+
+static KYTY_SYSV_ABI void* memchr(const void* s, int c, size_t n)
+{
+	return const_cast<void*>(::memchr(s, c, n));
+}
+
+static KYTY_SYSV_ABI size_t strlen(const char* s)
+{
+	return ::strlen(s);
+}
+
+static KYTY_SYSV_ABI size_t strnlen(const char* s, size_t maxlen)
+{
+	return ::strnlen(s, maxlen);
+}
+
+static KYTY_SYSV_ABI int strcmp(const char* s1, const char* s2)
+{
+	return ::strcmp(s1, s2);
+}
+
+static KYTY_SYSV_ABI int strncmp(const char* s1, const char* s2, size_t n)
+{
+	return ::strncmp(s1, s2, n);
+}
+
+static KYTY_SYSV_ABI char* strcpy(char* dst, const char* src)
+{
+	return ::strcpy(dst, src); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
+}
+
+static KYTY_SYSV_ABI char* strncpy(char* dst, const char* src, size_t n)
+{
+	return ::strncpy(dst, src, n);
+}
+
+static KYTY_SYSV_ABI char* strcat(char* dst, const char* src)
+{
+	return ::strcat(dst, src);
+}
+
+static KYTY_SYSV_ABI char* strchr(const char* s, int c)
+{
+	return const_cast<char*>(::strchr(s, c));
+}
+
+} // namespace LibcHost
+
+// NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
+#define LIBC_HOST_FUNCS(F)                                                                                                                 \
+	F("Q3VBxCXhUHs", LibcHost::memcpy)                                                                                                     \
+	F("+P6FRGH4LfA", LibcHost::memmove)                                                                                                    \
+	F("8zTFvBIAIN8", LibcHost::memset)                                                                                                     \
+	F("DfivPArhucg", LibcHost::memcmp)                                                                                                     \
+	F("8u8lPzUEq+U", LibcHost::memchr)                                                                                                     \
+	F("j4ViWNHEgww", LibcHost::strlen)                                                                                                     \
+	F("5jNubw4vlAA", LibcHost::strnlen)                                                                                                    \
+	F("Ovb2dSJOAuE", LibcHost::strcmp)                                                                                                     \
+	F("aesyjrHVWy4", LibcHost::strncmp)                                                                                                    \
+	F("kiZSXIWd9vg", LibcHost::strcpy)                                                                                                     \
+	F("6sJWiWSRuqk", LibcHost::strncpy)                                                                                                    \
+	F("Ls4tzzhimqQ", LibcHost::strcat)                                                                                                     \
+	F("ob5xAW4ln-0", LibcHost::strchr)
+
 namespace LibC {
 
 LIB_VERSION("libc", 1, "libc", 1, 1);
@@ -118,6 +208,12 @@ void KYTY_SYSV_ABI cxa_finalize(void* d)
 	}
 }
 
+// The bundled libc.prx exports the same functions, but HLE symbols are resolved first
+LIB_DEFINE(InitLibcHost_1)
+{
+	LIBC_HOST_FUNCS(LIB_FUNC);
+}
+
 } // namespace LibC
 
 namespace LibcInternalExt {
@@ -251,6 +347,13 @@ LIB_DEFINE(InitLibcInternal_1)
 
 	LIB_FUNC("-hn1tcVHq5Q", LibcInternal::LibcMspaceCreate);
 	LIB_FUNC("OJjm-QOIHlI", LibcInternal::LibcMspaceMalloc);
+
+	if (Config::LibcHostFunctionsEnabled())
+	{
+		LibC::InitLibcHost_1(s);
+
+		LIBC_HOST_FUNCS(LIB_FUNC);
+	}
 }
 
 } // namespace LibcInternal
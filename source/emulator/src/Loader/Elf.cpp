@@ -48,7 +48,7 @@ static void save_ehdr_64(Core::File& f, const Elf64_Ehdr* ehdr)
 {
 	EXIT_IF(ehdr == nullptr);
 
-	uint32_t bytes_written = 0;
+	uint64_t bytes_written = 0;
 
 	f.Write(ehdr, sizeof(Elf64_Ehdr), &bytes_written);
 
@@ -69,7 +69,7 @@ static void save_phdr_64(Core::File& f, uint64_t offset, Elf64_Half num, const E
 {
 	EXIT_IF(phdr == nullptr);
 
-	uint32_t bytes_written = 0;
+	uint64_t bytes_written = 0;
 
 	f.Seek(offset);
 	f.Write(phdr, sizeof(Elf64_Phdr) * num, &bytes_written);
@@ -101,7 +101,7 @@ static void save_shdr_64(Core::File& f, uint64_t offset, Elf64_Half num, const E
 
 	EXIT_IF(shdr == nullptr);
 
-	uint32_t bytes_written = 0;
+	uint64_t bytes_written = 0;
 
 	f.Seek(offset);
 	f.Write(shdr, sizeof(Elf64_Shdr) * num, &bytes_written);
@@ -385,14 +385,14 @@ void Elf64::DbgDump(const String& folder)
 		Core::File fout;
 		fout.Create(folder_str + str);
 
-		auto* buf = new char[static_cast<uint32_t>(m_phdr[i].p_filesz)];
+		auto* buf = new char[m_phdr[i].p_filesz];
 
 		// m_f->Seek(m_phdr[i].p_offset);
-		// m_f->Read(buf, static_cast<uint32_t>(m_phdr[i].p_filesz));
+		// m_f->Read(buf, m_phdr[i].p_filesz);
 
 		LoadSegment(reinterpret_cast<uint64_t>(buf), m_phdr[i].p_offset, m_phdr[i].p_filesz);
 
-		fout.Write(buf, static_cast<uint32_t>(m_phdr[i].p_filesz));
+		fout.Write(buf, m_phdr[i].p_filesz);
 
 		delete[] buf;
 
@@ -413,11 +413,11 @@ void Elf64::DbgDump(const String& folder)
 		Core::File fout;
 		fout.Create(folder_str + str);
 
-		auto* buf = new char[static_cast<uint32_t>(m_shdr[i].sh_size)];
+		auto* buf = new char[m_shdr[i].sh_size];
 
 		m_f->Seek(m_shdr[i].sh_offset);
-		m_f->Read(buf, static_cast<uint32_t>(m_shdr[i].sh_size));
-		fout.Write(buf, static_cast<uint32_t>(m_shdr[i].sh_size));
+		m_f->Read(buf, m_shdr[i].sh_size);
+		fout.Write(buf, m_shdr[i].sh_size);
 
 		delete[] buf;
 
@@ -667,14 +667,14 @@ void Elf64::Save(const String& file_name)
 				continue;
 			}
 
-			auto* buf = new char[static_cast<uint32_t>(m_phdr[i].p_filesz)];
+			auto* buf = new char[m_phdr[i].p_filesz];
 
 			LoadSegment(reinterpret_cast<uint64_t>(buf), m_phdr[i].p_offset, m_phdr[i].p_filesz);
 
-			uint32_t bytes_written = 0;
+			uint64_t bytes_written = 0;
 
 			f.Seek(m_phdr[i].p_offset);
-			f.Write(buf, static_cast<uint32_t>(m_phdr[i].p_filesz), &bytes_written);
+			f.Write(buf, m_phdr[i].p_filesz, &bytes_written);
 
 			EXIT_IF(bytes_written == 0);
 
@@ -688,15 +688,15 @@ void Elf64::Save(const String& file_name)
 				continue;
 			}
 
-			auto* buf = new char[static_cast<uint32_t>(m_shdr[i].sh_size)];
+			auto* buf = new char[m_shdr[i].sh_size];
 
 			m_f->Seek(m_shdr[i].sh_offset);
-			m_f->Read(buf, static_cast<uint32_t>(m_shdr[i].sh_size));
+			m_f->Read(buf, m_shdr[i].sh_size);
 
-			uint32_t bytes_written = 0;
+			uint64_t bytes_written = 0;
 
 			f.Seek(m_shdr[i].sh_offset);
-			f.Write(buf, static_cast<uint32_t>(m_shdr[i].sh_size), &bytes_written);
+			f.Write(buf, m_shdr[i].sh_size, &bytes_written);
 
 			EXIT_IF(bytes_written == 0);
 
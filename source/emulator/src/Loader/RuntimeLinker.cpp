@@ -7,6 +7,7 @@
 #include "Kyty/Core/Singleton.h"
 #include "Kyty/Core/String.h"
 #include "Kyty/Core/Threads.h"
+#include "Kyty/Core/Timer.h"
 #include "Kyty/Core/VirtualMemory.h"
 #include "Kyty/Sys/SysDbg.h"
 
@@ -18,6 +19,14 @@
 #include "Emulator/Loader/SymbolDatabase.h"
 #include "Emulator/Profiler.h"
 
+#if KYTY_PLATFORM == KYTY_PLATFORM_WINDOWS
+#include <windows.h> // IWYU pragma: keep
+// IWYU pragma: no_include <processthreadsapi.h>
+#endif
+
+#include <algorithm>
+#include <thread>
+
 #ifdef KYTY_EMU_ENABLED
 
 namespace Kyty::Libs::LibKernel {
@@ -85,6 +94,55 @@ static Program* g_tls_main_program = nullptr;
 alignas(64) static uint8_t g_tls_reg_save_area[XSAVE_BUFFER_SIZE + sizeof(XSAVE_CHK_GUARD)];
 static uint8_t g_tls_spinlock = 0;
 
+// Per-thread TLS base of the main program. Guest code reads it directly via fs/gs (see Jit::TlsCall),
+// the slow path (SafeCall) fills it on the first access from a thread.
+#if KYTY_PLATFORM == KYTY_PLATFORM_WINDOWS
+// TEB.TlsSlots[64] is at gs:[0x1480]
+constexpr int32_t TEB_TLS_SLOTS_OFFSET = 0x1480;
+constexpr DWORD   TEB_TLS_SLOTS_NUM    = 64;
+
+static DWORD g_tls_main_slot = TLS_OUT_OF_INDEXES;
+
+static void TlsMainSlotInit()
+{
+	g_tls_main_slot = TlsAlloc();
+
+	EXIT_NOT_IMPLEMENTED(g_tls_main_slot >= TEB_TLS_SLOTS_NUM);
+}
+
+static int32_t TlsMainSlotGetOffset()
+{
+	return TEB_TLS_SLOTS_OFFSET + static_cast<int32_t>(g_tls_main_slot * sizeof(void*));
+}
+
+static void TlsMainSlotSet(uint8_t* base)
+{
+	TlsSetValue(g_tls_main_slot, base);
+}
+#else
+// initial-exec keeps the variable in the static TLS block at a constant offset from fs:[0]
+static thread_local uint8_t* g_tls_main_base __attribute__((tls_model("initial-exec"))) = nullptr;
+
+static void TlsMainSlotInit() {}
+
+static int32_t TlsMainSlotGetOffset()
+{
+	uint64_t thread_pointer = 0;
+	asm volatile("mov %%fs:0, %0" : "=r"(thread_pointer));
+
+	auto offset = static_cast<int64_t>(reinterpret_cast<uint64_t>(&g_tls_main_base) - thread_pointer);
+
+	EXIT_NOT_IMPLEMENTED(offset < INT32_MIN || offset > INT32_MAX);
+
+	return static_cast<int32_t>(offset);
+}
+
+static void TlsMainSlotSet(uint8_t* base)
+{
+	g_tls_main_base = base;
+}
+#endif
+
 static KYTY_SYSV_ABI void run_entry(uint64_t addr, EntryParams* params, atexit_func_t atexit_func)
 {
 	reinterpret_cast<entry_func_t>(addr)(params, atexit_func);
@@ -202,15 +260,19 @@ void KYTY_SYSV_ABI sys_stack_walk_x86(uint64_t rbp, void** stack, int* depth)
 
 static void kyty_exception_handler(const Core::VirtualMemory::ExceptionHandler::ExceptionInfo* info)
 {
+	// Reads fault on pages which wait for a GPU write-back
+	if (info->type == Core::VirtualMemory::ExceptionHandler::ExceptionType::AccessViolation &&
+	    (info->access_violation_type == Core::VirtualMemory::ExceptionHandler::AccessViolationType::Write ||
+	     info->access_violation_type == Core::VirtualMemory::ExceptionHandler::AccessViolationType::Read) &&
+	    Libs::Graphics::GpuMemoryCheckAccessViolation(info->access_violation_vaddr, sizeof(uint64_t)))
+	{
+		return;
+	}
+
 	printf("kyty_exception_handler: %016" PRIx64 "\n", info->exception_address);
 
 	if (info->type == Core::VirtualMemory::ExceptionHandler::ExceptionType::AccessViolation)
 	{
-		if (info->access_violation_type == Core::VirtualMemory::ExceptionHandler::AccessViolationType::Write &&
-		    Libs::Graphics::GpuMemoryCheckAccessViolation(info->access_violation_vaddr, sizeof(uint64_t)))
-		{
-			return;
-		}
 
 		if (info->rbp != 0)
 		{
@@ -310,6 +372,7 @@ static void get_dyn_modules(Elf64* elf, T* out, const char* names, Elf64_Sxword
 		id.version_major = static_cast<int>((need >> 40u) & 0xffu);
 		id.version_minor = static_cast<int>((need >> 32u) & 0xffu);
 		id.name          = names + (need & 0xffffffff);
+		id.key           = SymbolDatabase::GenerateModuleKey(id.name, id.version_major, id.version_minor);
 		out->Add(id);
 	}
 }
@@ -326,11 +389,13 @@ static void get_dyn_libs(Elf64* elf, T* out, const char* names, Elf64_Sxword tag
 		encode_id_64(static_cast<uint16_t>((need >> 48u) & 0xffffu), &id.id);
 		id.version = static_cast<int>((need >> 32u) & 0xffffu);
 		id.name    = names + (need & 0xffffffff);
+		id.key     = SymbolDatabase::GenerateLibraryKey(id.name, id.version);
 		out->Add(id);
 	}
 }
 
-static RelocationInfo GetRelocationInfo(Elf64_Rela* r, Program* program)
+// With lock == false the caller must hold the linker lock, relocation workers rely on RelocateAll
+static RelocationInfo GetRelocationInfo(Elf64_Rela* r, Program* program, bool lock = true)
 {
 	KYTY_PROFILER_FUNCTION();
 
@@ -385,7 +450,13 @@ static RelocationInfo GetRelocationInfo(Elf64_Rela* r, Program* program)
 				{
 					ret.bind = (ret.bind == BindType::Unknown ? BindType::Weak : ret.bind);
 					ret.name = names + sym.st_name;
-					program->rt->Resolve(ret.name, ret.type, program, &sr, &ret.bind_self);
+					if (lock)
+					{
+						program->rt->Resolve(ret.name, ret.type, program, &sr, &ret.bind_self);
+					} else
+					{
+						program->rt->ResolveNoLock(ret.name, ret.type, program, &sr, &ret.bind_self);
+					}
 					symbol_vaddr = sr.vaddr;
 				}
 				break;
@@ -416,12 +487,10 @@ static RelocationInfo GetRelocationInfo(Elf64_Rela* r, Program* program)
 	return ret;
 }
 
-static void relocate(uint32_t index, Elf64_Rela* r, Program* program, bool jmprela_table)
+static void patch(uint32_t index, const RelocationInfo& ri, Program* program, bool jmprela_table)
 {
 	KYTY_PROFILER_FUNCTION();
 
-	auto ri = GetRelocationInfo(r, program);
-
 	[[maybe_unused]] bool patched = false;
 
 	// KYTY_PROFILER_BLOCK("patch");
@@ -480,15 +549,65 @@ static void relocate(uint32_t index, Elf64_Rela* r, Program* program, bool jmpre
 	}
 }
 
-static void relocate_all(Elf64_Rela* records, uint64_t size, Program* program, bool jmprela_table)
+struct RelocationChunk
+{
+	Elf64_Rela*     records = nullptr;
+	RelocationInfo* infos   = nullptr;
+	uint32_t        num     = 0;
+	Program*        program = nullptr;
+};
+
+static void resolve_chunk(void* arg)
+{
+	KYTY_PROFILER_FUNCTION();
+
+	const auto* chunk = static_cast<const RelocationChunk*>(arg);
+
+	for (uint32_t i = 0; i < chunk->num; i++)
+	{
+		chunk->infos[i] = GetRelocationInfo(chunk->records + i, chunk->program, false);
+	}
+}
+
+// Symbol lookups are independent and read only, so records are resolved by several threads. Patching stays serial, it
+// changes page protection around every write and keeps the original order of errors and debug output.
+static uint32_t resolve_all(Elf64_Rela* records, uint32_t num, Program* program, RelocationInfo* infos)
 {
 	KYTY_PROFILER_FUNCTION();
 
-	uint32_t index = 0;
-	for (auto* r = records; reinterpret_cast<uint8_t*>(r) < reinterpret_cast<uint8_t*>(records) + size; r++, index++)
+	static constexpr uint32_t THREADS_MAX = 8;
+	static constexpr uint32_t CHUNK_MIN   = 1024;
+
+	uint32_t threads_num = std::min({std::max(std::thread::hardware_concurrency(), 1u), THREADS_MAX, (num + CHUNK_MIN - 1) / CHUNK_MIN});
+
+	RelocationChunk chunks[THREADS_MAX];
+	Core::Thread*   threads[THREADS_MAX] {};
+
+	uint32_t chunk_size = (threads_num == 0 ? 0 : (num + threads_num - 1) / threads_num);
+
+	for (uint32_t i = 0; i < threads_num; i++)
+	{
+		uint32_t start = i * chunk_size;
+		chunks[i]      = {records + start, infos + start, std::min(chunk_size, num - start), program};
+	}
+
+	for (uint32_t i = 1; i < threads_num; i++)
+	{
+		threads[i] = new Core::Thread(resolve_chunk, &chunks[i]);
+	}
+
+	if (threads_num > 0)
 	{
-		relocate(index, r, program, jmprela_table);
+		resolve_chunk(&chunks[0]);
 	}
+
+	for (uint32_t i = 1; i < threads_num; i++)
+	{
+		threads[i]->Join();
+		delete threads[i];
+	}
+
+	return threads_num;
 }
 
 static KYTY_SYSV_ABI void RelocateHandler(RelocateHandlerStack s)
@@ -523,7 +642,12 @@ static KYTY_MS_ABI uint8_t* TlsMainGetAddr()
 		EXIT("xsave buffer is too small\n");
 	}
 
-	return RuntimeLinker::TlsGetAddr(g_tls_main_program) + g_tls_main_program->tls.image_size;
+	uint8_t* base = RuntimeLinker::TlsGetAddr(g_tls_main_program) + g_tls_main_program->tls.image_size;
+
+	// The buffer lives until the thread is joined, so next accesses can skip the lookup
+	TlsMainSlotSet(base);
+
+	return base;
 }
 
 static void PatchProgram(Program* program, uint64_t address, uint64_t size)
@@ -653,12 +777,17 @@ void RuntimeLinker::RelocateAll()
 
 	Core::LockGuard lock(m_mutex);
 
+	Core::Timer timer;
+	timer.Start();
+
 	for (auto* p: m_programs)
 	{
 		Relocate(p);
 	}
 
 	m_relocated = true;
+
+	printf("--- Relocate all: %.2f ms ---\n", timer.GetTimeMs());
 }
 
 void RuntimeLinker::UnloadProgram(Program* program)
@@ -702,6 +831,9 @@ Program* RuntimeLinker::LoadProgram(const String& elf_name)
 
 	printf("Loading: %s\n", elf_name.C_Str());
 
+	Core::Timer timer;
+	timer.Start();
+
 	auto* program = new Program;
 
 	program->rt        = this;
@@ -737,6 +869,8 @@ Program* RuntimeLinker::LoadProgram(const String& elf_name)
 		program->fail_if_global_not_resolved = false;
 	}
 
+	printf("Loaded: %s, %.2f ms\n", elf_name.FilenameWithoutDirectory().C_Str(), timer.GetTimeMs());
+
 	return program;
 }
 
@@ -833,10 +967,15 @@ void RuntimeLinker::Clear()
 
 void RuntimeLinker::Resolve(const String& name, SymbolType type, Program* program, SymbolRecord* out_info, bool* bind_self)
 {
-	KYTY_PROFILER_FUNCTION();
-
 	Core::LockGuard lock(m_mutex);
 
+	ResolveNoLock(name, type, program, out_info, bind_self);
+}
+
+void RuntimeLinker::ResolveNoLock(const String& name, SymbolType type, Program* program, SymbolRecord* out_info, bool* bind_self)
+{
+	KYTY_PROFILER_FUNCTION();
+
 	EXIT_IF(out_info == nullptr);
 
 	auto ids = name.Split(U'#');
@@ -853,27 +992,20 @@ void RuntimeLinker::Resolve(const String& name, SymbolType type, Program* progra
 
 		if (l != nullptr && m != nullptr)
 		{
-			SymbolResolve sr {};
-			sr.name                 = ids.At(0);
-			sr.library              = l->name;
-			sr.library_version      = l->version;
-			sr.module               = m->name;
-			sr.module_version_major = m->version_major;
-			sr.module_version_minor = m->version_minor;
-			sr.type                 = type;
+			auto key = SymbolDatabase::GenerateKey(l->key, m->key, ids.At(0), type);
 
 			const SymbolRecord* rec = nullptr;
 
 			if (m_symbols != nullptr)
 			{
-				rec = m_symbols->Find(sr);
+				rec = m_symbols->Find(key);
 			}
 
 			if (rec == nullptr)
 			{
 				if (auto* p = FindProgram(*m, *l); p != nullptr && p->export_symbols != nullptr)
 				{
-					rec = p->export_symbols->Find(sr);
+					rec = p->export_symbols->Find(key);
 					if (bind_self != nullptr)
 					{
 						*bind_self = (p == program);
@@ -887,6 +1019,15 @@ void RuntimeLinker::Resolve(const String& name, SymbolType type, Program* progra
 				*out_info = *rec;
 			} else
 			{
+				SymbolResolve sr {};
+				sr.name                 = ids.At(0);
+				sr.library              = l->name;
+				sr.library_version      = l->version;
+				sr.module               = m->name;
+				sr.module_version_major = m->version_major;
+				sr.module_version_minor = m->version_minor;
+				sr.type                 = type;
+
 				out_info->vaddr    = 0;
 				out_info->name     = SymbolDatabase::GenerateName(sr);
 				out_info->dbg_name = U"";
@@ -1001,6 +1142,9 @@ void RuntimeLinker::StartAllModules()
 
 	Core::LockGuard lock(m_mutex);
 
+	Core::Timer timer;
+	timer.Start();
+
 	for (auto* p: m_programs)
 	{
 		if (p->elf->IsShared())
@@ -1008,6 +1152,8 @@ void RuntimeLinker::StartAllModules()
 			StartModule(p, 0, nullptr, nullptr);
 		}
 	}
+
+	printf("--- Start all modules: %.2f ms ---\n", timer.GetTimeMs());
 }
 
 void RuntimeLinker::StopAllModules()
@@ -1138,7 +1284,7 @@ void RuntimeLinker::LoadProgramToMemory(Program* program)
 	program->base_size_aligned = (program->base_size & ~(static_cast<uint64_t>(0x1000) - 1)) + 0x1000;
 
 	uint64_t exception_handler_size = Core::VirtualMemory::ExceptionHandler::GetSize();
-	uint64_t tls_handler_size       = is_shared ? 0 : Jit::SafeCall::GetSize();
+	uint64_t tls_handler_size       = is_shared ? 0 : Jit::TlsCall::GetSize();
 	uint64_t alloc_size             = program->base_size_aligned + exception_handler_size + tls_handler_size;
 
 	program->base_vaddr = Core::VirtualMemory::Alloc(g_desired_base_addr, alloc_size, Core::VirtualMemory::Mode::ExecuteReadWrite);
@@ -1432,14 +1578,36 @@ void RuntimeLinker::Relocate(Program* program)
 
 	InstallRelocateHandler(program);
 
-	relocate_all(program->dynamic_info->rela_table, program->dynamic_info->rela_table_total_size, program, false);
-	relocate_all(program->dynamic_info->jmprela_table, program->dynamic_info->jmprela_table_size, program, true);
+	auto rela_num    = static_cast<uint32_t>(program->dynamic_info->rela_table_total_size / sizeof(Elf64_Rela));
+	auto jmprela_num = static_cast<uint32_t>(program->dynamic_info->jmprela_table_size / sizeof(Elf64_Rela));
+
+	Vector<RelocationInfo> rela_infos(rela_num);
+	Vector<RelocationInfo> jmprela_infos(jmprela_num);
+
+	Core::Timer timer;
+	timer.Start();
+
+	uint32_t rela_threads    = resolve_all(program->dynamic_info->rela_table, rela_num, program, rela_infos.GetData());
+	uint32_t jmprela_threads = resolve_all(program->dynamic_info->jmprela_table, jmprela_num, program, jmprela_infos.GetData());
+
+	double resolve_time = timer.GetTimeMs();
+	timer.Start();
+
+	for (uint32_t index = 0; index < rela_num; index++)
+	{
+		patch(index, rela_infos.At(index), program, false);
+	}
+	for (uint32_t index = 0; index < jmprela_num; index++)
+	{
+		patch(index, jmprela_infos.At(index), program, true);
+	}
+
+	printf("Relocated: %u records, %u threads, resolve: %.2f ms, patch: %.2f ms\n", rela_num + jmprela_num,
+	       std::max(rela_threads, jmprela_threads), resolve_time, timer.GetTimeMs());
 }
 
 Program* RuntimeLinker::FindProgram(const ModuleId& m, const LibraryId& l)
 {
-	Core::LockGuard lock(m_mutex);
-
 	for (auto* p: m_programs)
 	{
 		const auto& export_libs    = p->dynamic_info->export_libs;
@@ -1563,17 +1731,23 @@ void RuntimeLinker::SetupTlsHandler(Program* program)
 
 	g_tls_main_program = program;
 
-	auto* code = new (reinterpret_cast<void*>(program->tls.handler_vaddr)) Jit::SafeCall;
+	TlsMainSlotInit();
+
+	auto* code = new (reinterpret_cast<void*>(program->tls.handler_vaddr)) Jit::TlsCall;
+
+	code->SetSlotOffset(TlsMainSlotGetOffset());
 
 	memset(g_tls_reg_save_area, 0, XSAVE_BUFFER_SIZE);
 	std::memcpy(&g_tls_reg_save_area[XSAVE_BUFFER_SIZE], &XSAVE_CHK_GUARD, sizeof(XSAVE_CHK_GUARD));
 
-	code->SetFunc(TlsMainGetAddr);
-	code->SetRegSaveArea(g_tls_reg_save_area);
-	code->SetLockVar(&g_tls_spinlock);
+	auto* slow_call = code->GetSlowCall();
+
+	slow_call->SetFunc(TlsMainGetAddr);
+	slow_call->SetRegSaveArea(g_tls_reg_save_area);
+	slow_call->SetLockVar(&g_tls_spinlock);
 
-	Core::VirtualMemory::Protect(program->tls.handler_vaddr, Jit::SafeCall::GetSize(), Core::VirtualMemory::Mode::Execute);
-	Core::VirtualMemory::FlushInstructionCache(program->tls.handler_vaddr, Jit::SafeCall::GetSize());
+	Core::VirtualMemory::Protect(program->tls.handler_vaddr, Jit::TlsCall::GetSize(), Core::VirtualMemory::Mode::Execute);
+	Core::VirtualMemory::FlushInstructionCache(program->tls.handler_vaddr, Jit::TlsCall::GetSize());
 }
 
 void RuntimeLinker::DeleteTlss(int thread_id)
@@ -1,5 +1,6 @@
 #include "Emulator/Loader/SymbolDatabase.h"
 
+#include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/File.h"
 #include "Kyty/Core/MagicEnum.h"
 #include "Kyty/Core/Vector.h"
@@ -29,13 +30,76 @@ String SymbolDatabase::GenerateName(const SymbolResolve& s)
 	                          s.module_version_major, s.module_version_minor, Core::EnumName(s.type).C_Str());
 }
 
+// FNV-1a
+constexpr uint64_t KEY_BASIS = 0xcbf29ce484222325;
+constexpr uint64_t KEY_PRIME = 0x00000100000001b3;
+
+static uint64_t key_add(uint64_t key, uint64_t value)
+{
+	for (int i = 0; i < 8; i++, value >>= 8u)
+	{
+		key = (key ^ (value & 0xffu)) * KEY_PRIME;
+	}
+	return key;
+}
+
+static uint64_t key_add(uint64_t key, const String& str)
+{
+	for (auto ch: str)
+	{
+		key = (key ^ static_cast<uint64_t>(ch)) * KEY_PRIME;
+	}
+	// Terminator, so "ab" + "c" and "a" + "bc" differ
+	return (key ^ 0xffu) * KEY_PRIME;
+}
+
+uint64_t SymbolDatabase::GenerateLibraryKey(const String& library, int library_version)
+{
+	return key_add(key_add(KEY_BASIS, update_name(library)), static_cast<uint64_t>(library_version));
+}
+
+uint64_t SymbolDatabase::GenerateModuleKey(const String& module, int module_version_major, int module_version_minor)
+{
+	return key_add(key_add(key_add(KEY_BASIS, update_name(module)), static_cast<uint64_t>(module_version_major)),
+	               static_cast<uint64_t>(module_version_minor));
+}
+
+uint64_t SymbolDatabase::GenerateKey(uint64_t library_key, uint64_t module_key, const String& name, SymbolType type)
+{
+	return key_add(key_add(key_add(key_add(KEY_BASIS, name), library_key), module_key), static_cast<uint64_t>(type));
+}
+
+uint64_t SymbolDatabase::GenerateKey(const SymbolResolve& s)
+{
+	return GenerateKey(GenerateLibraryKey(s.library, s.library_version),
+	                   GenerateModuleKey(s.module, s.module_version_major, s.module_version_minor), s.name, s.type);
+}
+
+void SymbolDatabase::Add(const SymbolResolve& s, SymbolRecord* r)
+{
+	auto key   = GenerateKey(s);
+	auto index = m_map.Get(key, decltype(m_symbols)::INVALID_INDEX);
+
+	if (m_symbols.IndexValid(index))
+	{
+		if (m_symbols.At(index).name != r->name)
+		{
+			EXIT("symbol key collision: %s, %s\n", m_symbols.At(index).name.C_Str(), r->name.C_Str());
+		}
+		m_symbols[index] = *r;
+	} else
+	{
+		m_map.Put(key, m_symbols.Size());
+		m_symbols.Add(*r);
+	}
+}
+
 void SymbolDatabase::Add(const SymbolResolve& s, uint64_t vaddr)
 {
 	SymbolRecord r {};
 	r.name  = GenerateName(s);
 	r.vaddr = vaddr;
-	m_map.Put(r.name, m_symbols.Size());
-	m_symbols.Add(r);
+	Add(s, &r);
 }
 
 void SymbolDatabase::Add(const SymbolResolve& s, uint64_t vaddr, const String& dbg_name)
@@ -44,8 +108,7 @@ void SymbolDatabase::Add(const SymbolResolve& s, uint64_t vaddr, const String& d
 	r.name     = GenerateName(s);
 	r.vaddr    = vaddr;
 	r.dbg_name = dbg_name;
-	m_map.Put(r.name, m_symbols.Size());
-	m_symbols.Add(r);
+	Add(s, &r);
 }
 
 void SymbolDatabase::DbgDump(const String& folder, const String& file_name)
@@ -67,7 +130,12 @@ void SymbolDatabase::DbgDump(const String& folder, const String& file_name)
 
 const SymbolRecord* SymbolDatabase::Find(const SymbolResolve& s) const
 {
-	auto index = m_map.Get(GenerateName(s), decltype(m_symbols)::INVALID_INDEX);
+	return Find(GenerateKey(s));
+}
+
+const SymbolRecord* SymbolDatabase::Find(uint64_t key) const
+{
+	auto index = m_map.Get(key, decltype(m_symbols)::INVALID_INDEX);
 	if (!m_symbols.IndexValid(index))
 	{
 		return nullptr;
@@ -43,7 +43,7 @@ private:
 	};
 
 	Core::File  m_f;
-	Core::Mutex m_mutex;
+	Core::Mutex m_mutex {Core::Mutex::Type::Recursive};
 	bool        m_opened           = false;
 	uint32_t    m_name_tbl_offset  = 0;
 	uint32_t    m_value_tbl_offset = 0;
@@ -71,7 +71,7 @@ public:
 
 private:
 	Core::File  m_f;
-	Core::Mutex m_mutex;
+	Core::Mutex m_mutex {Core::Mutex::Type::Recursive};
 	bool        m_opened     = false;
 	uint16_t    m_chunks_num = 0;
 };
@@ -1,5 +1,6 @@
 #include "Emulator/Log.h"
 
+#include "Kyty/Core/DateTime.h"
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/File.h"
 #include "Kyty/Core/String.h"
@@ -9,6 +10,16 @@
 
 #include "Emulator/Common.h"
 #include "Emulator/Config.h"
+#include "Emulator/Loader/Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #if KYTY_PLATFORM == KYTY_PLATFORM_WINDOWS
 #include <windows.h> // IWYU pragma: keep
@@ -32,6 +43,7 @@ static Core::File*              g_file               = nullptr;
 static bool                     g_colored_printf     = false;
 static thread_local Core::File* g_thread_local_file  = nullptr;
 static Vector<Core::File*>*     g_thread_local_files = nullptr;
+static TraceSwitch*             g_trace_switches     = nullptr;
 
 static bool EnableVTMode()
 {
@@ -85,10 +97,840 @@ String RemoveColors(const String& str)
 	return ret;
 }
 
+// Asynchronous log.
+// Every printing thread owns a ring buffer. A record keeps the format string and the raw arguments,
+// the writer thread collects records from all rings, restores their order and does the formatting and I/O.
+
+static constexpr uint32_t RING_SIZE        = 256 * 1024;
+static constexpr uint32_t RECORD_MAX_SIZE  = 2048;
+static constexpr uint32_t WRITER_PERIOD_US = 10000;
+
+enum class RecordType : uint16_t
+{
+	Wrap,
+	Text,
+	Binary,
+	Trace
+};
+
+struct RecordHeader
+{
+	uint32_t   size = 0; // With the header, multiple of 8
+	RecordType type = RecordType::Wrap;
+	uint16_t   emu  = 0; // emu_printf: printed to the console regardless of the direction
+	uint64_t   seq  = 0;
+};
+
+struct TraceRecord
+{
+	int         thread_id = 0;
+	double      time_ms   = 0.0;
+	const char* library   = nullptr;
+	const char* module    = nullptr;
+	const char* func      = nullptr;
+};
+
+static Core::File* OpenThreadLocalFile(int thread_id);
+
+struct LogRing
+{
+	explicit LogRing(int id): thread_id(id) {}
+
+	alignas(64) std::atomic_uint64_t head {0}; // Written by the owner thread
+	alignas(64) std::atomic_uint64_t tail {0}; // Written by the writer thread
+	std::atomic_bool                 orphan {false};
+	int                              thread_id;
+	Core::File*                      file = nullptr;
+	alignas(8) uint8_t data[RING_SIZE] {};
+};
+
+struct LogRingOwner
+{
+	LogRingOwner() = default;
+	~LogRingOwner()
+	{
+		if (ring != nullptr)
+		{
+			ring->orphan = true;
+			ring         = nullptr;
+		}
+	}
+
+	KYTY_CLASS_NO_COPY(LogRingOwner);
+
+	LogRing* ring = nullptr;
+};
+
+static std::atomic_bool          g_async {false};
+static std::atomic_uint64_t      g_seq {0};
+static Vector<LogRing*>*         g_rings        = nullptr;
+static Core::Thread*             g_writer       = nullptr;
+static Core::Mutex*              g_writer_mutex = nullptr;
+static Core::CondVar*            g_writer_cond  = nullptr;
+static bool                      g_writer_wake  = false;
+static bool                      g_writer_stop  = false;
+static std::atomic_int           g_writer_id {-1};
+static thread_local LogRingOwner g_ring_owner;
+
+class RecordBuilder
+{
+public:
+	RecordBuilder(RecordType type, bool emu)
+	{
+		auto* header = GetHeader();
+		header->type = type;
+		header->emu  = (emu ? 1 : 0);
+	}
+
+	template <class T>
+	void Add(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		if (Reserve(sizeof(T)))
+		{
+			memcpy(m_data + m_size, &value, sizeof(T));
+			m_size += Align(sizeof(T));
+		}
+	}
+
+	void AddString(const char* str, uint32_t len)
+	{
+		Add(len);
+		Add(static_cast<uint32_t>(str == nullptr ? 1 : 0));
+		if (Reserve(len + 1))
+		{
+			if (len != 0)
+			{
+				memcpy(m_data + m_size, str, len);
+			}
+			m_data[m_size + len] = 0;
+			m_size += Align(len + 1);
+		}
+	}
+
+	[[nodiscard]] bool IsOverflow() const { return m_overflow; }
+
+	RecordHeader* Finish()
+	{
+		EXIT_IF(m_overflow);
+
+		auto* header = GetHeader();
+		header->size = m_size;
+		return header;
+	}
+
+	KYTY_CLASS_NO_COPY(RecordBuilder);
+
+private:
+	static constexpr uint32_t Align(uint32_t size) { return (size + 7u) & ~7u; }
+
+	RecordHeader* GetHeader() { return reinterpret_cast<RecordHeader*>(m_data); }
+
+	bool Reserve(uint32_t size)
+	{
+		if (m_overflow || Align(size) > RECORD_MAX_SIZE - m_size)
+		{
+			m_overflow = true;
+			return false;
+		}
+		return true;
+	}
+
+	// Not cleared: only the written part is copied to the ring
+	alignas(8) uint8_t m_data[RECORD_MAX_SIZE];
+	uint32_t m_size     = sizeof(RecordHeader);
+	bool     m_overflow = false;
+};
+
+class RecordReader
+{
+public:
+	explicit RecordReader(const RecordHeader* header): m_data(reinterpret_cast<const uint8_t*>(header)) {}
+
+	template <class T>
+	T Get()
+	{
+		T value {};
+		memcpy(&value, m_data + m_pos, sizeof(T));
+		m_pos += Align(sizeof(T));
+		return value;
+	}
+
+	const char* GetString()
+	{
+		auto len     = Get<uint32_t>();
+		auto is_null = Get<uint32_t>();
+		auto pos     = m_pos;
+		m_pos += Align(len + 1);
+		return (is_null != 0 ? nullptr : reinterpret_cast<const char*>(m_data + pos));
+	}
+
+private:
+	static constexpr uint32_t Align(uint32_t size) { return (size + 7u) & ~7u; }
+
+	const uint8_t* m_data;
+	uint32_t       m_pos = sizeof(RecordHeader);
+};
+
+enum class FormatLength
+{
+	None,
+	Char,
+	Short,
+	Long,
+	LongLong,
+	LongDouble,
+	Max,
+	Size,
+	Ptrdiff
+};
+
+enum class FormatArg
+{
+	Int,
+	Uint,
+	Char,
+	Double,
+	LongDouble,
+	String,
+	Pointer
+};
+
+struct FormatSpec
+{
+	const char*  length_begin   = nullptr;
+	const char*  next           = nullptr;
+	FormatLength length         = FormatLength::None;
+	FormatArg    arg            = FormatArg::Int;
+	char         conversion     = 0;
+	bool         width_star     = false;
+	bool         precision_star = false;
+	bool         has_precision  = false;
+	int          precision      = 0;
+};
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static FormatLength ParseLength(const char** p)
+{
+	const char* s = *p;
+	switch (*s)
+	{
+		case 'h':
+			*p = s + (s[1] == 'h' ? 2 : 1);
+			return (s[1] == 'h' ? FormatLength::Char : FormatLength::Short);
+		case 'l':
+			*p = s + (s[1] == 'l' ? 2 : 1);
+			return (s[1] == 'l' ? FormatLength::LongLong : FormatLength::Long);
+		case 'q': *p = s + 1; return FormatLength::LongLong;
+		case 'L': *p = s + 1; return FormatLength::LongDouble;
+		case 'j': *p = s + 1; return FormatLength::Max;
+		case 'z': *p = s + 1; return FormatLength::Size;
+		case 't': *p = s + 1; return FormatLength::Ptrdiff;
+		case 'I':
+			if (s[1] == '6' && s[2] == '4')
+			{
+				*p = s + 3;
+				return FormatLength::LongLong;
+			}
+			if (s[1] == '3' && s[2] == '2')
+			{
+				*p = s + 3;
+				return FormatLength::None;
+			}
+			*p = s + 1;
+			return FormatLength::Size;
+		default: return FormatLength::None;
+	}
+}
+
+// Parses "%[flags][width][.precision][length]conversion".
+// Returns false for everything that can't be captured as a plain value (%n, wide strings, positional arguments, ...)
+static bool ParseSpec(const char* p, FormatSpec* spec)
+{
+	p++;
+	while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'')
+	{
+		p++;
+	}
+	if (*p == '*')
+	{
+		spec->width_star = true;
+		p++;
+	}
+	while (IsDigit(*p))
+	{
+		p++;
+	}
+	if (*p == '.')
+	{
+		spec->has_precision = true;
+		p++;
+		if (*p == '*')
+		{
+			spec->precision_star = true;
+			p++;
+		}
+		while (IsDigit(*p))
+		{
+			spec->precision = spec->precision * 10 + (*p - '0');
+			p++;
+		}
+	}
+
+	spec->length_begin = p;
+	spec->length       = ParseLength(&p);
+	spec->conversion   = *p;
+	spec->next         = p + 1;
+
+	bool no_length = (spec->length == FormatLength::None);
+
+	switch (*p)
+	{
+		case 'd':
+		case 'i': spec->arg = FormatArg::Int; return true;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X': spec->arg = FormatArg::Uint; return true;
+		case 'c': spec->arg = FormatArg::Char; return no_length;
+		case 's': spec->arg = FormatArg::String; return no_length;
+		case 'p': spec->arg = FormatArg::Pointer; return no_length;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			spec->arg = (spec->length == FormatLength::LongDouble ? FormatArg::LongDouble : FormatArg::Double);
+			return no_length || spec->length == FormatLength::Long || spec->length == FormatLength::LongDouble;
+		default: return false;
+	}
+}
+
+static int64_t GetSignedArg(FormatLength length, va_list* args)
+{
+	switch (length)
+	{
+		case FormatLength::Char: return static_cast<signed char>(va_arg(*args, int));
+		case FormatLength::Short: return static_cast<int16_t>(va_arg(*args, int));
+		case FormatLength::Long: return va_arg(*args, long);
+		case FormatLength::LongLong:
+		case FormatLength::LongDouble: return va_arg(*args, long long);
+		case FormatLength::Max: return va_arg(*args, intmax_t);
+		case FormatLength::Size: return va_arg(*args, std::make_signed_t<size_t>);
+		case FormatLength::Ptrdiff: return va_arg(*args, ptrdiff_t);
+		default: return va_arg(*args, int);
+	}
+}
+
+static uint64_t GetUnsignedArg(FormatLength length, va_list* args)
+{
+	switch (length)
+	{
+		case FormatLength::Char: return static_cast<unsigned char>(va_arg(*args, unsigned int));
+		case FormatLength::Short: return static_cast<uint16_t>(va_arg(*args, unsigned int));
+		case FormatLength::Long: return va_arg(*args, unsigned long);
+		case FormatLength::LongLong:
+		case FormatLength::LongDouble: return va_arg(*args, unsigned long long);
+		case FormatLength::Max: return va_arg(*args, uintmax_t);
+		case FormatLength::Size: return va_arg(*args, size_t);
+		case FormatLength::Ptrdiff: return va_arg(*args, std::make_unsigned_t<ptrdiff_t>);
+		default: return va_arg(*args, unsigned int);
+	}
+}
+
+static bool EncodeArgs(RecordBuilder* b, const char* format, va_list* args)
+{
+	for (const char* p = strchr(format, '%'); p != nullptr; p = strchr(p, '%'))
+	{
+		if (p[1] == '%')
+		{
+			p += 2;
+			continue;
+		}
+
+		FormatSpec spec;
+		if (!ParseSpec(p, &spec))
+		{
+			return false;
+		}
+
+		int precision = spec.precision;
+		if (spec.width_star)
+		{
+			b->Add(static_cast<int64_t>(va_arg(*args, int)));
+		}
+		if (spec.precision_star)
+		{
+			precision = va_arg(*args, int);
+			b->Add(static_cast<int64_t>(precision));
+		}
+
+		switch (spec.arg)
+		{
+			case FormatArg::Int: b->Add(GetSignedArg(spec.length, args)); break;
+			case FormatArg::Uint: b->Add(GetUnsignedArg(spec.length, args)); break;
+			case FormatArg::Char: b->Add(static_cast<int64_t>(va_arg(*args, int))); break;
+			case FormatArg::Double: b->Add(va_arg(*args, double)); break;
+			case FormatArg::LongDouble: b->Add(va_arg(*args, long double)); break;
+			case FormatArg::Pointer: b->Add(reinterpret_cast<uintptr_t>(va_arg(*args, void*))); break;
+			case FormatArg::String:
+			{
+				const auto* str = va_arg(*args, const char*);
+				uint32_t    len = 0;
+				if (str != nullptr)
+				{
+					// With a precision the string doesn't have to be null-terminated
+					bool limited = (spec.has_precision && precision >= 0);
+					while ((!limited || len < static_cast<uint32_t>(precision)) && str[len] != '\0')
+					{
+						len++;
+					}
+				}
+				b->AddString(str, len);
+				break;
+			}
+		}
+
+		if (b->IsOverflow())
+		{
+			return false;
+		}
+
+		p = spec.next;
+	}
+
+	return true;
+}
+
+template <class T>
+static void AppendFormatted(std::string* out, const char* format, T value)
+{
+	char buf[256];
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+	int len = snprintf(buf, sizeof(buf), format, value);
+	if (len < 0)
+	{
+		return;
+	}
+	if (static_cast<size_t>(len) < sizeof(buf))
+	{
+		out->append(buf, len);
+	} else
+	{
+		auto pos = out->size();
+		out->resize(pos + len + 1);
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+		snprintf(out->data() + pos, len + 1, format, value);
+		out->resize(pos + len);
+	}
+}
+
+static void FormatBinary(const RecordHeader* header, std::string* out)
+{
+	RecordReader r(header);
+
+	const char* format = r.GetString();
+
+	std::string spec_str;
+
+	for (const char* p = format; *p != '\0';)
+	{
+		if (*p == '%' && p[1] == '%')
+		{
+			out->push_back('%');
+			p += 2;
+			continue;
+		}
+		if (*p != '%')
+		{
+			const char* next = strchr(p, '%');
+			if (next == nullptr)
+			{
+				next = p + strlen(p);
+			}
+			out->append(p, next - p);
+			p = next;
+			continue;
+		}
+
+		FormatSpec spec;
+		ParseSpec(p, &spec);
+
+		// Rebuild the conversion with '*' replaced by the captured values and the length matching the stored type
+		spec_str.clear();
+		for (const char* s = p; s < spec.length_begin; s++)
+		{
+			if (*s == '*')
+			{
+				spec_str += std::to_string(r.Get<int64_t>());
+			} else
+			{
+				spec_str.push_back(*s);
+			}
+		}
+		switch (spec.arg)
+		{
+			case FormatArg::Int:
+			case FormatArg::Uint: spec_str += "ll"; break;
+			case FormatArg::LongDouble: spec_str += "L"; break;
+			default: break;
+		}
+		spec_str.push_back(spec.conversion);
+
+		switch (spec.arg)
+		{
+			case FormatArg::Int: AppendFormatted(out, spec_str.c_str(), static_cast<long long>(r.Get<int64_t>())); break;
+			case FormatArg::Uint: AppendFormatted(out, spec_str.c_str(), static_cast<unsigned long long>(r.Get<uint64_t>())); break;
+			case FormatArg::Char: AppendFormatted(out, spec_str.c_str(), static_cast<int>(r.Get<int64_t>())); break;
+			case FormatArg::Double: AppendFormatted(out, spec_str.c_str(), r.Get<double>()); break;
+			case FormatArg::LongDouble: AppendFormatted(out, spec_str.c_str(), r.Get<long double>()); break;
+			case FormatArg::Pointer: AppendFormatted(out, spec_str.c_str(), reinterpret_cast<void*>(r.Get<uintptr_t>())); break;
+			case FormatArg::String: AppendFormatted(out, spec_str.c_str(), r.GetString()); break;
+		}
+
+		p = spec.next;
+	}
+}
+
+static void FormatRecord(const RecordHeader* header, std::string* out)
+{
+	switch (header->type)
+	{
+		case RecordType::Text:
+		{
+			RecordReader r(header);
+			out->append(r.GetString());
+			break;
+		}
+		case RecordType::Binary: FormatBinary(header, out); break;
+		case RecordType::Trace:
+		{
+			RecordReader r(header);
+			auto         t = r.Get<TraceRecord>();
+			char         prefix[64];
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+			snprintf(prefix, sizeof(prefix), FG_CYAN "[%d][%s] ", t.thread_id,
+			         Core::Time(static_cast<int>(t.time_ms)).ToString("HH24:MI:SS.FFF").C_Str());
+			out->append(prefix);
+			out->append(t.library);
+			out->append("::");
+			out->append(t.module);
+			out->append("::");
+			out->append(t.func);
+			out->append("()" DEFAULT "\n");
+			break;
+		}
+		default: EXIT("invalid record\n");
+	}
+}
+
+static void StripColors(std::string* str)
+{
+	size_t dst = 0;
+	for (size_t src = 0; src < str->size(); src++)
+	{
+		if ((*str)[src] == '\x1b')
+		{
+			src = str->find('m', src);
+			if (src == std::string::npos)
+			{
+				break;
+			}
+			continue;
+		}
+		(*str)[dst++] = (*str)[src];
+	}
+	str->resize(dst);
+}
+
+struct PendingRecord
+{
+	uint64_t            seq    = 0;
+	const RecordHeader* header = nullptr;
+	LogRing*            ring   = nullptr;
+};
+
+struct RingSnapshot
+{
+	LogRing* ring   = nullptr;
+	uint64_t head   = 0;
+	bool     orphan = false;
+};
+
+// Formats and writes out everything the rings have so far
+static void Drain()
+{
+	g_mutex->Lock();
+
+	Vector<RingSnapshot>       snapshots;
+	std::vector<PendingRecord> records;
+
+	for (auto* ring: *g_rings)
+	{
+		// The owner can't push anything after it has gone
+		bool     orphan = ring->orphan.load(std::memory_order_acquire);
+		uint64_t head   = ring->head.load(std::memory_order_acquire);
+
+		for (uint64_t pos = ring->tail.load(std::memory_order_relaxed); pos < head;)
+		{
+			uint32_t    offset = pos % RING_SIZE;
+			const auto* header = reinterpret_cast<const RecordHeader*>(ring->data + offset);
+			if (RING_SIZE - offset < sizeof(RecordHeader) || header->type == RecordType::Wrap)
+			{
+				pos += RING_SIZE - offset;
+				continue;
+			}
+			records.push_back(PendingRecord {header->seq, header, ring});
+			pos += header->size;
+		}
+
+		snapshots.Add(RingSnapshot {ring, head, orphan});
+	}
+
+	// Every ring is sorted already, the result is a merge of a few runs
+	std::sort(records.begin(), records.end(), [](const PendingRecord& a, const PendingRecord& b) { return a.seq < b.seq; });
+
+	std::string console;
+	std::string text;
+
+	for (const auto& r: records)
+	{
+		text.clear();
+		FormatRecord(r.header, &text);
+
+		if (!g_colored_printf)
+		{
+			StripColors(&text);
+		}
+
+		if (g_dir == Direction::Console || r.header->emu != 0)
+		{
+			console += text;
+		}
+
+		if (g_dir == Direction::File && g_file != nullptr)
+		{
+			g_file->Write(text.data(), text.size());
+		} else if (g_dir == Direction::Directory)
+		{
+			if (r.ring->file == nullptr)
+			{
+				r.ring->file = OpenThreadLocalFile(r.ring->thread_id);
+				if (r.ring->file != nullptr)
+				{
+					g_thread_local_files->Add(r.ring->file);
+				}
+			}
+			if (r.ring->file != nullptr)
+			{
+				r.ring->file->Write(text.data(), text.size());
+			}
+		}
+	}
+
+	if (!console.empty())
+	{
+		fwrite(console.data(), 1, console.size(), stdout);
+		fflush(stdout);
+	}
+
+	g_rings->Clear();
+	for (const auto& s: snapshots)
+	{
+		s.ring->tail.store(s.head, std::memory_order_release);
+
+		if (s.orphan)
+		{
+			delete s.ring;
+		} else
+		{
+			g_rings->Add(s.ring);
+		}
+	}
+
+	g_mutex->Unlock();
+}
+
+static void WakeWriter()
+{
+	g_writer_mutex->Lock();
+	g_writer_wake = true;
+	g_writer_cond->Signal();
+	g_writer_mutex->Unlock();
+}
+
+static void WriterThread(void* /*arg*/)
+{
+	g_writer_id = Core::Thread::GetThreadIdUnique();
+
+	for (bool stop = false; !stop;)
+	{
+		g_writer_mutex->Lock();
+		if (!g_writer_wake && !g_writer_stop)
+		{
+			g_writer_cond->WaitFor(g_writer_mutex, WRITER_PERIOD_US);
+		}
+		g_writer_wake = false;
+		stop          = g_writer_stop;
+		g_writer_mutex->Unlock();
+
+		Drain();
+	}
+}
+
+static void StartWriter()
+{
+	EXIT_IF(g_writer != nullptr);
+
+	g_writer_mutex = new Core::Mutex;
+	g_writer_cond  = new Core::CondVar;
+	g_writer       = new Core::Thread(WriterThread, nullptr);
+	g_async        = true;
+}
+
+static void StopWriter()
+{
+	if (!g_async.exchange(false))
+	{
+		return;
+	}
+
+	g_writer_mutex->Lock();
+	g_writer_stop = true;
+	g_writer_cond->Signal();
+	g_writer_mutex->Unlock();
+
+	if (g_writer_id != Core::Thread::GetThreadIdUnique())
+	{
+		g_writer->Join();
+		delete g_writer;
+		g_writer = nullptr;
+	}
+
+	// Records pushed after the last pass of the writer
+	Drain();
+}
+
+static LogRing* GetRing()
+{
+	if (g_ring_owner.ring == nullptr)
+	{
+		auto* ring = new LogRing(Core::Thread::GetThreadIdUnique());
+
+		g_mutex->Lock();
+		g_rings->Add(ring);
+		g_mutex->Unlock();
+
+		g_ring_owner.ring = ring;
+	}
+	return g_ring_owner.ring;
+}
+
+static void RingPush(LogRing* ring, const RecordHeader* header)
+{
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	uint32_t pos  = head % RING_SIZE;
+	uint32_t pad  = (RING_SIZE - pos < header->size ? RING_SIZE - pos : 0);
+
+	while (head + pad + header->size - ring->tail.load(std::memory_order_acquire) > RING_SIZE)
+	{
+		if (!g_async.load(std::memory_order_relaxed))
+		{
+			// The writer is stopping or gone, write the ring out here
+			Drain();
+			continue;
+		}
+		// The writer is behind, wait for it rather than lose the record
+		WakeWriter();
+		Core::Thread::SleepMicro(100);
+	}
+
+	if (pad != 0)
+	{
+		if (pad >= sizeof(RecordHeader))
+		{
+			auto* wrap = reinterpret_cast<RecordHeader*>(ring->data + pos);
+			wrap->size = pad;
+			wrap->type = RecordType::Wrap;
+		}
+		pos = 0;
+	}
+
+	auto* record = reinterpret_cast<RecordHeader*>(ring->data + pos);
+
+	memcpy(record, header, header->size);
+
+	// Numbered only when there is room, a record which waited for the writer doesn't come before the ones pushed meanwhile
+	record->seq = g_seq.fetch_add(1, std::memory_order_relaxed);
+
+	ring->head.store(head + pad + header->size, std::memory_order_release);
+
+	if (!g_async.load(std::memory_order_relaxed))
+	{
+		// Pushed after the last pass of the writer
+		Drain();
+	}
+}
+
+static void AsyncPrintf(const char* format, va_list args, bool emu)
+{
+	auto* ring = GetRing();
+
+	{
+		RecordBuilder b(RecordType::Binary, emu);
+
+		va_list copy {};
+		va_copy(copy, args);
+		b.AddString(format, static_cast<uint32_t>(strlen(format)));
+		bool ok = (!b.IsOverflow() && EncodeArgs(&b, format, &copy));
+		va_end(copy);
+
+		if (ok)
+		{
+			RingPush(ring, b.Finish());
+			return;
+		}
+	}
+
+	// The arguments can't be captured (or are too long), format them here and split the text into records
+	va_list copy {};
+	va_copy(copy, args);
+	int len = vsnprintf(nullptr, 0, format, copy);
+	va_end(copy);
+
+	if (len <= 0)
+	{
+		return;
+	}
+
+	std::string text(len + 1, '\0');
+	vsnprintf(text.data(), len + 1, format, args);
+	text.resize(len);
+
+	// Header, length, null flag and the terminating zero with alignment
+	static constexpr uint32_t CHUNK_SIZE = RECORD_MAX_SIZE - sizeof(RecordHeader) - 16 - 8;
+
+	for (size_t pos = 0; pos < text.size(); pos += CHUNK_SIZE)
+	{
+		RecordBuilder b(RecordType::Text, emu);
+		b.AddString(text.data() + pos, static_cast<uint32_t>(std::min<size_t>(CHUNK_SIZE, text.size() - pos)));
+		RingPush(ring, b.Finish());
+	}
+}
+
 static void Close()
 {
 	if (g_log_initialized)
 	{
+		StopWriter();
+
 		g_mutex->Lock();
 		if (g_dir == Direction::File && g_file != nullptr)
 		{
@@ -106,6 +948,15 @@ static void Close()
 				delete file;
 			}
 			g_thread_local_files->Clear();
+			for (auto* ring: *g_rings)
+			{
+				ring->file = nullptr;
+			}
+		}
+		if (g_dir == Direction::File || g_dir == Direction::Directory)
+		{
+			// A thread which was printing while the log was closed drains its ring itself, the output goes to the console then
+			g_dir = Direction::Console;
 		}
 		g_mutex->Unlock();
 	}
@@ -115,7 +966,7 @@ KYTY_SUBSYSTEM_INIT(Log)
 {
 	if (!g_log_initialized)
 	{
-		g_mutex           = new Core::Mutex;
+		g_mutex           = new Core::Mutex(Core::Mutex::Type::Recursive);
 		g_log_initialized = true;
 	}
 
@@ -127,6 +978,17 @@ KYTY_SUBSYSTEM_INIT(Log)
 	}
 
 	g_thread_local_files = new Vector<Core::File*>;
+	g_rings              = new Vector<LogRing*>;
+
+	if (dir == Log::Direction::Silent)
+	{
+		TraceEnableAll(false);
+	}
+
+	if (Config::PrintfAsyncEnabled())
+	{
+		StartWriter();
+	}
 }
 
 KYTY_SUBSYSTEM_UNEXPECTED_SHUTDOWN(Log)
@@ -189,38 +1051,125 @@ void SetOutputFile(const String& file_name, Core::File::Encoding enc)
 	}
 }
 
-void SetOutputThreadLocalFile(const String& file_name, Core::File::Encoding enc)
+static Core::File* OpenThreadLocalFile(int thread_id)
+{
+	auto file_name = String::FromPrintf("%s/%d.txt", Config::GetPrintfOutputFolder().C_Str(), thread_id);
+
+	Core::File::CreateDirectories(file_name.DirectoryWithoutFilename());
+
+	auto* file = new Core::File;
+	file->Create(file_name);
+
+	if (file->IsInvalid())
+	{
+		::printf("Can't create log file: %s\n", file_name.C_Str());
+		delete file;
+		return nullptr;
+	}
+
+	file->SetEncoding(Core::File::Encoding::Utf8);
+	file->WriteBOM();
+
+	return file;
+}
+
+static void CreateThreadLocalFile()
 {
 	EXIT_IF(!Log::g_log_initialized);
 	EXIT_IF(Log::g_dir != Log::Direction::Directory);
 	EXIT_IF(Log::g_thread_local_file != nullptr);
 	EXIT_IF(g_thread_local_files == nullptr);
 
-	Core::File::CreateDirectories(file_name.DirectoryWithoutFilename());
+	g_thread_local_file = OpenThreadLocalFile(Core::Thread::GetThreadIdUnique());
+
+	if (g_thread_local_file != nullptr)
+	{
+		g_mutex->Lock();
+		g_thread_local_files->Add(g_thread_local_file);
+		g_mutex->Unlock();
+	}
+}
 
-	g_thread_local_file = new Core::File;
-	g_thread_local_file->Create(file_name);
+static void SyncPrintf(const char* format, va_list args)
+{
+	String s;
+	s.Printf(format, args);
 
-	if (g_thread_local_file->IsInvalid())
+	if (!g_colored_printf)
 	{
-		::printf("Can't create log file: %s\n", file_name.C_Str());
-		delete g_thread_local_file;
-		g_thread_local_file = nullptr;
-	} else
+		s = RemoveColors(s);
+	}
+
+	if (g_dir == Direction::Console)
+	{
+		g_mutex->Lock();
+		::printf("%s", s.C_Str());
+		g_mutex->Unlock();
+	} else if (g_dir == Direction::File && g_file != nullptr)
+	{
+		g_mutex->Lock();
+		g_file->Write(s);
+		g_mutex->Unlock();
+	} else if (g_dir == Direction::Directory)
 	{
-		g_thread_local_file->SetEncoding(enc);
-		g_thread_local_file->WriteBOM();
+		if (g_thread_local_file == nullptr)
+		{
+			CreateThreadLocalFile();
+		}
+		if (g_thread_local_file != nullptr)
+		{
+			g_thread_local_file->Write(s);
+		}
 	}
+}
 
-	g_mutex->Lock();
-	g_thread_local_files->Add(g_thread_local_file);
-	g_mutex->Unlock();
+TraceSwitch::TraceSwitch(const char* library): m_library(library), m_next(g_trace_switches)
+{
+	// Runs during static initialization, before any other thread exists
+	g_trace_switches = this;
 }
 
-void CreateThreadLocalFile()
+bool TraceEnable(const String& library, bool enabled)
 {
-	auto file_name = String::FromPrintf("%s/%d.txt", Config::GetPrintfOutputFolder().C_Str(), Core::Thread::GetThreadIdUnique());
-	SetOutputThreadLocalFile(file_name, Core::File::Encoding::Utf8);
+	bool found = false;
+	for (auto* s = g_trace_switches; s != nullptr; s = s->GetNext())
+	{
+		if (String::FromUtf8(s->GetLibrary()) == library)
+		{
+			s->SetEnabled(enabled);
+			found = true;
+		}
+	}
+	return found;
+}
+
+void TraceEnableAll(bool enabled)
+{
+	for (auto* s = g_trace_switches; s != nullptr; s = s->GetNext())
+	{
+		s->SetEnabled(enabled);
+	}
+}
+
+void Trace(const char* library, const char* module, const char* func)
+{
+	EXIT_IF(!g_log_initialized);
+
+	if (g_dir == Direction::Silent)
+	{
+		return;
+	}
+
+	if (g_async.load(std::memory_order_relaxed))
+	{
+		RecordBuilder b(RecordType::Trace, false);
+		b.Add(TraceRecord {Core::Thread::GetThreadIdUnique(), Loader::Timer::GetTimeMs(), library, module, func});
+		RingPush(GetRing(), b.Finish());
+	} else
+	{
+		Kyty::printf(FG_CYAN "[%d][%s] %s::%s::%s()" DEFAULT "\n", Core::Thread::GetThreadIdUnique(),
+		             Loader::Timer::GetTime().ToString("HH24:MI:SS.FFF").C_Str(), library, module, func);
+	}
 }
 
 } // namespace Log
@@ -231,27 +1180,35 @@ void emu_printf(const char* format, ...)
 
 	EXIT_IF(Log::g_mutex == nullptr);
 
-	Log::g_mutex->Lock();
-	{
-		va_list args {};
-		va_start(args, format);
-		String s;
-		s.Printf(format, args);
-		va_end(args);
+	va_list args {};
+	va_start(args, format);
 
-		if (!Log::g_colored_printf)
+	if (Log::g_async.load(std::memory_order_relaxed))
+	{
+		Log::AsyncPrintf(format, args, true);
+	} else
+	{
+		Log::g_mutex->Lock();
 		{
-			s = Log::RemoveColors(s);
-		}
+			String s;
+			s.Printf(format, args);
 
-		::printf("%s", s.C_Str());
+			if (!Log::g_colored_printf)
+			{
+				s = Log::RemoveColors(s);
+			}
 
-		if (Log::g_dir == Log::Direction::File && Log::g_file != nullptr)
-		{
-			Log::g_file->Write(s);
+			::printf("%s", s.C_Str());
+
+			if (Log::g_dir == Log::Direction::File && Log::g_file != nullptr)
+			{
+				Log::g_file->Write(s);
+			}
 		}
+		Log::g_mutex->Unlock();
 	}
-	Log::g_mutex->Unlock();
+
+	va_end(args);
 }
 
 void printf(const char* format, ...)
@@ -267,36 +1224,16 @@ void printf(const char* format, ...)
 
 	va_list args {};
 	va_start(args, format);
-	String s;
-	s.Printf(format, args);
-	va_end(args);
-
-	if (!Log::g_colored_printf)
-	{
-		s = Log::RemoveColors(s);
-	}
 
-	if (Log::g_dir == Log::Direction::Console)
+	if (Log::g_async.load(std::memory_order_relaxed))
 	{
-		Log::g_mutex->Lock();
-		::printf("%s", s.C_Str());
-		Log::g_mutex->Unlock();
-	} else if (Log::g_dir == Log::Direction::File && Log::g_file != nullptr)
-	{
-		Log::g_mutex->Lock();
-		Log::g_file->Write(s);
-		Log::g_mutex->Unlock();
-	} else if (Log::g_dir == Log::Direction::Directory)
+		Log::AsyncPrintf(format, args, false);
+	} else
 	{
-		if (Log::g_thread_local_file == nullptr)
-		{
-			Log::CreateThreadLocalFile();
-		}
-		if (Log::g_thread_local_file != nullptr)
-		{
-			Log::g_thread_local_file->Write(s);
-		}
+		Log::SyncPrintf(format, args);
 	}
+
+	va_end(args);
 }
 
 } // namespace Kyty
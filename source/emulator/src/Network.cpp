@@ -180,7 +180,7 @@ private:
 	static constexpr int SSL_MAX   = 32;
 	static constexpr int HTTP_MAX  = 32;
 
-	Core::Mutex            m_mutex;
+	Core::Mutex            m_mutex {Core::Mutex::Type::Recursive};
 	Pool                   m_pools[POOLS_MAX];
 	Ssl                    m_ssl[SSL_MAX];
 	Http                   m_http[HTTP_MAX];
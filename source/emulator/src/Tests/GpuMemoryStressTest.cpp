@@ -0,0 +1,198 @@
+#include "Emulator/Tests.h"
+
+#include "Kyty/Core/DbgAssert.h"
+#include "Kyty/Core/Threads.h"
+#include "Kyty/Core/Timer.h"
+#include "Kyty/Core/VirtualMemory.h"
+
+#include "Emulator/Graphics/GraphicContext.h"
+#include "Emulator/Graphics/Objects/GpuMemory.h"
+
+#include <atomic>
+
+#if defined(KYTY_EMU_ENABLED) && defined(KYTY_EMU_TESTS)
+
+namespace Kyty::Libs::Graphics {
+
+// Objects for the stress test, nothing is allocated on the GPU
+class StressObject: public GpuObject
+{
+public:
+	StressObject(uint64_t vaddr, uint64_t size)
+	{
+		// Equal ranges always get equal types and params
+		type       = ((vaddr / 256) % 2 == 0 ? GpuMemoryObjectType::VertexBuffer : GpuMemoryObjectType::IndexBuffer);
+		params[0]  = vaddr;
+		params[1]  = size;
+		check_hash = true;
+		read_only  = false;
+	}
+
+	bool Equal(const uint64_t* other) const override { return params[0] == other[0] && params[1] == other[1]; }
+
+	[[nodiscard]] create_func_t              GetCreateFunc() const override { return Create; }
+	[[nodiscard]] create_from_objects_func_t GetCreateFromObjectsFunc() const override { return nullptr; }
+	[[nodiscard]] write_back_func_t          GetWriteBackFunc() const override { return nullptr; }
+	[[nodiscard]] delete_func_t              GetDeleteFunc() const override { return Delete; }
+	[[nodiscard]] update_func_t              GetUpdateFunc() const override { return Update; }
+
+	static std::atomic_int created;
+	static std::atomic_int deleted;
+	static std::atomic_int updated;
+
+private:
+	static void* Create(GraphicContext* /*ctx*/, const uint64_t* params, const uint64_t* vaddr, const uint64_t* size, int vaddr_num,
+	                    VulkanMemory* /*mem*/)
+	{
+		EXIT_IF(vaddr_num != 1 || params[0] != vaddr[0] || params[1] != size[0]);
+		created++;
+		return new uint64_t(vaddr[0]);
+	}
+
+	static void Delete(GraphicContext* /*ctx*/, void* obj, VulkanMemory* /*mem*/)
+	{
+		deleted++;
+		delete static_cast<uint64_t*>(obj);
+	}
+
+	static void Update(GraphicContext* /*ctx*/, const uint64_t* /*params*/, void* obj, const uint64_t* vaddr, const uint64_t* /*size*/,
+	                   int /*vaddr_num*/)
+	{
+		EXIT_IF(*static_cast<uint64_t*>(obj) != vaddr[0]);
+		updated++;
+	}
+};
+
+std::atomic_int StressObject::created(0);
+std::atomic_int StressObject::deleted(0);
+std::atomic_int StressObject::updated(0);
+
+struct StressThread
+{
+	GraphicContext* ctx = nullptr;
+	uint64_t        vaddr = 0;
+	uint64_t        size  = 0;
+	uint32_t        seed  = 0;
+	uint64_t        ops   = 0;
+};
+
+static void StressThreadRun(void* arg)
+{
+	static constexpr int ITERATIONS = 20000;
+
+	auto* t = static_cast<StressThread*>(arg);
+
+	auto rand = [t]()
+	{
+		t->seed ^= t->seed << 13u;
+		t->seed ^= t->seed >> 17u;
+		t->seed ^= t->seed << 5u;
+		return t->seed;
+	};
+
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		// Objects are smaller than the range, so Free() sees only contained or crossing objects
+		uint64_t size  = (1 + rand() % 64) * 256;
+		uint64_t vaddr = t->vaddr + (rand() % ((t->size - size) / 256)) * 256;
+
+		switch (rand() % 16)
+		{
+			case 0: GpuMemoryFree(t->ctx, t->vaddr, t->size, false); break;
+			case 1: GpuMemoryFlush(t->ctx, vaddr, size); break;
+			case 2: GpuMemoryCheckAccessViolation(vaddr, size); break;
+			case 3: GpuMemoryFindObjects(vaddr, size, GpuMemoryObjectType::VertexBuffer, false, false); break;
+			case 4: GpuMemoryFrameDone(); break;
+			default:
+			{
+				StressObject info(vaddr, size);
+				void*        obj = GpuMemoryCreateObject(1, t->ctx, nullptr, vaddr, size, info);
+				// With overlapping ranges another thread can already delete the object, Update() checks it under the heap lock
+				EXIT_IF(obj == nullptr);
+				break;
+			}
+		}
+		t->ops++;
+	}
+}
+
+void GpuMemoryStressTest()
+{
+	static constexpr int      HEAPS_NUM   = 4;
+	static constexpr int      THREADS_NUM = 8;
+	static constexpr uint64_t HEAP_SIZE   = 4 * 1024 * 1024;
+	static constexpr uint64_t SLICE_SIZE  = HEAP_SIZE / (THREADS_NUM / HEAPS_NUM);
+
+	EXIT_NOT_IMPLEMENTED(!Core::Thread::IsMainThread());
+
+	// The heaps are added to the GpuMemory of the emulator, so the test runs instead of a game
+
+	// Callbacks of the test objects don't use the context
+	static GraphicContext ctx {};
+
+	uint64_t heaps[HEAPS_NUM] = {};
+	for (auto& heap: heaps)
+	{
+		heap = Core::VirtualMemory::Alloc(0, HEAP_SIZE, Core::VirtualMemory::Mode::ReadWrite);
+		EXIT_IF(heap == 0);
+		GpuMemorySetAllocatedRange(heap, HEAP_SIZE);
+	}
+
+	StressObject::created = 0;
+	StressObject::deleted = 0;
+	StressObject::updated = 0;
+
+	struct Run
+	{
+		int  threads_num;
+		bool overlap;
+	};
+
+	for (const auto& run: {Run {1, false}, Run {THREADS_NUM, false}, Run {THREADS_NUM, true}})
+	{
+		int           threads_num = run.threads_num;
+		StressThread  args[THREADS_NUM];
+		Core::Thread* threads[THREADS_NUM] = {};
+		uint64_t      ops                  = 0;
+
+		Core::Timer timer;
+		timer.Start();
+		for (int i = 0; i < threads_num; i++)
+		{
+			// Threads share heaps. Without overlap the ranges are disjoint, with overlap a range shares a half with the next one.
+			auto slice    = static_cast<uint64_t>(i / HEAPS_NUM);
+			args[i].ctx   = &ctx;
+			args[i].vaddr = heaps[i % HEAPS_NUM] + (run.overlap ? slice * SLICE_SIZE / 2 : slice * SLICE_SIZE);
+			args[i].size  = SLICE_SIZE;
+			args[i].seed  = 2463534242u + static_cast<uint32_t>(i);
+			threads[i]    = new Core::Thread(StressThreadRun, &args[i]);
+		}
+		for (int i = 0; i < threads_num; i++)
+		{
+			threads[i]->Join();
+			delete threads[i];
+			ops += args[i].ops;
+		}
+		double time = timer.GetTimeS();
+
+		GpuMemoryFlushAll(&ctx);
+
+		printf("GpuMemory stress test, %d threads%s: %" PRIu64 " ops in %.3f s, %.0f ops/s\n", threads_num,
+		       run.overlap ? ", overlapping ranges" : "", ops, time, static_cast<double>(ops) / time);
+	}
+
+	for (auto heap: heaps)
+	{
+		GpuMemoryFree(&ctx, heap, HEAP_SIZE, true);
+		Core::VirtualMemory::Free(heap);
+	}
+
+	printf("GpuMemory stress test: created = %d, deleted = %d, updated = %d %s\n", StressObject::created.load(),
+	       StressObject::deleted.load(), StressObject::updated.load(), StressObject::created == StressObject::deleted ? "ok" : "MISMATCH");
+
+	EXIT_IF(StressObject::created != StressObject::deleted);
+}
+
+} // namespace Kyty::Libs::Graphics
+
+#endif // KYTY_EMU_TESTS
@@ -0,0 +1,189 @@
+#include "Emulator/Tests.h"
+
+#include "Kyty/Core/DbgAssert.h"
+#include "Kyty/Core/Threads.h"
+
+#include "Emulator/Kernel/Pthread.h"
+#include "Emulator/Libs/Errno.h"
+
+#include <atomic>
+
+#if defined(KYTY_EMU_ENABLED) && defined(KYTY_EMU_TESTS)
+
+namespace Kyty::Libs::LibKernel {
+
+struct KeysTestThread
+{
+	PthreadKey       key       = 0;
+	int              values[2] = {};
+	int              errors    = 0;
+	std::atomic_int* state     = nullptr;
+	int              wait_for  = 0;
+};
+
+static std::atomic_int g_keys_test_destructed[4];
+
+static KYTY_SYSV_ABI void keys_test_destructor(void* data)
+{
+	g_keys_test_destructed[*static_cast<int*>(data)]++;
+}
+
+static void keys_test_wait(const std::atomic_int* state, int value)
+{
+	while (state->load() < value)
+	{
+		Core::Thread::SleepMicro(100);
+	}
+}
+
+// Sets its own value and checks that no other thread's value is visible
+static KYTY_SYSV_ABI void* keys_test_hammer(void* arg)
+{
+	auto* t = static_cast<KeysTestThread*>(arg);
+
+	for (int i = 0; i < 100000; i++)
+	{
+		void* own = &t->values[i & 1];
+		if (PthreadSetspecific(t->key, own) != OK || PthreadGetspecific(t->key) != own)
+		{
+			t->errors++;
+		}
+	}
+
+	return nullptr;
+}
+
+// Sets a value, waits until the key is deleted and its slot is reused, then checks that the old value is gone
+static KYTY_SYSV_ABI void* keys_test_reuse(void* arg)
+{
+	static int tag = 1;
+
+	auto* t = static_cast<KeysTestThread*>(arg);
+
+	if (PthreadSetspecific(t->key, &tag) != OK)
+	{
+		t->errors++;
+	}
+
+	(*t->state)++;
+	keys_test_wait(t->state, t->wait_for);
+
+	if (PthreadGetspecific(t->key) != nullptr)
+	{
+		t->errors++;
+	}
+
+	return nullptr;
+}
+
+// Sets a value and exits, the destructor is called with it
+static KYTY_SYSV_ABI void* keys_test_exit(void* arg)
+{
+	static int tag = 2;
+
+	auto* t = static_cast<KeysTestThread*>(arg);
+
+	if (PthreadSetspecific(t->key, &tag) != OK)
+	{
+		t->errors++;
+	}
+
+	return nullptr;
+}
+
+// A new thread, which may get the PthreadPrivate of an exited one, starts without values
+static KYTY_SYSV_ABI void* keys_test_fresh(void* arg)
+{
+	auto* t = static_cast<KeysTestThread*>(arg);
+
+	if (PthreadGetspecific(t->key) != nullptr)
+	{
+		t->errors++;
+	}
+
+	return nullptr;
+}
+
+static int keys_test_run(pthread_entry_func_t func, KeysTestThread* args, int threads_num)
+{
+	static constexpr int THREADS_MAX = 8;
+
+	EXIT_IF(threads_num > THREADS_MAX);
+
+	Pthread threads[THREADS_MAX] = {};
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		EXIT_NOT_IMPLEMENTED(PthreadCreate(&threads[i], nullptr, func, &args[i], "KeysTest") != OK);
+	}
+
+	int errors = 0;
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		EXIT_NOT_IMPLEMENTED(PthreadJoin(threads[i], nullptr) != OK);
+		errors += args[i].errors;
+	}
+
+	return errors;
+}
+
+void PthreadKeysTest()
+{
+	for (auto& d: g_keys_test_destructed)
+	{
+		d = 0;
+	}
+
+	int errors = 0;
+
+	// Concurrent get/set of one key
+	PthreadKey key = 0;
+	EXIT_NOT_IMPLEMENTED(PthreadKeyCreate(&key, nullptr) != OK);
+	KeysTestThread hammer[8];
+	for (auto& t: hammer)
+	{
+		t.key = key;
+	}
+	errors += keys_test_run(keys_test_hammer, hammer, 8);
+	EXIT_NOT_IMPLEMENTED(PthreadKeyDelete(key) != OK);
+
+	// Values of an exited thread are destructed once and are not visible to later threads
+	EXIT_NOT_IMPLEMENTED(PthreadKeyCreate(&key, keys_test_destructor) != OK);
+	KeysTestThread exit_thread;
+	exit_thread.key = key;
+	errors += keys_test_run(keys_test_exit, &exit_thread, 1);
+	errors += (g_keys_test_destructed[2] != 1 ? 1 : 0);
+	KeysTestThread fresh_thread;
+	fresh_thread.key = key;
+	errors += keys_test_run(keys_test_fresh, &fresh_thread, 1);
+	EXIT_NOT_IMPLEMENTED(PthreadKeyDelete(key) != OK);
+
+	// A deleted key is reused by the next create, the value set before the delete is neither visible nor destructed
+	EXIT_NOT_IMPLEMENTED(PthreadKeyCreate(&key, keys_test_destructor) != OK);
+	std::atomic_int reuse_state = 0;
+	KeysTestThread  reuse_thread;
+	reuse_thread.key      = key;
+	reuse_thread.state    = &reuse_state;
+	reuse_thread.wait_for = 2;
+	Pthread thread        = nullptr;
+	EXIT_NOT_IMPLEMENTED(PthreadCreate(&thread, nullptr, keys_test_reuse, &reuse_thread, "KeysTest") != OK);
+	keys_test_wait(&reuse_state, 1);
+	EXIT_NOT_IMPLEMENTED(PthreadKeyDelete(key) != OK);
+	PthreadKey new_key = 0;
+	EXIT_NOT_IMPLEMENTED(PthreadKeyCreate(&new_key, keys_test_destructor) != OK);
+	errors += (new_key != key ? 1 : 0);
+	reuse_state++;
+	EXIT_NOT_IMPLEMENTED(PthreadJoin(thread, nullptr) != OK);
+	errors += reuse_thread.errors;
+	errors += (g_keys_test_destructed[1] != 0 ? 1 : 0);
+	EXIT_NOT_IMPLEMENTED(PthreadKeyDelete(new_key) != OK);
+
+	printf("PthreadKeys test: %s\n", errors == 0 ? "ok" : "FAILED");
+
+	EXIT_IF(errors != 0);
+}
+
+} // namespace Kyty::Libs::LibKernel
+
+#endif // KYTY_EMU_TESTS
@@ -0,0 +1,99 @@
+#include "Emulator/Tests.h"
+
+#include "Kyty/Core/DbgAssert.h"
+#include "Kyty/Core/Timer.h"
+#include "Kyty/Core/Vector.h"
+
+#include "Emulator/Graphics/Tile.h"
+
+#include <cstring>
+
+#if defined(KYTY_EMU_ENABLED) && defined(KYTY_EMU_TESTS)
+
+namespace Kyty::Libs::Graphics {
+
+static void BenchmarkSurface(const char* name, TileMode mode, uint32_t dfmt, uint32_t nfmt, uint32_t width, uint32_t height, bool neo)
+{
+	static constexpr int ITERATIONS = 50;
+
+	uint64_t linear_size = 0;
+	uint64_t tiled_size  = 0;
+
+	TileGetSurfaceSize(mode, dfmt, nfmt, width, height, neo, &linear_size, &tiled_size);
+
+	Vector<uint8_t> tiled(static_cast<uint32_t>(tiled_size), false);
+	Vector<uint8_t> retiled(static_cast<uint32_t>(tiled_size), false);
+	Vector<uint8_t> linear(static_cast<uint32_t>(linear_size), false);
+	Vector<uint8_t> ref(static_cast<uint32_t>(linear_size), false);
+
+	for (uint32_t i = 0; i < tiled.Size(); i++)
+	{
+		tiled[i] = static_cast<uint8_t>(i * 2654435761u >> 24u);
+	}
+
+	Core::Timer timer;
+
+	timer.Start();
+	TileConvertSurface(ref.GetData(), tiled.GetDataConst(), mode, dfmt, nfmt, width, height, neo, false, true);
+	double ref_time = timer.GetTimeS();
+
+	timer.Start();
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		TileConvertSurface(linear.GetData(), tiled.GetDataConst(), mode, dfmt, nfmt, width, height, neo, false, false);
+	}
+	double detile_time = timer.GetTimeS() / ITERATIONS;
+
+	bool detile_ok = (memcmp(linear.GetDataConst(), ref.GetDataConst(), linear_size) == 0);
+
+	timer.Start();
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		TileConvertSurface(retiled.GetData(), ref.GetDataConst(), mode, dfmt, nfmt, width, height, neo, true, false);
+	}
+	double retile_time = timer.GetTimeS() / ITERATIONS;
+
+	// Round trip: detile(retile(linear)) == linear
+	TileConvertSurface(linear.GetData(), retiled.GetDataConst(), mode, dfmt, nfmt, width, height, neo, false, false);
+
+	bool retile_ok = (memcmp(linear.GetDataConst(), ref.GetDataConst(), linear_size) == 0);
+
+	auto gbs = [linear_size](double time) { return static_cast<double>(linear_size) / time / 1e9; };
+
+	printf("%-24s %4ux%-4u: detile %7.2f GB/s, retile %7.2f GB/s (reference: %6.2f GB/s) %s\n", name, width, height, gbs(detile_time),
+	       gbs(retile_time), gbs(ref_time), detile_ok && retile_ok ? "ok" : "MISMATCH");
+
+	EXIT_IF(!detile_ok || !retile_ok);
+}
+
+void TileBenchmark()
+{
+	for (bool neo: {false, true})
+	{
+		BenchmarkSurface(neo ? "VideoOut (neo)" : "VideoOut", TileMode::VideoOutTiled, 0, 0, 1920, 1080, neo);
+	}
+
+	struct Texture
+	{
+		const char* name;
+		uint32_t    dfmt;
+		uint32_t    nfmt;
+		uint32_t    width;
+		uint32_t    height;
+	};
+
+	static const Texture textures[] = {
+	    {"Texture R8G8B8A8", 10, 9, 1920, 1080}, {"Texture R8G8B8A8", 10, 9, 3840, 2160},
+	    {"Texture BC1", 35, 0, 1920, 1080},      {"Texture BC1", 35, 0, 3840, 2160},
+	    {"Texture BC3", 37, 0, 1920, 1080},      {"Texture BC3", 37, 0, 3840, 2160},
+	};
+
+	for (const auto& tex: textures)
+	{
+		BenchmarkSurface(tex.name, TileMode::TextureTiled, tex.dfmt, tex.nfmt, tex.width, tex.height, false);
+	}
+}
+
+} // namespace Kyty::Libs::Graphics
+
+#endif // KYTY_EMU_TESTS
@@ -20,40 +20,40 @@ constexpr ZstdCompressLevel ZSTD_BEST_SPEED       = 1;
 constexpr ZstdCompressLevel ZSTD_DEFAULT_LEVEL    = 3;
 constexpr ZstdCompressLevel ZSTD_BEST_COMPRESSION = 22;
 
-ByteBuffer CompressZstd(const uint8_t* buf, uint32_t length, int level = ZSTD_DEFAULT_LEVEL);
+ByteBuffer CompressZstd(const uint8_t* buf, uint64_t length, int level = ZSTD_DEFAULT_LEVEL);
 ByteBuffer CompressZstd(const ByteBuffer& buf, int level = ZSTD_DEFAULT_LEVEL);
 ByteBuffer CompressZstd(const String& str, int level = ZSTD_DEFAULT_LEVEL);
 
-ByteBuffer DecompressZstd(const uint8_t* buf, uint32_t length);
+ByteBuffer DecompressZstd(const uint8_t* buf, uint64_t length);
 ByteBuffer DecompressZstd(const ByteBuffer& buf);
-String     DecompressZstdStr(const uint8_t* buf, uint32_t length);
+String     DecompressZstdStr(const uint8_t* buf, uint64_t length);
 String     DecompressZstdStr(const ByteBuffer& buf);
 
-ByteBuffer CompressLzma(const uint8_t* buf, uint32_t length);
+ByteBuffer CompressLzma(const uint8_t* buf, uint64_t length);
 ByteBuffer CompressLzma(const ByteBuffer& buf);
 ByteBuffer CompressLzma(const String& str);
 
-ByteBuffer DecompressLzma(const uint8_t* buf, uint32_t length);
+ByteBuffer DecompressLzma(const uint8_t* buf, uint64_t length);
 ByteBuffer DecompressLzma(const ByteBuffer& buf);
-String     DecompressLzmaStr(const uint8_t* buf, uint32_t length);
+String     DecompressLzmaStr(const uint8_t* buf, uint64_t length);
 String     DecompressLzmaStr(const ByteBuffer& buf);
 
-ByteBuffer CompressZip(const uint8_t* buf, uint32_t length, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
+ByteBuffer CompressZip(const uint8_t* buf, uint64_t length, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
 ByteBuffer CompressZip(const ByteBuffer& buf, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
 ByteBuffer CompressZip(const String& str, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
 
-ByteBuffer DecompressZip(const uint8_t* buf, uint32_t length);
+ByteBuffer DecompressZip(const uint8_t* buf, uint64_t length);
 ByteBuffer DecompressZip(const ByteBuffer& buf);
-String     DecompressZipStr(const uint8_t* buf, uint32_t length);
+String     DecompressZipStr(const uint8_t* buf, uint64_t length);
 String     DecompressZipStr(const ByteBuffer& buf);
 
-ByteBuffer CompressLzf(const uint8_t* buf, uint32_t length);
+ByteBuffer CompressLzf(const uint8_t* buf, uint64_t length);
 ByteBuffer CompressLzf(const ByteBuffer& buf);
 ByteBuffer CompressLzf(const String& str);
 
-ByteBuffer DecompressLzf(const uint8_t* buf, uint32_t length);
+ByteBuffer DecompressLzf(const uint8_t* buf, uint64_t length);
 ByteBuffer DecompressLzf(const ByteBuffer& buf);
-String     DecompressLzfStr(const uint8_t* buf, uint32_t length);
+String     DecompressLzfStr(const uint8_t* buf, uint64_t length);
 String     DecompressLzfStr(const ByteBuffer& buf);
 
 struct ZipFileStat
@@ -86,7 +86,7 @@ public:
 
 	bool Open(const String& file_name);
 	bool Open(const ByteBuffer& buf);
-	bool Open(uint8_t* mem, uint32_t size);
+	bool Open(uint8_t* mem, uint64_t size);
 
 	void Close();
 
@@ -130,7 +130,7 @@ public:
 	void Close();
 
 	bool AddFile(const String& file_name, const ByteBuffer& buf, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
-	bool AddFile(const String& file_name, const uint8_t* buf, uint32_t size, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
+	bool AddFile(const String& file_name, const uint8_t* buf, uint64_t size, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
 	bool AddFileFromFile(const String& file_name, const String& from_file, ZipCompressLevel level = ZIP_DEFAULT_LEVEL);
 	bool AddFileFromReader(const String& file_name, ZipReader* from_reader, int file_index);
 
@@ -50,6 +50,13 @@ public:
 		WriteRead
 	};
 
+	enum class CacheHint
+	{
+		Auto,
+		RandomAccess,
+		SequentialScan
+	};
+
 	struct FindInfo
 	{
 		String   path_with_name;
@@ -71,8 +78,9 @@ public:
 	virtual ~File();
 
 	bool Create(const String& name);
-	bool Open(const String& name, Mode mode);
-	bool OpenInMem(void* buf, uint32_t buf_size);
+	bool Open(const String& name, Mode mode, CacheHint hint = CacheHint::Auto);
+	bool OpenMapped(const String& name, CacheHint hint = CacheHint::Auto);
+	bool OpenInMem(void* buf, uint64_t buf_size);
 	bool OpenInMem(ByteBuffer& buf); // NOLINT(google-runtime-references)
 	bool CreateInMem();
 
@@ -94,14 +102,16 @@ public:
 
 	void GetLastAccessAndWriteTimeUTC(DateTime* access, DateTime* write);
 
-	void       Read(void* data, uint32_t size, uint32_t* bytes_read = nullptr);
+	void       Read(void* data, uint64_t size, uint64_t* bytes_read = nullptr);
 	ByteBuffer Read(uint32_t size);
-	void       Write(const void* data, uint32_t size, uint32_t* bytes_written = nullptr);
-	void       Write(const ByteBuffer& buf, uint32_t* bytes_written = nullptr);
+	void       Write(const void* data, uint64_t size, uint64_t* bytes_written = nullptr);
+	void       Write(const ByteBuffer& buf, uint64_t* bytes_written = nullptr);
+	void       ReadAt(void* data, uint64_t size, uint64_t offset, uint64_t* bytes_read = nullptr);
+	void       WriteAt(const void* data, uint64_t size, uint64_t offset, uint64_t* bytes_written = nullptr);
 	void       ReadR(void* data, uint32_t size);
 	void       WriteR(const void* data, uint32_t size);
 
-	void                   Write(const String& str, uint32_t* bytes_written = nullptr);
+	void                   Write(const String& str, uint64_t* bytes_written = nullptr);
 	void                   WriteBOM();
 	String                 ReadLine();
 	String                 ReadWholeString();
@@ -2,13 +2,15 @@
 #define INCLUDE_KYTY_CORE_HASHMAP_H_
 
 #include "Kyty/Core/Common.h"
+#include "Kyty/Core/DbgAssert.h"
 
+#include <cstring>
 #include <new>
+#include <type_traits>
+#include <utility>
 
 namespace Kyty::Core {
 
-class HashmapPrivate;
-
 //#if KYTY_PLATFORM == KYTY_PLATFORM_WINDOWS
 //#define HASH_CALL __stdcall
 //#else
@@ -17,7 +19,7 @@ class HashmapPrivate;
 
 #define KYTY_HASH_DEFINE_CALC(type)                                                                                                        \
 	template <>                                                                                                                            \
-	uint32_t KYTY_HASH_CALL hash_calc<>(type const* key)
+	uint64_t KYTY_HASH_CALL hash_calc<>(type const* key)
 #define KYTY_HASH_DEFINE_EQUALS(type)                                                                                                      \
 	template <>                                                                                                                            \
 	bool KYTY_HASH_CALL hash_key_equals(type const* key_a, type const* key_b)
@@ -25,128 +27,213 @@ class HashmapPrivate;
 	static void KYTY_HASH_CALL name(K* key, V* value, void* arg) /* NOLINT(bugprone-macro-parentheses) */
 
 template <class T>
-uint32_t KYTY_HASH_CALL hash_calc(const T* key);
+uint64_t KYTY_HASH_CALL hash_calc(const T* key);
 template <class T>
 bool KYTY_HASH_CALL hash_key_equals(const T* key_a, const T* key_b);
 
-template <class T>
-void KYTY_HASH_CALL hash_key_copy(T* key_dst, const T* key_src)
-{
-	new (key_dst) T(*key_src);
-}
-
-template <class T>
-void KYTY_HASH_CALL hash_value_copy(T* value_dst, const T* value_src)
-{
-	new (value_dst) T(*value_src);
-}
+// Integers and pointers are hashed by value, Hashmap mixes the bits itself
+#define KYTY_HASH_DEFINE_INLINE(type, cast)                                                                                                \
+	template <>                                                                                                                            \
+	inline uint64_t KYTY_HASH_CALL hash_calc<>(type const* key)                                                                            \
+	{                                                                                                                                      \
+		return static_cast<uint64_t>(cast(*key));                                                                                          \
+	}                                                                                                                                      \
+	template <>                                                                                                                            \
+	inline bool KYTY_HASH_CALL hash_key_equals(type const* key_a, type const* key_b)                                                       \
+	{                                                                                                                                      \
+		return (*key_a) == (*key_b);                                                                                                       \
+	}
 
-template <class T>
-void KYTY_HASH_CALL hash_key_free(T* key)
+#define KYTY_HASH_DEFINE_INT(type) KYTY_HASH_DEFINE_INLINE(type, static_cast<type>)
+#define KYTY_HASH_DEFINE_PTR(type) KYTY_HASH_DEFINE_INLINE(type, reinterpret_cast<uintptr_t>)
+
+KYTY_HASH_DEFINE_INT(int8_t);
+KYTY_HASH_DEFINE_INT(uint8_t);
+KYTY_HASH_DEFINE_INT(int16_t);
+KYTY_HASH_DEFINE_INT(uint16_t);
+KYTY_HASH_DEFINE_INT(int32_t);
+KYTY_HASH_DEFINE_INT(uint32_t);
+KYTY_HASH_DEFINE_INT(int64_t);
+KYTY_HASH_DEFINE_INT(uint64_t);
+KYTY_HASH_DEFINE_INT(char16_t);
+KYTY_HASH_DEFINE_INT(char32_t);
+KYTY_HASH_DEFINE_PTR(int8_t*);
+KYTY_HASH_DEFINE_PTR(uint8_t*);
+KYTY_HASH_DEFINE_PTR(int16_t*);
+KYTY_HASH_DEFINE_PTR(uint16_t*);
+KYTY_HASH_DEFINE_PTR(int32_t*);
+KYTY_HASH_DEFINE_PTR(uint32_t*);
+KYTY_HASH_DEFINE_PTR(int64_t*);
+KYTY_HASH_DEFINE_PTR(uint64_t*);
+KYTY_HASH_DEFINE_PTR(char16_t*);
+KYTY_HASH_DEFINE_PTR(char32_t*);
+KYTY_HASH_DEFINE_PTR(void*);
+
+#undef KYTY_HASH_DEFINE_PTR
+#undef KYTY_HASH_DEFINE_INT
+#undef KYTY_HASH_DEFINE_INLINE
+
+// Heterogeneous lookup: Find/Get/Contains/Remove of Hashmap<K, V> accept a key of type Q without converting it to K.
+// Enable it only if hash_calc<Q> and hash_calc<K> give the same hash for equal keys, and K == Q is defined.
+template <class K, class Q>
+struct hash_is_transparent
+    : std::bool_constant<std::is_integral_v<K> && std::is_integral_v<Q> && std::is_signed_v<K> == std::is_signed_v<Q>>
 {
-	key->~T();
-}
+};
 
-template <class T>
-void KYTY_HASH_CALL hash_value_free(T* value)
-{
-	value->~T();
-}
-
-using hash_calc_func_t       = uint32_t (*)(const void*);
-using hash_key_equals_func_t = bool (*)(const void*, const void*);
-using hash_key_copy_func_t   = void (*)(void*, const void*);
-using hash_value_copy_func_t = void (*)(void*, const void*);
-using hash_key_free_func_t   = void (*)(void*);
-using hash_value_free_func_t = void (*)(void*);
-using hash_callback_func_t   = bool (*)(const void*, const void*, void*);
-
-class HashmapBase
+// Open addressing with linear probing. Keys and values are stored inline, removal shifts entries back (no tombstones).
+// Pointers to values are invalidated by any insertion or removal.
+template <class K, class V>
+class Hashmap
 {
 public:
-	HashmapBase(uint32_t key_size, uint32_t value_size, hash_calc_func_t hash, hash_key_equals_func_t equals, hash_key_copy_func_t key_copy,
-	            hash_value_copy_func_t value_copy, hash_key_free_func_t key_free, hash_value_free_func_t value_free);
+	Hashmap() = default;
+	virtual ~Hashmap() { Clear(); }
 
-	virtual ~HashmapBase();
-
-	void Clear();
-
-	[[nodiscard]] uint32_t Size() const;
+	void Clear()
+	{
+		if (m_ctrl != nullptr)
+		{
+			for (uint32_t i = 0; i <= m_mask; i++)
+			{
+				if (m_ctrl[i] != 0)
+				{
+					At(i)->~Entry();
+				}
+			}
+			delete[] m_ctrl;
+			delete[] m_slots;
+			m_ctrl  = nullptr;
+			m_slots = nullptr;
+			m_mask  = 0;
+			m_shift = 64;
+			m_size  = 0;
+		}
+	}
 
-	void        Put(const void* key, const void* value);
-	const void* Get(const void* key) const;
-	void        Remove(const void* key);
-	void*       OperatorSquareBrackets(const void* key, const void* default_value);
+	[[nodiscard]] uint32_t Size() const { return m_size; }
 
-	void                      Start() const;
-	[[nodiscard]] bool        End() const;
-	void                      Next() const;
-	[[nodiscard]] const void* Value() const;
-	[[nodiscard]] const void* Key() const;
-	void                      ForEach(hash_callback_func_t callback, void* arg) const;
-	[[nodiscard]] uint32_t    CollisionsCount() const;
+	void Reserve(uint32_t size)
+	{
+		uint32_t capacity = CapacityFor(size);
+		if (m_ctrl == nullptr || capacity > m_mask + 1)
+		{
+			Rehash(capacity);
+		}
+	}
 
-	KYTY_CLASS_NO_COPY(HashmapBase);
+	V& operator[](const K& key)
+	{
+		V def {};
+		return GetOrPutDef(key, def);
+	}
 
-private:
-	HashmapPrivate* m_p;
-};
+	V& GetOrPutDef(const K& key, const V& def)
+	{
+		uint64_t hash  = HashKey(key);
+		uint32_t index = FindIndex(key, hash);
+		return (index != INVALID_INDEX ? At(index)->value : Insert(key, hash, def)->value);
+	}
 
-template <class K, class V>
-class Hashmap
-{
-public:
-	Hashmap()
-	    : m_b(sizeof(K), sizeof(V), // NOLINT(bugprone-sizeof-expression)
-	          reinterpret_cast<hash_calc_func_t>(hash_calc<K>), reinterpret_cast<hash_key_equals_func_t>(hash_key_equals<K>),
-	          reinterpret_cast<hash_key_copy_func_t>(hash_key_copy<K>), reinterpret_cast<hash_value_copy_func_t>(hash_value_copy<V>),
-	          reinterpret_cast<hash_key_free_func_t>(hash_key_free<K>), reinterpret_cast<hash_value_free_func_t>(hash_value_free<V>))
+	void Put(const K& key, const V& value)
 	{
+		uint64_t hash  = HashKey(key);
+		uint32_t index = FindIndex(key, hash);
+		if (index != INVALID_INDEX)
+		{
+			At(index)->value = value;
+		} else
+		{
+			Insert(key, hash, value);
+		}
 	}
-	virtual ~Hashmap() = default;
 
-	void Clear() { m_b.Clear(); }
+	[[nodiscard]] V Get(const K& key, const V& default_value = V()) const { return GetImpl(key, default_value); }
 
-	[[nodiscard]] uint32_t Size() const { return m_b.Size(); }
+	[[nodiscard]] const V* Find(const K& key) const { return FindImpl(key); }
 
-	V& operator[](const K& key)
+	[[nodiscard]] bool Contains(const K& key) const { return FindImpl(key) != nullptr; }
+
+	void Remove(const K& key) { RemoveImpl(key); }
+
+	template <class Q, class = std::enable_if_t<hash_is_transparent<K, Q>::value>>
+	[[nodiscard]] V Get(const Q& key, const V& default_value = V()) const
 	{
-		V def {};
-		return *(static_cast<V*>(m_b.OperatorSquareBrackets(&key, &def)));
+		return GetImpl(key, default_value);
 	}
 
-	V& GetOrPutDef(const K& key, const V& def) { return *(static_cast<V*>(m_b.OperatorSquareBrackets(&key, &def))); }
+	template <class Q, class = std::enable_if_t<hash_is_transparent<K, Q>::value>>
+	[[nodiscard]] const V* Find(const Q& key) const
+	{
+		return FindImpl(key);
+	}
 
-	void Put(const K& key, const V& value) { m_b.Put(&key, &value); }
+	template <class Q, class = std::enable_if_t<hash_is_transparent<K, Q>::value>>
+	[[nodiscard]] bool Contains(const Q& key) const
+	{
+		return FindImpl(key) != nullptr;
+	}
 
-	[[nodiscard]] V Get(const K& key, const V& default_value = V()) const
+	template <class Q, class = std::enable_if_t<hash_is_transparent<K, Q>::value>>
+	void Remove(const Q& key)
 	{
-		const V* v = static_cast<const V*>(m_b.Get(&key));
-		return (v ? *v : default_value);
+		RemoveImpl(key);
 	}
 
-	[[nodiscard]] const V* Find(const K& key) const { return static_cast<const V*>(m_b.Get(&key)); }
+	void Start() const
+	{
+		m_loop_index = 0;
+		SkipEmpty();
+	}
 
-	[[nodiscard]] bool Contains(const K& key) const { return m_b.Get(&key); }
+	[[nodiscard]] bool End() const { return m_ctrl == nullptr || m_loop_index > m_mask; }
 
-	void Remove(const K& key) { m_b.Remove(&key); }
+	void Next() const
+	{
+		EXIT_IF(End());
 
-	void Start() const { m_b.Start(); }
+		m_loop_index++;
+		SkipEmpty();
+	}
 
-	[[nodiscard]] bool End() const { return m_b.End(); }
+	[[nodiscard]] const V& Value() const
+	{
+		EXIT_IF(End());
 
-	void Next() const { m_b.Next(); }
+		return At(m_loop_index)->value;
+	}
 
-	[[nodiscard]] const V& Value() const { return *(static_cast<const V*>(m_b.Value())); }
+	[[nodiscard]] const K& Key() const
+	{
+		EXIT_IF(End());
 
-	[[nodiscard]] const K& Key() const { return *(static_cast<const K*>(m_b.Key())); }
+		return At(m_loop_index)->key;
+	}
 
 	void ForEach(bool(KYTY_HASH_CALL* callback)(const K* key, const V* value, void* context), void* arg) const
 	{
-		m_b.ForEach(reinterpret_cast<hash_callback_func_t>(callback), arg);
+		for (uint32_t i = 0; m_ctrl != nullptr && i <= m_mask; i++)
+		{
+			if (m_ctrl[i] != 0 && !callback(&At(i)->key, &At(i)->value, arg))
+			{
+				break;
+			}
+		}
 	}
 
-	uint32_t CollisionsCount() { return m_b.CollisionsCount(); }
+	// Number of entries which are not in their home slot
+	uint32_t CollisionsCount()
+	{
+		uint32_t collisions = 0;
+		for (uint32_t i = 0; m_ctrl != nullptr && i <= m_mask; i++)
+		{
+			if (m_ctrl[i] != 0 && HomeIndex(At(i)->hash) != i)
+			{
+				collisions++;
+			}
+		}
+		return collisions;
+	}
 
 	bool operator==(const Hashmap<K, V>& other) const
 	{
@@ -173,7 +260,201 @@ public:
 	KYTY_CLASS_NO_COPY(Hashmap);
 
 private:
-	HashmapBase m_b;
+	static constexpr uint32_t INVALID_INDEX    = static_cast<uint32_t>(-1);
+	static constexpr uint32_t CAPACITY_INITIAL = 8;
+
+	struct Entry
+	{
+		uint64_t hash;
+		K        key;
+		V        value;
+	};
+
+	struct alignas(Entry) Slot
+	{
+		uint8_t data[sizeof(Entry)];
+	};
+
+	// Fibonacci hashing spreads weak hashes (identity of integers, aligned pointers) over the whole table
+	template <class Q>
+	static uint64_t HashKey(const Q& key)
+	{
+		return hash_calc<Q>(&key) * 0x9E3779B97F4A7C15ull;
+	}
+
+	template <class Q>
+	static bool EqualKeys(const K& key_a, const Q& key_b)
+	{
+		if constexpr (std::is_same_v<K, Q>)
+		{
+			return hash_key_equals<K>(&key_a, &key_b);
+		} else
+		{
+			return key_a == key_b;
+		}
+	}
+
+	static uint32_t CapacityFor(uint32_t size)
+	{
+		uint32_t capacity = CAPACITY_INITIAL;
+		while (size > (capacity / 4) * 3)
+		{
+			capacity <<= 1u;
+		}
+		return capacity;
+	}
+
+	// Index comes from the top bits, the tag from the bits below them. Non-zero tag marks a used slot.
+	[[nodiscard]] uint32_t HomeIndex(uint64_t hash) const { return static_cast<uint32_t>(hash >> m_shift); }
+	[[nodiscard]] uint8_t  Tag(uint64_t hash) const { return static_cast<uint8_t>(0x80u | ((hash >> (m_shift - 7)) & 0x7fu)); }
+
+	[[nodiscard]] Entry* At(uint32_t index) const { return std::launder(reinterpret_cast<Entry*>(m_slots[index].data)); }
+
+	void SkipEmpty() const
+	{
+		while (m_ctrl != nullptr && m_loop_index <= m_mask && m_ctrl[m_loop_index] == 0)
+		{
+			m_loop_index++;
+		}
+	}
+
+	template <class Q>
+	[[nodiscard]] uint32_t FindIndex(const Q& key, uint64_t hash) const
+	{
+		if (m_size == 0)
+		{
+			return INVALID_INDEX;
+		}
+
+		uint8_t tag = Tag(hash);
+
+		for (uint32_t index = HomeIndex(hash);; index = (index + 1) & m_mask)
+		{
+			uint8_t c = m_ctrl[index];
+			if (c == 0)
+			{
+				return INVALID_INDEX;
+			}
+			if (c == tag)
+			{
+				const Entry* e = At(index);
+				if (e->hash == hash && EqualKeys(e->key, key))
+				{
+					return index;
+				}
+			}
+		}
+	}
+
+	template <class Q>
+	[[nodiscard]] const V* FindImpl(const Q& key) const
+	{
+		uint32_t index = FindIndex(key, HashKey(key));
+		return (index != INVALID_INDEX ? &At(index)->value : nullptr);
+	}
+
+	template <class Q>
+	[[nodiscard]] V GetImpl(const Q& key, const V& default_value) const
+	{
+		const V* v = FindImpl(key);
+		return (v != nullptr ? *v : default_value);
+	}
+
+	// Key must not be present
+	Entry* Insert(const K& key, uint64_t hash, const V& value)
+	{
+		if (m_ctrl == nullptr || m_size + 1 > ((m_mask + 1) / 4) * 3)
+		{
+			Rehash(CapacityFor(m_size + 1));
+		}
+
+		uint32_t index = HomeIndex(hash);
+		while (m_ctrl[index] != 0)
+		{
+			index = (index + 1) & m_mask;
+		}
+
+		m_ctrl[index] = Tag(hash);
+		auto* e       = new (m_slots[index].data) Entry {hash, key, value};
+		m_size++;
+		return e;
+	}
+
+	template <class Q>
+	void RemoveImpl(const Q& key)
+	{
+		uint32_t index = FindIndex(key, HashKey(key));
+		if (index == INVALID_INDEX)
+		{
+			return;
+		}
+
+		At(index)->~Entry();
+		m_ctrl[index] = 0;
+		m_size--;
+
+		// Shift back the following entries of the cluster which may not stay behind the hole
+		for (uint32_t next = (index + 1) & m_mask; m_ctrl[next] != 0; next = (next + 1) & m_mask)
+		{
+			uint32_t home = HomeIndex(At(next)->hash);
+			if (((next - home) & m_mask) >= ((next - index) & m_mask))
+			{
+				new (m_slots[index].data) Entry(std::move(*At(next)));
+				At(next)->~Entry();
+				m_ctrl[index] = m_ctrl[next];
+				m_ctrl[next]  = 0;
+				index         = next;
+			}
+		}
+	}
+
+	void Rehash(uint32_t capacity)
+	{
+		EXIT_IF(capacity < m_size || (capacity & (capacity - 1)) != 0);
+
+		auto*    old_ctrl  = m_ctrl;
+		auto*    old_slots = m_slots;
+		uint32_t old_mask  = m_mask;
+
+		m_ctrl  = new uint8_t[capacity];
+		m_slots = new Slot[capacity];
+		m_mask  = capacity - 1;
+		m_shift = 64;
+		for (uint32_t c = capacity; c > 1; c >>= 1u)
+		{
+			m_shift--;
+		}
+
+		std::memset(m_ctrl, 0, capacity);
+
+		if (old_ctrl != nullptr)
+		{
+			for (uint32_t i = 0; i <= old_mask; i++)
+			{
+				if (old_ctrl[i] != 0)
+				{
+					auto*    e     = std::launder(reinterpret_cast<Entry*>(old_slots[i].data));
+					uint32_t index = HomeIndex(e->hash);
+					while (m_ctrl[index] != 0)
+					{
+						index = (index + 1) & m_mask;
+					}
+					m_ctrl[index] = Tag(e->hash);
+					new (m_slots[index].data) Entry(std::move(*e));
+					e->~Entry();
+				}
+			}
+			delete[] old_ctrl;
+			delete[] old_slots;
+		}
+	}
+
+	uint8_t*         m_ctrl       = nullptr;
+	Slot*            m_slots      = nullptr;
+	uint32_t         m_mask       = 0;
+	uint32_t         m_shift      = 64;
+	uint32_t         m_size       = 0;
+	mutable uint32_t m_loop_index = 0;
 };
 
 #define FOR_HASH(h) for ((h).Start(); !(h).End(); (h).Next()) /*NOLINT(cppcoreguidelines-macro-usage)*/
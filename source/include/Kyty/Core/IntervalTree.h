@@ -0,0 +1,42 @@
+#ifndef INCLUDE_KYTY_CORE_INTERVALTREE_H_
+#define INCLUDE_KYTY_CORE_INTERVALTREE_H_
+
+#include "Kyty/Core/Common.h"
+#include "Kyty/Core/Vector.h"
+
+namespace Kyty::Core {
+
+struct IntervalTreePrivate;
+
+// Set of address ranges [start, start + size) tagged with an id. The same id can own several ranges.
+// Balanced tree ordered by start, every node keeps the largest end of its subtree, so overlap queries
+// are O(log n + k) where k is the number of reported ranges.
+class IntervalTree
+{
+public:
+	IntervalTree();
+	virtual ~IntervalTree();
+
+	void Insert(uint64_t start, uint64_t size, int id);
+
+	// Returns false if the range was not inserted with this id
+	bool Erase(uint64_t start, uint64_t size, int id);
+
+	// Adds ids of all ranges which overlap [start, start + size). An id is added once per overlapping range.
+	void FindOverlaps(uint64_t start, uint64_t size, Vector<int>* ids) const;
+
+	// Adds ids of all ranges which start at the address
+	void FindStart(uint64_t start, Vector<int>* ids) const;
+
+	[[nodiscard]] uint32_t Size() const;
+	[[nodiscard]] bool     IsEmpty() const { return Size() == 0; }
+
+	KYTY_CLASS_NO_COPY(IntervalTree);
+
+private:
+	IntervalTreePrivate* m_p;
+};
+
+} // namespace Kyty::Core
+
+#endif /* INCLUDE_KYTY_CORE_INTERVALTREE_H_ */
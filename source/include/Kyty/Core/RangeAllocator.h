@@ -0,0 +1,40 @@
+#ifndef INCLUDE_KYTY_CORE_RANGEALLOCATOR_H_
+#define INCLUDE_KYTY_CORE_RANGEALLOCATOR_H_
+
+#include "Kyty/Core/Common.h"
+
+namespace Kyty::Core {
+
+struct RangeAllocatorPrivate;
+
+// Best-fit allocator of address ranges (no memory is touched).
+// Free ranges are kept ordered by address (for merging) and by size (for best-fit search),
+// so Alloc and Free are O(log n) unless the search range or alignment rejects the best candidates.
+class RangeAllocator
+{
+public:
+	RangeAllocator(uint64_t base, uint64_t size);
+	virtual ~RangeAllocator();
+
+	// Returns the lowest suitable address inside the smallest free range that can hold
+	// [addr, addr + size) with addr aligned and addr >= search_start, addr + size <= search_end
+	bool Alloc(uint64_t search_start, uint64_t search_end, uint64_t size, uint64_t alignment, uint64_t* addr_out);
+
+	// Returns false if the range is out of bounds or (partially) free already
+	bool Free(uint64_t addr, uint64_t size);
+
+	[[nodiscard]] uint64_t GetBase() const;
+	[[nodiscard]] uint64_t GetSize() const;
+	[[nodiscard]] uint64_t GetFreeSize() const;
+	[[nodiscard]] uint64_t GetLargestFree() const;
+	[[nodiscard]] uint32_t GetFreeRangesNum() const;
+
+	KYTY_CLASS_NO_COPY(RangeAllocator);
+
+private:
+	RangeAllocatorPrivate* m_p;
+};
+
+} // namespace Kyty::Core
+
+#endif /* INCLUDE_KYTY_CORE_RANGEALLOCATOR_H_ */
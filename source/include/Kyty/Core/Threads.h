@@ -4,6 +4,8 @@
 #include "Kyty/Core/Common.h"
 #include "Kyty/Core/Subsystems.h"
 
+#include <atomic>
+
 namespace Kyty::Core {
 
 KYTY_SUBSYSTEM_DEFINE(Threads);
@@ -49,10 +51,19 @@ private:
 	ThreadPrivate* m_thread;
 };
 
+// On Linux the mutex is a futex word which spins a bit before going to sleep. A normal mutex can't be locked
+// again by the owner, use Type::Recursive for that. Other platforms keep the system mutex, which is always recursive.
 class Mutex
 {
 public:
+	enum class Type
+	{
+		Normal,
+		Recursive
+	};
+
 	Mutex();
+	explicit Mutex(Type type);
 	virtual ~Mutex();
 
 	void Lock();
@@ -64,7 +75,14 @@ public:
 	KYTY_CLASS_NO_COPY(Mutex);
 
 private:
-	MutexPrivate* m_mutex;
+	void LockContended(int thread_id);
+
+	std::atomic_uint32_t m_state {0};
+	std::atomic_int      m_owner {0};
+	std::atomic_int      m_spin {0};
+	uint32_t             m_count = 0;
+	Type                 m_type  = Type::Normal;
+	MutexPrivate*        m_mutex = nullptr;
 };
 
 class DummyMutex final
@@ -119,6 +137,30 @@ private:
 	mutex_type& m_mutex;
 };
 
+// Double-checked lazy creation of an object published through an atomic pointer. The mutex is locked only while the slot is empty,
+// create() is called under it at most once per slot and returns the object to publish.
+template <class T, class F>
+T* LazyCreate(std::atomic<T*>* slot, Mutex* mutex, F&& create)
+{
+	if (T* obj = slot->load(std::memory_order_acquire); obj != nullptr)
+	{
+		return obj;
+	}
+
+	LockGuard lock(*mutex);
+
+	T* obj = slot->load(std::memory_order_relaxed);
+
+	if (obj == nullptr)
+	{
+		// Built aside, other threads may already be reading the slot without the lock
+		obj = create();
+		slot->store(obj, std::memory_order_release);
+	}
+
+	return obj;
+}
+
 } // namespace Kyty::Core
 
 #endif /* INCLUDE_KYTY_CORE_THREADS_H_ */
@@ -58,6 +58,9 @@ public:
 
 	static bool InstallVectored(handler_func_t func);
 
+	// The handler of the calling thread runs on a separate stack, so it doesn't overflow a small guest stack. No-op on Windows.
+	static bool InstallAltStack();
+
 private:
 	ExceptionHandlerPrivate* m_p = nullptr;
 };
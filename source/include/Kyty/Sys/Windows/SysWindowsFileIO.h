@@ -24,7 +24,8 @@ enum sys_file_type_t
 	SYS_FILE_ERROR,       // NOLINT(readability-identifier-naming)
 	SYS_FILE_MEMORY_STAT, // NOLINT(readability-identifier-naming)
 	SYS_FILE_FILE,        // NOLINT(readability-identifier-naming)
-	SYS_FILE_MEMORY_DYN   // NOLINT(readability-identifier-naming)
+	SYS_FILE_MEMORY_DYN,  // NOLINT(readability-identifier-naming)
+	SYS_FILE_MAPPED       // NOLINT(readability-identifier-naming)
 };
 
 // NOLINTNEXTLINE(readability-identifier-naming)
@@ -40,7 +41,7 @@ struct sys_file_mem_buf_t
 {
 	uint8_t* base;
 	uint8_t* ptr;
-	uint32_t size;
+	uint64_t size;
 };
 
 // NOLINTNEXTLINE(readability-identifier-naming)
@@ -70,14 +71,19 @@ struct sys_dir_entry_t
 	bool   is_file;
 };
 
-void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_read = nullptr);           // NOLINT(google-runtime-references)
-void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_written = nullptr); // NOLINT(google-runtime-references)
+void sys_file_read(void* data, uint64_t size, sys_file_t& f, uint64_t* bytes_read = nullptr);           // NOLINT(google-runtime-references)
+void sys_file_write(const void* data, uint64_t size, sys_file_t& f, uint64_t* bytes_written = nullptr); // NOLINT(google-runtime-references)
 void sys_file_read_r(void* data, uint32_t size, sys_file_t& f);                                         // NOLINT(google-runtime-references)
 void sys_file_write_r(const void* data, uint32_t size, sys_file_t& f);                                  // NOLINT(google-runtime-references)
+// NOLINTNEXTLINE(google-runtime-references)
+void sys_file_read_at(void* data, uint64_t size, uint64_t offset, sys_file_t& f, uint64_t* bytes_read = nullptr);
+// NOLINTNEXTLINE(google-runtime-references)
+void sys_file_write_at(const void* data, uint64_t size, uint64_t offset, sys_file_t& f, uint64_t* bytes_written = nullptr);
 sys_file_t*       sys_file_create(const String& file_name);
 sys_file_t*       sys_file_open_r(const String& file_name, sys_file_cache_type_t cache_type = SYS_FILE_CACHE_AUTO);
 sys_file_t*       sys_file_open_w(const String& file_name, sys_file_cache_type_t cache_type = SYS_FILE_CACHE_AUTO);
-sys_file_t*       sys_file_open(uint8_t* buf, uint32_t buf_size);
+sys_file_t*       sys_file_open_mapped(const String& file_name, sys_file_cache_type_t cache_type = SYS_FILE_CACHE_AUTO);
+sys_file_t*       sys_file_open(uint8_t* buf, uint64_t buf_size);
 sys_file_t*       sys_file_create();
 sys_file_t*       sys_file_open_rw(const String& file_name, sys_file_cache_type_t cache_type = SYS_FILE_CACHE_AUTO);
 void              sys_file_close(sys_file_t* f);
@@ -49,7 +49,7 @@ struct InStream
 	ISeqInStream t {};
 	Core::File   mem_file;
 
-	void Init(const uint8_t* buf, uint32_t size);
+	void Init(const uint8_t* buf, uint64_t size);
 	void Close();
 };
 
@@ -70,12 +70,8 @@ SRes Read(void* p, void* buf, size_t* size)
 	EXIT_IF(!buf);
 	EXIT_IF(!size);
 
-	uint64_t s64 = *size;
-
-	EXIT_IF((s64 >> 32u) != 0);
-
-	uint32_t br = 0;
-	s->mem_file.Read(buf, s64, &br);
+	uint64_t br = 0;
+	s->mem_file.Read(buf, *size, &br);
 
 	//	if (br != s64)
 	//	{
@@ -119,7 +115,7 @@ void Free(void* /*p*/, void* address)
 	Core::mem_free(address);
 }
 
-void InStream::Init(const uint8_t* buf, uint32_t size)
+void InStream::Init(const uint8_t* buf, uint64_t size)
 {
 	this->t.Read = Read;
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
@@ -161,22 +157,16 @@ void* Realloc(void* /*opaque*/, void* address, size_t items, size_t size)
 size_t Read(void* opaque, mz_uint64 file_ofs, void* buf, size_t n)
 {
 	File* f = static_cast<File*>(opaque);
-	f->Seek(file_ofs);
-	uint32_t b = 0;
-	EXIT_IF(sizeof(size_t) > 4 && (uint64_t(n) >> 32u) > 0);
-	auto nn = static_cast<uint32_t>(n);
-	f->Read(buf, nn, &b);
+	uint64_t b = 0;
+	f->ReadAt(buf, n, file_ofs, &b);
 	return b;
 }
 
 size_t Write(void* opaque, mz_uint64 file_ofs, const void* buf, size_t n)
 {
 	File* f = static_cast<File*>(opaque);
-	f->Seek(file_ofs);
-	uint32_t b = 0;
-	EXIT_IF(sizeof(size_t) > 4 && (uint64_t(n) >> 32u) > 0);
-	auto nn = static_cast<uint32_t>(n);
-	f->Write(buf, nn, &b);
+	uint64_t b = 0;
+	f->WriteAt(buf, n, file_ofs, &b);
 	return b;
 }
 
@@ -641,7 +631,7 @@ static uint32_t lzf_decompress(const void* input, uint32_t length, void* output,
 	return op - static_cast<uint8_t*>(output);
 }
 
-ByteBuffer CompressLzma(const uint8_t* buf, uint32_t length)
+ByteBuffer CompressLzma(const uint8_t* buf, uint64_t length)
 {
 	CLzmaEncHandle enc = LzmaEnc_Create(&LzmaImpl::g_alloc_lzma);
 
@@ -669,9 +659,7 @@ ByteBuffer CompressLzma(const uint8_t* buf, uint32_t length)
 
 	EXIT_IF(res != SZ_OK || size != LZMA_PROPS_SIZE);
 
-	uint64_t length64 = length;
-
-	std::memcpy(header + LZMA_PROPS_SIZE, &length64, 8);
+	std::memcpy(header + LZMA_PROPS_SIZE, &length, 8);
 
 	in_stream.Init(buf, length);
 	out_stream.Init(0);
@@ -762,7 +750,7 @@ static SRes Decode2(CLzmaDec* state, ISeqOutStream* out_stream, ISeqInStream* in
 	return SZ_OK;
 }
 
-ByteBuffer DecompressLzma(const uint8_t* buf, uint32_t length)
+ByteBuffer DecompressLzma(const uint8_t* buf, uint64_t length)
 {
 	EXIT_IF(!buf);
 	EXIT_IF(length == 0);
@@ -813,7 +801,7 @@ ByteBuffer DecompressLzma(const ByteBuffer& buf)
 	return DecompressLzma(reinterpret_cast<const uint8_t*>(buf.GetDataConst()), buf.Size());
 }
 
-String DecompressLzmaStr(const uint8_t* buf, uint32_t length)
+String DecompressLzmaStr(const uint8_t* buf, uint64_t length)
 {
 	ByteBuffer utf8 = DecompressLzma(buf, length);
 	EXIT_IF(utf8.At(utf8.Size() - 1) != (Byte)0);
@@ -826,8 +814,22 @@ String DecompressLzmaStr(const ByteBuffer& buf)
 }
 
 constexpr uint32_t ZIP_OUT_BUF_SIZE = (16 * 1024);
+constexpr uint64_t ZIP_IN_CHUNK     = (1024 * 1024 * 1024);
 
-ByteBuffer CompressZip(const uint8_t* buf, uint32_t length, ZipCompressLevel level)
+// mz_stream has a 32-bit input size, a longer buffer is given in parts. Returns true when the last part is in.
+static bool zip_feed_input(mz_stream* stream, const uint8_t* buf, uint64_t length)
+{
+	uint64_t left = length - static_cast<uint64_t>(stream->next_in - buf);
+
+	if (stream->avail_in == 0)
+	{
+		stream->avail_in = static_cast<unsigned int>(left < ZIP_IN_CHUNK ? left : ZIP_IN_CHUNK);
+	}
+
+	return left == stream->avail_in;
+}
+
+ByteBuffer CompressZip(const uint8_t* buf, uint64_t length, ZipCompressLevel level)
 {
 	int       status = 0;
 	mz_stream stream;
@@ -836,10 +838,9 @@ ByteBuffer CompressZip(const uint8_t* buf, uint32_t length, ZipCompressLevel lev
 	ByteBuffer out;
 	uint8_t    temp_buf[ZIP_OUT_BUF_SIZE];
 
-	stream.next_in  = buf;
-	stream.avail_in = length;
-	stream.zalloc   = ZipImpl::Alloc;
-	stream.zfree    = ZipImpl::Free;
+	stream.next_in = buf;
+	stream.zalloc  = ZipImpl::Alloc;
+	stream.zfree   = ZipImpl::Free;
 
 	status = mz_deflateInit(&stream, level);
 
@@ -849,10 +850,12 @@ ByteBuffer CompressZip(const uint8_t* buf, uint32_t length, ZipCompressLevel lev
 	{
 		for (;;)
 		{
+			bool last = zip_feed_input(&stream, buf, length);
+
 			stream.next_out  = temp_buf;
 			stream.avail_out = ZIP_OUT_BUF_SIZE;
 
-			status = mz_deflate(&stream, MZ_FINISH);
+			status = mz_deflate(&stream, last ? MZ_FINISH : MZ_NO_FLUSH);
 
 			EXIT_IF(status != MZ_OK && status != MZ_STREAM_END);
 
@@ -883,7 +886,7 @@ ByteBuffer CompressZip(const String& str, ZipCompressLevel level)
 	return CompressZip(reinterpret_cast<const uint8_t*>(utf8.GetDataConst()), utf8.Size(), level);
 }
 
-ByteBuffer DecompressZip(const uint8_t* buf, uint32_t length)
+ByteBuffer DecompressZip(const uint8_t* buf, uint64_t length)
 {
 	int       status = 0;
 	mz_stream stream;
@@ -892,10 +895,9 @@ ByteBuffer DecompressZip(const uint8_t* buf, uint32_t length)
 	ByteBuffer out;
 	uint8_t    temp_buf[ZIP_OUT_BUF_SIZE];
 
-	stream.next_in  = buf;
-	stream.avail_in = length;
-	stream.zalloc   = ZipImpl::Alloc;
-	stream.zfree    = ZipImpl::Free;
+	stream.next_in = buf;
+	stream.zalloc  = ZipImpl::Alloc;
+	stream.zfree   = ZipImpl::Free;
 
 	status = mz_inflateInit(&stream);
 
@@ -905,6 +907,8 @@ ByteBuffer DecompressZip(const uint8_t* buf, uint32_t length)
 	{
 		for (;;)
 		{
+			zip_feed_input(&stream, buf, length);
+
 			stream.next_out  = temp_buf;
 			stream.avail_out = ZIP_OUT_BUF_SIZE;
 
@@ -933,7 +937,7 @@ ByteBuffer DecompressZip(const ByteBuffer& buf)
 	return DecompressZip(reinterpret_cast<const uint8_t*>(buf.GetDataConst()), buf.Size());
 }
 
-String DecompressZipStr(const uint8_t* buf, uint32_t length)
+String DecompressZipStr(const uint8_t* buf, uint64_t length)
 {
 	ByteBuffer utf8 = DecompressZip(buf, length);
 	EXIT_IF(utf8.At(utf8.Size() - 1) != Byte(0));
@@ -945,11 +949,13 @@ String DecompressZipStr(const ByteBuffer& buf)
 	return DecompressZipStr(reinterpret_cast<const uint8_t*>(buf.GetDataConst()), buf.Size());
 }
 
-ByteBuffer CompressLzf(const uint8_t* buf, uint32_t length)
+ByteBuffer CompressLzf(const uint8_t* buf, uint64_t length)
 {
-	uint32_t   size = lzf_calc_compressed_size(buf, length);
+	EXIT_NOT_IMPLEMENTED(length > UINT32_MAX);
+
+	uint32_t   size = lzf_calc_compressed_size(buf, static_cast<uint32_t>(length));
 	ByteBuffer b(size * 2);
-	size = lzf_compress(buf, length, b.GetData());
+	size = lzf_compress(buf, static_cast<uint32_t>(length), b.GetData());
 
 	KYTY_MEM_CHECK(b.GetDataConst());
 
@@ -974,11 +980,13 @@ ByteBuffer CompressLzf(const String& str)
 	return CompressLzf(reinterpret_cast<const uint8_t*>(utf8.GetDataConst()), utf8.Size());
 }
 
-ByteBuffer DecompressLzf(const uint8_t* buf, uint32_t length)
+ByteBuffer DecompressLzf(const uint8_t* buf, uint64_t length)
 {
-	[[maybe_unused]] uint32_t size = lzf_calc_decompressed_size(buf, length);
+	EXIT_NOT_IMPLEMENTED(length > UINT32_MAX);
+
+	[[maybe_unused]] uint32_t size = lzf_calc_decompressed_size(buf, static_cast<uint32_t>(length));
 	ByteBuffer                b(size);
-	size = lzf_decompress(buf, length, b.GetData(), size);
+	size = lzf_decompress(buf, static_cast<uint32_t>(length), b.GetData(), size);
 
 	EXIT_IF(size != b.Size());
 
@@ -990,7 +998,7 @@ ByteBuffer DecompressLzf(const ByteBuffer& buf)
 	return DecompressLzf(reinterpret_cast<const uint8_t*>(buf.GetDataConst()), buf.Size());
 }
 
-String DecompressLzfStr(const uint8_t* buf, uint32_t length)
+String DecompressLzfStr(const uint8_t* buf, uint64_t length)
 {
 	ByteBuffer utf8 = DecompressLzf(buf, length);
 	EXIT_IF(utf8.At(utf8.Size() - 1) != (Byte)0);
@@ -1002,7 +1010,7 @@ String DecompressLzfStr(const ByteBuffer& buf)
 	return DecompressLzfStr(reinterpret_cast<const uint8_t*>(buf.GetDataConst()), buf.Size());
 }
 
-ByteBuffer CompressZstd(const uint8_t* buf, uint32_t length, int level)
+ByteBuffer CompressZstd(const uint8_t* buf, uint64_t length, int level)
 {
 	size_t dst_size = ZSTD_compressBound(length) * 2;
 	auto*  dst      = new uint8_t[dst_size];
@@ -1011,6 +1019,7 @@ ByteBuffer CompressZstd(const uint8_t* buf, uint32_t length, int level)
 	{
 		EXIT("ZSTD: %s\n", ZSTD_getErrorName(dst_size));
 	}
+	EXIT_NOT_IMPLEMENTED(dst_size > UINT32_MAX);
 	ByteBuffer ret(dst, static_cast<uint32_t>(dst_size));
 	DeleteArray(dst);
 	return ret;
@@ -1027,7 +1036,7 @@ ByteBuffer CompressZstd(const String& str, int level)
 	return CompressZstd(reinterpret_cast<const uint8_t*>(utf8.GetDataConst()), utf8.Size(), level);
 }
 
-ByteBuffer DecompressZstd(const uint8_t* buf, uint32_t length)
+ByteBuffer DecompressZstd(const uint8_t* buf, uint64_t length)
 {
 	ByteBuffer       r;
 	size_t           buff_out_size = ZSTD_DStreamOutSize();
@@ -1054,7 +1063,7 @@ ByteBuffer DecompressZstd(const ByteBuffer& buf)
 	return DecompressZstd(reinterpret_cast<const uint8_t*>(buf.GetDataConst()), buf.Size());
 }
 
-String DecompressZstdStr(const uint8_t* buf, uint32_t length)
+String DecompressZstdStr(const uint8_t* buf, uint64_t length)
 {
 	ByteBuffer utf8 = DecompressZstd(buf, length);
 	EXIT_IF(utf8.At(utf8.Size() - 1) != (Byte)0);
@@ -1130,7 +1139,7 @@ bool ZipReader::Open(const ByteBuffer& buf)
 	return true;
 }
 
-bool ZipReader::Open(uint8_t* mem, uint32_t size)
+bool ZipReader::Open(uint8_t* mem, uint64_t size)
 {
 	Close();
 
@@ -1330,7 +1339,7 @@ bool ZipWriter::AddFile(const String& file_name, const ByteBuffer& buf, ZipCompr
 	return false;
 }
 
-bool ZipWriter::AddFile(const String& file_name, const uint8_t* buf, uint32_t size, ZipCompressLevel level)
+bool ZipWriter::AddFile(const String& file_name, const uint8_t* buf, uint64_t size, ZipCompressLevel level)
 {
 	EXIT_IF(!m_p);
 	EXIT_IF(!buf && size > 0);
@@ -84,7 +84,7 @@ struct KytyFile
 
 static int KytyDirectWrite(KytyFile* p, const void* z_buf, int i_amt, sqlite_int64 i_ofst)
 {
-	uint32_t n_write = 0; /* Return value from write() */
+	uint64_t n_write = 0; /* Return value from write() */
 
 	if (!p->fd->Seek(i_ofst))
 	{
@@ -125,7 +125,7 @@ static int KytyClose(sqlite3_file* p_file)
 static int KytyRead(sqlite3_file* p_file, void* z_buf, int i_amt, sqlite_int64 i_ofst)
 {
 	auto*    p      = reinterpret_cast<KytyFile*>(p_file);
-	uint32_t n_read = 0;
+	uint64_t n_read = 0;
 
 	if (int rc = KytyFlushBuffer(p); rc != SQLITE_OK)
 	{
@@ -105,28 +105,40 @@ bool File::Create(const String& name)
 	return true;
 }
 
-bool File::Open(const String& name, Mode mode)
+static sys_file_cache_type_t get_cache_type(File::CacheHint hint)
+{
+	switch (hint)
+	{
+		case File::CacheHint::RandomAccess: return SYS_FILE_CACHE_RANDOM_ACCESS;
+		case File::CacheHint::SequentialScan: return SYS_FILE_CACHE_SEQUENTIAL_SCAN;
+		default: return SYS_FILE_CACHE_AUTO;
+	}
+}
+
+bool File::Open(const String& name, Mode mode, CacheHint hint)
 {
 	EXIT_IF(m_p->f != nullptr);
 
 	m_file_name = name;
 
+	auto cache_type = get_cache_type(hint);
+
 	if (mode == Mode::Read)
 	{
-		m_p->f = sys_file_open_r(*g_assets_dir + *g_assets_sub_dir + name);
+		m_p->f = sys_file_open_r(*g_assets_dir + *g_assets_sub_dir + name, cache_type);
 
 		if ((m_p->f == nullptr) || sys_file_is_error(*m_p->f))
 		{
 			Close();
-			m_p->f = sys_file_open_r(name);
+			m_p->f = sys_file_open_r(name, cache_type);
 		}
 	} else if (mode == Mode::Write)
 	{
-		m_p->f = sys_file_open_w(name);
+		m_p->f = sys_file_open_w(name, cache_type);
 	}
 	if (mode == Mode::ReadWrite || mode == Mode::WriteRead)
 	{
-		m_p->f = sys_file_open_rw(name);
+		m_p->f = sys_file_open_rw(name, cache_type);
 	}
 
 	if ((m_p->f == nullptr) || sys_file_is_error(*m_p->f))
@@ -138,7 +150,25 @@ bool File::Open(const String& name, Mode mode)
 	return true;
 }
 
-bool File::OpenInMem(void* buf, uint32_t buf_size)
+// Read-only, the whole file is mapped into memory. Writes are ignored.
+bool File::OpenMapped(const String& name, CacheHint hint)
+{
+	EXIT_IF(m_p->f != nullptr);
+
+	m_file_name = name;
+
+	m_p->f = sys_file_open_mapped(name, get_cache_type(hint));
+
+	if ((m_p->f == nullptr) || sys_file_is_error(*m_p->f))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool File::OpenInMem(void* buf, uint64_t buf_size)
 {
 	EXIT_IF(m_p->f != nullptr);
 
@@ -228,7 +258,7 @@ uint64_t File::Tell() const
 	return sys_file_tell(*m_p->f);
 }
 
-void File::Read(void* data, uint32_t size, uint32_t* bytes_read)
+void File::Read(void* data, uint64_t size, uint64_t* bytes_read)
 {
 	EXIT_IF(m_p->f == nullptr);
 
@@ -238,13 +268,27 @@ void File::Read(void* data, uint32_t size, uint32_t* bytes_read)
 	}
 }
 
-void File::Write(const void* data, uint32_t size, uint32_t* bytes_written)
+void File::Write(const void* data, uint64_t size, uint64_t* bytes_written)
 {
 	EXIT_IF(m_p->f == nullptr);
 
 	sys_file_write(data, size, *m_p->f, bytes_written);
 }
 
+void File::ReadAt(void* data, uint64_t size, uint64_t offset, uint64_t* bytes_read)
+{
+	EXIT_IF(m_p->f == nullptr);
+
+	sys_file_read_at(data, size, offset, *m_p->f, bytes_read);
+}
+
+void File::WriteAt(const void* data, uint64_t size, uint64_t offset, uint64_t* bytes_written)
+{
+	EXIT_IF(m_p->f == nullptr);
+
+	sys_file_write_at(data, size, offset, *m_p->f, bytes_written);
+}
+
 void File::ReadR(void* data, uint32_t size)
 {
 	EXIT_IF(m_p->f == nullptr);
@@ -259,7 +303,7 @@ void File::WriteR(const void* data, uint32_t size)
 	sys_file_write_r(data, size, *m_p->f);
 }
 
-void File::Write(const String& str, uint32_t* bytes_written)
+void File::Write(const String& str, uint64_t* bytes_written)
 {
 	EXIT_IF(IsInvalid());
 
@@ -277,7 +321,7 @@ void File::Write(const String& str, uint32_t* bytes_written)
 		case Encoding::Utf16BE:
 		{
 			String::Utf16 u  = str.utf16_str();
-			uint32_t      bw = 0;
+			uint64_t      bw = 0;
 			for (auto& b: u)
 			{
 				SwapByteOrder(b);
@@ -292,7 +336,7 @@ void File::Write(const String& str, uint32_t* bytes_written)
 		case Encoding::Utf16LE:
 		{
 			String::Utf16 u  = str.utf16_str();
-			uint32_t      bw = 0;
+			uint64_t      bw = 0;
 			Write(u.GetData(), (u.Size() - 1) * 2, &bw);
 			if (bytes_written != nullptr)
 			{
@@ -303,7 +347,7 @@ void File::Write(const String& str, uint32_t* bytes_written)
 		case Encoding::Utf32BE:
 		{
 			String::Utf32 u  = str.utf32_str();
-			uint32_t      bw = 0;
+			uint64_t      bw = 0;
 			for (auto& b: u)
 			{
 				SwapByteOrder(b);
@@ -318,7 +362,7 @@ void File::Write(const String& str, uint32_t* bytes_written)
 		case Encoding::Utf32LE:
 		{
 			String::Utf32 u  = str.utf32_str();
-			uint32_t      bw = 0;
+			uint64_t      bw = 0;
 			Write(u.GetData(), (u.Size() - 1) * 4, &bw);
 			if (bytes_written != nullptr)
 			{
@@ -331,7 +375,7 @@ void File::Write(const String& str, uint32_t* bytes_written)
 		default:
 		{
 			String::Utf8 u  = str.utf8_str();
-			uint32_t     bw = 0;
+			uint64_t     bw = 0;
 			Write(u.GetData(), u.Size() - 1, &bw);
 			if (bytes_written != nullptr)
 			{
@@ -401,7 +445,7 @@ static void file_read_line(File* f, T end_line, Vector<T>& buf, OP&& swap)
 	for (;;)
 	{
 		T        c;
-		uint32_t br = 0;
+		uint64_t br = 0;
 		f->Read(&c, sizeof(c), &br);
 		swap(c);
 		if (br == 0)
@@ -662,15 +706,9 @@ static size_t myreadfunc(SDL_RWops* context, void* ptr, size_t size, size_t maxn
 {
 	File* f = static_cast<File*>(context->hidden.unknown.data1);
 
-	uint32_t bytes = 0;
-
-	size_t sm = size * maxnum;
-
-	EXIT_IF(sizeof(size_t) > 4 && (uint64_t(sm) >> 32u) > 0);
+	uint64_t bytes = 0;
 
-	auto sm2 = static_cast<uint32_t>(sm);
-
-	f->Read(ptr, sm2, &bytes);
+	f->Read(ptr, size * maxnum, &bytes);
 
 	return bytes / size;
 }
@@ -679,15 +717,9 @@ static size_t mywritefunc(SDL_RWops* context, const void* ptr, size_t size, size
 {
 	File* f = static_cast<File*>(context->hidden.unknown.data1);
 
-	uint32_t bytes = 0;
-
-	size_t sm = size * num;
-
-	EXIT_IF(sizeof(size_t) > 4 && (uint64_t(sm) >> 32u) > 0);
-
-	auto sm2 = static_cast<uint32_t>(sm);
+	uint64_t bytes = 0;
 
-	f->Write(ptr, sm2, &bytes);
+	f->Write(ptr, size * num, &bytes);
 
 	return bytes / size;
 }
@@ -756,7 +788,7 @@ void File::DetectEncoding()
 	Seek(0);
 
 	uint8_t  b[2]      = {0, 0};
-	uint32_t bytes_num = 0;
+	uint64_t bytes_num = 0;
 
 	Read(b, 2, &bytes_num);
 
@@ -914,13 +946,13 @@ String File::ReadWholeString()
 ByteBuffer File::Read(uint32_t size)
 {
 	ByteBuffer buf(size);
-	uint32_t   b = 0;
+	uint64_t   b = 0;
 	Read(buf.GetData(), size, &b);
-	buf.RemoveAt(b, size - b);
+	buf.RemoveAt(static_cast<uint32_t>(b), size - static_cast<uint32_t>(b));
 	return buf;
 }
 
-void File::Write(const ByteBuffer& buf, uint32_t* bytes_written)
+void File::Write(const ByteBuffer& buf, uint64_t* bytes_written)
 {
 	Write(buf.GetDataConst(), buf.Size(), bytes_written);
 }
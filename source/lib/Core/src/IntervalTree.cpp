@@ -0,0 +1,320 @@
+#include "Kyty/Core/IntervalTree.h"
+
+#include "Kyty/Core/DbgAssert.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Kyty::Core {
+
+// AVL tree, nodes are kept in an array and referenced by index
+struct IntervalTreePrivate
+{
+	static constexpr int NIL = -1;
+
+	struct Node
+	{
+		uint64_t start   = 0;
+		uint64_t end     = 0;
+		uint64_t max_end = 0;
+		int      id      = 0;
+		int      left    = NIL;
+		int      right   = NIL;
+		int      height  = 1;
+	};
+
+	[[nodiscard]] int Height(int n) const { return (n == NIL ? 0 : nodes[n].height); }
+
+	[[nodiscard]] static bool Less(uint64_t start_a, uint64_t end_a, int id_a, const Node& b)
+	{
+		if (start_a != b.start)
+		{
+			return start_a < b.start;
+		}
+		if (end_a != b.end)
+		{
+			return end_a < b.end;
+		}
+		return id_a < b.id;
+	}
+
+	void Update(int n)
+	{
+		auto& node   = nodes[n];
+		node.height  = 1 + std::max(Height(node.left), Height(node.right));
+		node.max_end = node.end;
+		if (node.left != NIL)
+		{
+			node.max_end = std::max(node.max_end, nodes[node.left].max_end);
+		}
+		if (node.right != NIL)
+		{
+			node.max_end = std::max(node.max_end, nodes[node.right].max_end);
+		}
+	}
+
+	int RotateRight(int n)
+	{
+		int l          = nodes[n].left;
+		nodes[n].left  = nodes[l].right;
+		nodes[l].right = n;
+		Update(n);
+		Update(l);
+		return l;
+	}
+
+	int RotateLeft(int n)
+	{
+		int r          = nodes[n].right;
+		nodes[n].right = nodes[r].left;
+		nodes[r].left  = n;
+		Update(n);
+		Update(r);
+		return r;
+	}
+
+	int Balance(int n)
+	{
+		Update(n);
+
+		int diff = Height(nodes[n].left) - Height(nodes[n].right);
+
+		if (diff > 1)
+		{
+			int l = nodes[n].left;
+			if (Height(nodes[l].left) < Height(nodes[l].right))
+			{
+				nodes[n].left = RotateLeft(l);
+			}
+			return RotateRight(n);
+		}
+
+		if (diff < -1)
+		{
+			int r = nodes[n].right;
+			if (Height(nodes[r].right) < Height(nodes[r].left))
+			{
+				nodes[n].right = RotateRight(r);
+			}
+			return RotateLeft(n);
+		}
+
+		return n;
+	}
+
+	int NewNode(uint64_t start, uint64_t end, int id)
+	{
+		int n = NIL;
+		if (first_free != NIL)
+		{
+			n          = first_free;
+			first_free = nodes[n].left;
+		} else
+		{
+			n = static_cast<int>(nodes.size());
+			nodes.emplace_back();
+		}
+		auto& node   = nodes[n];
+		node.start   = start;
+		node.end     = end;
+		node.max_end = end;
+		node.id      = id;
+		node.left    = NIL;
+		node.right   = NIL;
+		node.height  = 1;
+		return n;
+	}
+
+	void FreeNode(int n)
+	{
+		nodes[n].left = first_free;
+		first_free    = n;
+	}
+
+	int Insert(int n, uint64_t start, uint64_t end, int id)
+	{
+		if (n == NIL)
+		{
+			size++;
+			return NewNode(start, end, id);
+		}
+
+		const auto& node = nodes[n];
+
+		if (Less(start, end, id, node))
+		{
+			int l         = Insert(node.left, start, end, id);
+			nodes[n].left = l;
+		} else if (start == node.start && end == node.end && id == node.id)
+		{
+			return n;
+		} else
+		{
+			int r          = Insert(node.right, start, end, id);
+			nodes[n].right = r;
+		}
+
+		return Balance(n);
+	}
+
+	// Unlinks the leftmost node of the subtree, returns the new subtree root
+	int RemoveMin(int n, int* min)
+	{
+		if (nodes[n].left == NIL)
+		{
+			*min = n;
+			return nodes[n].right;
+		}
+		int l         = RemoveMin(nodes[n].left, min);
+		nodes[n].left = l;
+		return Balance(n);
+	}
+
+	int Erase(int n, uint64_t start, uint64_t end, int id, bool* erased)
+	{
+		if (n == NIL)
+		{
+			return NIL;
+		}
+
+		const auto& node = nodes[n];
+
+		if (start == node.start && end == node.end && id == node.id)
+		{
+			int l = node.left;
+			int r = node.right;
+
+			FreeNode(n);
+			size--;
+			*erased = true;
+
+			if (r == NIL)
+			{
+				return l;
+			}
+
+			int min          = NIL;
+			int root         = RemoveMin(r, &min);
+			nodes[min].left  = l;
+			nodes[min].right = root;
+			return Balance(min);
+		}
+
+		if (Less(start, end, id, node))
+		{
+			int l         = Erase(node.left, start, end, id, erased);
+			nodes[n].left = l;
+		} else
+		{
+			int r          = Erase(node.right, start, end, id, erased);
+			nodes[n].right = r;
+		}
+
+		return Balance(n);
+	}
+
+	void FindOverlaps(int n, uint64_t start, uint64_t end, Vector<int>* ids) const
+	{
+		while (n != NIL)
+		{
+			const auto& node = nodes[n];
+
+			// Nothing in the subtree reaches the range
+			if (node.max_end <= start)
+			{
+				return;
+			}
+
+			FindOverlaps(node.left, start, end, ids);
+
+			// The node and its right subtree start after the range
+			if (node.start >= end)
+			{
+				return;
+			}
+
+			if (node.end > start)
+			{
+				ids->Add(node.id);
+			}
+
+			n = node.right;
+		}
+	}
+
+	void FindStart(int n, uint64_t start, Vector<int>* ids) const
+	{
+		while (n != NIL)
+		{
+			const auto& node = nodes[n];
+
+			if (start < node.start)
+			{
+				n = node.left;
+			} else if (start > node.start)
+			{
+				n = node.right;
+			} else
+			{
+				// Equal starts may be on both sides
+				FindStart(node.left, start, ids);
+				ids->Add(node.id);
+				n = node.right;
+			}
+		}
+	}
+
+	std::vector<Node> nodes;
+
+	int      root       = NIL;
+	int      first_free = NIL;
+	uint32_t size       = 0;
+};
+
+IntervalTree::IntervalTree(): m_p(new IntervalTreePrivate) {}
+
+IntervalTree::~IntervalTree()
+{
+	delete m_p;
+}
+
+void IntervalTree::Insert(uint64_t start, uint64_t size, int id)
+{
+	EXIT_IF(size == 0);
+	EXIT_IF(start + size < start);
+
+	m_p->root = m_p->Insert(m_p->root, start, start + size, id);
+}
+
+bool IntervalTree::Erase(uint64_t start, uint64_t size, int id)
+{
+	EXIT_IF(size == 0);
+	EXIT_IF(start + size < start);
+
+	bool erased = false;
+	m_p->root   = m_p->Erase(m_p->root, start, start + size, id, &erased);
+	return erased;
+}
+
+void IntervalTree::FindOverlaps(uint64_t start, uint64_t size, Vector<int>* ids) const
+{
+	EXIT_IF(ids == nullptr);
+	EXIT_IF(size == 0);
+	EXIT_IF(start + size < start);
+
+	m_p->FindOverlaps(m_p->root, start, start + size, ids);
+}
+
+void IntervalTree::FindStart(uint64_t start, Vector<int>* ids) const
+{
+	EXIT_IF(ids == nullptr);
+
+	m_p->FindStart(m_p->root, start, ids);
+}
+
+uint32_t IntervalTree::Size() const
+{
+	return m_p->size;
+}
+
+} // namespace Kyty::Core
@@ -442,7 +442,7 @@ static bool MSpaceInternalInit(MSpaceContext& ctx, const char* name, void* base,
 	ctx.base[ctx.capacity].u.hdr.prev_size = ctx.capacity;
 	ctx.base[ctx.capacity].u.hdr.size_4x   = 1;
 
-	ctx.mutex        = (thread_safe ? new Core::Mutex : nullptr);
+	ctx.mutex        = (thread_safe ? new Core::Mutex(Core::Mutex::Type::Recursive) : nullptr);
 	ctx.dbg_callback = dbg_callback;
 
 	return true;
@@ -0,0 +1,163 @@
+#include "Kyty/Core/RangeAllocator.h"
+
+#include "Kyty/Core/DbgAssert.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace Kyty::Core {
+
+struct RangeAllocatorPrivate
+{
+	using ranges_t   = std::map<uint64_t, uint64_t>;            // start -> size
+	using by_size_t  = std::set<std::pair<uint64_t, uint64_t>>; // (size, start)
+	using iterator_t = ranges_t::iterator;
+
+	RangeAllocatorPrivate(uint64_t b, uint64_t s): base(b), size(s) { AddRange(b, s); }
+
+	void AddRange(uint64_t start, uint64_t len)
+	{
+		free_ranges[start] = len;
+		free_by_size.insert({len, start});
+		free_size += len;
+	}
+
+	void RemoveRange(iterator_t it)
+	{
+		free_by_size.erase({it->second, it->first});
+		free_size -= it->second;
+		free_ranges.erase(it);
+	}
+
+	uint64_t base;
+	uint64_t size;
+	uint64_t free_size = 0;
+
+	ranges_t  free_ranges;
+	by_size_t free_by_size;
+};
+
+static uint64_t align_up(uint64_t pos, uint64_t align)
+{
+	return (align != 0 ? (pos + (align - 1)) & ~(align - 1) : pos);
+}
+
+RangeAllocator::RangeAllocator(uint64_t base, uint64_t size): m_p(new RangeAllocatorPrivate(base, size))
+{
+	EXIT_IF(size == 0);
+	EXIT_IF(base + size < base);
+}
+
+RangeAllocator::~RangeAllocator()
+{
+	delete m_p;
+}
+
+bool RangeAllocator::Alloc(uint64_t search_start, uint64_t search_end, uint64_t size, uint64_t alignment, uint64_t* addr_out)
+{
+	EXIT_IF(addr_out == nullptr);
+	EXIT_IF(alignment != 0 && (alignment & (alignment - 1)) != 0);
+
+	if (size == 0 || search_end <= search_start)
+	{
+		return false;
+	}
+
+	// Candidates are visited from the smallest one, so the first match is the best fit
+	for (auto it = m_p->free_by_size.lower_bound({size, 0}); it != m_p->free_by_size.end(); ++it)
+	{
+		auto [range_size, range_start] = *it;
+
+		uint64_t start = std::max(range_start, search_start);
+		uint64_t end   = std::min(range_start + range_size, search_end);
+		uint64_t addr  = align_up(start, alignment);
+
+		if (addr < start || addr > end || end - addr < size)
+		{
+			continue;
+		}
+
+		// Split the free range into [range_start, addr) and [addr + size, range_end)
+		m_p->RemoveRange(m_p->free_ranges.find(range_start));
+
+		if (addr > range_start)
+		{
+			m_p->AddRange(range_start, addr - range_start);
+		}
+		if (addr + size < range_start + range_size)
+		{
+			m_p->AddRange(addr + size, range_start + range_size - (addr + size));
+		}
+
+		*addr_out = addr;
+		return true;
+	}
+
+	return false;
+}
+
+bool RangeAllocator::Free(uint64_t addr, uint64_t size)
+{
+	if (size == 0 || addr < m_p->base || addr + size < addr || addr + size > m_p->base + m_p->size)
+	{
+		return false;
+	}
+
+	auto next = m_p->free_ranges.lower_bound(addr);
+	auto prev = (next != m_p->free_ranges.begin() ? std::prev(next) : m_p->free_ranges.end());
+
+	// Double free or overlapping free
+	if ((next != m_p->free_ranges.end() && next->first < addr + size) ||
+	    (prev != m_p->free_ranges.end() && prev->first + prev->second > addr))
+	{
+		return false;
+	}
+
+	uint64_t start = addr;
+	uint64_t end   = addr + size;
+
+	if (prev != m_p->free_ranges.end() && prev->first + prev->second == start)
+	{
+		start = prev->first;
+		m_p->RemoveRange(prev);
+	}
+	if (next != m_p->free_ranges.end() && next->first == end)
+	{
+		end = next->first + next->second;
+		m_p->RemoveRange(next);
+	}
+
+	m_p->AddRange(start, end - start);
+
+	return true;
+}
+
+uint64_t RangeAllocator::GetBase() const
+{
+	return m_p->base;
+}
+
+uint64_t RangeAllocator::GetSize() const
+{
+	return m_p->size;
+}
+
+uint64_t RangeAllocator::GetFreeSize() const
+{
+	return m_p->free_size;
+}
+
+uint64_t RangeAllocator::GetLargestFree() const
+{
+	return (m_p->free_by_size.empty() ? 0 : m_p->free_by_size.rbegin()->first);
+}
+
+uint32_t RangeAllocator::GetFreeRangesNum() const
+{
+	return static_cast<uint32_t>(m_p->free_ranges.size());
+}
+
+} // namespace Kyty::Core
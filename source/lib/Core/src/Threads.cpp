@@ -23,6 +23,15 @@
 
 //#define KYTY_DEBUG_LOCKS
 //#define KYTY_DEBUG_LOCKS_TIMED
+//#define KYTY_MUTEX_STATS
+
+#if KYTY_PLATFORM == KYTY_PLATFORM_LINUX && !(defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED))
+#define KYTY_FUTEX
+#endif
+
+#if defined(KYTY_MUTEX_STATS) && !defined(KYTY_FUTEX)
+#error "KYTY_MUTEX_STATS needs KYTY_FUTEX"
+#endif
 
 #ifdef KYTY_SDL_THREADS
 #include "SDL_thread.h"
@@ -37,6 +46,21 @@
 #include "SDL_mutex.h"
 #endif
 
+#ifdef KYTY_FUTEX
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef KYTY_MUTEX_STATS
+#include <unordered_map>
+#include <vector>
+#endif
+
 #if defined(KYTY_WIN_CS) && defined(KYTY_SDL_CS)
 #error "defined(KYTY_WIN_CS) && defined(KYTY_SDL_CS)"
 #endif
@@ -106,6 +130,118 @@ using thread_id_t = std::thread::id;
 constexpr auto DBG_TRY_SECONDS = std::chrono::seconds(15);
 #endif
 
+#ifdef KYTY_FUTEX
+static_assert(sizeof(std::atomic_uint32_t) == sizeof(uint32_t));
+
+// Mutex::m_state
+constexpr uint32_t MUTEX_UNLOCKED  = 0;
+constexpr uint32_t MUTEX_LOCKED    = 1;
+constexpr uint32_t MUTEX_CONTENDED = 2; // Locked and somebody may sleep in the kernel
+
+constexpr int MUTEX_SPIN_MAX = 100;
+
+static long FutexWait(std::atomic_uint32_t* addr, uint32_t expected, const timespec* timeout)
+{
+	return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+static void FutexWake(std::atomic_uint32_t* addr, int num)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, num, nullptr, nullptr, 0);
+}
+
+static void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+#endif
+
+#ifdef KYTY_MUTEX_STATS
+constexpr int MUTEX_STATS_TOP = 10;
+
+// All mutexes created by the same code share the record, records are never deleted
+struct MutexStats
+{
+	void*                site      = nullptr;
+	std::atomic_uint64_t mutexes   = 0;
+	std::atomic_uint64_t locks     = 0;
+	std::atomic_uint64_t contended = 0;
+	std::atomic_uint64_t wait_ns   = 0;
+	DebugStack           stack;
+};
+
+static std::mutex& MutexStatsLock()
+{
+	static auto* m = new std::mutex;
+	return *m;
+}
+
+static std::unordered_map<void*, MutexStats*>& MutexStatsMap()
+{
+	static auto* m = new std::unordered_map<void*, MutexStats*>;
+	return *m;
+}
+
+static MutexStats* MutexStatsGet(void* site)
+{
+	{
+		std::lock_guard lock(MutexStatsLock());
+		if (auto it = MutexStatsMap().find(site); it != MutexStatsMap().end())
+		{
+			it->second->mutexes++;
+			return it->second;
+		}
+	}
+
+	// Tracing can create mutexes too, so do it outside of the lock
+	auto* stats = new MutexStats;
+	stats->site = site;
+	DebugStack::Trace(&stats->stack);
+
+	std::lock_guard lock(MutexStatsLock());
+	auto [it, inserted] = MutexStatsMap().emplace(site, stats);
+	if (!inserted)
+	{
+		delete stats;
+	}
+	it->second->mutexes++;
+	return it->second;
+}
+
+static void MutexStatsReport()
+{
+	std::vector<const MutexStats*> list;
+	{
+		std::lock_guard lock(MutexStatsLock());
+		for (const auto& s: MutexStatsMap())
+		{
+			list.push_back(s.second);
+		}
+	}
+
+	std::sort(list.begin(), list.end(), [](const MutexStats* a, const MutexStats* b) { return a->wait_ns > b->wait_ns; });
+
+	printf("--- Top contended mutexes ---\n");
+	for (size_t i = 0; i < list.size() && i < MUTEX_STATS_TOP && list[i]->contended != 0; i++)
+	{
+		const auto* s     = list[i];
+		auto        locks = std::max(s->locks.load(), static_cast<uint64_t>(1));
+		printf("\n[%d] site = %016" PRIx64 ", mutexes = %" PRIu64 ", locks = %" PRIu64 ", contended = %" PRIu64
+		       " (%.2f%%), wait = %.3f ms\n\n",
+		       static_cast<int>(i), reinterpret_cast<uint64_t>(s->site), s->mutexes.load(), s->locks.load(), s->contended.load(),
+		       100.0 * static_cast<double>(s->contended) / static_cast<double>(locks), static_cast<double>(s->wait_ns) / 1000000.0);
+		s->stack.Print(0);
+	}
+}
+
+// Mutexes are grouped by the code which creates them
+#define KYTY_MUTEX_SITE __builtin_return_address(0)
+#else
+#define KYTY_MUTEX_SITE nullptr
+#endif
+
 struct MutexPrivate
 {
 #if defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)
@@ -130,6 +266,10 @@ struct MutexPrivate
 	}
 	KYTY_CLASS_NO_COPY(MutexPrivate);
 	SDL_mutex* sdl;
+#elif defined(KYTY_FUTEX)
+#ifdef KYTY_MUTEX_STATS
+	MutexStats* stats = nullptr;
+#endif
 #else
 	std::recursive_mutex m_mutex;
 #endif
@@ -156,6 +296,9 @@ struct CondVarPrivate
 	}
 	KYTY_CLASS_NO_COPY(CondVarPrivate);
 	SDL_cond* sdl;
+#elif defined(KYTY_FUTEX)
+	std::atomic_uint32_t seq {0};
+	std::atomic_uint32_t waiters {0};
 #else
 	std::condition_variable_any m_cv;
 #endif
@@ -280,7 +423,12 @@ KYTY_SUBSYSTEM_INIT(Threads)
 
 KYTY_SUBSYSTEM_UNEXPECTED_SHUTDOWN(Threads) {}
 
-KYTY_SUBSYSTEM_DESTROY(Threads) {}
+KYTY_SUBSYSTEM_DESTROY(Threads)
+{
+#ifdef KYTY_MUTEX_STATS
+	MutexStatsReport();
+#endif
+}
 
 void WaitForGraph::DbgDump(const Vector<Cycle>& list)
 {
@@ -621,7 +769,22 @@ String Thread::GetThreadId()
 #endif
 }
 
-Mutex::Mutex(): m_mutex(new MutexPrivate) {}
+static MutexPrivate* CreateMutexPrivate([[maybe_unused]] void* site)
+{
+#if defined(KYTY_MUTEX_STATS)
+	auto* m  = new MutexPrivate;
+	m->stats = MutexStatsGet(site);
+	return m;
+#elif defined(KYTY_FUTEX)
+	return nullptr;
+#else
+	return new MutexPrivate;
+#endif
+}
+
+Mutex::Mutex(): m_mutex(CreateMutexPrivate(KYTY_MUTEX_SITE)) {}
+
+Mutex::Mutex(Type type): m_type(type), m_mutex(CreateMutexPrivate(KYTY_MUTEX_SITE)) {}
 
 Mutex::~Mutex()
 {
@@ -631,12 +794,76 @@ Mutex::~Mutex()
 		g_wait_for_graph.load()->Delete(m_mutex);
 	}
 #endif
-	Delete(m_mutex);
+	// The futex mutex has no private part
+	delete m_mutex;
+}
+
+#ifdef KYTY_FUTEX
+void Mutex::LockContended(int thread_id)
+{
+	if (m_owner.load(std::memory_order_relaxed) == thread_id)
+	{
+		EXIT("mutex is already locked by this thread, use Mutex::Type::Recursive\n");
+	}
+
+#ifdef KYTY_MUTEX_STATS
+	auto start = std::chrono::steady_clock::now();
+#endif
+
+	// Spin about as long as it took to get the lock recently, like glibc's adaptive mutex
+	int  spin_max = std::min(MUTEX_SPIN_MAX, m_spin.load(std::memory_order_relaxed) * 2 + 10);
+	int  spin     = 0;
+	bool locked   = false;
+	for (; spin < spin_max; spin++)
+	{
+		CpuRelax();
+		if (uint32_t expected = MUTEX_UNLOCKED;
+		    m_state.load(std::memory_order_relaxed) == MUTEX_UNLOCKED &&
+		    m_state.compare_exchange_weak(expected, MUTEX_LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			locked = true;
+			break;
+		}
+	}
+	int old_spin = m_spin.load(std::memory_order_relaxed);
+	m_spin.store(old_spin + (spin - old_spin) / 8, std::memory_order_relaxed);
+
+	if (!locked)
+	{
+		// The state stays contended while anybody sleeps, so Unlock() knows it has to wake somebody up
+		while (m_state.exchange(MUTEX_CONTENDED, std::memory_order_acquire) != MUTEX_UNLOCKED)
+		{
+			FutexWait(&m_state, MUTEX_CONTENDED, nullptr);
+		}
+	}
+
+#ifdef KYTY_MUTEX_STATS
+	m_mutex->stats->contended++;
+	m_mutex->stats->wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+#endif
 }
+#endif
 
 void Mutex::Lock()
 {
-#ifdef KYTY_DEBUG_LOCKS
+#ifdef KYTY_FUTEX
+	int thread_id = Thread::GetThreadIdUnique();
+	if (m_type == Type::Recursive && m_owner.load(std::memory_order_relaxed) == thread_id)
+	{
+		m_count++;
+		return;
+	}
+	if (uint32_t expected = MUTEX_UNLOCKED;
+	    !m_state.compare_exchange_strong(expected, MUTEX_LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+	{
+		LockContended(thread_id);
+	}
+	m_owner.store(thread_id, std::memory_order_relaxed);
+	m_count = 1;
+#ifdef KYTY_MUTEX_STATS
+	m_mutex->stats->locks++;
+#endif
+#elif defined(KYTY_DEBUG_LOCKS)
 	if (g_wait_for_graph != nullptr)
 	{
 		int  index  = g_wait_for_graph.load()->Insert(Thread::GetThreadIdUnique(), m_mutex, WaitForGraph::Link::Wait);
@@ -685,7 +912,19 @@ void Mutex::Lock()
 
 void Mutex::Unlock()
 {
-#ifdef KYTY_DEBUG_LOCKS
+#ifdef KYTY_FUTEX
+	EXIT_IF(m_count == 0);
+	if (--m_count != 0)
+	{
+		return;
+	}
+	m_owner.store(0, std::memory_order_relaxed);
+	// Single write, the mutex may be destroyed by another thread as soon as it's unlocked
+	if (m_state.exchange(MUTEX_UNLOCKED, std::memory_order_release) == MUTEX_CONTENDED)
+	{
+		FutexWake(&m_state, 1);
+	}
+#elif defined(KYTY_DEBUG_LOCKS)
 	if (g_wait_for_graph != nullptr)
 	{
 		g_wait_for_graph.load()->Delete(Thread::GetThreadIdUnique(), m_mutex, WaitForGraph::Link::Own);
@@ -704,7 +943,25 @@ void Mutex::Unlock()
 
 bool Mutex::TryLock()
 {
-#ifdef KYTY_DEBUG_LOCKS
+#ifdef KYTY_FUTEX
+	int thread_id = Thread::GetThreadIdUnique();
+	if (m_type == Type::Recursive && m_owner.load(std::memory_order_relaxed) == thread_id)
+	{
+		m_count++;
+		return true;
+	}
+	if (uint32_t expected = MUTEX_UNLOCKED;
+	    m_state.compare_exchange_strong(expected, MUTEX_LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+	{
+		m_owner.store(thread_id, std::memory_order_relaxed);
+		m_count = 1;
+#ifdef KYTY_MUTEX_STATS
+		m_mutex->stats->locks++;
+#endif
+		return true;
+	}
+	return false;
+#elif defined(KYTY_DEBUG_LOCKS)
 	if (m_mutex->m_mutex.try_lock())
 	{
 		if (g_wait_for_graph != nullptr)
@@ -734,6 +991,14 @@ CondVar::~CondVar()
 
 void CondVar::Wait(Mutex* mutex)
 {
+#ifdef KYTY_FUTEX
+	m_cond_var->waiters++;
+	uint32_t seq = m_cond_var->seq;
+	mutex->Unlock();
+	FutexWait(&m_cond_var->seq, seq, nullptr);
+	m_cond_var->waiters--;
+	mutex->Lock();
+#else
 #if defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)
 	std::unique_lock<std::recursive_timed_mutex> cpp_lock(mutex->m_mutex->m_mutex, std::adopt_lock_t());
 #else
@@ -769,11 +1034,24 @@ void CondVar::Wait(Mutex* mutex)
 #else
 	cpp_lock.release();
 #endif
+#endif
 }
 
 bool CondVar::WaitFor(Mutex* mutex, uint32_t micros)
 {
 	bool ok = false;
+#ifdef KYTY_FUTEX
+	timespec timeout {};
+	timeout.tv_sec  = static_cast<time_t>(micros / 1000000);
+	timeout.tv_nsec = static_cast<long>(micros % 1000000) * 1000;
+
+	m_cond_var->waiters++;
+	uint32_t seq = m_cond_var->seq;
+	mutex->Unlock();
+	ok = !(FutexWait(&m_cond_var->seq, seq, &timeout) != 0 && errno == ETIMEDOUT);
+	m_cond_var->waiters--;
+	mutex->Lock();
+#else
 #if defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)
 	std::unique_lock<std::recursive_timed_mutex> cpp_lock(mutex->m_mutex->m_mutex, std::adopt_lock_t());
 #else
@@ -791,13 +1069,20 @@ bool CondVar::WaitFor(Mutex* mutex, uint32_t micros)
 #else
 	ok = (m_cond_var->m_cv.wait_for(cpp_lock, std::chrono::microseconds(micros)) == std::cv_status::no_timeout);
 	cpp_lock.release();
+#endif
 #endif
 	return ok;
 }
 
 void CondVar::Signal()
 {
-#if !(defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)) && defined(KYTY_WIN_CS)
+#ifdef KYTY_FUTEX
+	m_cond_var->seq++;
+	if (m_cond_var->waiters != 0)
+	{
+		FutexWake(&m_cond_var->seq, 1);
+	}
+#elif !(defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)) && defined(KYTY_WIN_CS)
 	static auto func = ResolveWakeConditionVariable();
 	EXIT_NOT_IMPLEMENTED(func == nullptr);
 	func(&m_cond_var->m_cv);
@@ -810,7 +1095,13 @@ void CondVar::Signal()
 
 void CondVar::SignalAll()
 {
-#if !(defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)) && defined(KYTY_WIN_CS)
+#ifdef KYTY_FUTEX
+	m_cond_var->seq++;
+	if (m_cond_var->waiters != 0)
+	{
+		FutexWake(&m_cond_var->seq, INT_MAX);
+	}
+#elif !(defined(KYTY_DEBUG_LOCKS) || defined(KYTY_DEBUG_LOCKS_TIMED)) && defined(KYTY_WIN_CS)
 	static auto func = ResolveWakeAllConditionVariable();
 	EXIT_NOT_IMPLEMENTED(func == nullptr);
 	func(&m_cond_var->m_cv);
@@ -6,10 +6,20 @@
 #define KYTY_HAS_EXCEPTIONS
 #endif
 
+#if KYTY_PLATFORM == KYTY_PLATFORM_LINUX
+#define KYTY_HAS_SIGNALS
+#endif
+
 #ifdef KYTY_HAS_EXCEPTIONS
 #include <windows.h> // IWYU pragma: keep
 #endif
 
+#ifdef KYTY_HAS_SIGNALS
+#include <csignal>
+#include <cstdlib>
+#include <ucontext.h>
+#endif
+
 // IWYU pragma: no_include <basetsd.h>
 // IWYU pragma: no_include <errhandlingapi.h>
 // IWYU pragma: no_include <excpt.h>
@@ -236,10 +246,39 @@ static LONG WINAPI ExceptionFilter(PEXCEPTION_POINTERS exception)
 }
 #endif
 
+#ifdef KYTY_HAS_SIGNALS
+static ExceptionHandler::handler_func_t g_signal_vec_func = nullptr;
+
+static void SignalHandler(int sig, siginfo_t* si, void* context)
+{
+	auto* uc = static_cast<ucontext_t*>(context);
+
+	ExceptionHandler::ExceptionInfo info {};
+
+	info.exception_address = static_cast<uint64_t>(uc->uc_mcontext.gregs[REG_RIP]);
+
+	if (sig == SIGSEGV || sig == SIGBUS)
+	{
+		info.type = ExceptionHandler::ExceptionType::AccessViolation;
+		// Bit 1 of the page fault error code is set for write accesses
+		info.access_violation_type  = ((static_cast<uint64_t>(uc->uc_mcontext.gregs[REG_ERR]) & 0x2u) != 0
+		                                   ? ExceptionHandler::AccessViolationType::Write
+		                                   : ExceptionHandler::AccessViolationType::Read);
+		info.access_violation_vaddr = reinterpret_cast<uint64_t>(si->si_addr);
+	}
+
+	info.rbp                = static_cast<uint64_t>(uc->uc_mcontext.gregs[REG_RBP]);
+	info.exception_win_code = static_cast<uint32_t>(sig);
+
+	// If the handler returns, the faulting instruction is restarted
+	g_signal_vec_func(&info);
+}
+#endif
+
 // NOLINTNEXTLINE(readability-convert-member-functions-to-static, misc-unused-parameters)
 bool ExceptionHandler::InstallVectored(handler_func_t func)
 {
-#ifdef KYTY_HAS_EXCEPTIONS
+#if defined(KYTY_HAS_EXCEPTIONS)
 	if (ExceptionHandlerPrivate::g_vec_func == nullptr)
 	{
 		ExceptionHandlerPrivate::g_vec_func = func;
@@ -253,6 +292,92 @@ bool ExceptionHandler::InstallVectored(handler_func_t func)
 		return true;
 	}
 	return false;
+#elif defined(KYTY_HAS_SIGNALS)
+	if (g_signal_vec_func == nullptr)
+	{
+		g_signal_vec_func = func;
+
+		struct sigaction sa {};
+		sa.sa_sigaction = SignalHandler;
+		sa.sa_flags     = SA_SIGINFO | SA_ONSTACK;
+		sigemptyset(&sa.sa_mask);
+
+		if (sigaction(SIGSEGV, &sa, nullptr) != 0 || sigaction(SIGBUS, &sa, nullptr) != 0)
+		{
+			printf("sigaction() failed\n");
+			return false;
+		}
+
+		return InstallAltStack();
+	}
+	return false;
+#else
+	return true;
+#endif
+}
+
+#ifdef KYTY_HAS_SIGNALS
+// The handler may write back a GPU object, which needs much more stack than a signal frame
+class SignalAltStack
+{
+public:
+	static constexpr size_t STACK_SIZE = static_cast<size_t>(256) * 1024;
+
+	SignalAltStack() = default;
+	~SignalAltStack()
+	{
+		if (m_stack != nullptr)
+		{
+			stack_t ss {};
+			ss.ss_flags = SS_DISABLE;
+			sigaltstack(&ss, nullptr);
+			free(m_stack);
+		}
+	}
+
+	KYTY_CLASS_NO_COPY(SignalAltStack);
+
+	bool Install()
+	{
+		if (m_stack != nullptr)
+		{
+			return true;
+		}
+
+		m_stack = malloc(STACK_SIZE);
+
+		if (m_stack == nullptr)
+		{
+			return false;
+		}
+
+		stack_t ss {};
+		ss.ss_sp    = m_stack;
+		ss.ss_size  = STACK_SIZE;
+		ss.ss_flags = 0;
+
+		if (sigaltstack(&ss, nullptr) != 0)
+		{
+			printf("sigaltstack() failed\n");
+			free(m_stack);
+			m_stack = nullptr;
+			return false;
+		}
+
+		return true;
+	}
+
+private:
+	void* m_stack = nullptr;
+};
+
+static thread_local SignalAltStack g_signal_alt_stack;
+#endif
+
+bool ExceptionHandler::InstallAltStack()
+{
+#ifdef KYTY_HAS_SIGNALS
+	return g_signal_alt_stack.Install();
 #else
 	return true;
 #endif
@@ -13,6 +13,9 @@
 #include "SDL_system.h"
 
 #include <cerrno>
+#include <fcntl.h>
+#include <stdio_ext.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <utime.h>
@@ -38,7 +41,33 @@ bool sys_file_io_init()
 	return !g_internal_files_dir->IsEmpty();
 }
 
-void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_read)
+static uint64_t mem_buf_remaining(const sys_file_mem_buf_t* buf)
+{
+	auto pos = static_cast<uint64_t>(buf->ptr - buf->base);
+	return (pos < buf->size ? buf->size - pos : 0);
+}
+
+static void file_advise(FILE* f, sys_file_cache_type_t cache_type)
+{
+	if (f == nullptr || cache_type == SYS_FILE_CACHE_AUTO)
+	{
+		return;
+	}
+
+	posix_fadvise(fileno(f), 0, 0, (cache_type == SYS_FILE_CACHE_RANDOM_ACCESS ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL));
+}
+
+static void mapped_advise(void* addr, uint64_t size, sys_file_cache_type_t cache_type)
+{
+	if (cache_type == SYS_FILE_CACHE_AUTO)
+	{
+		return;
+	}
+
+	madvise(addr, size, (cache_type == SYS_FILE_CACHE_RANDOM_ACCESS ? MADV_RANDOM : MADV_SEQUENTIAL));
+}
+
+void sys_file_read(void* data, uint64_t size, sys_file_t& f, uint64_t* bytes_read)
 {
 	if (f.type == SYS_FILE_FILE)
 	{
@@ -49,10 +78,10 @@ void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_rea
 		}
 	} else if (f.type == SYS_FILE_MEMORY_STAT)
 	{
-		uint32_t s = size;
+		uint64_t s = size;
 		if (f.buf->size != 0)
 		{
-			uint32_t l = f.buf->size - (f.buf->ptr - f.buf->base);
+			uint64_t l = mem_buf_remaining(f.buf);
 			if (s > l)
 			{
 				s = l;
@@ -64,12 +93,12 @@ void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_rea
 		{
 			*bytes_read = s;
 		}
-	} else if (f.type == SYS_FILE_MEMORY_DYN)
+	} else if (f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
-		uint32_t s = size;
+		uint64_t s = size;
 		if (f.buf->size != 0)
 		{
-			uint32_t l = f.buf->size - (f.buf->ptr - f.buf->base);
+			uint64_t l = mem_buf_remaining(f.buf);
 			if (s > l)
 			{
 				s = l;
@@ -87,7 +116,7 @@ void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_rea
 	}
 }
 
-void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_written)
+void sys_file_write(const void* data, uint64_t size, sys_file_t& f, uint64_t* bytes_written)
 {
 	if (f.type == SYS_FILE_FILE)
 	{
@@ -98,10 +127,10 @@ void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* by
 		}
 	} else if (f.type == SYS_FILE_MEMORY_STAT)
 	{
-		uint32_t s = size;
+		uint64_t s = size;
 		if (f.buf->size != 0)
 		{
-			uint32_t l = f.buf->size - (f.buf->ptr - f.buf->base);
+			uint64_t l = mem_buf_remaining(f.buf);
 			if (s > l)
 			{
 				s = l;
@@ -115,7 +144,7 @@ void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* by
 		}
 	} else if (f.type == SYS_FILE_MEMORY_DYN)
 	{
-		uint32_t pos = f.buf->ptr - f.buf->base;
+		uint64_t pos = f.buf->ptr - f.buf->base;
 		if (f.buf->size < pos + size)
 		{
 			f.buf->base = static_cast<uint8_t*>(Core::mem_realloc(f.buf->base, pos + size));
@@ -131,6 +160,125 @@ void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* by
 	}
 }
 
+void sys_file_read_at(void* data, uint64_t size, uint64_t offset, sys_file_t& f, uint64_t* bytes_read)
+{
+	if (f.type == SYS_FILE_FILE)
+	{
+		// Goes to the descriptor directly, only data still sitting in the stdio write buffer needs a flush
+		if (__fpending(f.f) != 0)
+		{
+			fflush(f.f);
+		}
+
+		// A single pread returns at most ~2GB
+		uint64_t done = 0;
+		while (done < size)
+		{
+			auto r = pread(fileno(f.f), static_cast<uint8_t*>(data) + done, size - done, static_cast<off_t>(offset + done));
+			if (r <= 0)
+			{
+				if (r < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				break;
+			}
+			done += r;
+		}
+		if (bytes_read != nullptr)
+		{
+			*bytes_read = done;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_STAT)
+	{
+		// The cursor is not touched, so concurrent positional reads are safe
+		uint64_t s = size;
+		if (f.buf->size != 0u)
+		{
+			uint64_t l = (offset < f.buf->size ? f.buf->size - offset : 0);
+			if (s > l)
+			{
+				s = l;
+			}
+		}
+		memcpy(data, f.buf->base + offset, s);
+		if (bytes_read != nullptr)
+		{
+			*bytes_read = s;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
+	{
+		uint64_t s = (offset < f.buf->size ? f.buf->size - offset : 0);
+		if (s > size)
+		{
+			s = size;
+		}
+		memcpy(data, f.buf->base + offset, s);
+		if (bytes_read != nullptr)
+		{
+			*bytes_read = s;
+		}
+	}
+}
+
+void sys_file_write_at(const void* data, uint64_t size, uint64_t offset, sys_file_t& f, uint64_t* bytes_written)
+{
+	if (f.type == SYS_FILE_FILE)
+	{
+		// Keep the order with buffered writes and drop the read buffer, it may hold the old data
+		fflush(f.f);
+
+		uint64_t done = 0;
+		while (done < size)
+		{
+			auto r = pwrite(fileno(f.f), static_cast<const uint8_t*>(data) + done, size - done, static_cast<off_t>(offset + done));
+			if (r <= 0)
+			{
+				if (r < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				break;
+			}
+			done += r;
+		}
+		if (bytes_written != nullptr)
+		{
+			*bytes_written = done;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_STAT)
+	{
+		uint64_t s = size;
+		if (f.buf->size != 0u)
+		{
+			uint64_t l = (offset < f.buf->size ? f.buf->size - offset : 0);
+			if (s > l)
+			{
+				s = l;
+			}
+		}
+		memcpy(f.buf->base + offset, data, s);
+		if (bytes_written != nullptr)
+		{
+			*bytes_written = s;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_DYN)
+	{
+		if (f.buf->size < offset + size)
+		{
+			uint64_t pos = f.buf->ptr - f.buf->base;
+			f.buf->base  = static_cast<uint8_t*>(Core::mem_realloc(f.buf->base, offset + size));
+			f.buf->ptr   = f.buf->base + pos;
+			f.buf->size  = offset + size;
+		}
+		memcpy(f.buf->base + offset, data, size);
+		if (bytes_written != nullptr)
+		{
+			*bytes_written = size;
+		}
+	}
+}
+
 void sys_file_read_r(void* data, uint32_t size, sys_file_t& f)
 {
 	// DWORD w;
@@ -187,7 +335,7 @@ sys_file_t* sys_file_create(const String& file_name)
 	return ret;
 }
 
-sys_file_t* sys_file_open_r(const String& file_name, sys_file_cache_type_t /*cache_type*/)
+sys_file_t* sys_file_open_r(const String& file_name, sys_file_cache_type_t cache_type)
 {
 	auto* ret = new sys_file_t;
 
@@ -203,12 +351,59 @@ sys_file_t* sys_file_open_r(const String& file_name, sys_file_cache_type_t /*cac
 		ret->type = SYS_FILE_ERROR;
 	}
 
+	file_advise(f, cache_type);
+
 	ret->f = f;
 
 	return ret;
 }
 
-sys_file_t* sys_file_open(uint8_t* buf, uint32_t buf_size)
+// Read-only view of the whole file. Reads are served from the page cache with one memcpy and don't go through stdio.
+sys_file_t* sys_file_open_mapped(const String& file_name, sys_file_cache_type_t cache_type)
+{
+	String internal_name = get_internal_name(file_name);
+
+	int fd = open(internal_name.utf8_str().GetData(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+	{
+		auto* ret = new sys_file_t;
+		ret->type = SYS_FILE_ERROR;
+		ret->f    = nullptr;
+		return ret;
+	}
+
+	struct stat st {};
+	void*       addr = MAP_FAILED;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+
+	// The mapping keeps its own reference to the file
+	close(fd);
+
+	if (addr == MAP_FAILED)
+	{
+		// Empty files can't be mapped
+		return sys_file_open_r(file_name, cache_type);
+	}
+
+	mapped_advise(addr, st.st_size, cache_type);
+
+	auto* ret = new sys_file_t;
+
+	ret->type      = SYS_FILE_MAPPED;
+	ret->buf       = new sys_file_mem_buf_t;
+	ret->buf->base = static_cast<uint8_t*>(addr);
+	ret->buf->ptr  = ret->buf->base;
+	ret->buf->size = st.st_size;
+
+	return ret;
+}
+
+sys_file_t* sys_file_open(uint8_t* buf, uint64_t buf_size)
 {
 	auto* ret = new sys_file_t;
 
@@ -234,7 +429,7 @@ sys_file_t* sys_file_create()
 	return ret;
 }
 
-sys_file_t* sys_file_open_w(const String& file_name, sys_file_cache_type_t /*cache_type*/)
+sys_file_t* sys_file_open_w(const String& file_name, sys_file_cache_type_t cache_type)
 {
 	auto* ret = new sys_file_t;
 
@@ -251,12 +446,14 @@ sys_file_t* sys_file_open_w(const String& file_name, sys_file_cache_type_t /*cac
 		ret->type = SYS_FILE_FILE;
 	}
 
+	file_advise(f, cache_type);
+
 	ret->f = f;
 
 	return ret;
 }
 
-sys_file_t* sys_file_open_rw(const String& file_name, sys_file_cache_type_t /*cache_type*/)
+sys_file_t* sys_file_open_rw(const String& file_name, sys_file_cache_type_t cache_type)
 {
 	auto* ret = new sys_file_t;
 
@@ -272,6 +469,8 @@ sys_file_t* sys_file_open_rw(const String& file_name, sys_file_cache_type_t /*ca
 		ret->type = SYS_FILE_FILE;
 	}
 
+	file_advise(f, cache_type);
+
 	ret->f = f;
 
 	return ret;
@@ -291,6 +490,10 @@ void sys_file_close(sys_file_t* f)
 	{
 		Core::mem_free(f->buf->base);
 		delete f->buf;
+	} else if (f->type == SYS_FILE_MAPPED)
+	{
+		result = munmap(f->buf->base, f->buf->size);
+		delete f->buf;
 	}
 
 	// f.type = SYS_FILE_ERROR;
@@ -303,14 +506,14 @@ uint64_t sys_file_size(sys_file_t& f)
 
 	if (f.type == SYS_FILE_FILE)
 	{
-		uint32_t pos  = ftell(f.f);
-		result        = fseek(f.f, 0, SEEK_END);
-		uint32_t size = ftell(f.f);
-		result        = fseek(f.f, pos, SEEK_SET);
+		auto pos  = ftello(f.f);
+		result    = fseeko(f.f, 0, SEEK_END);
+		auto size = ftello(f.f);
+		result    = fseeko(f.f, pos, SEEK_SET);
 		return size;
 	}
 
-	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN)
+	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
 		return f.buf->size;
 	}
@@ -336,12 +539,12 @@ bool sys_file_seek(sys_file_t& f, uint64_t offset)
 	bool ok = true;
 	if (f.type == SYS_FILE_FILE)
 	{
-		ok = (fseek(f.f, static_cast<int64_t>(offset), SEEK_SET) == 0);
+		ok = (fseeko(f.f, static_cast<off_t>(offset), SEEK_SET) == 0);
 		//		LARGE_INTEGER s;
 		//		s.QuadPart = offset;
 		//		SetFilePointerEx(f.handle, s, 0, FILE_BEGIN);
 		// printf("seek: %u\n", offset);
-	} else if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN)
+	} else if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
 		f.buf->ptr = f.buf->base + offset;
 	}
@@ -352,10 +555,10 @@ uint64_t sys_file_tell(sys_file_t& f)
 {
 	if (f.type == SYS_FILE_FILE)
 	{
-		return ftell(f.f);
+		return ftello(f.f);
 	}
 
-	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN)
+	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
 		return f.buf->ptr - f.buf->base;
 	}
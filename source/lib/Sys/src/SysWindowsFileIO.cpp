@@ -44,28 +44,80 @@ static DWORD get_cache_access_type(sys_file_cache_type_t t)
 
 	if (t == SYS_FILE_CACHE_SEQUENTIAL_SCAN)
 	{
-		return SYS_FILE_CACHE_SEQUENTIAL_SCAN;
+		return FILE_FLAG_SEQUENTIAL_SCAN;
 	}
 
-	return SYS_FILE_CACHE_AUTO;
+	return FILE_ATTRIBUTE_NORMAL;
 }
 
-void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_read)
+// ReadFile/WriteFile take a 32-bit size
+constexpr uint64_t FILE_IO_CHUNK = 1024u * 1024u * 1024u;
+
+static uint64_t mem_buf_remaining(const sys_file_mem_buf_t* buf)
+{
+	auto pos = static_cast<uint64_t>(buf->ptr - buf->base);
+	return (pos < buf->size ? buf->size - pos : 0);
+}
+
+static uint64_t file_read(HANDLE handle, void* data, uint64_t size, const uint64_t* offset)
+{
+	uint64_t done = 0;
+	while (done < size)
+	{
+		OVERLAPPED o {};
+		DWORD      w = 0;
+		if (offset != nullptr)
+		{
+			o.Offset     = static_cast<DWORD>((*offset + done) & 0xffffffffu);
+			o.OffsetHigh = static_cast<DWORD>((*offset + done) >> 32u);
+		}
+		auto chunk = static_cast<DWORD>(size - done < FILE_IO_CHUNK ? size - done : FILE_IO_CHUNK);
+		if (ReadFile(handle, static_cast<uint8_t*>(data) + done, chunk, &w, (offset != nullptr ? &o : nullptr)) == 0 || w == 0)
+		{
+			break;
+		}
+		done += w;
+	}
+	return done;
+}
+
+static uint64_t file_write(HANDLE handle, const void* data, uint64_t size, const uint64_t* offset)
+{
+	uint64_t done = 0;
+	while (done < size)
+	{
+		OVERLAPPED o {};
+		DWORD      w = 0;
+		if (offset != nullptr)
+		{
+			o.Offset     = static_cast<DWORD>((*offset + done) & 0xffffffffu);
+			o.OffsetHigh = static_cast<DWORD>((*offset + done) >> 32u);
+		}
+		auto chunk = static_cast<DWORD>(size - done < FILE_IO_CHUNK ? size - done : FILE_IO_CHUNK);
+		if (WriteFile(handle, static_cast<const uint8_t*>(data) + done, chunk, &w, (offset != nullptr ? &o : nullptr)) == 0 || w == 0)
+		{
+			break;
+		}
+		done += w;
+	}
+	return done;
+}
+
+void sys_file_read(void* data, uint64_t size, sys_file_t& f, uint64_t* bytes_read)
 {
 	if (f.type == SYS_FILE_FILE)
 	{
-		DWORD w = 0;
-		ReadFile(f.handle, data, size, &w, nullptr);
+		uint64_t w = file_read(f.handle, data, size, nullptr);
 		if (bytes_read != nullptr)
 		{
 			*bytes_read = w;
 		}
 	} else if (f.type == SYS_FILE_MEMORY_STAT)
 	{
-		uint32_t s = size;
+		uint64_t s = size;
 		if (f.buf->size != 0u)
 		{
-			uint32_t l = f.buf->size - (f.buf->ptr - f.buf->base);
+			uint64_t l = mem_buf_remaining(f.buf);
 			if (s > l)
 			{
 				s = l;
@@ -77,12 +129,12 @@ void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_rea
 		{
 			*bytes_read = s;
 		}
-	} else if (f.type == SYS_FILE_MEMORY_DYN)
+	} else if (f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
-		uint32_t s = size;
+		uint64_t s = size;
 		if (f.buf->size != 0u)
 		{
-			uint32_t l = f.buf->size - (f.buf->ptr - f.buf->base);
+			uint64_t l = mem_buf_remaining(f.buf);
 			if (s > l)
 			{
 				s = l;
@@ -100,22 +152,21 @@ void sys_file_read(void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_rea
 	}
 }
 
-void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* bytes_written)
+void sys_file_write(const void* data, uint64_t size, sys_file_t& f, uint64_t* bytes_written)
 {
 	if (f.type == SYS_FILE_FILE)
 	{
-		DWORD w = 0;
-		WriteFile(f.handle, data, size, &w, nullptr);
+		uint64_t w = file_write(f.handle, data, size, nullptr);
 		if (bytes_written != nullptr)
 		{
 			*bytes_written = w;
 		}
 	} else if (f.type == SYS_FILE_MEMORY_STAT)
 	{
-		uint32_t s = size;
+		uint64_t s = size;
 		if (f.buf->size != 0u)
 		{
-			uint32_t l = f.buf->size - (f.buf->ptr - f.buf->base);
+			uint64_t l = mem_buf_remaining(f.buf);
 			if (s > l)
 			{
 				s = l;
@@ -129,7 +180,7 @@ void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* by
 		}
 	} else if (f.type == SYS_FILE_MEMORY_DYN)
 	{
-		uint32_t pos = f.buf->ptr - f.buf->base;
+		uint64_t pos = f.buf->ptr - f.buf->base;
 		if (f.buf->size < pos + size)
 		{
 			f.buf->base = static_cast<uint8_t*>(mem_realloc(f.buf->base, pos + size));
@@ -145,6 +196,95 @@ void sys_file_write(const void* data, uint32_t size, sys_file_t& f, uint32_t* by
 	}
 }
 
+// With a synchronous handle ReadFile/WriteFile move the file pointer even when the offset is given, so it's put back. The caller
+// must keep other I/O on the file from running meanwhile.
+void sys_file_read_at(void* data, uint64_t size, uint64_t offset, sys_file_t& f, uint64_t* bytes_read)
+{
+	if (f.type == SYS_FILE_FILE)
+	{
+		auto     pos = sys_file_tell(f);
+		uint64_t w   = file_read(f.handle, data, size, &offset);
+		sys_file_seek(f, pos);
+		if (bytes_read != nullptr)
+		{
+			*bytes_read = w;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_STAT)
+	{
+		// The cursor is not touched, so concurrent positional reads are safe
+		uint64_t s = size;
+		if (f.buf->size != 0u)
+		{
+			uint64_t l = (offset < f.buf->size ? f.buf->size - offset : 0);
+			if (s > l)
+			{
+				s = l;
+			}
+		}
+		std::memcpy(data, f.buf->base + offset, s);
+		if (bytes_read != nullptr)
+		{
+			*bytes_read = s;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
+	{
+		uint64_t s = (offset < f.buf->size ? f.buf->size - offset : 0);
+		if (s > size)
+		{
+			s = size;
+		}
+		std::memcpy(data, f.buf->base + offset, s);
+		if (bytes_read != nullptr)
+		{
+			*bytes_read = s;
+		}
+	}
+}
+
+void sys_file_write_at(const void* data, uint64_t size, uint64_t offset, sys_file_t& f, uint64_t* bytes_written)
+{
+	if (f.type == SYS_FILE_FILE)
+	{
+		auto     pos = sys_file_tell(f);
+		uint64_t w   = file_write(f.handle, data, size, &offset);
+		sys_file_seek(f, pos);
+		if (bytes_written != nullptr)
+		{
+			*bytes_written = w;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_STAT)
+	{
+		uint64_t s = size;
+		if (f.buf->size != 0u)
+		{
+			uint64_t l = (offset < f.buf->size ? f.buf->size - offset : 0);
+			if (s > l)
+			{
+				s = l;
+			}
+		}
+		std::memcpy(f.buf->base + offset, data, s);
+		if (bytes_written != nullptr)
+		{
+			*bytes_written = s;
+		}
+	} else if (f.type == SYS_FILE_MEMORY_DYN)
+	{
+		if (f.buf->size < offset + size)
+		{
+			uint64_t pos = f.buf->ptr - f.buf->base;
+			f.buf->base  = static_cast<uint8_t*>(mem_realloc(f.buf->base, offset + size));
+			f.buf->ptr   = f.buf->base + pos;
+			f.buf->size  = offset + size;
+		}
+		std::memcpy(f.buf->base + offset, data, size);
+		if (bytes_written != nullptr)
+		{
+			*bytes_written = size;
+		}
+	}
+}
+
 void sys_file_read_r(void* data, uint32_t size, sys_file_t& f)
 {
 	// DWORD w;
@@ -219,7 +359,54 @@ sys_file_t* sys_file_open_r(const String& file_name, sys_file_cache_type_t cache
 	return ret;
 }
 
-sys_file_t* sys_file_open(uint8_t* buf, uint32_t buf_size)
+// Read-only view of the whole file. Reads are served from the page cache with one memcpy.
+sys_file_t* sys_file_open_mapped(const String& file_name, sys_file_cache_type_t cache_type)
+{
+	HANDLE h_file = CreateFileW(reinterpret_cast<LPCWSTR>(file_name.utf16_str().GetData()), GENERIC_READ, FILE_SHARE_READ, nullptr,
+	                            OPEN_EXISTING, get_cache_access_type(cache_type), nullptr);
+
+	if (h_file == KYTY_INVALID_HANDLE_VALUE())
+	{
+		auto* ret   = new sys_file_t;
+		ret->type   = SYS_FILE_ERROR;
+		ret->handle = h_file;
+		return ret;
+	}
+
+	LARGE_INTEGER size {};
+	void*         addr = nullptr;
+
+	if (GetFileSizeEx(h_file, &size) != 0 && size.QuadPart > 0)
+	{
+		HANDLE h_map = CreateFileMappingW(h_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (h_map != nullptr)
+		{
+			addr = MapViewOfFile(h_map, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(h_map);
+		}
+	}
+
+	// The view keeps its own reference to the file
+	CloseHandle(h_file);
+
+	if (addr == nullptr)
+	{
+		// Empty files can't be mapped
+		return sys_file_open_r(file_name, cache_type);
+	}
+
+	auto* ret = new sys_file_t;
+
+	ret->type      = SYS_FILE_MAPPED;
+	ret->buf       = new sys_file_mem_buf_t;
+	ret->buf->base = static_cast<uint8_t*>(addr);
+	ret->buf->ptr  = ret->buf->base;
+	ret->buf->size = size.QuadPart;
+
+	return ret;
+}
+
+sys_file_t* sys_file_open(uint8_t* buf, uint64_t buf_size)
 {
 	auto* ret = new sys_file_t;
 
@@ -300,6 +487,10 @@ void sys_file_close(sys_file_t* f)
 	{
 		mem_free(f->buf->base);
 		delete f->buf;
+	} else if (f->type == SYS_FILE_MAPPED)
+	{
+		UnmapViewOfFile(f->buf->base);
+		delete f->buf;
 	}
 
 	// f.type = SYS_FILE_ERROR;
@@ -315,7 +506,7 @@ uint64_t sys_file_size(sys_file_t& f)
 		return s.QuadPart;
 	}
 
-	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN)
+	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
 		return f.buf->size;
 	}
@@ -365,7 +556,7 @@ bool sys_file_seek(sys_file_t& f, uint64_t offset)
 		s.QuadPart = static_cast<LONGLONG>(offset);
 		ok         = (SetFilePointerEx(f.handle, s, nullptr, FILE_BEGIN) != 0);
 		// printf("seek: %u\n", offset);
-	} else if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN)
+	} else if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
 		f.buf->ptr = f.buf->base + offset;
 	}
@@ -385,7 +576,7 @@ uint64_t sys_file_tell(sys_file_t& f)
 		return r.QuadPart;
 	}
 
-	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN)
+	if (f.type == SYS_FILE_MEMORY_STAT || f.type == SYS_FILE_MEMORY_DYN || f.type == SYS_FILE_MAPPED)
 	{
 		return f.buf->ptr - f.buf->base;
 	}
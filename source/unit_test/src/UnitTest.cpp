@@ -6,6 +6,12 @@ UT_LINK(CoreCharString);
 UT_LINK(CoreCharString8);
 UT_LINK(CoreMSpace);
 UT_LINK(CoreDateTime);
+UT_LINK(CoreThreads);
+UT_LINK(CoreRangeAllocator);
+UT_LINK(CoreHashmap);
+UT_LINK(CoreIntervalTree);
+UT_LINK(CoreMemcpy);
+UT_LINK(CoreFile);
 
 KYTY_SUBSYSTEM_INIT(UnitTest)
 {
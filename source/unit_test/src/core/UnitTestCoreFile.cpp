@@ -0,0 +1,334 @@
+#include "Kyty/Core/File.h"
+#include "Kyty/Core/Threads.h"
+#include "Kyty/Core/Timer.h"
+#include "Kyty/UnitTest.h"
+
+#include <atomic>
+
+UT_BEGIN(CoreFile);
+
+using Core::File;
+using Core::LockGuard;
+using Core::Mutex;
+using Core::Thread;
+using Core::Timer;
+
+static void test_read_at()
+{
+	String name = U"_unit_test_file_read_at.bin";
+
+	File f;
+	ASSERT_TRUE(f.Create(name));
+
+	uint32_t data[256];
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		data[i] = i;
+	}
+	f.Write(data, sizeof(data));
+
+	// Buffered data must be visible to the positional read, the cursor must stay where it was
+	uint32_t v          = 0;
+	uint64_t bytes_read = 0;
+	f.ReadAt(&v, 4, 100 * 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 4u);
+	EXPECT_EQ(v, 100u);
+	EXPECT_EQ(f.Tell(), sizeof(data));
+
+	v = 12345;
+	f.WriteAt(&v, 4, 10 * 4);
+	EXPECT_EQ(f.Tell(), sizeof(data));
+
+	f.Seek(10 * 4);
+	f.Read(&v, 4);
+	EXPECT_EQ(v, 12345u);
+	EXPECT_EQ(f.Tell(), 11u * 4);
+
+	// Past the end
+	f.ReadAt(&v, 4, sizeof(data) + 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 0u);
+
+	f.Close();
+	EXPECT_TRUE(File::DeleteFile(name));
+
+	File m;
+	ASSERT_TRUE(m.OpenInMem(data, sizeof(data)));
+	m.Seek(8);
+	m.ReadAt(&v, 4, 200 * 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 4u);
+	EXPECT_EQ(v, 200u);
+	EXPECT_EQ(m.Tell(), 8u);
+	m.Close();
+}
+
+static void test_mapped()
+{
+	String name = U"_unit_test_file_mapped.bin";
+
+	uint32_t data[256];
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		data[i] = i;
+	}
+
+	File w;
+	ASSERT_TRUE(w.Create(name));
+	w.Write(data, sizeof(data));
+	w.Close();
+
+	File f;
+	ASSERT_TRUE(f.OpenMapped(name, File::CacheHint::RandomAccess));
+	EXPECT_EQ(f.Size(), sizeof(data));
+
+	uint32_t v          = 0;
+	uint64_t bytes_read = 0;
+	f.ReadAt(&v, 4, 100 * 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 4u);
+	EXPECT_EQ(v, 100u);
+	EXPECT_EQ(f.Tell(), 0u);
+
+	EXPECT_TRUE(f.Seek(10 * 4));
+	f.Read(&v, 4);
+	EXPECT_EQ(v, 10u);
+	EXPECT_EQ(f.Tell(), 11u * 4);
+
+	// Read-only
+	v                      = 12345;
+	uint64_t bytes_written = 0;
+	f.Write(&v, 4, &bytes_written);
+	EXPECT_EQ(bytes_written, 0u);
+	f.ReadAt(&v, 4, 11 * 4);
+	EXPECT_EQ(v, 11u);
+
+	// Past the end
+	f.ReadAt(&v, 4, sizeof(data) - 2, &bytes_read);
+	EXPECT_EQ(bytes_read, 2u);
+	f.ReadAt(&v, 4, sizeof(data) + 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 0u);
+	EXPECT_TRUE(f.Seek(sizeof(data)));
+	f.Read(&v, 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 0u);
+
+	f.Close();
+	EXPECT_TRUE(File::DeleteFile(name));
+
+	// Empty file can't be mapped, falls back to the regular read
+	ASSERT_TRUE(w.Create(name));
+	w.Close();
+	ASSERT_TRUE(f.OpenMapped(name));
+	EXPECT_EQ(f.Size(), 0u);
+	f.Read(&v, 4, &bytes_read);
+	EXPECT_EQ(bytes_read, 0u);
+	f.Close();
+	EXPECT_TRUE(File::DeleteFile(name));
+
+	EXPECT_FALSE(f.OpenMapped(U"_unit_test_file_mapped_not_existing.bin"));
+}
+
+#if KYTY_PLATFORM == KYTY_PLATFORM_LINUX
+// Sparse file, the offsets don't fit into 32 bits
+static void test_large_offset()
+{
+	String name = U"_unit_test_file_large_offset.bin";
+
+	static constexpr uint64_t OFFSET = 5ull * 1024 * 1024 * 1024;
+
+	File f;
+	ASSERT_TRUE(f.Create(name));
+
+	uint32_t v             = 0x12345678;
+	uint64_t bytes_written = 0;
+	f.WriteAt(&v, 4, OFFSET, &bytes_written);
+	EXPECT_EQ(bytes_written, 4u);
+	EXPECT_EQ(f.Size(), OFFSET + 4);
+
+	EXPECT_TRUE(f.Seek(OFFSET));
+	EXPECT_EQ(f.Tell(), OFFSET);
+
+	v = 0;
+	f.Read(&v, 4);
+	EXPECT_EQ(v, 0x12345678u);
+
+	f.Close();
+	EXPECT_TRUE(File::DeleteFile(name));
+}
+#endif
+
+struct ReadArgs
+{
+	File*            file        = nullptr;
+	Mutex*           mutex       = nullptr;
+	std::atomic_int* ready       = nullptr;
+	int              threads_num = 0;
+	int              reads       = 0;
+	uint32_t         seed        = 0;
+	uint32_t         blocks_num  = 0;
+	int              wrong       = 0;
+};
+
+static constexpr uint32_t BLOCK_SIZE = 16 * 1024;
+
+static bool check_block(const uint32_t* buf, uint32_t block)
+{
+	return buf[0] == block * (BLOCK_SIZE / 4) && buf[BLOCK_SIZE / 4 - 1] == (block + 1) * (BLOCK_SIZE / 4) - 1;
+}
+
+static uint32_t next_block(ReadArgs* a)
+{
+	a->seed = a->seed * 1664525u + 1013904223u;
+	return (a->seed >> 8u) % a->blocks_num;
+}
+
+// What KernelPread used to do: seek, read and seek back under the file mutex
+static void read_seek_func(void* arg)
+{
+	auto* a   = static_cast<ReadArgs*>(arg);
+	auto* buf = new uint32_t[BLOCK_SIZE / 4];
+
+	(*a->ready)++;
+	while (*a->ready < a->threads_num)
+	{
+	}
+
+	for (int i = 0; i < a->reads; i++)
+	{
+		uint32_t block = next_block(a);
+
+		LockGuard lock(*a->mutex);
+
+		auto pos = a->file->Tell();
+		a->file->Seek(static_cast<uint64_t>(block) * BLOCK_SIZE);
+		a->file->Read(buf, BLOCK_SIZE);
+		a->file->Seek(pos);
+
+		a->wrong += (check_block(buf, block) ? 0 : 1);
+	}
+
+	delete[] buf;
+}
+
+static void read_at_func(void* arg)
+{
+	auto* a   = static_cast<ReadArgs*>(arg);
+	auto* buf = new uint32_t[BLOCK_SIZE / 4];
+
+	(*a->ready)++;
+	while (*a->ready < a->threads_num)
+	{
+	}
+
+	for (int i = 0; i < a->reads; i++)
+	{
+		uint32_t block = next_block(a);
+
+		a->file->ReadAt(buf, BLOCK_SIZE, static_cast<uint64_t>(block) * BLOCK_SIZE);
+
+		a->wrong += (check_block(buf, block) ? 0 : 1);
+	}
+
+	delete[] buf;
+}
+
+static double test_random_read(File* file, uint32_t blocks_num, int threads_num, int reads, bool positional)
+{
+	static constexpr int THREADS_MAX = 16;
+
+	Mutex           mutex;
+	std::atomic_int ready = 0;
+	ReadArgs        args[THREADS_MAX];
+	Thread*         threads[THREADS_MAX] {};
+
+	Timer timer;
+	timer.Start();
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		args[i].file        = file;
+		args[i].mutex       = &mutex;
+		args[i].ready       = &ready;
+		args[i].threads_num = threads_num;
+		args[i].reads       = reads;
+		args[i].seed        = 12345u + static_cast<uint32_t>(i);
+		args[i].blocks_num  = blocks_num;
+		threads[i]          = new Thread(positional ? read_at_func : read_seek_func, &args[i]);
+	}
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		threads[i]->Join();
+		delete threads[i];
+		EXPECT_EQ(args[i].wrong, 0);
+	}
+
+	return timer.GetTimeMs();
+}
+
+static void test_benchmark()
+{
+	// Small enough for every unit_test run, the file stays in the page cache anyway
+	static constexpr uint32_t FILE_SIZE = 8 * 1024 * 1024;
+	static constexpr int      READS     = 4000;
+
+	String name = U"_unit_test_file_random_read.bin";
+
+	File w;
+	ASSERT_TRUE(w.Create(name));
+
+	auto* buf = new uint32_t[BLOCK_SIZE / 4];
+	for (uint32_t block = 0; block < FILE_SIZE / BLOCK_SIZE; block++)
+	{
+		for (uint32_t i = 0; i < BLOCK_SIZE / 4; i++)
+		{
+			buf[i] = block * (BLOCK_SIZE / 4) + i;
+		}
+		w.Write(buf, BLOCK_SIZE);
+	}
+	delete[] buf;
+	w.Close();
+
+	File f;
+	ASSERT_TRUE(f.Open(name, File::Mode::Read));
+
+	File m;
+	ASSERT_TRUE(m.OpenMapped(name, File::CacheHint::RandomAccess));
+
+	for (int threads_num: {1, 4, 8})
+	{
+		double seek_ms   = test_random_read(&f, FILE_SIZE / BLOCK_SIZE, threads_num, READS, false);
+		double at_ms     = test_random_read(&f, FILE_SIZE / BLOCK_SIZE, threads_num, READS, true);
+		double mapped_ms = test_random_read(&m, FILE_SIZE / BLOCK_SIZE, threads_num, READS, true);
+
+		auto mb = static_cast<double>(threads_num) * READS * BLOCK_SIZE / (1024.0 * 1024.0);
+
+		printf("random read, %d threads x %d x %u bytes: seek + read %.1f MB/s, read at %.1f MB/s, mapped %.1f MB/s\n", threads_num, READS,
+		       BLOCK_SIZE, mb * 1000.0 / seek_ms, mb * 1000.0 / at_ms, mb * 1000.0 / mapped_ms);
+	}
+
+	m.Close();
+	f.Close();
+	EXPECT_TRUE(File::DeleteFile(name));
+}
+
+TEST(Core, FileReadAt)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_read_at();
+	test_mapped();
+#if KYTY_PLATFORM == KYTY_PLATFORM_LINUX
+	test_large_offset();
+#endif
+
+	UT_MEM_CHECK();
+}
+
+TEST(Core, FileRandomReadBenchmark)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_benchmark();
+
+	UT_MEM_CHECK();
+}
+
+UT_END();
@@ -0,0 +1,216 @@
+#include "Kyty/Core/Hashmap.h"
+#include "Kyty/Core/String.h"
+#include "Kyty/Core/Timer.h"
+#include "Kyty/Core/Vector.h"
+#include "Kyty/Math/Rand.h"
+#include "Kyty/UnitTest.h"
+
+#include "UnitTestCoreHashmapOld.h"
+
+#include <unordered_map>
+
+UT_BEGIN(CoreHashmap);
+
+using Core::Hashmap;
+using Core::Timer;
+using Math::Rand;
+
+static void test_random()
+{
+	Hashmap<uint64_t, int>            h;
+	std::unordered_map<uint64_t, int> r;
+
+	bool ok = true;
+
+	for (int i = 0; i < 200000 && ok; i++)
+	{
+		// Small key range gives long clusters and a lot of removals
+		uint64_t key   = static_cast<uint64_t>(Rand::UintInclusiveRange(0, 3000)) << (i % 3 == 0 ? 32u : 4u);
+		int      value = Rand::Int();
+
+		switch (Rand::Uint() % 5)
+		{
+			case 0:
+				h.Put(key, value);
+				r[key] = value;
+				break;
+			case 1:
+				h[key] += value;
+				r[key] += value;
+				break;
+			case 2:
+			case 3:
+				h.Remove(key);
+				r.erase(key);
+				break;
+			default:
+			{
+				const auto* v = h.Find(key);
+				auto        f = r.find(key);
+				ok            = (v == nullptr ? f == r.end() : (f != r.end() && *v == f->second));
+				ok            = ok && h.Get(key, -1) == (f == r.end() ? -1 : f->second);
+				break;
+			}
+		}
+
+		ok = ok && h.Size() == r.size();
+	}
+
+	EXPECT_TRUE(ok);
+
+	uint32_t num = 0;
+	FOR_HASH (h)
+	{
+		auto f = r.find(h.Key());
+		EXPECT_TRUE(f != r.end() && f->second == h.Value());
+		num++;
+	}
+	EXPECT_EQ(num, r.size());
+
+	for (const auto& [key, value]: r)
+	{
+		EXPECT_TRUE(h.Contains(key));
+		h.Remove(key);
+	}
+	EXPECT_EQ(h.Size(), 0u);
+	EXPECT_EQ(h.Find(0), nullptr);
+}
+
+static void test_types()
+{
+	Hashmap<String, Vector<int>> h;
+
+	h.Reserve(1000);
+
+	for (int i = 0; i < 1000; i++)
+	{
+		h[String::FromPrintf("key_%d", i)].Add(i);
+		h[String::FromPrintf("key_%d", i / 2)].Add(i);
+	}
+
+	EXPECT_EQ(h.Size(), 1000u);
+	EXPECT_EQ(h.Get(U"key_10").Size(), 3u);
+	EXPECT_EQ(h.Get(U"key_999").Size(), 1u);
+	EXPECT_FALSE(h.Contains(U"key_1000"));
+
+	for (int i = 0; i < 1000; i += 2)
+	{
+		h.Remove(String::FromPrintf("key_%d", i));
+	}
+
+	EXPECT_EQ(h.Size(), 500u);
+	EXPECT_EQ(h.Get(U"key_11").Size(), 3u);
+
+	h.Clear();
+	EXPECT_EQ(h.Size(), 0u);
+
+	// Heterogeneous lookup
+	Hashmap<uint64_t, int> h64;
+	h64.Put(0x12345678u, 1);
+	h64.Put(UINT64_MAX, 2);
+	EXPECT_TRUE(h64.Contains(static_cast<uint32_t>(0x12345678u)));
+	EXPECT_FALSE(h64.Contains(UINT32_MAX));
+	EXPECT_EQ(h64.Get(static_cast<uint16_t>(0x5678u), -1), -1);
+
+	Hashmap<int64_t, int> hs;
+	hs.Put(-1, 3);
+	EXPECT_EQ(hs.Get(static_cast<int8_t>(-1)), 3);
+}
+
+template <class M>
+static void bench_put(M* m, const Vector<uint64_t>& keys)
+{
+	for (auto k: keys)
+	{
+		m->Put(k, static_cast<uint32_t>(k));
+	}
+}
+
+template <class M>
+static uint32_t bench_find(const M& m, const Vector<uint64_t>& keys)
+{
+	uint32_t sum = 0;
+	for (auto k: keys)
+	{
+		if (const auto* v = m.Find(k); v != nullptr)
+		{
+			sum += *v;
+		}
+	}
+	return sum;
+}
+
+template <class M>
+static void bench_remove(M* m, const Vector<uint64_t>& keys)
+{
+	for (auto k: keys)
+	{
+		m->Remove(k);
+	}
+}
+
+TEST(Core, Hashmap)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_random();
+	test_types();
+
+	UT_MEM_CHECK();
+}
+
+static void test_benchmark()
+{
+	static constexpr uint32_t NUM = 500000;
+
+	// Page-aligned addresses, like GPU memory lookups
+	Vector<uint64_t> keys;
+	Vector<uint64_t> misses;
+	for (uint32_t i = 0; i < NUM; i++)
+	{
+		keys.Add((static_cast<uint64_t>(Rand::Uint()) << 16u) | (static_cast<uint64_t>(i) << 48u));
+		misses.Add(keys.At(i) + 0x1000);
+	}
+
+	Timer t;
+
+	// The previous implementation: chained buckets, an allocation per entry, 32-bit hash called through a pointer
+	Core::HashmapOld::Hashmap<uint64_t, uint32_t> c;
+	t.Start();
+	bench_put(&c, keys);
+	double c_put = t.GetTimeMs();
+	t.Start();
+	uint32_t c_sum = bench_find(c, keys) + bench_find(c, misses);
+	double   c_find = t.GetTimeMs();
+	t.Start();
+	bench_remove(&c, keys);
+	double c_remove = t.GetTimeMs();
+
+	Hashmap<uint64_t, uint32_t> h;
+	t.Start();
+	bench_put(&h, keys);
+	double h_put = t.GetTimeMs();
+	t.Start();
+	uint32_t h_sum = bench_find(h, keys) + bench_find(h, misses);
+	double   h_find = t.GetTimeMs();
+	t.Start();
+	bench_remove(&h, keys);
+	double h_remove = t.GetTimeMs();
+
+	EXPECT_EQ(c_sum, h_sum);
+	EXPECT_EQ(h.Size(), 0u);
+
+	printf("hashmap, %u keys: put %.1f ms -> %.1f ms, find %.1f ms -> %.1f ms, remove %.1f ms -> %.1f ms\n", NUM, c_put, h_put, c_find,
+	       h_find, c_remove, h_remove);
+}
+
+TEST(Core, HashmapBenchmark)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_benchmark();
+
+	UT_MEM_CHECK();
+}
+
+UT_END();
@@ -1,4 +1,4 @@
-#include "Kyty/Core/Hashmap.h"
+#include "UnitTestCoreHashmapOld.h"
 
 #include "Kyty/Core/DbgAssert.h"
 #include "Kyty/Core/Hash.h"
@@ -6,13 +6,13 @@
 
 #include <cstring>
 
-namespace Kyty::Core {
+namespace Kyty::Core::HashmapOld {
 
 constexpr uint32_t HASH_MAX_KEY_SIZE   = 32;
 constexpr uint32_t HASH_MAX_VALUE_SIZE = 16;
 
-#define KYTY_HASH_DEFINE_INT(type)                                                                                                         \
-	KYTY_HASH_DEFINE_CALC(type)                                                                                                            \
+#define KYTY_HASH_OLD_DEFINE_INT(type)                                                                                                     \
+	KYTY_HASH_OLD_DEFINE_CALC(type)                                                                                                        \
 	{                                                                                                                                      \
 		switch (sizeof(type))                                                                                                              \
 		{                                                                                                                                  \
@@ -23,10 +23,10 @@ constexpr uint32_t HASH_MAX_VALUE_SIZE = 16;
 		}                                                                                                                                  \
 		return hash((void*)key, sizeof(type));                                                                                             \
 	}                                                                                                                                      \
-	KYTY_HASH_DEFINE_EQUALS(type) { return (*key_a) == (*key_b); }
+	KYTY_HASH_OLD_DEFINE_EQUALS(type) { return (*key_a) == (*key_b); }
 
-#define KYTY_HASH_DEFINE_PTR(type)                                                                                                         \
-	KYTY_HASH_DEFINE_CALC(type)                                                                                                            \
+#define KYTY_HASH_OLD_DEFINE_PTR(type)                                                                                                     \
+	KYTY_HASH_OLD_DEFINE_CALC(type)                                                                                                        \
 	{                                                                                                                                      \
 		switch (sizeof(type))                                                                                                              \
 		{                                                                                                                                  \
@@ -35,29 +35,29 @@ constexpr uint32_t HASH_MAX_VALUE_SIZE = 16;
 		}                                                                                                                                  \
 		return hash((void*)key, sizeof(type));                                                                                             \
 	}                                                                                                                                      \
-	KYTY_HASH_DEFINE_EQUALS(type) { return (*key_a) == (*key_b); }
-
-KYTY_HASH_DEFINE_INT(int8_t);
-KYTY_HASH_DEFINE_INT(uint8_t);
-KYTY_HASH_DEFINE_INT(int16_t);
-KYTY_HASH_DEFINE_INT(uint16_t);
-KYTY_HASH_DEFINE_INT(int32_t);
-KYTY_HASH_DEFINE_INT(uint32_t);
-KYTY_HASH_DEFINE_INT(int64_t);
-KYTY_HASH_DEFINE_INT(uint64_t);
-KYTY_HASH_DEFINE_INT(char16_t);
-KYTY_HASH_DEFINE_INT(char32_t);
-KYTY_HASH_DEFINE_PTR(int8_t*);
-KYTY_HASH_DEFINE_PTR(uint8_t*);
-KYTY_HASH_DEFINE_PTR(int16_t*);
-KYTY_HASH_DEFINE_PTR(uint16_t*);
-KYTY_HASH_DEFINE_PTR(int32_t*);
-KYTY_HASH_DEFINE_PTR(uint32_t*);
-KYTY_HASH_DEFINE_PTR(int64_t*);
-KYTY_HASH_DEFINE_PTR(uint64_t*);
-KYTY_HASH_DEFINE_PTR(char16_t*);
-KYTY_HASH_DEFINE_PTR(char32_t*);
-KYTY_HASH_DEFINE_PTR(void*);
+	KYTY_HASH_OLD_DEFINE_EQUALS(type) { return (*key_a) == (*key_b); }
+
+KYTY_HASH_OLD_DEFINE_INT(int8_t);
+KYTY_HASH_OLD_DEFINE_INT(uint8_t);
+KYTY_HASH_OLD_DEFINE_INT(int16_t);
+KYTY_HASH_OLD_DEFINE_INT(uint16_t);
+KYTY_HASH_OLD_DEFINE_INT(int32_t);
+KYTY_HASH_OLD_DEFINE_INT(uint32_t);
+KYTY_HASH_OLD_DEFINE_INT(int64_t);
+KYTY_HASH_OLD_DEFINE_INT(uint64_t);
+KYTY_HASH_OLD_DEFINE_INT(char16_t);
+KYTY_HASH_OLD_DEFINE_INT(char32_t);
+KYTY_HASH_OLD_DEFINE_PTR(int8_t*);
+KYTY_HASH_OLD_DEFINE_PTR(uint8_t*);
+KYTY_HASH_OLD_DEFINE_PTR(int16_t*);
+KYTY_HASH_OLD_DEFINE_PTR(uint16_t*);
+KYTY_HASH_OLD_DEFINE_PTR(int32_t*);
+KYTY_HASH_OLD_DEFINE_PTR(uint32_t*);
+KYTY_HASH_OLD_DEFINE_PTR(int64_t*);
+KYTY_HASH_OLD_DEFINE_PTR(uint64_t*);
+KYTY_HASH_OLD_DEFINE_PTR(char16_t*);
+KYTY_HASH_OLD_DEFINE_PTR(char32_t*);
+KYTY_HASH_OLD_DEFINE_PTR(void*);
 
 class HashmapPrivate
 {
@@ -504,4 +504,4 @@ uint32_t HashmapBase::CollisionsCount() const
 	return m_p->CollisionsCount();
 }
 
-} // namespace Kyty::Core
+} // namespace Kyty::Core::HashmapOld
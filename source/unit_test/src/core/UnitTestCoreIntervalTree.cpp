@@ -0,0 +1,283 @@
+#include "Kyty/Core/Hashmap.h"
+#include "Kyty/Core/IntervalTree.h"
+#include "Kyty/Core/Timer.h"
+#include "Kyty/Core/Vector.h"
+#include "Kyty/Math/Rand.h"
+#include "Kyty/UnitTest.h"
+
+#include <algorithm>
+#include <vector>
+
+UT_BEGIN(CoreIntervalTree);
+
+using Core::IntervalTree;
+using Core::Timer;
+using Math::Rand;
+
+struct TestRange
+{
+	uint64_t start = 0;
+	uint64_t size  = 0;
+	int      id    = 0;
+};
+
+static std::vector<int> sorted(const Vector<int>& ids)
+{
+	std::vector<int> ret(ids.begin(), ids.end());
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
+
+static void test_simple()
+{
+	IntervalTree t;
+
+	t.Insert(0x1000, 0x1000, 1);
+	t.Insert(0x1800, 0x100, 2);
+	t.Insert(0x1000, 0x10, 3);
+	t.Insert(0x5000, 0x1000, 1);
+	t.Insert(0x5000, 0x1000, 1);
+
+	EXPECT_EQ(t.Size(), 4u);
+
+	Vector<int> ids;
+	t.FindOverlaps(0x18f0, 0x4000, &ids);
+	EXPECT_EQ(sorted(ids), (std::vector<int> {1, 1, 2}));
+
+	ids.Clear();
+	t.FindOverlaps(0x2000, 0x3000, &ids);
+	EXPECT_TRUE(ids.IsEmpty());
+
+	ids.Clear();
+	t.FindStart(0x1000, &ids);
+	EXPECT_EQ(sorted(ids), (std::vector<int> {1, 3}));
+
+	EXPECT_FALSE(t.Erase(0x1000, 0x1000, 2));
+	EXPECT_TRUE(t.Erase(0x1000, 0x1000, 1));
+	EXPECT_FALSE(t.Erase(0x1000, 0x1000, 1));
+
+	ids.Clear();
+	t.FindOverlaps(0, UINT64_MAX, &ids);
+	EXPECT_EQ(sorted(ids), (std::vector<int> {1, 2, 3}));
+
+	EXPECT_TRUE(t.Erase(0x1800, 0x100, 2));
+	EXPECT_TRUE(t.Erase(0x1000, 0x10, 3));
+	EXPECT_TRUE(t.Erase(0x5000, 0x1000, 1));
+	EXPECT_TRUE(t.IsEmpty());
+}
+
+static void test_random()
+{
+	IntervalTree           t;
+	std::vector<TestRange> ranges;
+	bool                   ok = true;
+
+	for (int r = 0; r < 20000 && ok; r++)
+	{
+		if (ranges.empty() || Rand::Uint() % 3 != 0)
+		{
+			TestRange range {static_cast<uint64_t>(Rand::UintInclusiveRange(0, 1000)) * 0x100,
+			                 static_cast<uint64_t>(Rand::UintInclusiveRange(1, 64)) * 0x100, static_cast<int>(Rand::UintInclusiveRange(0, 1000))};
+			if (std::none_of(ranges.begin(), ranges.end(),
+			                 [&](const auto& o) { return o.start == range.start && o.size == range.size && o.id == range.id; }))
+			{
+				ranges.push_back(range);
+			}
+			t.Insert(range.start, range.size, range.id);
+		} else
+		{
+			auto index = Rand::UintInclusiveRange(0, ranges.size() - 1);
+			ok         = t.Erase(ranges[index].start, ranges[index].size, ranges[index].id);
+			ranges.erase(ranges.begin() + index);
+		}
+
+		uint64_t start = static_cast<uint64_t>(Rand::UintInclusiveRange(0, 1100)) * 0x80;
+		uint64_t size  = static_cast<uint64_t>(Rand::UintInclusiveRange(1, 128)) * 0x80;
+
+		Vector<int> ids;
+		Vector<int> ref;
+		t.FindOverlaps(start, size, &ids);
+		for (const auto& o: ranges)
+		{
+			if (o.start < start + size && start < o.start + o.size)
+			{
+				ref.Add(o.id);
+			}
+		}
+
+		Vector<int> ids_start;
+		Vector<int> ref_start;
+		t.FindStart(start, &ids_start);
+		for (const auto& o: ranges)
+		{
+			if (o.start == start)
+			{
+				ref_start.Add(o.id);
+			}
+		}
+
+		ok = ok && t.Size() == ranges.size() && sorted(ids) == sorted(ref) && sorted(ids_start) == sorted(ref_start);
+	}
+
+	EXPECT_TRUE(ok);
+}
+
+TEST(Core, IntervalTree)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_simple();
+	test_random();
+
+	UT_MEM_CHECK();
+}
+
+// Reference for the benchmark: the previous GpuMemory index (16KB page buckets)
+class PageMap
+{
+public:
+	void Insert(uint64_t vaddr, uint64_t size, int id)
+	{
+		for (auto page = vaddr >> PAGE_BITS; page <= (vaddr + size - 1) >> PAGE_BITS; page++)
+		{
+			auto& ids = m_map[page];
+			if (!ids.Contains(id))
+			{
+				ids.Add(id);
+			}
+		}
+	}
+
+	void Erase(uint64_t vaddr, uint64_t size, int id)
+	{
+		for (auto page = vaddr >> PAGE_BITS; page <= (vaddr + size - 1) >> PAGE_BITS; page++)
+		{
+			auto& ids = m_map[page];
+			ids.Remove(id);
+			if (ids.IsEmpty())
+			{
+				m_map.Remove(page);
+			}
+		}
+	}
+
+	[[nodiscard]] Vector<int> FindAll(uint64_t vaddr, uint64_t size) const
+	{
+		Vector<int> ret;
+		for (auto page = vaddr >> PAGE_BITS; page <= (vaddr + size - 1) >> PAGE_BITS; page++)
+		{
+			for (int id: m_map.Get(page))
+			{
+				if (!ret.Contains(id))
+				{
+					ret.Add(id);
+				}
+			}
+		}
+		return ret;
+	}
+
+private:
+	static constexpr uint32_t PAGE_BITS = 14u;
+
+	Core::Hashmap<uint64_t, Vector<int>> m_map;
+};
+
+// The first large allocation after a lot of small frees merges all freed chunks, keep it out of the timings
+static void release_free_chunks()
+{
+	Vector<uint8_t> buf(64 * 1024, true);
+	buf.Memset(0);
+}
+
+static void test_benchmark()
+{
+	static constexpr int      NUM     = 30000;
+	static constexpr int      QUERIES = 2000;
+	static constexpr uint64_t BASE    = 0x0000000400000000;
+
+	// Mostly small buffers and textures, every 16th object is a render target of 8-32 MB
+	std::vector<TestRange> ranges;
+	uint64_t               addr = BASE;
+	for (int i = 0; i < NUM; i++)
+	{
+		uint64_t size = (i % 16 == 0 ? static_cast<uint64_t>(Rand::UintInclusiveRange(8, 32)) * 1024 * 1024
+		                             : static_cast<uint64_t>(Rand::UintInclusiveRange(1, 64)) * 256);
+		ranges.push_back({addr, size, i});
+		// Some objects alias the previous ones
+		addr += (i % 5 == 0 ? 0 : size);
+	}
+
+	std::vector<TestRange> queries;
+	for (int i = 0; i < QUERIES; i++)
+	{
+		const auto& r = ranges[Rand::UintInclusiveRange(0, NUM - 1)];
+		queries.push_back({r.start, r.size, r.id});
+	}
+
+	Timer timer;
+
+	PageMap m;
+	release_free_chunks();
+	timer.Start();
+	for (const auto& r: ranges)
+	{
+		m.Insert(r.start, r.size, r.id);
+	}
+	double m_insert = timer.GetTimeMs();
+	timer.Start();
+	uint64_t m_found = 0;
+	for (const auto& q: queries)
+	{
+		m_found += m.FindAll(q.start, q.size).Size();
+	}
+	double m_find = timer.GetTimeMs();
+	timer.Start();
+	for (const auto& r: ranges)
+	{
+		m.Erase(r.start, r.size, r.id);
+	}
+	double m_erase = timer.GetTimeMs();
+
+	IntervalTree t;
+	release_free_chunks();
+	timer.Start();
+	for (const auto& r: ranges)
+	{
+		t.Insert(r.start, r.size, r.id);
+	}
+	double t_insert = timer.GetTimeMs();
+	timer.Start();
+	uint64_t t_found = 0;
+	for (const auto& q: queries)
+	{
+		Vector<int> ids;
+		t.FindOverlaps(q.start, q.size, &ids);
+		t_found += ids.Size();
+	}
+	double t_find = timer.GetTimeMs();
+	timer.Start();
+	for (const auto& r: ranges)
+	{
+		t.Erase(r.start, r.size, r.id);
+	}
+	double t_erase = timer.GetTimeMs();
+
+	// Page buckets return false positives, the tree doesn't
+	EXPECT_GE(m_found, t_found);
+	EXPECT_TRUE(t.IsEmpty());
+
+	printf("interval tree, %d objects, %d queries: insert %.1f ms -> %.1f ms, find %.1f ms -> %.1f ms, erase %.1f ms -> %.1f ms\n", NUM,
+	       QUERIES, m_insert, t_insert, m_find, t_find, m_erase, t_erase);
+}
+
+TEST(Core, IntervalTreeBenchmark)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_benchmark();
+
+	UT_MEM_CHECK();
+}
+
+UT_END();
@@ -0,0 +1,84 @@
+#include "Kyty/Core/Timer.h"
+#include "Kyty/UnitTest.h"
+
+#include <cstring>
+#include <emmintrin.h>
+#include <vector>
+
+UT_BEGIN(CoreMemcpy);
+
+using Core::Timer;
+
+// Reference for the benchmark: 16-byte SSE2 loop, the kind of copy routine the guest libc is tuned for
+static void* copy_sse2(void* dst, const void* src, size_t n)
+{
+	auto*       d = static_cast<uint8_t*>(dst);
+	const auto* s = static_cast<const uint8_t*>(src);
+
+	for (; n >= 16; n -= 16, d += 16, s += 16)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+	}
+	for (; n > 0; n--)
+	{
+		*d++ = *s++;
+	}
+
+	return dst;
+}
+
+template <class F>
+static double measure(F func, uint8_t* dst, const uint8_t* src, size_t size, int repeat)
+{
+	Timer timer;
+	timer.Start();
+	for (int i = 0; i < repeat; i++)
+	{
+		// Shift the source a bit so that the loop can't be hoisted
+		func(dst, src + (i & 7), size);
+	}
+	return timer.GetTimeMs();
+}
+
+static void test_benchmark()
+{
+	struct Case
+	{
+		size_t size;
+		int    repeat;
+	};
+
+	static constexpr Case CASES[] = {{256, 200000}, {64 * 1024, 4000}, {1024 * 1024, 200}, {32 * 1024 * 1024, 8}};
+
+	std::vector<uint8_t> src(CASES[3].size + 64);
+	std::vector<uint8_t> dst1(CASES[3].size + 64);
+	std::vector<uint8_t> dst2(CASES[3].size + 64);
+
+	for (size_t i = 0; i < src.size(); i++)
+	{
+		src[i] = static_cast<uint8_t>(i * 7 + 3);
+	}
+
+	for (const auto& c: CASES)
+	{
+		double sse2_ms = measure(copy_sse2, dst1.data(), src.data(), c.size, c.repeat);
+		double host_ms = measure(std::memcpy, dst2.data(), src.data(), c.size, c.repeat);
+
+		EXPECT_EQ(std::memcmp(dst1.data(), dst2.data(), c.size), 0);
+
+		auto mb = static_cast<double>(c.size) * c.repeat / (1024.0 * 1024.0);
+
+		printf("memcpy %8zu bytes: sse2 loop %.1f MB/s, host %.1f MB/s\n", c.size, mb * 1000.0 / sse2_ms, mb * 1000.0 / host_ms);
+	}
+}
+
+TEST(Core, MemcpyBenchmark)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_benchmark();
+
+	UT_MEM_CHECK();
+}
+
+UT_END();
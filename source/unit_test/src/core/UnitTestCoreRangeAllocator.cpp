@@ -0,0 +1,149 @@
+#include "Kyty/Core/RangeAllocator.h"
+#include "Kyty/Core/Vector.h"
+#include "Kyty/Math/Rand.h"
+#include "Kyty/UnitTest.h"
+
+UT_BEGIN(CoreRangeAllocator);
+
+using Core::RangeAllocator;
+using Math::Rand;
+
+static constexpr uint64_t PAGE = 64 * 1024;
+
+static void test_best_fit()
+{
+	RangeAllocator a(0, 16 * PAGE);
+
+	uint64_t addr[8] {};
+	for (auto& p: addr)
+	{
+		EXPECT_TRUE(a.Alloc(0, UINT64_MAX, 2 * PAGE, PAGE, &p));
+	}
+
+	EXPECT_FALSE(a.Alloc(0, UINT64_MAX, PAGE, 0, &addr[0]));
+	EXPECT_EQ(a.GetFreeSize(), 0u);
+
+	// Holes: 2 pages at 0, 4 pages at 4, 2 pages at 12
+	EXPECT_TRUE(a.Free(0 * PAGE, 2 * PAGE));
+	EXPECT_TRUE(a.Free(4 * PAGE, 4 * PAGE));
+	EXPECT_TRUE(a.Free(12 * PAGE, 2 * PAGE));
+	EXPECT_EQ(a.GetFreeRangesNum(), 3u);
+	EXPECT_EQ(a.GetLargestFree(), 4 * PAGE);
+
+	// Double free
+	EXPECT_FALSE(a.Free(4 * PAGE, PAGE));
+	EXPECT_FALSE(a.Free(3 * PAGE, 2 * PAGE));
+	EXPECT_FALSE(a.Free(15 * PAGE, 2 * PAGE));
+
+	uint64_t p = 0;
+
+	// The smallest hole wins
+	EXPECT_TRUE(a.Alloc(0, UINT64_MAX, PAGE, 0, &p));
+	EXPECT_EQ(p, 0u);
+
+	// The search range skips the hole at 1
+	EXPECT_TRUE(a.Alloc(2 * PAGE, UINT64_MAX, PAGE, 0, &p));
+	EXPECT_EQ(p, 12 * PAGE);
+
+	// Alignment
+	EXPECT_FALSE(a.Alloc(0, UINT64_MAX, 2 * PAGE, 8 * PAGE, &p));
+	EXPECT_TRUE(a.Alloc(0, UINT64_MAX, 2 * PAGE, 2 * PAGE, &p));
+	EXPECT_EQ(p, 4 * PAGE);
+	EXPECT_FALSE(a.Alloc(0, 7 * PAGE, 2 * PAGE, 2 * PAGE, &p));
+
+	EXPECT_TRUE(a.Alloc(0, UINT64_MAX, PAGE, 0, &p));
+	EXPECT_EQ(p, PAGE);
+}
+
+struct TestBlock
+{
+	uint64_t addr = 0;
+	uint64_t size = 0;
+};
+
+static void test_stress()
+{
+	static constexpr uint64_t SIZE   = static_cast<uint64_t>(5376) * 1024 * 1024;
+	static constexpr uint32_t PAGES  = SIZE / PAGE;
+	static constexpr int      ROUNDS = 100000;
+
+	RangeAllocator    a(0, SIZE);
+	Vector<uint8_t>   used(PAGES, true);
+	Vector<TestBlock> blocks;
+	uint64_t          used_size = 0;
+	bool              ok        = true;
+
+	used.Memset(0);
+
+	for (int r = 0; r < ROUNDS && ok; r++)
+	{
+		if (blocks.IsEmpty() || Rand::Uint() % 5 < 3)
+		{
+			uint64_t size      = PAGE * Rand::UintInclusiveRange(1, 2048);
+			uint64_t alignment = PAGE << Rand::UintInclusiveRange(0, 5);
+			uint64_t start     = 0;
+			uint64_t end       = UINT64_MAX;
+
+			if (Rand::Uint() % 4 == 0)
+			{
+				start = PAGE * Rand::UintInclusiveRange(0, PAGES - 1);
+				end   = start + PAGE * Rand::UintInclusiveRange(1, PAGES);
+			}
+
+			uint64_t addr = 0;
+			if (!a.Alloc(start, end, size, alignment, &addr))
+			{
+				continue;
+			}
+
+			ok = ok && (addr % alignment) == 0 && addr >= start && addr + size <= end && addr + size <= SIZE;
+
+			for (uint64_t p = addr / PAGE; ok && p < (addr + size) / PAGE; p++)
+			{
+				ok      = (used[p] == 0);
+				used[p] = 1;
+			}
+
+			blocks.Add(TestBlock {addr, size});
+			used_size += size;
+		} else
+		{
+			uint32_t index = Rand::UintInclusiveRange(0, blocks.Size() - 1);
+			auto     b     = blocks.At(index);
+
+			ok = ok && a.Free(b.addr, b.size) && !a.Free(b.addr, b.size);
+
+			for (uint64_t p = b.addr / PAGE; p < (b.addr + b.size) / PAGE; p++)
+			{
+				used[p] = 0;
+			}
+
+			blocks.RemoveAt(index);
+			used_size -= b.size;
+		}
+
+		ok = ok && a.GetFreeSize() == SIZE - used_size;
+	}
+
+	EXPECT_TRUE(ok);
+
+	for (const auto& b: blocks)
+	{
+		EXPECT_TRUE(a.Free(b.addr, b.size));
+	}
+
+	EXPECT_EQ(a.GetFreeRangesNum(), 1u);
+	EXPECT_EQ(a.GetLargestFree(), SIZE);
+}
+
+TEST(Core, RangeAllocator)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_best_fit();
+	test_stress();
+
+	UT_MEM_CHECK();
+}
+
+UT_END();
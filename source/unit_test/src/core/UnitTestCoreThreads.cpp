@@ -0,0 +1,333 @@
+#include "Kyty/Core/Threads.h"
+#include "Kyty/Core/Timer.h"
+#include "Kyty/UnitTest.h"
+
+#include <atomic>
+#include <mutex>
+
+UT_BEGIN(CoreThreads);
+
+using Core::CondVar;
+using Core::LockGuard;
+using Core::Mutex;
+using Core::Thread;
+using Core::Timer;
+
+struct TryLockArgs
+{
+	Mutex* mutex  = nullptr;
+	bool   locked = false;
+};
+
+static void try_lock_func(void* arg)
+{
+	auto* a   = static_cast<TryLockArgs*>(arg);
+	a->locked = a->mutex->TryLock();
+	if (a->locked)
+	{
+		a->mutex->Unlock();
+	}
+}
+
+static bool try_lock_from_other_thread(Mutex* mutex)
+{
+	TryLockArgs args;
+	args.mutex = mutex;
+	Thread t(try_lock_func, &args);
+	t.Join();
+	return args.locked;
+}
+
+TEST(Core, MutexRecursive)
+{
+	UT_MEM_CHECK_INIT();
+
+	Mutex normal;
+	Mutex recursive(Mutex::Type::Recursive);
+
+	normal.Lock();
+	EXPECT_FALSE(try_lock_from_other_thread(&normal));
+	normal.Unlock();
+	EXPECT_TRUE(try_lock_from_other_thread(&normal));
+
+	recursive.Lock();
+	recursive.Lock();
+	EXPECT_TRUE(recursive.TryLock());
+	recursive.Unlock();
+	recursive.Unlock();
+	EXPECT_FALSE(try_lock_from_other_thread(&recursive));
+	recursive.Unlock();
+	EXPECT_TRUE(try_lock_from_other_thread(&recursive));
+
+	UT_MEM_CHECK();
+}
+
+template <class M>
+struct CounterArgs
+{
+	M*               mutex       = nullptr;
+	std::atomic_int* ready       = nullptr;
+	uint64_t*        counter     = nullptr;
+	int              threads_num = 0;
+	int              iterations  = 0;
+};
+
+template <class M>
+static void counter_func(void* arg)
+{
+	auto* a = static_cast<CounterArgs<M>*>(arg);
+
+	(*a->ready)++;
+	while (*a->ready < a->threads_num)
+	{
+	}
+
+	for (int i = 0; i < a->iterations; i++)
+	{
+		a->mutex->lock();
+		(*a->counter)++;
+		a->mutex->unlock();
+	}
+}
+
+// Core::Mutex with the names std::lock_guard expects
+struct CoreMutexAdapter
+{
+	Mutex mutex;
+	void  lock() { mutex.Lock(); }
+	void  unlock() { mutex.Unlock(); }
+};
+
+template <class M>
+static double test_counter(int threads_num, int iterations)
+{
+	static constexpr int THREADS_MAX = 16;
+
+	M               mutex;
+	std::atomic_int ready   = 0;
+	uint64_t        counter = 0;
+	CounterArgs<M>  args[THREADS_MAX];
+	Thread*         threads[THREADS_MAX] {};
+
+	Timer timer;
+	timer.Start();
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		args[i].mutex       = &mutex;
+		args[i].ready       = &ready;
+		args[i].counter     = &counter;
+		args[i].threads_num = threads_num;
+		args[i].iterations  = iterations;
+		threads[i]          = new Thread(counter_func<M>, &args[i]);
+	}
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		threads[i]->Join();
+		delete threads[i];
+	}
+
+	EXPECT_EQ(counter, static_cast<uint64_t>(threads_num) * iterations);
+
+	return timer.GetTimeMs();
+}
+
+TEST(Core, MutexContention)
+{
+	UT_MEM_CHECK_INIT();
+
+	static constexpr int ITERATIONS = 200000;
+
+	for (int threads_num: {1, 4, 8})
+	{
+		double std_mutex  = test_counter<std::recursive_mutex>(threads_num, ITERATIONS);
+		double core_mutex = test_counter<CoreMutexAdapter>(threads_num, ITERATIONS);
+
+		printf("mutex, %d threads x %d: std::recursive_mutex = %.1f ms, Core::Mutex = %.1f ms\n", threads_num, ITERATIONS, std_mutex,
+		       core_mutex);
+	}
+
+	UT_MEM_CHECK();
+}
+
+// Statically initialized object (like a guest PTHREAD_MUTEX_INITIALIZER), created on first use
+struct StaticSlot
+{
+	std::atomic<StaticSlot*> object  = nullptr;
+	std::atomic_int          created = 0;
+	Mutex                    mutex;
+};
+
+static StaticSlot* create_static(StaticSlot* slot)
+{
+	slot->created++;
+	return slot;
+}
+
+// What PthreadStaticObjects::CreateObject did before: the lock on every call
+static StaticSlot* get_locked(StaticSlot* slot)
+{
+	LockGuard lock(slot->mutex);
+
+	StaticSlot* obj = slot->object.load(std::memory_order_relaxed);
+	if (obj == nullptr)
+	{
+		obj = create_static(slot);
+		slot->object.store(obj, std::memory_order_relaxed);
+	}
+	return obj;
+}
+
+static StaticSlot* get_lazy(StaticSlot* slot)
+{
+	return Core::LazyCreate(&slot->object, &slot->mutex, [slot]() { return create_static(slot); });
+}
+
+using get_static_func_t = StaticSlot* (*)(StaticSlot*);
+
+struct StaticArgs
+{
+	StaticSlot*       slot        = nullptr;
+	get_static_func_t get         = nullptr;
+	std::atomic_int*  ready       = nullptr;
+	int               threads_num = 0;
+	int               iterations  = 0;
+	int               wrong       = 0;
+};
+
+static void static_func(void* arg)
+{
+	auto* a = static_cast<StaticArgs*>(arg);
+
+	(*a->ready)++;
+	while (*a->ready < a->threads_num)
+	{
+	}
+
+	for (int i = 0; i < a->iterations; i++)
+	{
+		if (a->get(a->slot) != a->slot)
+		{
+			a->wrong++;
+		}
+	}
+}
+
+static double test_static(get_static_func_t get, int threads_num, int iterations)
+{
+	static constexpr int THREADS_MAX = 16;
+
+	StaticSlot      slot;
+	std::atomic_int ready = 0;
+	StaticArgs      args[THREADS_MAX];
+	Thread*         threads[THREADS_MAX] {};
+
+	Timer timer;
+	timer.Start();
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		args[i].slot        = &slot;
+		args[i].get         = get;
+		args[i].ready       = &ready;
+		args[i].threads_num = threads_num;
+		args[i].iterations  = iterations;
+		threads[i]          = new Thread(static_func, &args[i]);
+	}
+
+	for (int i = 0; i < threads_num; i++)
+	{
+		threads[i]->Join();
+		delete threads[i];
+		EXPECT_EQ(args[i].wrong, 0);
+	}
+
+	EXPECT_EQ(slot.created.load(), 1);
+
+	return timer.GetTimeMs();
+}
+
+TEST(Core, LazyCreateContention)
+{
+	UT_MEM_CHECK_INIT();
+
+	static constexpr int ITERATIONS = 1000000;
+
+	for (int threads_num: {1, 4, 8})
+	{
+		double locked = test_static(get_locked, threads_num, ITERATIONS);
+		double lazy   = test_static(get_lazy, threads_num, ITERATIONS);
+
+		printf("static init, %d threads x %d: locked = %.1f ms, Core::LazyCreate = %.1f ms\n", threads_num, ITERATIONS, locked, lazy);
+	}
+
+	UT_MEM_CHECK();
+}
+
+struct QueueArgs
+{
+	Mutex    mutex;
+	CondVar  not_empty;
+	CondVar  not_full;
+	int      items = 0;
+	uint64_t sum   = 0;
+	int      total = 0;
+};
+
+static void consumer_func(void* arg)
+{
+	auto* a = static_cast<QueueArgs*>(arg);
+
+	for (int i = 0; i < a->total; i++)
+	{
+		LockGuard lock(a->mutex);
+		while (a->items == 0)
+		{
+			a->not_empty.Wait(&a->mutex);
+		}
+		a->items--;
+		a->sum += i;
+		a->not_full.Signal();
+	}
+}
+
+static void test_cond_var()
+{
+	QueueArgs args;
+	args.total = 100000;
+
+	Thread consumer(consumer_func, &args);
+
+	for (int i = 0; i < args.total; i++)
+	{
+		LockGuard lock(args.mutex);
+		while (args.items >= 4)
+		{
+			args.not_full.Wait(&args.mutex);
+		}
+		args.items++;
+		args.not_empty.Signal();
+	}
+
+	consumer.Join();
+
+	EXPECT_EQ(args.items, 0);
+	EXPECT_EQ(args.sum, static_cast<uint64_t>(args.total) * (args.total - 1) / 2);
+
+	{
+		LockGuard lock(args.mutex);
+		EXPECT_FALSE(args.not_empty.WaitFor(&args.mutex, 1000));
+	}
+}
+
+TEST(Core, CondVar)
+{
+	UT_MEM_CHECK_INIT();
+
+	test_cond_var();
+
+	UT_MEM_CHECK();
+}
+
+UT_END();